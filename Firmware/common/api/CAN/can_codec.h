@@ -0,0 +1,891 @@
+/*
+ * can_codec.h
+ * Typed payload structs for every message in canDef.json.
+ *
+ * GENERATED by generate_can_codec.py, do not edit by hand.
+ * Rerun the generator after changing canDef.json.
+ */
+
+#ifndef BRIZO_CAN_CODEC_H
+#define BRIZO_CAN_CODEC_H
+
+#include <stdint.h>
+#include "can_scale.h"
+
+// Payload fields are laid out little-endian, as on the LPC15XX
+namespace BRIZO_CAN{
+
+	/*
+	 * 0x060 NEUTRINO0_ALIVE - Neutrino heartbeat
+	 */
+	struct __attribute__((packed)) Neutrino0AlivePayload {
+		static constexpr int ID = 0x060;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint64_t loopTimeAvg;	// s
+
+		typedef CANScale<1, 1000000, uint64_t> loopTimeAvgScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino0AlivePayload) == 8, "0x060 payload size");
+
+	/*
+	 * 0x061 NEUTRINO1_ALIVE - Neutrino heartbeat
+	 */
+	struct __attribute__((packed)) Neutrino1AlivePayload {
+		static constexpr int ID = 0x061;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint64_t loopTimeAvg;	// s
+
+		typedef CANScale<1, 1000000, uint64_t> loopTimeAvgScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino1AlivePayload) == 8, "0x061 payload size");
+
+	/*
+	 * 0x062 NEUTRINO2_ALIVE - Neutrino heartbeat
+	 */
+	struct __attribute__((packed)) Neutrino2AlivePayload {
+		static constexpr int ID = 0x062;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint64_t loopTimeAvg;	// s
+
+		typedef CANScale<1, 1000000, uint64_t> loopTimeAvgScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino2AlivePayload) == 8, "0x062 payload size");
+
+	/*
+	 * 0x064 NEUTRINO4_ALIVE - Neutrino heartbeat
+	 */
+	struct __attribute__((packed)) Neutrino4AlivePayload {
+		static constexpr int ID = 0x064;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint64_t loopTimeAvg;	// s
+
+		typedef CANScale<1, 1000000, uint64_t> loopTimeAvgScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino4AlivePayload) == 8, "0x064 payload size");
+
+	/*
+	 * 0x070 WHEEL_HEART - wheel heartbeat; CPU load of the last window and the busiest window since the last heartbeat, see cpu_load.h
+	 */
+	struct __attribute__((packed)) WheelHeartPayload {
+		static constexpr int ID = 0x070;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint32_t uptime;	// s
+		uint16_t cpuLoad;	// %
+		uint16_t cpuPeak;	// %
+
+		typedef CANScale<1, 1000000, uint32_t> uptimeScale;	// x1e-06
+		typedef CANScale<1, 10, uint16_t> cpuLoadScale;	// x0.1
+		typedef CANScale<1, 10, uint16_t> cpuPeakScale;	// x0.1
+	};
+	static_assert(sizeof(WheelHeartPayload) == 8, "0x070 payload size");
+
+	/*
+	 * 0x071 WHEEL_ERROR - wheel errors
+	 */
+	struct __attribute__((packed)) WheelErrorPayload {
+		static constexpr int ID = 0x071;
+		static constexpr int INTERVAL_MS = 0;
+
+		uint8_t value;
+	};
+	static_assert(sizeof(WheelErrorPayload) == 1, "0x071 payload size");
+
+	/*
+	 * 0x072 WHEEL_WARN - wheel warnings
+	 */
+	struct __attribute__((packed)) WheelWarnPayload {
+		static constexpr int ID = 0x072;
+		static constexpr int INTERVAL_MS = 0;
+
+		uint8_t value;
+	};
+	static_assert(sizeof(WheelWarnPayload) == 1, "0x072 payload size");
+
+	/*
+	 * 0x074 WHEEL_TEMPS - wheel temperatures
+	 */
+	struct __attribute__((packed)) WheelTempsPayload {
+		static constexpr int ID = 0x074;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint8_t mcuTemp;	// C
+		uint8_t ledTemp;	// C
+		uint8_t powerTemp;	// C
+
+		typedef CANScale<1, 2, uint8_t> mcuTempScale;	// x0.5
+		typedef CANScale<1, 2, uint8_t> ledTempScale;	// x0.5
+		typedef CANScale<1, 2, uint8_t> powerTempScale;	// x0.5
+	};
+	static_assert(sizeof(WheelTempsPayload) == 3, "0x074 payload size");
+
+	/*
+	 * 0x100 CHASE_CAR_LIGHT_ON - Bitmap indicating which lights the chase car board is enabling on. 1 means turn on, 0 means ignore this light.
+	 */
+	struct __attribute__((packed)) ChaseCarLightOnPayload {
+		static constexpr int ID = 0x100;
+		static constexpr int INTERVAL_MS = 0;
+
+		uint16_t lightOnBitmap;	// bitmap
+	};
+	static_assert(sizeof(ChaseCarLightOnPayload) == 2, "0x100 payload size");
+
+	/*
+	 * 0x101 CHASE_CAR_LIGHT_OFF - Bitmap indicating which lights the chase car board is turning off. 1 means turn off, 0 means ignore this light.
+	 */
+	struct __attribute__((packed)) ChaseCarLightOffPayload {
+		static constexpr int ID = 0x101;
+		static constexpr int INTERVAL_MS = 0;
+
+		uint16_t lightOffBitmap;	// bitmap
+	};
+	static_assert(sizeof(ChaseCarLightOffPayload) == 2, "0x101 payload size");
+
+	/*
+	 * 0x250 DASH_DRIVE_DIR_AND_BRAKE - drive direction (FNR) and brake sensor state (pressed/unpressed)
+	 */
+	struct __attribute__((packed)) DashDriveDirAndBrakePayload {
+		static constexpr int ID = 0x250;
+		static constexpr int INTERVAL_MS = 100;
+
+		uint8_t driveDirection;	// enum
+		uint8_t brakeSensorStatus;	// enum
+	};
+	static_assert(sizeof(DashDriveDirAndBrakePayload) == 2, "0x250 payload size");
+
+	/*
+	 * 0x300 DASH_LIGHT_SET_STATES - State of various car lights
+	 */
+	struct __attribute__((packed)) DashLightSetStatesPayload {
+		static constexpr int ID = 0x300;
+		static constexpr int INTERVAL_MS = 200;
+
+		uint16_t lightStatesBitmap;	// bitmap
+	};
+	static_assert(sizeof(DashLightSetStatesPayload) == 2, "0x300 payload size");
+
+	/*
+	 * 0x301 WHEEL_TURN_SIGNALS_HORN - Turn signal and horn states. The interval is the minimum message send rate (the message is also sent if a horn/TS button is pressed/released)
+	 */
+	struct __attribute__((packed)) WheelTurnSignalsHornPayload {
+		static constexpr int ID = 0x301;
+		static constexpr int INTERVAL_MS = 250;
+
+		uint8_t leftTurnSignalState;	// enum
+		uint8_t rightTurnSignalState;	// enum
+		uint8_t hornButtonState;	// enum
+	};
+	static_assert(sizeof(WheelTurnSignalsHornPayload) == 3, "0x301 payload size");
+
+	/*
+	 * 0x302 DASH_PERIPHERALS_STATES - Bitmap. In general, 1 means on/pressed, 0 means off/unpressed. For 'Reverse Camera Button Enabled', 1/0 indicates whether button has toggled camera on/off
+	 */
+	struct __attribute__((packed)) DashPeripheralsStatesPayload {
+		static constexpr int ID = 0x302;
+		static constexpr int INTERVAL_MS = 250;
+
+		uint16_t peripheralsStatesBitmap;	// bitmap
+	};
+	static_assert(sizeof(DashPeripheralsStatesPayload) == 2, "0x302 payload size");
+
+	/*
+	 * 0x303 DASH_LIGHT_OUTPUT - Bitmap - raw output (1 or 0) of all light groups
+	 */
+	struct __attribute__((packed)) DashLightOutputPayload {
+		static constexpr int ID = 0x303;
+		static constexpr int INTERVAL_MS = 200;
+
+		uint16_t rawFlashingLightOutputBitmap;	// bitmap
+	};
+	static_assert(sizeof(DashLightOutputPayload) == 2, "0x303 payload size");
+
+	/*
+	 * 0x471 WHEEL_RAWBTN - wheel buttons raw
+	 */
+	struct __attribute__((packed)) WheelRawbtnPayload {
+		static constexpr int ID = 0x471;
+		static constexpr int INTERVAL_MS = 50;
+
+		uint16_t rawButtonData;
+	};
+	static_assert(sizeof(WheelRawbtnPayload) == 2, "0x471 payload size");
+
+	/*
+	 * 0x472 WHEEL_CAN_STATS - CAN buffer losses and high-water marks, sent when built with CAN_STATS
+	 */
+	struct __attribute__((packed)) WheelCanStatsPayload {
+		static constexpr int ID = 0x472;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint16_t rxOverflows;
+		uint16_t txRejects;
+		uint8_t rxHighWater;
+		uint8_t txHighWater;
+		uint16_t isrMaxUs;	// us
+	};
+	static_assert(sizeof(WheelCanStatsPayload) == 8, "0x472 payload size");
+
+	/*
+	 * 0x473 WHEEL_CAN_STATS_ID - Frames received and sent for one CAN ID (cycles through IDs, counts wrap), sent when built with CAN_STATS
+	 */
+	struct __attribute__((packed)) WheelCanStatsIdPayload {
+		static constexpr int ID = 0x473;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint16_t id;
+		uint16_t rx;
+		uint16_t tx;
+		uint16_t untracked;
+	};
+	static_assert(sizeof(WheelCanStatsIdPayload) == 8, "0x473 payload size");
+
+	/*
+	 * 0x474 WHEEL_TIMING_PROFILE - Main loop period and missed callback periods, sent when built with TIMING_PROFILE; buckets are log2 of the period in us
+	 */
+	struct __attribute__((packed)) WheelTimingProfilePayload {
+		static constexpr int ID = 0x474;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint16_t loopMeanUs;	// us
+		uint16_t loopMaxUs;	// us
+		uint8_t loopP50Bucket;
+		uint8_t loopP99Bucket;
+		uint16_t missed;
+	};
+	static_assert(sizeof(WheelTimingProfilePayload) == 8, "0x474 payload size");
+
+	/*
+	 * 0x475 WHEEL_TIMING_CALLBACK - Run time and lateness of one TimingCommon callback (cycles through callbacks), sent when built with TIMING_PROFILE
+	 */
+	struct __attribute__((packed)) WheelTimingCallbackPayload {
+		static constexpr int ID = 0x475;
+		static constexpr int INTERVAL_MS = 1000;
+
+		uint8_t slot;
+		uint8_t missed;
+		uint16_t meanRunUs;	// us
+		uint16_t maxRunUs;	// us
+		uint16_t maxLateUs;	// us
+	};
+	static_assert(sizeof(WheelTimingCallbackPayload) == 8, "0x475 payload size");
+
+	/*
+	 * 0x560 NEUTRINO0_SOLAR - mppt solar
+	 */
+	struct __attribute__((packed)) Neutrino0SolarPayload {
+		static constexpr int ID = 0x560;
+		static constexpr int INTERVAL_MS = 500;
+
+		int32_t voltage;	// V
+		int32_t current;	// A
+
+		typedef CANScale<9, 256, int32_t> voltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int32_t> currentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino0SolarPayload) == 8, "0x560 payload size");
+
+	/*
+	 * 0x561 NEUTRINO1_SOLAR - mppt solar
+	 */
+	struct __attribute__((packed)) Neutrino1SolarPayload {
+		static constexpr int ID = 0x561;
+		static constexpr int INTERVAL_MS = 500;
+
+		int32_t voltage;	// V
+		int32_t current;	// A
+
+		typedef CANScale<9, 256, int32_t> voltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int32_t> currentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino1SolarPayload) == 8, "0x561 payload size");
+
+	/*
+	 * 0x562 NEUTRINO2_SOLAR - mppt solar
+	 */
+	struct __attribute__((packed)) Neutrino2SolarPayload {
+		static constexpr int ID = 0x562;
+		static constexpr int INTERVAL_MS = 500;
+
+		int32_t voltage;	// V
+		int32_t current;	// A
+
+		typedef CANScale<9, 256, int32_t> voltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int32_t> currentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino2SolarPayload) == 8, "0x562 payload size");
+
+	/*
+	 * 0x564 NEUTRINO4_SOLAR - mppt solar
+	 */
+	struct __attribute__((packed)) Neutrino4SolarPayload {
+		static constexpr int ID = 0x564;
+		static constexpr int INTERVAL_MS = 500;
+
+		int32_t voltage;	// V
+		int32_t current;	// A
+
+		typedef CANScale<9, 256, int32_t> voltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int32_t> currentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino4SolarPayload) == 8, "0x564 payload size");
+
+	/*
+	 * 0x570 NEUTRINO0_BATTERY - mppt batt
+	 */
+	struct __attribute__((packed)) Neutrino0BatteryPayload {
+		static constexpr int ID = 0x570;
+		static constexpr int INTERVAL_MS = 500;
+
+		int32_t voltage;	// V
+		int32_t current;	// A
+
+		typedef CANScale<9, 256, int32_t> voltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int32_t> currentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino0BatteryPayload) == 8, "0x570 payload size");
+
+	/*
+	 * 0x571 NEUTRINO1_BATTERY - mppt batt
+	 */
+	struct __attribute__((packed)) Neutrino1BatteryPayload {
+		static constexpr int ID = 0x571;
+		static constexpr int INTERVAL_MS = 500;
+
+		int32_t voltage;	// V
+		int32_t current;	// A
+
+		typedef CANScale<9, 256, int32_t> voltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int32_t> currentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino1BatteryPayload) == 8, "0x571 payload size");
+
+	/*
+	 * 0x572 NEUTRINO2_BATTERY - mppt batt
+	 */
+	struct __attribute__((packed)) Neutrino2BatteryPayload {
+		static constexpr int ID = 0x572;
+		static constexpr int INTERVAL_MS = 500;
+
+		int32_t voltage;	// V
+		int32_t current;	// A
+
+		typedef CANScale<9, 256, int32_t> voltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int32_t> currentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino2BatteryPayload) == 8, "0x572 payload size");
+
+	/*
+	 * 0x574 NEUTRINO4_BATTERY - mppt batt
+	 */
+	struct __attribute__((packed)) Neutrino4BatteryPayload {
+		static constexpr int ID = 0x574;
+		static constexpr int INTERVAL_MS = 500;
+
+		int32_t voltage;	// V
+		int32_t current;	// A
+
+		typedef CANScale<9, 256, int32_t> voltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int32_t> currentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino4BatteryPayload) == 8, "0x574 payload size");
+
+	/*
+	 * 0x580 NEUTRINO0_SENSORS - mppt raw
+	 */
+	struct __attribute__((packed)) Neutrino0SensorsPayload {
+		static constexpr int ID = 0x580;
+		static constexpr int INTERVAL_MS = 500;
+
+		int16_t lastSolarVoltage;	// V
+		int16_t lastSolarCurrent;	// A
+		int16_t lastBatteryVoltage;	// V
+		int16_t lastBatteryCurrent;	// A
+
+		typedef CANScale<9, 256, int16_t> lastSolarVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastSolarCurrentScale;	// x0.0035903033088235292
+		typedef CANScale<9, 256, int16_t> lastBatteryVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastBatteryCurrentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino0SensorsPayload) == 8, "0x580 payload size");
+
+	/*
+	 * 0x581 NEUTRINO1_SENSORS - mppt raw
+	 */
+	struct __attribute__((packed)) Neutrino1SensorsPayload {
+		static constexpr int ID = 0x581;
+		static constexpr int INTERVAL_MS = 500;
+
+		int16_t lastSolarVoltage;	// V
+		int16_t lastSolarCurrent;	// A
+		int16_t lastBatteryVoltage;	// V
+		int16_t lastBatteryCurrent;	// A
+
+		typedef CANScale<9, 256, int16_t> lastSolarVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastSolarCurrentScale;	// x0.0035903033088235292
+		typedef CANScale<9, 256, int16_t> lastBatteryVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastBatteryCurrentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino1SensorsPayload) == 8, "0x581 payload size");
+
+	/*
+	 * 0x582 NEUTRINO2_SENSORS - mppt raw
+	 */
+	struct __attribute__((packed)) Neutrino2SensorsPayload {
+		static constexpr int ID = 0x582;
+		static constexpr int INTERVAL_MS = 500;
+
+		int16_t lastSolarVoltage;	// V
+		int16_t lastSolarCurrent;	// A
+		int16_t lastBatteryVoltage;	// V
+		int16_t lastBatteryCurrent;	// A
+
+		typedef CANScale<9, 256, int16_t> lastSolarVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastSolarCurrentScale;	// x0.0035903033088235292
+		typedef CANScale<9, 256, int16_t> lastBatteryVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastBatteryCurrentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino2SensorsPayload) == 8, "0x582 payload size");
+
+	/*
+	 * 0x584 NEUTRINO4_SENSORS - mppt raw
+	 */
+	struct __attribute__((packed)) Neutrino4SensorsPayload {
+		static constexpr int ID = 0x584;
+		static constexpr int INTERVAL_MS = 500;
+
+		int16_t lastSolarVoltage;	// V
+		int16_t lastSolarCurrent;	// A
+		int16_t lastBatteryVoltage;	// V
+		int16_t lastBatteryCurrent;	// A
+
+		typedef CANScale<9, 256, int16_t> lastSolarVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastSolarCurrentScale;	// x0.0035903033088235292
+		typedef CANScale<9, 256, int16_t> lastBatteryVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastBatteryCurrentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino4SensorsPayload) == 8, "0x584 payload size");
+
+	/*
+	 * 0x590 NEUTRINO0_TEMP - mppt temperature
+	 */
+	struct __attribute__((packed)) Neutrino0TempPayload {
+		static constexpr int ID = 0x590;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t value;	// C
+
+		typedef CANScale<1, 1000, uint32_t> valueScale;	// x0.001
+	};
+	static_assert(sizeof(Neutrino0TempPayload) == 4, "0x590 payload size");
+
+	/*
+	 * 0x591 NEUTRINO1_TEMP - mppt temperature
+	 */
+	struct __attribute__((packed)) Neutrino1TempPayload {
+		static constexpr int ID = 0x591;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t value;	// C
+
+		typedef CANScale<1, 1000, uint32_t> valueScale;	// x0.001
+	};
+	static_assert(sizeof(Neutrino1TempPayload) == 4, "0x591 payload size");
+
+	/*
+	 * 0x592 NEUTRINO2_TEMP - mppt temperature
+	 */
+	struct __attribute__((packed)) Neutrino2TempPayload {
+		static constexpr int ID = 0x592;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t value;	// C
+
+		typedef CANScale<1, 1000, uint32_t> valueScale;	// x0.001
+	};
+	static_assert(sizeof(Neutrino2TempPayload) == 4, "0x592 payload size");
+
+	/*
+	 * 0x594 NEUTRINO4_TEMP - mppt temperature
+	 */
+	struct __attribute__((packed)) Neutrino4TempPayload {
+		static constexpr int ID = 0x594;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t value;	// C
+
+		typedef CANScale<1, 1000, uint32_t> valueScale;	// x0.001
+	};
+	static_assert(sizeof(Neutrino4TempPayload) == 4, "0x594 payload size");
+
+	/*
+	 * 0x5A0 NEUTRINO0_DEBUG - state duty outputswitch
+	 */
+	struct __attribute__((packed)) Neutrino0DebugPayload {
+		static constexpr int ID = 0x5A0;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t state;	// enum
+		uint16_t CURR_DUTY;
+		uint16_t ledSt;
+	};
+	static_assert(sizeof(Neutrino0DebugPayload) == 6, "0x5A0 payload size");
+
+	/*
+	 * 0x5A1 NEUTRINO1_DEBUG - state duty outputswitch
+	 */
+	struct __attribute__((packed)) Neutrino1DebugPayload {
+		static constexpr int ID = 0x5A1;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t state;	// enum
+		uint16_t CURR_DUTY;
+		uint16_t ledSt;
+	};
+	static_assert(sizeof(Neutrino1DebugPayload) == 6, "0x5A1 payload size");
+
+	/*
+	 * 0x5A2 NEUTRINO2_DEBUG - state duty outputswitch
+	 */
+	struct __attribute__((packed)) Neutrino2DebugPayload {
+		static constexpr int ID = 0x5A2;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t state;	// enum
+		uint16_t CURR_DUTY;
+		uint16_t ledSt;
+	};
+	static_assert(sizeof(Neutrino2DebugPayload) == 6, "0x5A2 payload size");
+
+	/*
+	 * 0x5A4 NEUTRINO4_DEBUG - state duty outputswitch
+	 */
+	struct __attribute__((packed)) Neutrino4DebugPayload {
+		static constexpr int ID = 0x5A4;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t state;	// enum
+		uint16_t CURR_DUTY;
+		uint16_t ledSt;
+	};
+	static_assert(sizeof(Neutrino4DebugPayload) == 6, "0x5A4 payload size");
+
+	/*
+	 * 0x5B0 NEUTRINO0_LOGIC - gatedrive logic outputswitch logiccurr
+	 */
+	struct __attribute__((packed)) Neutrino0LogicPayload {
+		static constexpr int ID = 0x5B0;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t lastLogicV_12;	// V
+		uint16_t last3v3_12;	// V
+		uint16_t lastOutputVoltage16;	// V
+		uint16_t lastLogicCurr16;	// A
+
+		typedef CANScale<9, 256, uint16_t> lastOutputVoltage16Scale;	// x0.03515625
+		typedef CANScale<1, 144900, uint16_t> lastLogicCurr16Scale;	// x6.901306676843057e-06
+	};
+	static_assert(sizeof(Neutrino0LogicPayload) == 8, "0x5B0 payload size");
+
+	/*
+	 * 0x5B1 NEUTRINO1_LOGIC - gatedrive logic outputswitch logiccurr
+	 */
+	struct __attribute__((packed)) Neutrino1LogicPayload {
+		static constexpr int ID = 0x5B1;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t lastLogicV_12;	// V
+		uint16_t last3v3_12;	// V
+		uint16_t lastOutputVoltage16;	// V
+		uint16_t lastLogicCurr16;	// A
+
+		typedef CANScale<9, 256, uint16_t> lastOutputVoltage16Scale;	// x0.03515625
+		typedef CANScale<1, 144900, uint16_t> lastLogicCurr16Scale;	// x6.901306676843057e-06
+	};
+	static_assert(sizeof(Neutrino1LogicPayload) == 8, "0x5B1 payload size");
+
+	/*
+	 * 0x5B2 NEUTRINO2_LOGIC - gatedrive logic outputswitch logiccurr
+	 */
+	struct __attribute__((packed)) Neutrino2LogicPayload {
+		static constexpr int ID = 0x5B2;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t lastLogicV_12;	// V
+		uint16_t last3v3_12;	// V
+		uint16_t lastOutputVoltage16;	// V
+		uint16_t lastLogicCurr16;	// A
+
+		typedef CANScale<9, 256, uint16_t> lastOutputVoltage16Scale;	// x0.03515625
+		typedef CANScale<1, 144900, uint16_t> lastLogicCurr16Scale;	// x6.901306676843057e-06
+	};
+	static_assert(sizeof(Neutrino2LogicPayload) == 8, "0x5B2 payload size");
+
+	/*
+	 * 0x5B4 NEUTRINO4_LOGIC - gatedrive logic outputswitch logiccurr
+	 */
+	struct __attribute__((packed)) Neutrino4LogicPayload {
+		static constexpr int ID = 0x5B4;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t lastLogicV_12;	// V
+		uint16_t last3v3_12;	// V
+		uint16_t lastOutputVoltage16;	// V
+		uint16_t lastLogicCurr16;	// A
+
+		typedef CANScale<9, 256, uint16_t> lastOutputVoltage16Scale;	// x0.03515625
+		typedef CANScale<1, 144900, uint16_t> lastLogicCurr16Scale;	// x6.901306676843057e-06
+	};
+	static_assert(sizeof(Neutrino4LogicPayload) == 8, "0x5B4 payload size");
+
+	/*
+	 * 0x5C0 NEUTRINO0_LOOP - logicloop
+	 */
+	struct __attribute__((packed)) Neutrino0LoopPayload {
+		static constexpr int ID = 0x5C0;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint64_t loopTimeAvgSend;	// s
+
+		typedef CANScale<1, 1000000, uint64_t> loopTimeAvgSendScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino0LoopPayload) == 8, "0x5C0 payload size");
+
+	/*
+	 * 0x5C1 NEUTRINO1_LOOP - logicloop
+	 */
+	struct __attribute__((packed)) Neutrino1LoopPayload {
+		static constexpr int ID = 0x5C1;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t loopTimeAvgSend;	// s
+
+		typedef CANScale<1, 1000000, uint32_t> loopTimeAvgSendScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino1LoopPayload) == 4, "0x5C1 payload size");
+
+	/*
+	 * 0x5C2 NEUTRINO2_LOOP - logicloop
+	 */
+	struct __attribute__((packed)) Neutrino2LoopPayload {
+		static constexpr int ID = 0x5C2;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t loopTimeAvgSend;	// s
+
+		typedef CANScale<1, 1000000, uint32_t> loopTimeAvgSendScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino2LoopPayload) == 4, "0x5C2 payload size");
+
+	/*
+	 * 0x5C4 NEUTRINO4_LOOP - logicloop
+	 */
+	struct __attribute__((packed)) Neutrino4LoopPayload {
+		static constexpr int ID = 0x5C4;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t loopTimeAvgSend;	// s
+
+		typedef CANScale<1, 1000000, uint32_t> loopTimeAvgSendScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino4LoopPayload) == 4, "0x5C4 payload size");
+
+	/*
+	 * 0x5D0 NEUTRINO0_LOOP2 - logicloop
+	 */
+	struct __attribute__((packed)) Neutrino0Loop2Payload {
+		static constexpr int ID = 0x5D0;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t loopTimeMinSend;	// s
+		uint32_t loopTimeMaxSend;	// s
+
+		typedef CANScale<1, 1000000, uint32_t> loopTimeMinSendScale;	// x1e-06
+		typedef CANScale<1, 1000000, uint32_t> loopTimeMaxSendScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino0Loop2Payload) == 8, "0x5D0 payload size");
+
+	/*
+	 * 0x5D1 NEUTRINO1_LOOP2 - logicloop
+	 */
+	struct __attribute__((packed)) Neutrino1Loop2Payload {
+		static constexpr int ID = 0x5D1;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t loopTimeMinSend;	// s
+		uint32_t loopTimeMaxSend;	// s
+
+		typedef CANScale<1, 1000000, uint32_t> loopTimeMinSendScale;	// x1e-06
+		typedef CANScale<1, 1000000, uint32_t> loopTimeMaxSendScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino1Loop2Payload) == 8, "0x5D1 payload size");
+
+	/*
+	 * 0x5D2 NEUTRINO2_LOOP2 - logicloop
+	 */
+	struct __attribute__((packed)) Neutrino2Loop2Payload {
+		static constexpr int ID = 0x5D2;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t loopTimeMinSend;	// s
+		uint32_t loopTimeMaxSend;	// s
+
+		typedef CANScale<1, 1000000, uint32_t> loopTimeMinSendScale;	// x1e-06
+		typedef CANScale<1, 1000000, uint32_t> loopTimeMaxSendScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino2Loop2Payload) == 8, "0x5D2 payload size");
+
+	/*
+	 * 0x5D4 NEUTRINO4_LOOP2 - logicloop
+	 */
+	struct __attribute__((packed)) Neutrino4Loop2Payload {
+		static constexpr int ID = 0x5D4;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t loopTimeMinSend;	// s
+		uint32_t loopTimeMaxSend;	// s
+
+		typedef CANScale<1, 1000000, uint32_t> loopTimeMinSendScale;	// x1e-06
+		typedef CANScale<1, 1000000, uint32_t> loopTimeMaxSendScale;	// x1e-06
+	};
+	static_assert(sizeof(Neutrino4Loop2Payload) == 8, "0x5D4 payload size");
+
+	/*
+	 * 0x5E0 NEUTRINO0_WARNING - Neutrino warning values
+	 */
+	struct __attribute__((packed)) Neutrino0WarningPayload {
+		static constexpr int ID = 0x5E0;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t prevState;	// enum
+		uint16_t lastFaultReason;	// enum
+		uint16_t lastOutputVoltage16;	// V
+
+		typedef CANScale<9, 256, uint16_t> lastOutputVoltage16Scale;	// x0.03515625
+	};
+	static_assert(sizeof(Neutrino0WarningPayload) == 6, "0x5E0 payload size");
+
+	/*
+	 * 0x5E1 NEUTRINO1_WARNING - Neutrino warning values
+	 */
+	struct __attribute__((packed)) Neutrino1WarningPayload {
+		static constexpr int ID = 0x5E1;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t prevState;	// enum
+		uint16_t lastFaultReason;	// enum
+		uint16_t lastOutputVoltage16;	// V
+
+		typedef CANScale<9, 256, uint16_t> lastOutputVoltage16Scale;	// x0.03515625
+	};
+	static_assert(sizeof(Neutrino1WarningPayload) == 6, "0x5E1 payload size");
+
+	/*
+	 * 0x5E2 NEUTRINO2_WARNING - Neutrino warning values
+	 */
+	struct __attribute__((packed)) Neutrino2WarningPayload {
+		static constexpr int ID = 0x5E2;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint16_t prevState;	// enum
+		uint16_t lastFaultReason;	// enum
+		uint16_t lastOutputVoltage16;	// V
+
+		typedef CANScale<9, 256, uint16_t> lastOutputVoltage16Scale;	// x0.03515625
+	};
+	static_assert(sizeof(Neutrino2WarningPayload) == 6, "0x5E2 payload size");
+
+	/*
+	 * 0x5E4 NEUTRINO4_WARNING - Neutrino warning values
+	 */
+	struct __attribute__((packed)) Neutrino4WarningPayload {
+		static constexpr int ID = 0x5E4;
+		static constexpr int INTERVAL_MS = 500;
+
+		uint32_t prevState;	// enum
+		uint32_t lastFaultReason;	// enum
+	};
+	static_assert(sizeof(Neutrino4WarningPayload) == 8, "0x5E4 payload size");
+
+	/*
+	 * 0x5F0 NEUTRINO0_WSENSORS - Sensor values sent with warning
+	 */
+	struct __attribute__((packed)) Neutrino0WsensorsPayload {
+		static constexpr int ID = 0x5F0;
+		static constexpr int INTERVAL_MS = 500;
+
+		int16_t lastSolarVoltage;	// V
+		int16_t lastSolarCurrent;	// A
+		int16_t lastBatteryVoltage;	// V
+		int16_t lastBatteryCurrent;	// A
+
+		typedef CANScale<9, 256, int16_t> lastSolarVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastSolarCurrentScale;	// x0.0035903033088235292
+		typedef CANScale<9, 256, int16_t> lastBatteryVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastBatteryCurrentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino0WsensorsPayload) == 8, "0x5F0 payload size");
+
+	/*
+	 * 0x5F1 NEUTRINO1_WSENSORS - Sensor values sent with warning
+	 */
+	struct __attribute__((packed)) Neutrino1WsensorsPayload {
+		static constexpr int ID = 0x5F1;
+		static constexpr int INTERVAL_MS = 500;
+
+		int16_t lastSolarVoltage;	// V
+		int16_t lastSolarCurrent;	// A
+		int16_t lastBatteryVoltage;	// V
+		int16_t lastBatteryCurrent;	// A
+
+		typedef CANScale<9, 256, int16_t> lastSolarVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastSolarCurrentScale;	// x0.0035903033088235292
+		typedef CANScale<9, 256, int16_t> lastBatteryVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastBatteryCurrentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino1WsensorsPayload) == 8, "0x5F1 payload size");
+
+	/*
+	 * 0x5F2 NEUTRINO2_WSENSORS - Sensor values sent with warning
+	 */
+	struct __attribute__((packed)) Neutrino2WsensorsPayload {
+		static constexpr int ID = 0x5F2;
+		static constexpr int INTERVAL_MS = 500;
+
+		int16_t lastSolarVoltage;	// V
+		int16_t lastSolarCurrent;	// A
+		int16_t lastBatteryVoltage;	// V
+		int16_t lastBatteryCurrent;	// A
+
+		typedef CANScale<9, 256, int16_t> lastSolarVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastSolarCurrentScale;	// x0.0035903033088235292
+		typedef CANScale<9, 256, int16_t> lastBatteryVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastBatteryCurrentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino2WsensorsPayload) == 8, "0x5F2 payload size");
+
+	/*
+	 * 0x5F4 NEUTRINO4_WSENSORS - Sensor values sent with warning
+	 */
+	struct __attribute__((packed)) Neutrino4WsensorsPayload {
+		static constexpr int ID = 0x5F4;
+		static constexpr int INTERVAL_MS = 500;
+
+		int16_t lastSolarVoltage;	// V
+		int16_t lastSolarCurrent;	// A
+		int16_t lastBatteryVoltage;	// V
+		int16_t lastBatteryCurrent;	// A
+
+		typedef CANScale<9, 256, int16_t> lastSolarVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastSolarCurrentScale;	// x0.0035903033088235292
+		typedef CANScale<9, 256, int16_t> lastBatteryVoltageScale;	// x0.03515625
+		typedef CANScale<36, 10027, int16_t> lastBatteryCurrentScale;	// x0.0035903033088235292
+	};
+	static_assert(sizeof(Neutrino4WsensorsPayload) == 8, "0x5F4 payload size");
+
+} // end namespace BRIZO_CAN
+
+#endif /* BRIZO_CAN_CODEC_H */
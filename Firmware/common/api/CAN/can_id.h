@@ -47,6 +47,9 @@ namespace BRIZO_CAN{
 	constexpr can_message_info WHEEL_ERROR		{0x071, 0};
 	constexpr can_message_info WHEEL_WARN		{0x072, 0};
 	constexpr can_message_info WHEEL_TEMPS		{0x074, 1000000};
+	// TELEMETRY; the time sync must stay its highest priority message
+	constexpr can_message_info TELEMETRY_TIME_SYNC		{0x0A0, 1000000};
+	constexpr can_message_info TELEMETRY_TIME_FOLLOW_UP	{0x0A1, 0};
 
 	// 0x1## Reserved for Testing and Chase Car messages
 	constexpr can_message_info CHASE_CAR_LIGHT_ON		{0x100, 0};
@@ -63,9 +66,22 @@ namespace BRIZO_CAN{
 	// 0x4## Diagnostics info and Raw data
 
 	//Wheel Diagnostics
-	const can_message_info WHEEL_RAWBTN			{0x471, 50000};
+	constexpr can_message_info WHEEL_RAWBTN		{0x471, 50000};
+	constexpr can_message_info WHEEL_CAN_STATS		{0x472, 1000000};
+	constexpr can_message_info WHEEL_CAN_STATS_ID	{0x473, 1000000};
+	constexpr can_message_info WHEEL_TIMING_PROFILE		{0x474, 1000000};
+	constexpr can_message_info WHEEL_TIMING_CALLBACK	{0x475, 1000000};
 
 	// 0x56# to 0x5FF Reserved for Neutrino MPPTs
+
+	// 0x6#0 and 0x6#8 Bootloader requests and replies, # as in the heartbeat ID
+	constexpr can_message_info DEMO_BOOT_REQUEST	{0x620, 0};
+	constexpr can_message_info DEMO_BOOT_REPLY		{0x628, 0};
+	constexpr can_message_info DASH_BOOT_REQUEST	{0x650, 0};
+	constexpr can_message_info DASH_BOOT_REPLY		{0x658, 0};
+	constexpr can_message_info WHEEL_BOOT_REQUEST	{0x670, 0};
+	constexpr can_message_info WHEEL_BOOT_REPLY		{0x678, 0};
+
 	// 0x7F0 to 0x7FF Reserved for Wavesculptor MPPTs
 
 } // end namespace CAN
@@ -0,0 +1,190 @@
+/*
+ * can_scale.h
+ * Integer-only conversion between raw CAN values and physical units.
+ */
+
+#ifndef BRIZO_CAN_SCALE_H
+#define BRIZO_CAN_SCALE_H
+
+#include <stdint.h>
+
+namespace BRIZO_CAN{
+
+	namespace scaleDetail {
+
+		constexpr int64_t gcd(int64_t a, int64_t b) {
+			return b == 0 ? a : gcd(b, a % b);
+		}
+
+		// Largest magnitude of a value of type T, of either sign, as far as
+		// an int64_t goes
+		template <typename T>
+		constexpr uint64_t maxMagnitude() {
+			return sizeof(T) >= 8 ? ((uint64_t)1 << 63) - 1 :
+					(T)-1 < 0 ? (uint64_t)1 << (sizeof(T) * 8 - 1) : (uint64_t)(T)-1;
+		}
+
+		// In 32 bits for types that fit, so the upper word is known to be 0
+		template <typename T>
+		constexpr uint64_t magnitude(T value) {
+			return sizeof(T) <= 4 ? (value < 0 ? 0 - (uint32_t)value : (uint32_t)value) :
+					value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+		}
+
+		// Shift s of the reciprocal below: q and rem are Mul * 2^s / Div,
+		// doubled until q has its top bit set
+		constexpr int reciprocalShift(uint64_t q, uint64_t rem, uint64_t den, int s) {
+			return q >> 63 ? s : reciprocalShift(q * 2 + (rem * 2 >= den), rem * 2 >= den ? rem * 2 - den : rem * 2, den, s + 1);
+		}
+
+		constexpr uint64_t reciprocal(uint64_t q, uint64_t rem, uint64_t den) {
+			return q >> 63 ? q : reciprocal(q * 2 + (rem * 2 >= den), rem * 2 >= den ? rem * 2 - den : rem * 2, den);
+		}
+
+		// (hi:lo) >> s for a 128-bit value
+		constexpr uint64_t shift128(uint64_t hi, uint64_t lo, int s) {
+			return s >= 64 ? hi >> (s - 64) : s == 0 ? lo : (hi << (64 - s)) | (lo >> s);
+		}
+
+		// x * m >> s from 32 x 32-bit products; mid is the middle column
+		constexpr uint64_t mulShift(uint64_t p00, uint64_t p01, uint64_t p10, uint64_t p11, uint64_t mid, int s) {
+			return shift128(p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32), (mid << 32) | (uint32_t)p00, s);
+		}
+
+		constexpr uint64_t mulShift(uint64_t x, uint64_t m, int s) {
+			return mulShift((uint64_t)(uint32_t)x * (uint32_t)m, (uint64_t)(uint32_t)x * (m >> 32),
+					(x >> 32) * (uint32_t)m, (x >> 32) * (m >> 32),
+					(((uint64_t)(uint32_t)x * (uint32_t)m) >> 32) + (uint32_t)((uint64_t)(uint32_t)x * (m >> 32))
+							+ (uint32_t)((x >> 32) * (uint32_t)m), s);
+		}
+
+		// Step q to the one remainder r (mod 2^64, negative from 2^63 up)
+		// of 0 to den2 - 1 belongs to
+		constexpr uint64_t correct(uint64_t q, uint64_t r, uint64_t den2) {
+			return r >> 63 ? correct(q - 1, r + den2, den2) : r >= den2 ? correct(q + 1, r - den2, den2) : q;
+		}
+
+		/*
+		 * x * Mul / Div rounded half up, for x up to MaxIn and results
+		 * within int64_t.
+		 *
+		 * If the sum never leaves 32 bits it is one 32-bit multiply and
+		 * divide. Otherwise x is multiplied by a 64-bit reciprocal of Div
+		 * worked out at compile time, which is at most one below the
+		 * quotient, and the exact remainder (mod 2^64) steps it to the
+		 * rounded result. Neither calls a 64-bit division routine such as
+		 * __aeabi_ldivmod.
+		 */
+		template <uint64_t Mul, uint64_t Div, uint64_t MaxIn>
+		struct Scaler {
+			static_assert(Mul > 0 && Mul <= 0xFFFFFFFF && Div > 0 && Div <= 0xFFFFFFFF,
+					"Reduced scale factor must fit in 32 bits");
+
+			static constexpr bool narrow() {
+				return MaxIn <= 0xFFFFFFFF && MaxIn <= (0xFFFFFFFF - Div / 2) / Mul;
+			}
+
+			// Mul / Div * 2^shift(), with its top bit set
+			static constexpr uint64_t factor() {
+				return reciprocal(Mul / Div, Mul % Div, Div);
+			}
+
+			static constexpr int shift() {
+				return reciprocalShift(Mul / Div, Mul % Div, Div, 0);
+			}
+
+			// Rounded result from q, the truncated quotient or one below
+			static constexpr uint64_t round(uint64_t x, uint64_t q) {
+				return correct(q, x * 2 * Mul + Div - q * 2 * Div, 2 * Div);
+			}
+
+			static constexpr uint64_t apply(uint64_t x) {
+				return narrow() ?
+						((uint32_t)x * (uint32_t)Mul + (uint32_t)(Div / 2)) / (uint32_t)Div :
+						round(x, mulShift(x, factor(), shift()));
+			}
+
+			// MaxIn * Mul / Div rounded down, at most INT64_MAX
+			static constexpr uint64_t maxOut() {
+				return MaxIn / Div > ((((uint64_t)1 << 63) - 1) - Mul) / Mul ? ((uint64_t)1 << 63) - 1 :
+						MaxIn / Div * Mul + MaxIn % Div * Mul / Div;
+			}
+		};
+
+	} // end namespace scaleDetail
+
+	/*
+	 * Fixed-point scale factor Num/Den, the canDef.json Multiplier of a value
+	 * sent as a Raw.
+	 *
+	 * Resolution picks the unit of the integer result: 1 gives whole units,
+	 * 1000 gives thousandths (mV for a value in V), and so on. The combined
+	 * factor Num * Resolution / Den is reduced at compile time, so scales
+	 * like 1/2 at a resolution of 1000 become a single multiply by 500.
+	 *
+	 * Results are rounded to the nearest unit, halves away from zero. The
+	 * range of Raw decides the arithmetic: if every raw value scales within
+	 * 32 bits it is 32-bit only, as for most 8 and 16-bit fields. Otherwise
+	 * it multiplies by a reciprocal instead of dividing, so no conversion
+	 * pulls in the 64-bit division routines. For 64-bit fields the caller is
+	 * responsible for keeping raw * Num * Resolution / Den within int64_t.
+	 *
+	 * Example usage:
+	 *   // 0x74 WHEEL_TEMPS sends temperatures in 0.5 C steps
+	 *   int32_t tenthsC = WheelTempsPayload::mcuTempScale::toUnits<10>(payload.mcuTemp);
+	 *   payload.mcuTemp = WheelTempsPayload::mcuTempScale::fromUnits<10>(425);	// 42.5 C
+	 */
+	template <int64_t Num, int64_t Den, typename Raw = int32_t>
+	struct CANScale {
+		static_assert(Num > 0 && Den > 0, "Scale must be positive");
+		static_assert(sizeof(Raw) <= 8, "Raw must be an integer of at most 64 bits");
+
+		/**
+		 * Convert a raw value to units of 1/Resolution.
+		 * @param raw value as sent on the bus
+		 * @return scaled value
+		 */
+		template <int64_t Resolution>
+		static constexpr int64_t toUnits(Raw raw) {
+			return raw < 0 ?
+					-(int64_t)ToScaler<Resolution>::apply(scaleDetail::magnitude(raw)) :
+					(int64_t)ToScaler<Resolution>::apply(scaleDetail::magnitude(raw));
+		}
+
+		/**
+		 * Convert a value in units of 1/Resolution to the raw value to send.
+		 * Values beyond what Raw can carry are clamped first.
+		 * Note: the caller is responsible for checking that the result fits
+		 *       the field it is stored in, e.g. that it is not negative
+		 * @param value scaled value
+		 * @return raw value
+		 */
+		template <int64_t Resolution>
+		static constexpr int64_t fromUnits(int64_t value) {
+			return value < 0 ?
+					-(int64_t)FromScaler<Resolution>::apply(clamp<Resolution>(scaleDetail::magnitude(value))) :
+					(int64_t)FromScaler<Resolution>::apply(clamp<Resolution>(scaleDetail::magnitude(value)));
+		}
+
+	private:
+		template <int64_t Resolution>
+		using ToScaler = scaleDetail::Scaler<
+				Num * Resolution / scaleDetail::gcd(Num * Resolution, Den),
+				Den / scaleDetail::gcd(Num * Resolution, Den),
+				scaleDetail::maxMagnitude<Raw>()>;
+
+		template <int64_t Resolution>
+		using FromScaler = scaleDetail::Scaler<
+				Den / scaleDetail::gcd(Num * Resolution, Den),
+				Num * Resolution / scaleDetail::gcd(Num * Resolution, Den),
+				ToScaler<Resolution>::maxOut()>;
+
+		template <int64_t Resolution>
+		static constexpr uint64_t clamp(uint64_t value) {
+			return value > ToScaler<Resolution>::maxOut() ? ToScaler<Resolution>::maxOut() : value;
+		}
+	};
+
+} // end namespace BRIZO_CAN
+
+#endif /* BRIZO_CAN_SCALE_H */
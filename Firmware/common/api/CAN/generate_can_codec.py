@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+"""
+generate_can_codec.py
+Generates can_codec.h, the typed payload structs for every message in canDef.json.
+
+Usage:
+    python3 generate_can_codec.py           # rewrite can_codec.h
+    python3 generate_can_codec.py --check   # exit 1 if can_codec.h is out of date
+"""
+
+import json
+import os
+import re
+import sys
+from fractions import Fraction
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+CAN_DEF = os.path.join(HERE, "canDef.json")
+OUTPUT = os.path.join(HERE, "can_codec.h")
+
+# DataFormat -> (C++ type, size in bytes)
+TYPES = {
+    "FloatLE": ("float", 4),
+    "Uint64LE": ("uint64_t", 8),
+    "Int64LE": ("int64_t", 8),
+    "Uint32LE": ("uint32_t", 4),
+    "Int32LE": ("int32_t", 4),
+    "Uint16LE": ("uint16_t", 2),
+    "Uint16": ("uint16_t", 2),
+    "Int16LE": ("int16_t", 2),
+    "Uint8": ("uint8_t", 1),
+    "Uint8LE": ("uint8_t", 1),
+    "BitMap8LE": ("uint8_t", 1),
+    "BitMap16LE": ("uint16_t", 2),
+    "BitMap32LE": ("uint32_t", 4),
+}
+
+# Largest relative error allowed when turning a Multiplier into a fraction
+SCALE_TOLERANCE = 1e-6
+
+IDENTIFIER = re.compile(r"^[A-Za-z_][A-Za-z0-9_]*$")
+
+
+def warn(key, text):
+    sys.stderr.write("canDef.json %s: %s\n" % (key, text))
+
+
+def as_list(value, count):
+    """Expand a scalar field to one entry per value."""
+    if isinstance(value, list):
+        return value
+    return [value] * count
+
+
+def struct_name(data_name):
+    """WHEEL_TEMPS -> WheelTempsPayload"""
+    words = [w for w in re.split(r"[^A-Za-z0-9]+", data_name) if w]
+    return "".join(w[0].upper() + w[1:].lower() for w in words) + "Payload"
+
+
+def field_name(value_name):
+    """'MCU Temp' -> mcuTemp; identifiers only get their first letter lowered."""
+    if not isinstance(value_name, str) or not value_name.strip():
+        return None
+    if IDENTIFIER.match(value_name):
+        return value_name if value_name.isupper() else value_name[0].lower() + value_name[1:]
+    words = [w for w in re.split(r"[^A-Za-z0-9]+", value_name) if w]
+    if not words:
+        return None
+    name = words[0].lower() + "".join(w[0].upper() + w[1:] for w in words[1:])
+    if name[0].isdigit():
+        name = "value" + name
+    return name
+
+
+def scale(multiplier):
+    """Smallest-denominator fraction within SCALE_TOLERANCE of the multiplier."""
+    if multiplier is None:
+        return None
+    exact = Fraction(repr(float(multiplier)))
+    if exact <= 0:
+        return None
+    for bits in range(0, 32):
+        fraction = exact.limit_denominator(1 << bits)
+        if fraction > 0 and abs(fraction - exact) / exact <= SCALE_TOLERANCE:
+            break
+    if fraction == 1:
+        return None
+    return fraction
+
+
+def units_comment(units):
+    if isinstance(units, str) and units:
+        return units
+    if isinstance(units, dict):
+        return "enum"
+    if isinstance(units, list):
+        return "bitmap"
+    return ""
+
+
+def message(key, entry):
+    count = entry.get("DataQty", 1)
+    formats = as_list(entry["DataFormat"], count)
+    names = entry.get("ValueNames")
+    if not isinstance(names, list):
+        names = [names]
+    multipliers = as_list(entry.get("Multiplier", 1), count)
+    units = entry.get("Units")
+    if not isinstance(units, list) or count == 1:
+        units = as_list(units, count) if count > 1 else [units]
+
+    if len(formats) != count:
+        warn(key, "%d DataFormats for DataQty %d" % (len(formats), count))
+    if len(names) > 1 and len(names) != count:
+        warn(key, "%d ValueNames for DataQty %d" % (len(names), count))
+    if len(multipliers) != count:
+        warn(key, "%d Multipliers for DataQty %d" % (len(multipliers), count))
+
+    fields = []
+    used = set()
+    for i in range(count):
+        data_format = formats[min(i, len(formats) - 1)]
+        if data_format not in TYPES:
+            raise SystemExit("canDef.json %s: unknown DataFormat %s" % (key, data_format))
+        ctype, size = TYPES[data_format]
+
+        name = field_name(names[i]) if i < len(names) else None
+        if name is None:
+            name = "value" if count == 1 else "value%d" % i
+        while name in used:
+            name += "_"
+        used.add(name)
+
+        multiplier = multipliers[i] if i < len(multipliers) else 1
+        fields.append({
+            "name": name,
+            "type": ctype,
+            "size": size,
+            "scale": None if ctype == "float" else scale(multiplier),
+            "multiplier": multiplier,
+            "units": units_comment(units[i] if i < len(units) else None),
+        })
+
+    interval = entry.get("Interval", -1)
+    return {
+        "id": int(key, 16),
+        "name": entry["DataName"],
+        "struct": struct_name(entry["DataName"]),
+        "description": entry.get("Description", ""),
+        "interval": interval if isinstance(interval, int) and interval > 0 else 0,
+        "fields": fields,
+        "size": sum(f["size"] for f in fields),
+    }
+
+
+def render(messages):
+    out = []
+    out.append("/*")
+    out.append(" * can_codec.h")
+    out.append(" * Typed payload structs for every message in canDef.json.")
+    out.append(" *")
+    out.append(" * GENERATED by generate_can_codec.py, do not edit by hand.")
+    out.append(" * Rerun the generator after changing canDef.json.")
+    out.append(" */")
+    out.append("")
+    out.append("#ifndef BRIZO_CAN_CODEC_H")
+    out.append("#define BRIZO_CAN_CODEC_H")
+    out.append("")
+    out.append("#include <stdint.h>")
+    out.append('#include "can_scale.h"')
+    out.append("")
+    out.append("// Payload fields are laid out little-endian, as on the LPC15XX")
+    out.append("namespace BRIZO_CAN{")
+
+    for m in messages:
+        out.append("")
+        out.append("\t/*")
+        out.append("\t * 0x%03X %s" % (m["id"], m["name"]) +
+                   (" - %s" % m["description"] if m["description"] else ""))
+        out.append("\t */")
+        out.append("\tstruct __attribute__((packed)) %s {" % m["struct"])
+        out.append("\t\tstatic constexpr int ID = 0x%03X;" % m["id"])
+        out.append("\t\tstatic constexpr int INTERVAL_MS = %d;" % m["interval"])
+        out.append("")
+        for f in m["fields"]:
+            line = "\t\t%s %s;" % (f["type"], f["name"])
+            if f["units"]:
+                line += "\t// %s" % f["units"]
+            out.append(line)
+        scaled = [f for f in m["fields"] if f["scale"] is not None]
+        if scaled:
+            out.append("")
+            for f in scaled:
+                out.append("\t\ttypedef CANScale<%d, %d, %s> %sScale;\t// x%r" % (
+                    f["scale"].numerator, f["scale"].denominator, f["type"], f["name"], f["multiplier"]))
+        out.append("\t};")
+        out.append("\tstatic_assert(sizeof(%s) == %d, \"0x%03X payload size\");" % (
+            m["struct"], m["size"], m["id"]))
+
+    out.append("")
+    out.append("} // end namespace BRIZO_CAN")
+    out.append("")
+    out.append("#endif /* BRIZO_CAN_CODEC_H */")
+    out.append("")
+    return "\n".join(out)
+
+
+def main():
+    with open(CAN_DEF) as f:
+        definitions = json.load(f)
+
+    messages = [message(key, entry) for key, entry in definitions.items()]
+    messages.sort(key=lambda m: m["id"])
+
+    seen = {}
+    for m in messages:
+        if m["size"] > 8:
+            raise SystemExit("canDef.json 0x%03X: payload is %d bytes" % (m["id"], m["size"]))
+        if m["struct"] in seen:
+            raise SystemExit("canDef.json 0x%03X: DataName %s also used by 0x%03X" % (
+                m["id"], m["name"], seen[m["struct"]]))
+        seen[m["struct"]] = m["id"]
+
+    text = render(messages)
+
+    if "--check" in sys.argv[1:]:
+        with open(OUTPUT) as f:
+            if f.read() != text:
+                sys.stderr.write("can_codec.h is out of date, rerun generate_can_codec.py\n")
+                return 1
+        return 0
+
+    with open(OUTPUT, "w") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -13,7 +13,12 @@ namespace IAP {
     const uint32_t IAP_LOCATION = 0x03000205;
 
     //See Table 498
+    const uint8_t COMMAND_PREPARE = 50;
+    const uint8_t COMMAND_COPY_RAM_TO_FLASH = 51;
+    const uint8_t COMMAND_ERASE_SECTORS = 52;
+    const uint8_t COMMAND_BLANK_CHECK = 53;
     const uint8_t COMMAND_PART_ID = 54;
+    const uint8_t COMMAND_COMPARE = 56;
     const uint8_t COMMAND_UID = 58;
     const uint8_t COMMAND_WRITE_EEPROM = 61;
     const uint8_t COMMAND_READ_EEPROM = 62;
@@ -22,6 +27,16 @@ namespace IAP {
 
     const IAP iap_entry = (IAP) IAP_LOCATION;
 
+    //See Table 499
+    const uint32_t CMD_SUCCESS = 0;
+    const uint32_t SECTOR_NOT_BLANK = 8;
+    const uint32_t COMPARE_ERROR = 10;
+
+    //LPC1549: 64 sectors of 4 kB, written in pages of 256 bytes
+    const uint32_t FLASH_SIZE = 0x40000;
+    const uint32_t FLASH_SECTOR_SIZE = 4096;
+    const uint32_t FLASH_PAGE_SIZE = 256;
+
     /*
      * Gets the part ID of the chip
      * @return - 0 if failed, else the xx part of LPC15xx (i.e. 49 for LPC1549)
@@ -35,6 +50,51 @@ namespace IAP {
      */
     bool getUniqueID(uint32_t (&data)[4]);
 
+    /*
+     * Gets the sector holding a flash address
+     * @param address - flash address
+     * @return sector number
+     */
+    inline uint32_t sector(uint32_t address) {
+        return address / FLASH_SECTOR_SIZE;
+    }
+
+    /*
+     * Erases flash sectors. Interrupts are disabled while the flash is busy,
+     * about 100 ms per call, since the vectors and handlers live in flash.
+     * @param start - first sector
+     * @param end - last sector, at least start
+     * @return CMD_SUCCESS, else the IAP status code
+     */
+    uint32_t eraseSectors(uint32_t start, uint32_t end);
+
+    /*
+     * Programs erased flash from RAM. Interrupts are disabled while the flash
+     * is busy, about 1 ms per 256 bytes.
+     * @param address - flash address, a multiple of FLASH_PAGE_SIZE
+     * @param data - source in RAM, word aligned
+     * @param bytes - 256, 512, 1024 or 4096, within one sector
+     * @return CMD_SUCCESS, else the IAP status code
+     */
+    uint32_t copyRamToFlash(uint32_t address, const uint32_t* data, uint32_t bytes);
+
+    /*
+     * Checks that flash sectors are erased
+     * @param start - first sector
+     * @param end - last sector, at least start
+     * @return CMD_SUCCESS, SECTOR_NOT_BLANK or another IAP status code
+     */
+    uint32_t blankCheck(uint32_t start, uint32_t end);
+
+    /*
+     * Compares flash with RAM
+     * @param address - flash address, word aligned
+     * @param data - RAM to compare with, word aligned
+     * @param bytes - multiple of 4
+     * @return CMD_SUCCESS, COMPARE_ERROR or another IAP status code
+     */
+    uint32_t compare(uint32_t address, const uint32_t* data, uint32_t bytes);
+
 }
 
 #endif
@@ -2,8 +2,8 @@
  * TimingCommon.h
  *
  * A class for handling common timing functions.
- * Only handles Timer overflow after 71 minutes (2^32 - 1 microseconds) and some calculations for now.
- * This adapts a signed time value (from the Timer class in mbed) into an unsigned uint32_t value.
+ * Time is read 64 bits wide from the mbed Timer, so it never wraps; the 32-bit times handed
+ * out for callbacks and loops wrap every 71 minutes and are only ever compared as differences.
  *
  * From Calsol Zephyr
  *
@@ -14,14 +14,28 @@
 #ifndef COMMON_API_TIMINGCOMMON_H_
 #define COMMON_API_TIMINGCOMMON_H_
 
+#include <stdint.h>
+
 #ifdef _TESTING_
 class Timer;
+#include <FunctionPointer.h>
 #else
 #include <mbed.h>
 #endif
 
-// Number of possible timing-based callbacks
+// Number of possible timing-based callbacks, periodic and one-shot together
+#ifndef TIMING_NUM_CALLBACKS
 #define TIMING_NUM_CALLBACKS 12
+#endif
+
+#if TIMING_NUM_CALLBACKS > 254
+#error "TIMING_NUM_CALLBACKS must fit in a byte"
+#endif
+
+#include <timing_profile.h>
+
+// Identifies a scheduled callback for cancelCallback(); 0 is never used
+typedef uint32_t TimingHandle;
 
 class TimingCommon {
 public:
@@ -38,19 +52,106 @@ public:
 	/**
 	 * Runs each time at the top of the board main run while(1).
 	 * @param outOverflow
-	 * 	Will be set true on timer overflow, false otherwise.
-	 * 	Can be NULL if unused.
-	 * @return Current time now (us)
+	 * 	Will be set true when the 32-bit time wrapped since the last tick, false otherwise.
+	 * 	Only needed by code keeping its own 32-bit times. Can be NULL if unused.
+	 * @return Current time now (us), low 32 bits
 	 */
 	uint32_t onTick(bool* outOverflow);
 
+	/**
+	 * @return time (us) since start() as of the last onTick(), 64 bits so it never wraps
+	 */
+	uint64_t tickTime64() const;
+
+	/**
+	 * @return current time (us) since start(), 64 bits so it never wraps
+	 */
+	uint64_t read64() const;
+
 	/**
 	 * Add a callback to be triggered periodically during onTick().
+	 * It runs on the first onTick() more than threshold after the last run
+	 * (or after start()).
 	 * @param threshold Period of callback (us)
 	 * @param callback Callback function
+	 * @param outHandle set to the callback's handle, can be NULL if unused
+	 * @return 0 on success, -1 on failure (too many callbacks added already)
+	 */
+	int addCallback(uint32_t threshold, void (*callback)(void), TimingHandle* outHandle = NULL);
+
+	/**
+	 * Add a member function to be triggered periodically during onTick().
+	 * @param threshold Period of callback (us)
+	 * @param object Object to call the method on
+	 * @param method Member function to call
+	 * @param outHandle set to the callback's handle, can be NULL if unused
+	 * @return 0 on success, -1 on failure (too many callbacks added already)
+	 */
+	template<typename T>
+	int addCallback(uint32_t threshold, T* object, void (T::*method)(void), TimingHandle* outHandle = NULL) {
+		return schedule(threshold + 1, threshold + 1, mbed::FunctionPointer(object, method), outHandle);
+	}
+
+	/**
+	 * Add a callback to be triggered once, on the first onTick() at least
+	 * delay after the last onTick() (or after start() if not started yet).
+	 * Added from another callback, it runs on the next onTick() at the
+	 * earliest.
+	 * @param delay Time until the callback (us), less than 2^31
+	 * @param callback Callback function
+	 * @param outHandle set to the callback's handle, can be NULL if unused
+	 * @return 0 on success, -1 on failure (too many callbacks added already)
+	 */
+	int addTimeout(uint32_t delay, void (*callback)(void), TimingHandle* outHandle = NULL);
+
+	/**
+	 * Add a member function to be triggered once, as addTimeout() above.
+	 * @param delay Time until the callback (us), less than 2^31
+	 * @param object Object to call the method on
+	 * @param method Member function to call
+	 * @param outHandle set to the callback's handle, can be NULL if unused
 	 * @return 0 on success, -1 on failure (too many callbacks added already)
 	 */
-	int addCallback(uint32_t threshold, void (*callback)(void));
+	template<typename T>
+	int addTimeout(uint32_t delay, T* object, void (T::*method)(void), TimingHandle* outHandle = NULL) {
+		return schedule(delay, 0, mbed::FunctionPointer(object, method), outHandle);
+	}
+
+	/**
+	 * Remove a periodic or one-shot callback. Safe to call from a callback,
+	 * including the one being removed.
+	 * @param handle Handle from addCallback() or addTimeout()
+	 * @return 0 on success, -1 if it is not scheduled (already run,
+	 * 	cancelled or never added)
+	 */
+	int cancelCallback(TimingHandle handle);
+
+	/**
+	 * When the main loop can sleep or do background work until. With
+	 * nothing scheduled (pending() is 0) nothing is due, and the time
+	 * INT32_MAX us after the last tick is returned, the furthest a signed
+	 * difference from now can reach.
+	 * @return time (us) the next callback is due
+	 */
+	uint32_t nextDeadline() const;
+
+	/**
+	 * @return number of callbacks scheduled, the heartbeat included
+	 */
+	int pending() const;
+
+	/**
+	 * Callback run times and the loop period histogram, collected when
+	 * built with TIMING_PROFILE (see timing_profile.h). Callback counters
+	 * are indexed by the low byte of the callback's TimingHandle.
+	 * @return the counters
+	 */
+	const TimingProfile& profile() const;
+
+	/**
+	 * Reset the counters in profile().
+	 */
+	void clearProfile();
 
 	/**
 	 * Add a callback for heartbeat messages to be triggered periodically.
@@ -62,8 +163,8 @@ public:
 	/*
 	 * Calculate the time difference between two times (unitless)
 	 * @param start time
-	 * @param end time
-	 * @return time difference
+	 * @param end time, less than 2^32 after start
+	 * @return time difference, correct across the 32-bit wrap
 	 */
 	static uint32_t difference(const uint32_t start, const uint32_t end);
 
@@ -84,23 +185,102 @@ public:
 	 */
 	int tickThreshold(uint32_t& last, const uint32_t interval);
 
+	/**
+	 * Set the correction from this board's clock to the network time shared
+	 * by all boards, usually from CANTimeSync.
+	 * @param localRef local time (us) of the reference point
+	 * @param globalRef network time (us) at localRef
+	 * @param rate how much faster the network clock runs than this board's,
+	 * 	in units of 2^-32 (about 0.00023 ppm)
+	 */
+	void setClockCorrection(uint32_t localRef, uint32_t globalRef, int32_t rate);
+
+	/**
+	 * Drop the clock correction; network time is local time again.
+	 */
+	void clearClockCorrection();
+
+	/**
+	 * @return true if a clock correction is set
+	 */
+	bool clockSynced() const;
+
+	/**
+	 * Convert a local time to network time.
+	 * @param local local time (us), within 35 minutes of the last correction
+	 * @return network time (us), or local if no correction is set
+	 */
+	uint32_t globalTime(uint32_t local) const;
+
+	/**
+	 * @return network time (us) as of the last onTick()
+	 */
+	uint32_t globalTick() const;
+
 private:
+	/** One scheduled callback */
+	struct Entry {
+		uint32_t deadline;				// next run (us)
+		uint32_t period;				// us between runs, 0 for one-shot
+		mbed::FunctionPointer callback;
+		uint16_t generation;			// changes every time the entry is freed
+		int16_t heapIndex;				// position in heap, -1 if free
+	};
+
 	uint32_t lastTickTime;
+	uint64_t lastTickTime64;
 	Timer* timer;
+	bool inTick;
 
-	uint32_t thresholds[TIMING_NUM_CALLBACKS];
-	uint32_t lastTick[TIMING_NUM_CALLBACKS];
-	void (*callbacks[TIMING_NUM_CALLBACKS])(void);
-	int num_callbacks;
+	// One more than TIMING_NUM_CALLBACKS, kept for the heartbeat
+	Entry entries[TIMING_NUM_CALLBACKS + 1];
+	// Entry indices, a min-heap on deadline, so onTick() only looks at the
+	// earliest one when nothing is due
+	uint8_t heap[TIMING_NUM_CALLBACKS + 1];
+	int heapSize;
 
-	uint32_t heartbeat_threshold;
-	uint32_t heartbeat_lastTick;
 	void (*heartbeat_callback)(int);
+	TimingHandle heartbeat_handle;
+
+	TimingProfile timingProfile;
+
+	bool synced;
+	uint32_t syncLocalRef;
+	uint32_t syncGlobalRef;
+	int32_t syncRate;
+
+	/**
+	 * Add an entry, due delay after the last tick.
+	 * @return 0 on success, -1 if all entries are in use
+	 */
+	int schedule(uint32_t delay, uint32_t period, const mbed::FunctionPointer& callback, TimingHandle* outHandle);
+
+	/**
+	 * Take an entry out of the heap and free it.
+	 */
+	void release(int entry);
+
+	/**
+	 * Runs the heartbeat callback from its entry.
+	 */
+	void heartbeat();
+
+	/**
+	 * @return true if heap position a is due before heap position b
+	 */
+	bool before(int a, int b) const;
+
+	void swap(int a, int b);
+
+	/**
+	 * Restore heap order below position i.
+	 */
+	void siftDown(int i);
 
 	/**
-	 * Reset all callback last tick times to the given time.
+	 * Restore heap order above position i.
 	 */
-	void resetCallbackLastTicks(uint32_t now);
+	void siftUp(int i);
 };
 
 #endif /* TIMINGCOMMON_H_ */
@@ -14,6 +14,9 @@
 #endif // ___COMMON_NO_MBED__
 
 #include "circular_buffer.h"
+#include "can_priority_queue.h"
+#include "can_stats.h"
+#include "can_recorder.h"
 
 /** CAN Message circular buffer template class + IRQ handler
  *
@@ -39,6 +42,12 @@
  *            if (canBuffer.read(msg)) {
  *                doStuff(msg);
  *            }
+ *            // Or handle messages in place without copying them
+ *            const CANMessage* pending;
+ *            while ((pending = canBuffer.peek()) != NULL) {
+ *                doStuff(*pending);
+ *                canBuffer.consume();
+ *            }
  *        }
  *    }
  */
@@ -50,7 +59,7 @@ public:
 	 *  @param can CAN interface to read messages from
 	 *  @param handle message filter handle (0 for any message)
 	 */
-	CANRXBuffer(CAN& can, int handle=0) : can(can), handle(handle) {
+	CANRXBuffer(CAN& can, int handle=0) : can(can), handle(handle), rxHook(NULL), recorder(NULL) {
 
 	}
 
@@ -92,27 +101,154 @@ public:
 		return messageValid;
 	}
 
+	/** Read every waiting CANMessage, up to max, from the buffer.
+	 *
+	 *  @param msgs array to read to.
+	 *  @param max size of msgs
+	 *
+	 *  @returns
+	 *    number of messages read
+	 */
+	int read(CANMessage* msgs, int max) {
+		return rxBuffer.read(msgs, max);
+	}
+
+	/** Access the oldest received CANMessage in place, without copying it.
+	 *  The message stays valid until consume() is called.
+	 *
+	 *  @returns
+	 *    pointer to the message if one arrived,
+	 *    NULL if the buffer is empty
+	 */
+	const CANMessage* peek() {
+		if (rxEmpty()) {
+			return NULL;
+		}
+		return &rxBuffer.peek();
+	}
+
+	/** Release the message returned by peek()
+	 *
+	 *  Note: the caller is responsible for checking that
+	 *        peek() returned a message
+	 */
+	void consume() {
+		rxBuffer.discard();
+	}
+
 	/** CAN receive message IRQ handler
-	 *  Reads any pending CAN messages into the RX buffer
+	 *  Reads any pending CAN messages directly into the RX buffer
 	 *  Stops when there are no more pending messages or the RX buffer is full
 	 */
 	void handleIrq() {
-		CANMessage msg;
-		while (can.read(msg, handle) && !rxFull()) {
-			rxBuffer.write(msg);
+		uint32_t begin = canStats.isrBegin();
+		drain(begin);
+		canStats.isrEnd(begin);
+	}
+
+	/** Call a function for every message as it is moved into the buffer,
+	 *  from the IRQ handler. For work that has to happen when the message
+	 *  arrives, like taking its receive time; keep it short.
+	 *
+	 *  @param hook function to call, NULL for none
+	 */
+	void setRxHook(void (*hook)(const CANMessage& msg)) {
+		rxHook = hook;
+	}
+
+	/** Record every message moved through this buffer
+	 *
+	 *  @param flightRecorder recorder to add messages to, NULL for none
+	 */
+	void setRecorder(CANRecorder* flightRecorder) {
+		recorder = flightRecorder;
+	}
+
+	/** Traffic counters; only filled in when CAN_STATS is enabled */
+	const CANStats& stats() const {
+		return canStats;
+	}
+
+protected:
+	/*
+	 * Move pending messages from the controller into the RX buffer and
+	 * count them; the receive half of handleIrq().
+	 */
+	void drain(uint32_t begin) {
+		canStats.countRxDrain(receive(), begin);
+		// Frames the full buffer could not take wait in the controller; they
+		// are only lost once the controller overwrites them
+		if (CAN_STATS) {
+			canStats.countRxOverflow(can.rxLost());
 		}
+		canStats.rxLevel(rxBuffer.size());
+	}
+
+	/*
+	 * Move pending messages from the controller into the RX buffer.
+	 * With no filter handle, whole runs of free slots are filled in one
+	 * call; a filtered read takes one message at a time.
+	 * Returns the number of messages moved.
+	 */
+	int receive() {
+		int total = 0;
+		if (handle != 0) {
+			while (!rxFull() && can.read(rxBuffer.claim(), handle)) {
+				canStats.countRx(rxBuffer.claim().id);
+				if (rxHook) {
+					rxHook(rxBuffer.claim());
+				}
+				if (recorder) {
+					recorder->record(rxBuffer.claim(), false);
+				}
+				rxBuffer.commit();
+				total++;
+			}
+			return total;
+		}
+
+		// The free space may wrap, so it can take two runs to fill
+		while (true) {
+			int free;
+			CANMessage* slots = rxBuffer.claim(free);
+			if (free == 0) {
+				break;
+			}
+			int got = can.read(slots, free);
+			for (int i = 0; i < got; i++) {
+				canStats.countRx(slots[i].id);
+				if (rxHook) {
+					rxHook(slots[i]);
+				}
+				if (recorder) {
+					recorder->record(slots[i], false);
+				}
+			}
+			rxBuffer.commit(got);
+			total += got;
+			if (got < free) {
+				break;
+			}
+		}
+		return total;
 	}
 
-private:
 	CircularBuffer<CANMessage, RXSize> rxBuffer;
 	CAN& can;
 	const int handle;
+	void (*rxHook)(const CANMessage& msg);
+	CANRecorder* recorder;
+	CANStats canStats;
 };
 
 /** CAN Message circular buffer template class + IRQ handler
  *
  *  @param RXSize size of receive buffer in messages; must be a power of 2
- *  @param TXSize size of transmit buffer in messages; must be a power of 2
+ *  @param TXSize size of transmit queue in messages; at most 254
+ *
+ *  Receiving works as in CANRXBuffer, which this extends with a transmit
+ *  queue. Queued messages are sent lowest CAN ID first, like bus
+ *  arbitration, rather than in the order they were written.
  *
  *  Typical usage:
  *    // 32 message RX buffer, 16 message TX buffer
@@ -144,27 +280,17 @@ private:
  *    }
  */
 template <int RXSize, int TXSize>
-class CANRXTXBuffer {
+class CANRXTXBuffer : public CANRXBuffer<RXSize> {
 public:
 	/** Constructs a new, empty CAN message buffer
 	 *
 	 *  @param can CAN interface to read messages from
 	 *  @param handle message filter handle (0 for any message)
 	 */
-	CANRXTXBuffer(CAN& can, int handle=0) : can(can), handle(handle) {
+	CANRXTXBuffer(CAN& can, int handle=0) : CANRXBuffer<RXSize>(can, handle) {
 
 	}
 
-	/** Check if the receive buffer is empty
-	 *
-	 *  @returns
-	 *    true if empty
-	 *    false if not empty
-	 */
-	bool rxEmpty() const {
-		return rxBuffer.empty();
-	}
-
 	/** Check if the transmit buffer is empty
 	 *
 	 *  @returns
@@ -175,16 +301,6 @@ public:
 		return txBuffer.empty();
 	}
 
-	/** Check if the receive buffer is full
-	 *
-	 *  @returns
-	 *    true if full
-	 *    false if not full
-	 */
-	bool rxFull() const {
-		return rxBuffer.full();
-	}
-
 	/** Check if the transmit buffer is full
 	 *
 	 *  @returns
@@ -195,24 +311,6 @@ public:
 		return txBuffer.full();
 	}
 
-    /** Read a CANMessage from the buffer.
-     *
-     *  @param msg A CANMessage to read to.
-     *
-     *  @returns
-     *    0 if no message arrived,
-     *    1 if message arrived
-     */
-	int read(CANMessage& msg) {
-		int messageValid = 0;
-		if (!rxEmpty()) {
-			msg = rxBuffer.read();
-			messageValid = 1;
-		}
-
-		return messageValid;
-	}
-
 	/** Write a CANMessage to the buffer.
 	 *
 	 *  @param msg A CANMessage to write.
@@ -221,51 +319,113 @@ public:
 	 *    0 if no space in buffer,
 	 *    1 if message added to buffer
 	 */
-	int write(CANMessage msg) {
-		int messageQueued = 0;
-
-		if (txEmpty() && (can.txstatus() == CAN::Idle)) {
-			messageQueued = can.write(msg);
-		} else if (!txFull()) {
-			txBuffer.write(msg);
-			messageQueued = 1;
+	int write(const CANMessage& msg) {
+		// The IRQ handler also takes from the queue
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+
+		int messageQueued = enqueue(msg);
+		if (!messageQueued) {
+			canStats.countTxReject();
 		}
 
+		__set_PRIMASK(primask);
 		return messageQueued;
 	}
 
+	/** Write several CANMessages to the buffer with interrupts disabled
+	 *  only once. Stops at the first message that does not fit.
+	 *
+	 *  Note: interrupts stay disabled while the whole batch is handed to
+	 *        the controller, so keep batches short
+	 *
+	 *  @param msgs CANMessages to write.
+	 *  @param count number of messages in msgs
+	 *
+	 *  @returns
+	 *    number of messages added to the buffer, from the start of msgs
+	 */
+	int write(const CANMessage* msgs, int count) {
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+
+		int queued = 0;
+		while (queued < count && enqueue(msgs[queued])) {
+			queued++;
+		}
+		for (int i = queued; i < count; i++) {
+			canStats.countTxReject();
+		}
+
+		__set_PRIMASK(primask);
+		return queued;
+	}
+
 	/**
 	 * Clear TX send buffer.
 	 */
 	void clearTX() {
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
 		txBuffer.clear();
+		__set_PRIMASK(primask);
 	}
 
 	/** CAN receive/transmit message IRQ handler
-	 *  Reads any pending CAN messages into the RX buffer
+	 *  Reads any pending CAN messages directly into the RX buffer
 	 *  Stops when there are no more pending messages or the RX buffer is full
-	 *  If the CAN interface is idle, transmits a message from the TX buffer
+	 *  Moves messages from the TX queue to the CAN interface, lowest ID first,
+	 *  until the queue is empty or the interface is full
 	 */
 	void handleIrq() {
-		CANMessage msg;
-		while (can.read(msg, handle) && !rxFull()) {
-			rxBuffer.write(msg);
-		}
+		uint32_t begin = canStats.isrBegin();
+
+		this->drain(begin);
 
 		while (!txEmpty()) {
 			if (can.write(txBuffer.peek()) != 0) {
+				canStats.countTx(txBuffer.peek().id);
+				if (recorder) {
+					recorder->record(txBuffer.peek(), true);
+				}
 				txBuffer.discard();
 			} else {
 				break;
 			}
 		}
+
+		canStats.isrEnd(begin);
 	}
 
 private:
-	CircularBuffer<CANMessage, RXSize> rxBuffer;
-	CircularBuffer<CANMessage, TXSize> txBuffer;
-	CAN& can;
-	const int handle;
+	using CANRXBuffer<RXSize>::can;
+	using CANRXBuffer<RXSize>::recorder;
+	using CANRXBuffer<RXSize>::canStats;
+
+	/*
+	 * Send or queue one message; interrupts must be disabled.
+	 * Returns 1 if the message was taken, 0 if the queue is full.
+	 */
+	int enqueue(const CANMessage& msg) {
+		// Hand the frame straight to a free hardware message object unless
+		// other frames are still waiting in the software queue
+		if (txEmpty() && (can.txstatus() != CAN::Busy) && can.write(msg)) {
+			canStats.countTx(msg.id);
+			if (recorder) {
+				recorder->record(msg, true);
+			}
+			return 1;
+		}
+
+		if (txFull()) {
+			return 0;
+		}
+		txBuffer.write(msg);
+		canStats.txLevel(txBuffer.size());
+		return 1;
+	}
+
+	CANPriorityQueue<TXSize> txBuffer;
 };
 
 
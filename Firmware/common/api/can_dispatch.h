@@ -0,0 +1,165 @@
+/*
+ * can_dispatch.h
+ * Compile-time table routing received CAN messages to typed handlers.
+ */
+
+#ifndef COMMON_API_CAN_DISPATCH_H_
+#define COMMON_API_CAN_DISPATCH_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <CAN/can_id.h>
+
+#ifndef ___COMMON_NO_MBED__
+#include <mbed.h>
+#endif // ___COMMON_NO_MBED__
+
+/** Binds a CAN message to its payload type and handler
+ *
+ *  @param Info message ID and rate from can_id.h
+ *  @param DataStruct payload type from can_data.h; the message DLC must equal its size
+ *  @param Handler function called with the unpacked payload
+ */
+template <const BRIZO_CAN::can_message_info& Info, typename DataStruct, void (*Handler)(const DataStruct&)>
+struct CANRoute {
+	static_assert(sizeof(DataStruct) <= 8, "Message payload too big");
+	static_assert(Info.ID >= 0 && Info.ID <= 0x7FF, "Only standard 11-bit IDs can be routed");
+
+	static constexpr int ID = Info.ID;
+
+	/** Unpack the payload and call the handler
+	 *
+	 *  @param msg received message with this route's ID
+	 *  @returns
+	 *    true if the handler was called,
+	 *    false if the DLC did not match the payload size
+	 */
+	static bool handle(const CANMessage& msg) {
+		if (msg.len != sizeof(DataStruct)) {
+			return false;
+		}
+		DataStruct data;
+		memcpy(&data, msg.data, sizeof(DataStruct));
+		Handler(data);
+		return true;
+	}
+};
+
+namespace CANDispatchDetail {
+
+	// List of 11-bit IDs, built by doubling so the instantiation depth stays low
+	template <unsigned... Ids>
+	struct IdList {
+		typedef IdList<Ids..., (sizeof...(Ids) + Ids)...> Doubled;
+	};
+
+	template <int Doublings>
+	struct AllIds {
+		typedef typename AllIds<Doublings - 1>::type::Doubled type;
+	};
+
+	template <>
+	struct AllIds<0> {
+		typedef IdList<0> type;
+	};
+
+	// Position (1-based) of the route handling an ID, or 0 if none does
+	template <int N, typename... Routes>
+	struct Find;
+
+	template <int N>
+	struct Find<N> {
+		static constexpr uint8_t at(unsigned) { return 0; }
+	};
+
+	template <int N, typename Route, typename... Routes>
+	struct Find<N, Route, Routes...> {
+		static constexpr uint8_t at(unsigned id) {
+			return (unsigned)Route::ID == id ? N : Find<N + 1, Routes...>::at(id);
+		}
+	};
+
+	// True if any two routes share an ID
+	template <typename... Routes>
+	struct Duplicates;
+
+	template <>
+	struct Duplicates<> {
+		static constexpr bool value = false;
+	};
+
+	template <typename Route, typename... Routes>
+	struct Duplicates<Route, Routes...> {
+		static constexpr bool value = Find<1, Routes...>::at(Route::ID) != 0 || Duplicates<Routes...>::value;
+	};
+
+	// Route index for every 11-bit ID
+	struct Table {
+		uint8_t routes[0x800];
+	};
+
+	template <typename Finder, unsigned... Ids>
+	constexpr Table makeTable(IdList<Ids...>) {
+		return Table{ { Finder::at(Ids)... } };
+	}
+
+	inline bool ignore(const CANMessage&) {
+		return false;
+	}
+
+} // end namespace CANDispatchDetail
+
+/** Routes received CAN messages to handlers without comparing IDs
+ *
+ *  Expands at compile time into a 2 KB table in flash mapping each 11-bit
+ *  ID to a route, so dispatching a message is one table lookup and one
+ *  indirect call regardless of how many routes there are.
+ *
+ *  Typical usage:
+ *    void onDriveDir(const BRIZO_CAN::DashBrakeAndDirection& data);
+ *    void onWheelTemps(const BRIZO_CAN::WheelTemps& data);
+ *
+ *    typedef CANDispatcher<
+ *        CANRoute<BRIZO_CAN::DASH_DRIVE_DIR_AND_BRAKE, BRIZO_CAN::DashBrakeAndDirection, onDriveDir>,
+ *        CANRoute<BRIZO_CAN::WHEEL_TEMPS, BRIZO_CAN::WheelTemps, onWheelTemps>
+ *    > Dispatcher;
+ *
+ *    while (!common.readCANMessage(msg)) {
+ *        Dispatcher::dispatch(msg);
+ *    }
+ */
+template <typename... Routes>
+class CANDispatcher {
+	static_assert(sizeof...(Routes) < 0xFF, "Too many routes");
+	static_assert(!CANDispatchDetail::Duplicates<Routes...>::value, "Two routes share a CAN ID");
+
+public:
+	/** Call the handler registered for a message
+	 *
+	 *  @param msg received message
+	 *  @returns
+	 *    true if a handler was called,
+	 *    false if the ID has no route or the DLC did not match
+	 */
+	static bool dispatch(const CANMessage& msg) {
+		if (msg.format != CANStandard) {
+			return false;
+		}
+		return handlers[table.routes[msg.id & 0x7FF]](msg);
+	}
+
+private:
+	static const CANDispatchDetail::Table table;
+	static bool (* const handlers[sizeof...(Routes) + 1])(const CANMessage&);
+};
+
+template <typename... Routes>
+const CANDispatchDetail::Table CANDispatcher<Routes...>::table =
+	CANDispatchDetail::makeTable<CANDispatchDetail::Find<1, Routes...> >(CANDispatchDetail::AllIds<11>::type());
+
+template <typename... Routes>
+bool (* const CANDispatcher<Routes...>::handlers[sizeof...(Routes) + 1])(const CANMessage&) = {
+	CANDispatchDetail::ignore, Routes::handle...
+};
+
+#endif /* COMMON_API_CAN_DISPATCH_H_ */
@@ -0,0 +1,117 @@
+/*
+ * can_filter.h
+ * Plans the C_CAN acceptance filters from the list of messages a board uses.
+ */
+
+#ifndef COMMON_API_CAN_FILTER_H_
+#define COMMON_API_CAN_FILTER_H_
+
+#include <stdint.h>
+#include <CAN/can_id.h>
+#include <can_msg_obj.h>
+
+#ifndef ___COMMON_NO_MBED__
+#include <mbed.h>
+#endif // ___COMMON_NO_MBED__
+
+// Receive message objects available for filters, as split in can_msg_obj.h
+#define CAN_RX_FILTER_COUNT CAN_RX_MSG_OBJ_COUNT
+
+/** Set of standard-ID acceptance filters covering a board's subscriptions
+ *
+ *  Each subscribed ID starts out as an exact-match filter. While there are
+ *  more filters than message objects, the two filters whose merged mask
+ *  accepts the fewest IDs are combined.
+ *
+ *  Typical usage:
+ *    const BRIZO_CAN::can_message_info subscriptions[] = {
+ *        BRIZO_CAN::DASH_DRIVE_DIR_AND_BRAKE,
+ *        BRIZO_CAN::DASH_LIGHT_SET_STATES,
+ *    };
+ *
+ *    CANFilterPlan plan;
+ *    if (plan.plan(subscriptions, 2) == 0) {
+ *        plan.install(can);
+ *    }
+ */
+class CANFilterPlan {
+public:
+	/** Filter as programmed into a message object */
+	struct Filter {
+		uint32_t id;
+		uint32_t mask;
+	};
+
+	CANFilterPlan();
+
+	/**
+	 * Compute the filters for a set of subscribed messages.
+	 * @param subscriptions messages the board needs to receive
+	 * @param count number of entries in subscriptions
+	 * @param maxFilters message objects available for filters
+	 * @param maxFalsePositives how many unsubscribed IDs the filters may accept
+	 * @return 0 on success, -1 if the plan accepts more than maxFalsePositives
+	 *         unsubscribed IDs (the plan is still usable, just looser)
+	 */
+	int plan(const BRIZO_CAN::can_message_info* subscriptions, int count,
+			int maxFilters = CAN_RX_FILTER_COUNT, int maxFalsePositives = 64);
+
+	/**
+	 * Program the filters into receive message objects 1..size() and
+	 * invalidate the receive objects above them, so nothing left from an
+	 * earlier plan or the accept-all filter still accepts messages.
+	 * An empty plan leaves the controller's accept-all filter in place.
+	 * @param can CAN controller to program
+	 * @return number of filters installed
+	 */
+	int install(CAN& can) const;
+
+	/**
+	 * @return number of filters in the plan
+	 */
+	int size() const;
+
+	/**
+	 * @param i filter index, less than size()
+	 * @return the filter
+	 */
+	const Filter& filter(int i) const;
+
+	/**
+	 * Check if a standard ID passes the filters.
+	 * @param id 11-bit CAN ID
+	 * @return true if accepted
+	 */
+	bool accepts(uint32_t id) const;
+
+	/**
+	 * @return number of unsubscribed IDs the filters let through
+	 */
+	int falsePositives() const;
+
+	/**
+	 * Estimate how many receive interrupts per second the filters avoid,
+	 * compared to accepting every message.
+	 * @param busTraffic periodic messages seen on the bus
+	 * @param count number of entries in busTraffic
+	 * @return rejected messages per second
+	 */
+	uint32_t rejectedPerSecond(const BRIZO_CAN::can_message_info* busTraffic, int count) const;
+
+private:
+	Filter filters[CAN_RX_FILTER_COUNT + 1];
+	int numFilters;
+	int numFalsePositives;
+
+	/**
+	 * Merge the two filters that accept the fewest IDs together.
+	 */
+	void mergeClosestPair();
+
+	/**
+	 * Drop filters fully covered by filter i.
+	 */
+	void removeCoveredBy(int i);
+};
+
+#endif /* COMMON_API_CAN_FILTER_H_ */
@@ -0,0 +1,188 @@
+/*
+ * can_flash_loader.h
+ * Receives a firmware image over CAN and programs it into flash through IAP.
+ */
+
+#ifndef COMMON_API_CAN_FLASH_LOADER_H_
+#define COMMON_API_CAN_FLASH_LOADER_H_
+
+#include <stdint.h>
+#include <IAP.h>
+#include "crc.h"
+
+// Image bytes in one DATA request; a multiple of IAP::FLASH_PAGE_SIZE
+#define CAN_FLASH_SEGMENT_SIZE 1024
+// Largest request: command, offset and one segment
+#define CAN_FLASH_REQUEST_SIZE (5 + CAN_FLASH_SEGMENT_SIZE)
+// Every reply: command | 0x80, result and a 32-bit value
+#define CAN_FLASH_REPLY_SIZE 6
+
+/** Flash side of the CAN bootloader protocol
+ *
+ *  Requests and replies are carried by a CANIsoTp session, one pair of IDs
+ *  per board (BOOT_REQUEST and BOOT_REPLY in can_id.h), so the updating
+ *  tool can talk to several boards at once. All values are little endian.
+ *
+ *    START  01 address(4) length(4) crc32(4)
+ *           erase the sectors for the image; replies the segment size
+ *    DATA   02 offset(4) bytes
+ *           CAN_FLASH_SEGMENT_SIZE bytes except for the last segment, in
+ *           order; replies the next offset expected
+ *    VERIFY 03
+ *           check the CRC32 of the whole image; replies the CRC computed
+ *    BOOT   04
+ *           start the image once it is verified
+ *
+ *  A DATA request is copied to a staging buffer and answered right away,
+ *  then written one page per poll() call while the next request arrives.
+ *  Writing a page keeps interrupts off for about 1 ms, and each receive
+ *  message object of the CAN controller holds a single frame: a second
+ *  frame for the same object in that time overwrites the first. So a page
+ *  is only written while the tool has no frame on its way:
+ *  - while pages are staged the session asks for a block size of 1, so
+ *    the tool waits for flow control after every consecutive frame, and
+ *  - the loop keeps flow control back with CANIsoTp::hold() while it reads
+ *    the CAN buffer, writes at most one page while a flow control frame is
+ *    held (or no transfer is being received), then lets it go.
+ *  The four pages of a segment are written in the gaps after the first
+ *  frames of the next one, which then streams with a block size of 0 once
+ *  they are done. The one frame that can arrive during a write while
+ *  nothing is being received, the first frame of the next request, waits
+ *  in its message object. Install a CANFilterPlan so BOOT_REQUEST has an
+ *  object of its own; with the accept-all object any other frame in that
+ *  millisecond would overwrite it.
+ *
+ *  A tool updating several boards should send one DATA request at a time.
+ *  A board's flow control and replies lose arbitration to the tool's
+ *  frames for boards with lower request IDs, and while several segments
+ *  stream they can wait past the ISO-TP timeout.
+ *
+ *  Typical usage in the bootloader main loop:
+ *    uint8_t request[CAN_FLASH_REQUEST_SIZE];
+ *    int session = isotp.open(BRIZO_CAN::DASH_BOOT_REPLY.ID, BRIZO_CAN::DASH_BOOT_REQUEST.ID,
+ *            request, sizeof(request), 1);
+ *
+ *    while (!loader.bootRequested()) {
+ *        isotp.hold(session, true);
+ *        ...read the CAN buffer into isotp.handle(), then isotp.poll(now)
+ *        if (isotp.rxStatus(session) == CANIsoTp<...>::DONE) {
+ *            int len = loader.request(request, isotp.received(session));
+ *            if (len >= 0) {
+ *                isotp.release(session);
+ *                isotp.send(session, loader.reply(), len, now);
+ *            }
+ *        }
+ *        if (isotp.flowControlHeld(session) || isotp.rxStatus(session) != CANIsoTp<...>::BUSY) {
+ *            loader.poll();
+ *        }
+ *        isotp.setBlockSize(session, loader.writing() ? 1 : 0);
+ *        isotp.hold(session, false);
+ *        isotp.poll(now);
+ *    }
+ *    // jump to loader.imageAddress()
+ */
+class CANFlashLoader {
+public:
+	enum Command {
+		START = 0x01,
+		DATA = 0x02,
+		VERIFY = 0x03,
+		BOOT = 0x04
+	};
+
+	enum Result {
+		OK = 0,
+		BAD_REQUEST,	// unknown command or wrong length
+		OUT_OF_RANGE,	// image outside the application area
+		OUT_OF_ORDER,	// segment offset is not the next one expected
+		FLASH_ERROR,	// IAP erase, write or compare failed
+		CRC_MISMATCH,	// image CRC differs from START
+		NOT_READY		// no image started, or not complete or verified yet
+	};
+
+	enum State {
+		IDLE = 0,		// waiting for START
+		RECEIVING,		// image being received and written
+		VERIFIED,		// whole image written and its CRC matches
+		FAILED			// flash error, START again
+	};
+
+	/**
+	 * @param firstAddress start of the application area, a sector boundary
+	 * @param endAddress end of the application area (exclusive)
+	 */
+	CANFlashLoader(uint32_t firstAddress, uint32_t endAddress);
+
+	/**
+	 * Handle a request received from the tool.
+	 * @param data request bytes
+	 * @param len number of bytes
+	 * @return length of the reply to send from reply(), or
+	 *         -1 if the last segment is still being written; keep the
+	 *         request and call again after poll()
+	 */
+	int request(const uint8_t* data, uint16_t len);
+
+	/**
+	 * @return reply to the last request, valid until the next request
+	 */
+	const uint8_t* reply() const;
+
+	/**
+	 * Write the next staged page to flash.
+	 * @return true if a page was written
+	 */
+	bool poll();
+
+	/**
+	 * @return true while a staged segment still has pages to write
+	 */
+	bool writing() const;
+
+	/**
+	 * @return state of the image transfer
+	 */
+	State state() const;
+
+	/**
+	 * @return image bytes received so far
+	 */
+	uint32_t received() const;
+
+	/**
+	 * @return start address of the image
+	 */
+	uint32_t imageAddress() const;
+
+	/**
+	 * @return true once a verified image was asked to boot
+	 */
+	bool bootRequested() const;
+
+private:
+	uint32_t areaStart;
+	uint32_t areaEnd;
+
+	State current;
+	uint32_t address;
+	uint32_t length;
+	uint32_t expectedCrc;
+	uint32_t offset;
+	CRC32Update crc;
+	bool boot;
+
+	// Segment waiting to be written, padded with 0xFF to whole pages
+	uint32_t staging[CAN_FLASH_SEGMENT_SIZE / 4];
+	uint32_t stagedAt;
+	uint16_t stagedBytes;
+	uint16_t writtenBytes;
+
+	uint8_t replyData[CAN_FLASH_REPLY_SIZE];
+
+	int start(const uint8_t* data, uint16_t len);
+	int segment(const uint8_t* data, uint16_t len);
+	int verify();
+	int answer(uint8_t command, Result result, uint32_t value);
+};
+
+#endif /* COMMON_API_CAN_FLASH_LOADER_H_ */
@@ -0,0 +1,459 @@
+/*
+ * can_isotp.h
+ * ISO 15765-2 (ISO-TP) segmented transfers over CAN for payloads longer than 8 bytes.
+ */
+
+#ifndef COMMON_API_CAN_ISOTP_H_
+#define COMMON_API_CAN_ISOTP_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef ___COMMON_NO_MBED__
+#include <mbed.h>
+#endif // ___COMMON_NO_MBED__
+
+// Longest transfer; the first frame carries a 12-bit length
+#define CAN_ISOTP_MAX_LENGTH 4095
+
+// How long a sender waits for flow control, and a receiver for the next
+// consecutive frame, before giving up (N_Bs and N_Cr in the standard)
+#ifndef CAN_ISOTP_TIMEOUT_US
+#define CAN_ISOTP_TIMEOUT_US 1000000
+#endif
+
+/** Segmented transfers of up to 4095 bytes over standard 11-bit IDs
+ *
+ *  Each session is a pair of IDs: frames are sent with txId and the
+ *  other side answers with rxId. A transfer of up to 7 bytes is a single
+ *  frame; longer ones are a first frame, a flow control frame from the
+ *  receiver, then consecutive frames of 7 bytes each. The receiver asks for
+ *  a flow control frame every blockSize consecutive frames (0 for never)
+ *  and for at least stMin between consecutive frames.
+ *
+ *  The sender writes consecutive frames as long as the buffer takes them,
+ *  so with a block size of 0 and no separation time the transmit queue
+ *  stays full and the transfer runs at close to line rate.
+ *
+ *  @param Buffer CANRXTXBuffer, or anything with the same write()
+ *  @param Sessions number of concurrent sessions
+ *
+ *  Typical usage:
+ *    uint8_t calibration[512];
+ *    CANIsoTp<CANRXTXBuffer<32, 16> > isotp(canBuffer);
+ *    int session = isotp.open(0x640, 0x648, calibration, sizeof(calibration));
+ *
+ *    void loop() {
+ *        uint32_t now = timer.read_us();
+ *        CANMessage msg;
+ *        while (canBuffer.read(msg)) {
+ *            if (!isotp.handle(msg, now)) {
+ *                handleOther(msg);
+ *            }
+ *        }
+ *        isotp.poll(now);
+ *
+ *        if (isotp.rxStatus(session) == CANIsoTp<...>::DONE) {
+ *            applyCalibration(calibration, isotp.received(session));
+ *            isotp.release(session);
+ *        }
+ *    }
+ *
+ *    // elsewhere: isotp.send(session, table, sizeof(table), now);
+ */
+template <typename Buffer, int Sessions = 4>
+class CANIsoTp {
+public:
+	enum Status {
+		IDLE = 0,		// nothing in progress
+		BUSY,			// transfer in progress
+		DONE,			// transfer complete
+		ERROR			// timed out, out of sequence or rejected
+	};
+
+	/** Constructs an ISO-TP layer with no sessions
+	 *
+	 *  @param buffer buffer to write frames through
+	 */
+	CANIsoTp(Buffer& buffer) : buffer(buffer), numSessions(0) {
+
+	}
+
+	/** Open a session
+	 *
+	 *  @param txId ID this side sends with
+	 *  @param rxId ID the other side sends with
+	 *  @param rxBuffer where received transfers are stored; NULL to only send
+	 *  @param rxSize size of rxBuffer; longer transfers are refused
+	 *  @param blockSize consecutive frames between flow control frames we
+	 *         ask for, 0 for none
+	 *  @param stMin separation time we ask for, encoded as in the standard:
+	 *         0x00-0x7F ms, 0xF1-0xF9 100-900 us
+	 *
+	 *  @returns
+	 *    session handle, or -1 if all sessions are in use
+	 */
+	int open(uint32_t txId, uint32_t rxId, uint8_t* rxBuffer, uint16_t rxSize,
+			uint8_t blockSize = 0, uint8_t stMin = 0) {
+		if (numSessions >= Sessions) {
+			return -1;
+		}
+		Session& s = sessions[numSessions];
+		memset(&s, 0, sizeof(s));
+		s.txId = txId;
+		s.rxId = rxId;
+		s.rxBuffer = rxBuffer;
+		s.rxSize = rxBuffer ? rxSize : 0;
+		s.blockSize = blockSize;
+		s.stMin = stMin;
+		return numSessions++;
+	}
+
+	/** Start sending a transfer
+	 *
+	 *  @param session handle from open()
+	 *  @param data bytes to send; must stay valid until txStatus() is not BUSY
+	 *  @param len number of bytes, at most CAN_ISOTP_MAX_LENGTH
+	 *  @param now current time (us)
+	 *
+	 *  @returns
+	 *    0 if started,
+	 *    -1 if a transfer is in progress, len is too long or the first
+	 *    frame did not fit in the buffer
+	 */
+	int send(int session, const uint8_t* data, uint16_t len, uint32_t now) {
+		Session& s = sessions[session];
+		if (s.txStatus == BUSY || len > CAN_ISOTP_MAX_LENGTH) {
+			return -1;
+		}
+
+		CANMessage msg;
+		msg.id = s.txId;
+		if (len <= 7) {
+			msg.data[0] = PCI_SINGLE | len;
+			memcpy(&msg.data[1], data, len);
+			msg.len = 1 + len;
+			if (!buffer.write(msg)) {
+				return -1;
+			}
+			s.txStatus = DONE;
+			return 0;
+		}
+
+		msg.data[0] = PCI_FIRST | (len >> 8);
+		msg.data[1] = len & 0xFF;
+		memcpy(&msg.data[2], data, 6);
+		msg.len = 8;
+		if (!buffer.write(msg)) {
+			return -1;
+		}
+		s.txData = data;
+		s.txLen = len;
+		s.txPos = 6;
+		s.txSeq = 1;
+		s.txWaiting = true;
+		s.txDeadline = now + CAN_ISOTP_TIMEOUT_US;
+		s.txStatus = BUSY;
+		return 0;
+	}
+
+	/** Process a received frame
+	 *
+	 *  @param msg frame read from the buffer
+	 *  @param now current time (us)
+	 *
+	 *  @returns
+	 *    true if the frame belonged to a session,
+	 *    false if it is for someone else
+	 */
+	bool handle(const CANMessage& msg, uint32_t now) {
+		if (msg.format != CANStandard || msg.type != CANData || msg.len < 1) {
+			return false;
+		}
+		for (int i = 0; i < numSessions; i++) {
+			Session& s = sessions[i];
+			if (s.rxId != msg.id) {
+				continue;
+			}
+			switch (msg.data[0] & 0xF0) {
+			case PCI_SINGLE: receiveSingle(s, msg); break;
+			case PCI_FIRST: receiveFirst(s, msg, now); break;
+			case PCI_CONSECUTIVE: receiveConsecutive(s, msg, now); break;
+			case PCI_FLOW: receiveFlowControl(s, msg, now); break;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	/** Send due consecutive and flow control frames, and time out stalled
+	 *  transfers. Call it often; every call tops up the transmit buffer.
+	 *
+	 *  @param now current time (us)
+	 */
+	void poll(uint32_t now) {
+		for (int i = 0; i < numSessions; i++) {
+			Session& s = sessions[i];
+			if (s.fcPending) {
+				sendFlowControl(s, FC_CONTINUE);
+				// The wait for the next frame starts once it is allowed
+				if (!s.fcPending && s.rxStatus == BUSY) {
+					s.rxDeadline = now + CAN_ISOTP_TIMEOUT_US;
+				}
+			}
+			if (s.rxStatus == BUSY && (int32_t)(now - s.rxDeadline) > 0) {
+				s.rxStatus = ERROR;
+			}
+			if (s.txStatus != BUSY) {
+				continue;
+			}
+			if (s.txWaiting) {
+				if ((int32_t)(now - s.txDeadline) > 0) {
+					s.txStatus = ERROR;
+				}
+				continue;
+			}
+			sendConsecutive(s, now);
+		}
+	}
+
+	/** @returns state of the session's outgoing transfer */
+	Status txStatus(int session) const {
+		return (Status)sessions[session].txStatus;
+	}
+
+	/** @returns state of the session's incoming transfer */
+	Status rxStatus(int session) const {
+		return (Status)sessions[session].rxStatus;
+	}
+
+	/** @returns length of the received transfer once rxStatus() is DONE */
+	uint16_t received(int session) const {
+		return sessions[session].rxLen;
+	}
+
+	/** Allow the next incoming transfer once the last one has been used.
+	 *  Until then new first frames are refused with an overflow.
+	 */
+	void release(int session) {
+		sessions[session].rxStatus = IDLE;
+	}
+
+	/** Keep back flow control frames that let the other side send more.
+	 *  The other side stops after the frames it was already allowed, e.g.
+	 *  one with a block size of 1, until poll() sends the flow control
+	 *  after the hold ends. For stretches where received frames could be
+	 *  lost, like flash writes with interrupts disabled.
+	 *
+	 *  @param session handle from open()
+	 *  @param on true to hold, false to let poll() send what was held
+	 */
+	void hold(int session, bool on) {
+		sessions[session].held = on;
+	}
+
+	/** Change the block size asked for in the flow control frames sent
+	 *  from now on, e.g. 1 only while received frames could be lost.
+	 *
+	 *  @param session handle from open()
+	 *  @param blockSize consecutive frames between flow control frames, 0
+	 *         for none
+	 */
+	void setBlockSize(int session, uint8_t blockSize) {
+		sessions[session].blockSize = blockSize;
+	}
+
+	/** @returns true while a flow control frame is kept back by hold(), so
+	 *  the other side is stopped and has no frame of this session on its
+	 *  way until poll() sends it
+	 */
+	bool flowControlHeld(int session) const {
+		return sessions[session].held && sessions[session].fcPending;
+	}
+
+private:
+	enum {
+		PCI_SINGLE = 0x00,
+		PCI_FIRST = 0x10,
+		PCI_CONSECUTIVE = 0x20,
+		PCI_FLOW = 0x30,
+
+		FC_CONTINUE = 0,
+		FC_WAIT = 1,
+		FC_OVERFLOW = 2
+	};
+
+	struct Session {
+		uint32_t txId;
+		uint32_t rxId;
+
+		// Outgoing
+		const uint8_t* txData;
+		uint16_t txLen;
+		uint16_t txPos;
+		uint8_t txSeq;
+		uint8_t txStatus;
+		bool txWaiting;			// for a flow control frame
+		uint8_t txBlockLeft;	// frames until the next flow control, 0 for no limit
+		uint32_t txSeparation;	// us between consecutive frames
+		uint32_t txNext;		// earliest time for the next consecutive frame
+		uint32_t txDeadline;
+
+		// Incoming
+		uint8_t* rxBuffer;
+		uint16_t rxSize;
+		uint16_t rxLen;
+		uint16_t rxPos;
+		uint8_t rxSeq;
+		uint8_t rxStatus;
+		uint8_t rxBlockCount;
+		uint32_t rxDeadline;
+		bool fcPending;			// flow control still to be written
+		bool held;				// keep flow control back, see hold()
+
+		uint8_t blockSize;
+		uint8_t stMin;
+	};
+
+	Buffer& buffer;
+	Session sessions[Sessions];
+	int numSessions;
+
+	static uint32_t separationUs(uint8_t stMin) {
+		if (stMin <= 0x7F) {
+			return stMin * 1000UL;
+		}
+		if (stMin >= 0xF1 && stMin <= 0xF9) {
+			return (stMin - 0xF0) * 100UL;
+		}
+		return 127000;	// reserved values mean the longest time
+	}
+
+	void sendFlowControl(Session& s, uint8_t flowStatus) {
+		if (s.held && flowStatus == FC_CONTINUE) {
+			s.fcPending = true;
+			return;
+		}
+		CANMessage msg;
+		msg.id = s.txId;
+		msg.data[0] = PCI_FLOW | flowStatus;
+		msg.data[1] = s.blockSize;
+		msg.data[2] = s.stMin;
+		msg.len = 3;
+		// Retried from poll() if the buffer is full
+		s.fcPending = !buffer.write(msg) && flowStatus == FC_CONTINUE;
+	}
+
+	void sendConsecutive(Session& s, uint32_t now) {
+		while (!s.txWaiting && (int32_t)(now - s.txNext) >= 0) {
+			uint16_t chunk = s.txLen - s.txPos;
+			if (chunk > 7) {
+				chunk = 7;
+			}
+			CANMessage msg;
+			msg.id = s.txId;
+			msg.data[0] = PCI_CONSECUTIVE | (s.txSeq & 0x0F);
+			memcpy(&msg.data[1], s.txData + s.txPos, chunk);
+			msg.len = 1 + chunk;
+			if (!buffer.write(msg)) {
+				return;
+			}
+
+			s.txPos += chunk;
+			s.txSeq++;
+			if (s.txPos >= s.txLen) {
+				s.txStatus = DONE;
+				return;
+			}
+			if (s.txBlockLeft != 0 && --s.txBlockLeft == 0) {
+				s.txWaiting = true;
+				s.txDeadline = now + CAN_ISOTP_TIMEOUT_US;
+			}
+			if (s.txSeparation != 0) {
+				s.txNext = now + s.txSeparation;
+			}
+		}
+	}
+
+	void receiveSingle(Session& s, const CANMessage& msg) {
+		uint8_t len = msg.data[0] & 0x0F;
+		if (s.rxStatus == DONE || len == 0 || len > 7 || len + 1 > msg.len || len > s.rxSize) {
+			return;
+		}
+		memcpy(s.rxBuffer, &msg.data[1], len);
+		s.rxLen = len;
+		s.rxStatus = DONE;
+	}
+
+	void receiveFirst(Session& s, const CANMessage& msg, uint32_t now) {
+		uint16_t len = ((msg.data[0] & 0x0F) << 8) | msg.data[1];
+		if (msg.len < 8 || len < 8) {
+			return;
+		}
+		if (s.rxStatus == DONE || len > s.rxSize) {
+			sendFlowControl(s, FC_OVERFLOW);
+			return;
+		}
+		memcpy(s.rxBuffer, &msg.data[2], 6);
+		s.rxLen = len;
+		s.rxPos = 6;
+		s.rxSeq = 1;
+		s.rxBlockCount = 0;
+		s.rxDeadline = now + CAN_ISOTP_TIMEOUT_US;
+		s.rxStatus = BUSY;
+		sendFlowControl(s, FC_CONTINUE);
+	}
+
+	void receiveConsecutive(Session& s, const CANMessage& msg, uint32_t now) {
+		if (s.rxStatus != BUSY) {
+			return;
+		}
+		if ((msg.data[0] & 0x0F) != (s.rxSeq & 0x0F)) {
+			s.rxStatus = ERROR;
+			return;
+		}
+		uint16_t chunk = s.rxLen - s.rxPos;
+		if (chunk > 7) {
+			chunk = 7;
+		}
+		if (msg.len < chunk + 1) {
+			s.rxStatus = ERROR;
+			return;
+		}
+		memcpy(s.rxBuffer + s.rxPos, &msg.data[1], chunk);
+		s.rxPos += chunk;
+		s.rxSeq++;
+		s.rxDeadline = now + CAN_ISOTP_TIMEOUT_US;
+		if (s.rxPos >= s.rxLen) {
+			s.rxStatus = DONE;
+			return;
+		}
+		if (s.blockSize != 0 && ++s.rxBlockCount == s.blockSize) {
+			s.rxBlockCount = 0;
+			sendFlowControl(s, FC_CONTINUE);
+		}
+	}
+
+	void receiveFlowControl(Session& s, const CANMessage& msg, uint32_t now) {
+		if (s.txStatus != BUSY || !s.txWaiting || msg.len < 3) {
+			return;
+		}
+		switch (msg.data[0] & 0x0F) {
+		case FC_CONTINUE:
+			s.txWaiting = false;
+			s.txBlockLeft = msg.data[1];
+			s.txSeparation = separationUs(msg.data[2]);
+			s.txNext = now;
+			sendConsecutive(s, now);
+			break;
+		case FC_WAIT:
+			s.txDeadline = now + CAN_ISOTP_TIMEOUT_US;
+			break;
+		default:
+			s.txStatus = ERROR;
+			break;
+		}
+	}
+};
+
+#endif /* COMMON_API_CAN_ISOTP_H_ */
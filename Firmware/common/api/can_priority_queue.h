@@ -0,0 +1,209 @@
+/*
+ * can_priority_queue.h
+ * Transmit queue that hands out CAN messages in bus arbitration order.
+ */
+
+#ifndef COMMON_API_CAN_PRIORITY_QUEUE_H_
+#define COMMON_API_CAN_PRIORITY_QUEUE_H_
+
+#include <stdint.h>
+
+#ifndef ___COMMON_NO_MBED__
+#include <mbed.h>
+#endif // ___COMMON_NO_MBED__
+
+/*
+ * CAN message priority queue template class
+ *
+ * Messages come out lowest arbitration ID first, the same order the bus
+ * would pick them in, and in FIFO order for equal IDs. Standard and
+ * extended frames are ranked by their 11-bit base ID, with a standard
+ * frame winning over an extended frame with the same base ID.
+ *
+ * Messages are kept in 128 buckets indexed by the top 7 bits of the base
+ * ID, with a bitmap of non-empty buckets. Finding the next message is a
+ * bitmap scan; inserting only walks the messages sharing a bucket.
+ *
+ * The interface matches CircularBuffer so it can be swapped in for it.
+ *
+ *  @param N capacity in messages; at most 254
+ */
+template <int N>
+class CANPriorityQueue {
+	static_assert(N > 0 && N < 0xFF, "Queue size must fit 8-bit indices");
+
+public:
+	/** Constructs a new, empty priority queue capable of storing up to
+	 *  N elements.
+	 */
+	CANPriorityQueue() {
+		clear();
+	}
+
+	/** Check if the queue is full
+	 *
+	 *  @returns
+	 *    true if full
+	 *    false if not full
+	 */
+	bool full() const {
+		return this->count == N;
+	}
+
+	/** Check if the queue is empty
+	 *
+	 *  @returns
+	 *    true if empty
+	 *    false if not empty
+	 */
+	bool empty() const {
+		return this->count == 0;
+	}
+
+	/** Number of messages in the queue
+	 *
+	 *  @returns
+	 *    messages written and not yet read
+	 */
+	int size() const {
+		return this->count;
+	}
+
+	/** Adds a message to the queue behind any message of equal or higher
+	 *  priority
+	 *
+	 *  Note: the caller is responsible for checking that
+	 *        the queue is not already full
+	 *
+	 *  @param msg message to add
+	 */
+	void write(const CANMessage& msg) {
+		uint8_t node = this->freeHead;
+		this->freeHead = this->next[node];
+
+		this->messages[node] = msg;
+		this->ranks[node] = rank(msg);
+
+		int bucket = this->ranks[node] >> BUCKET_SHIFT;
+		uint8_t prev = NONE;
+		uint8_t cur = this->head[bucket];
+		while (cur != NONE && this->ranks[cur] <= this->ranks[node]) {
+			prev = cur;
+			cur = this->next[cur];
+		}
+
+		this->next[node] = cur;
+		if (prev == NONE) {
+			this->head[bucket] = node;
+		} else {
+			this->next[prev] = node;
+		}
+
+		this->bitmap[bucket >> 5] |= (1UL << (bucket & 31));
+		this->count++;
+	}
+
+	/** Reads the highest priority message without removing it
+	 *
+	 *  Note: the caller is responsible for checking that
+	 *        the queue is not empty
+	 *
+	 *  @returns
+	 *    highest priority message in the queue
+	 */
+	const CANMessage& peek() const {
+		return this->messages[this->head[firstBucket()]];
+	}
+
+	/** Removes the highest priority message without reading it
+	 *
+	 *  Note: the caller is responsible for checking that
+	 *        the queue is not empty
+	 *
+	 */
+	void discard() {
+		int bucket = firstBucket();
+		uint8_t node = this->head[bucket];
+
+		this->head[bucket] = this->next[node];
+		if (this->head[bucket] == NONE) {
+			this->bitmap[bucket >> 5] &= ~(1UL << (bucket & 31));
+		}
+
+		this->next[node] = this->freeHead;
+		this->freeHead = node;
+		this->count--;
+	}
+
+	/** Pops the highest priority message
+	 *
+	 *  Note: the caller is responsible for checking that
+	 *        the queue is not empty
+	 *
+	 *  @returns
+	 *    highest priority message in the queue
+	 */
+	CANMessage read() {
+		CANMessage msg = peek();
+		discard();
+		return msg;
+	}
+
+	/** Empties the queue
+	 *
+	 *  Note: does not actually destroy any objects
+	 *
+	 */
+	void clear() {
+		for (int i = 0; i < BUCKETS; i++) {
+			this->head[i] = NONE;
+		}
+		for (int i = 0; i < BUCKETS / 32; i++) {
+			this->bitmap[i] = 0;
+		}
+		for (int i = 0; i < N; i++) {
+			this->next[i] = i + 1;
+		}
+		this->next[N - 1] = NONE;
+		this->freeHead = 0;
+		this->count = 0;
+	}
+
+private:
+	static const uint8_t NONE = 0xFF;
+	static const int BUCKETS = 128;
+	static const int BUCKET_SHIFT = 25;
+
+	/*
+	 * Arbitration rank of a message; lower wins.
+	 * Bits 31-21 hold the 11-bit base ID, bit 18 is set for extended frames
+	 * and bits 17-0 hold the rest of an extended ID.
+	 */
+	static uint32_t rank(const CANMessage& msg) {
+		if (msg.format == CANExtended) {
+			return (((msg.id >> 18) & 0x7FF) << 21) | (1UL << 18) | (msg.id & 0x3FFFF);
+		}
+		return (msg.id & 0x7FF) << 21;
+	}
+
+	/*
+	 * Index of the lowest non-empty bucket. The queue must not be empty.
+	 */
+	int firstBucket() const {
+		int word = 0;
+		while (this->bitmap[word] == 0) {
+			word++;
+		}
+		return (word << 5) + __builtin_ctz(this->bitmap[word]);
+	}
+
+	CANMessage messages[N];
+	uint32_t ranks[N];
+	uint8_t next[N];
+	uint8_t head[BUCKETS];
+	uint32_t bitmap[BUCKETS / 32];
+	uint8_t freeHead;
+	volatile uint8_t count;
+};
+
+#endif /* COMMON_API_CAN_PRIORITY_QUEUE_H_ */
@@ -0,0 +1,195 @@
+/*
+ * can_recorder.h
+ * CAN flight recorder: the last frames sent and received, kept across a
+ * watchdog reset.
+ */
+
+#ifndef COMMON_API_CAN_RECORDER_H_
+#define COMMON_API_CAN_RECORDER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef ___COMMON_NO_MBED__
+#include <mbed.h>
+#endif // ___COMMON_NO_MBED__
+
+#define CAN_RECORDER_MAGIC 0xCA4EF1D8
+
+// Storage layout: a header, then slots of three words
+#define CAN_RECORDER_HEADER_WORDS 4
+#define CAN_RECORDER_SLOT_WORDS 3
+// Words of storage for a recorder with this many slots
+#define CAN_RECORDER_WORDS(slots) (CAN_RECORDER_HEADER_WORDS + CAN_RECORDER_SLOT_WORDS * (slots))
+
+// First word of a slot
+#define CAN_RECORDER_ID_MASK 0x7FF
+#define CAN_RECORDER_TX (1UL << 11)
+#define CAN_RECORDER_EXTENDED (1UL << 12)
+#define CAN_RECORDER_REMOTE (1UL << 13)
+#define CAN_RECORDER_LEN_SHIFT 14
+#define CAN_RECORDER_LEN_MASK 0xF
+#define CAN_RECORDER_DELTA_SHIFT 18
+#define CAN_RECORDER_DELTA_MAX 0x3FFF
+
+// Length codes above 8 mark slots that are not frames
+// word 1: 29-bit ID of the extended frame in the next slot
+#define CAN_RECORDER_EXT_ID 13
+// word 1: time after reset, word 2: time of the last slot before it
+#define CAN_RECORDER_BOOT 14
+// word 1: current time, word 2: time of the last slot; for gaps longer
+// than CAN_RECORDER_DELTA_MAX us
+#define CAN_RECORDER_TIME 15
+
+/** RAM ring of the most recent CAN frames, for finding out what led up to
+ *  a watchdog reset
+ *
+ *  Each frame takes 12 bytes: ID, direction, length and the time since the
+ *  previous frame in one word, then the data. Frames are added from the
+ *  CANRXTXBuffer interrupt handler and write(), already under interrupt
+ *  lock, for a few dozen cycles each.
+ *
+ *  The storage, header included, belongs in .noinit so it keeps its
+ *  contents through a reset. start() carries on after the frames already
+ *  there, with a BOOT marker in between, as long as the header is valid.
+ *
+ *  dump() gives the contents oldest frame first, with a 16-byte header, to
+ *  send over CAN (e.g. with CANIsoTp) or serial. tools/can_trace turns a
+ *  dump into a trace file.
+ *
+ *  Typical usage:
+ *    uint32_t recorderStorage[CAN_RECORDER_WORDS(256)] __attribute__((section(".noinit")));
+ *    CANRecorder recorder(recorderStorage, 256, us_ticker_read);
+ *
+ *    void setup() {
+ *        if (recorder.start() && wdtReset) {
+ *            // keep what led up to the reset until it has been dumped
+ *            recorder.pause();
+ *        }
+ *        hardware->setCANRecorder(&recorder);
+ *    }
+ */
+class CANRecorder {
+public:
+	/**
+	 * @param storage CAN_RECORDER_WORDS(slots) words, preferably in .noinit
+	 * @param slots number of frames kept; must be a power of 2
+	 * @param clock current time (us), e.g. us_ticker_read
+	 */
+	CANRecorder(uint32_t* storage, uint32_t slots, uint32_t (*clock)(void));
+
+	/**
+	 * Start recording, keeping an earlier recording if the storage holds a
+	 * valid one.
+	 * @return true if an earlier recording was kept
+	 */
+	bool start();
+
+	/**
+	 * Drop everything recorded.
+	 */
+	void clear();
+
+	/**
+	 * Stop adding frames, e.g. until the recording has been dumped.
+	 */
+	void pause();
+
+	/**
+	 * Add frames again after pause().
+	 */
+	void resume();
+
+	/**
+	 * @return true while paused
+	 */
+	bool paused() const;
+
+	/**
+	 * @return number of resets recorded since clear()
+	 */
+	uint32_t boots() const;
+
+	/**
+	 * @return number of slots holding frames or markers
+	 */
+	uint32_t used() const;
+
+	/**
+	 * @return size (bytes) of the dump
+	 */
+	uint32_t dumpSize() const;
+
+	/**
+	 * Copy part of the dump: the header, then the slots oldest first, all
+	 * in little endian words.
+	 * @param offset byte offset into the dump
+	 * @param out where to copy to
+	 * @param len bytes wanted
+	 * @return bytes copied, 0 at the end of the dump
+	 */
+	int dump(uint32_t offset, uint8_t* out, int len) const;
+
+	/**
+	 * Add a frame. Interrupts must be disabled or this must be called from
+	 * the CAN interrupt, as CANRXTXBuffer does.
+	 * @param msg frame
+	 * @param tx true if sent by this board, false if received
+	 */
+	void record(const CANMessage& msg, bool tx) {
+		if (stopped) {
+			return;
+		}
+		uint32_t now = clock();
+		uint32_t delta = now - storage[LAST_TIME];
+		if (delta > CAN_RECORDER_DELTA_MAX) {
+			put(CAN_RECORDER_TIME << CAN_RECORDER_LEN_SHIFT, now, storage[LAST_TIME]);
+			delta = 0;
+		}
+		storage[LAST_TIME] = now;
+
+		uint32_t word = (msg.id & CAN_RECORDER_ID_MASK) | ((uint32_t)msg.len << CAN_RECORDER_LEN_SHIFT)
+				| (delta << CAN_RECORDER_DELTA_SHIFT);
+		if (tx) {
+			word |= CAN_RECORDER_TX;
+		}
+		if (msg.type == CANRemote) {
+			word |= CAN_RECORDER_REMOTE;
+		}
+		if (msg.format == CANExtended) {
+			put(CAN_RECORDER_EXT_ID << CAN_RECORDER_LEN_SHIFT, msg.id, 0);
+			word |= CAN_RECORDER_EXTENDED;
+		}
+
+		uint32_t* slot = slotAt(storage[HEAD]++);
+		slot[0] = word;
+		memcpy(&slot[1], msg.data, 8);
+	}
+
+private:
+	// Header words
+	enum {
+		MAGIC = 0,		// CAN_RECORDER_MAGIC ^ slots
+		HEAD,			// slots written since clear(); the next one is HEAD % slots
+		LAST_TIME,		// time of the newest slot
+		BOOTS			// BOOT markers written since clear()
+	};
+
+	uint32_t* const storage;
+	const uint32_t mask;
+	uint32_t (*const clock)(void);
+	bool stopped;
+
+	uint32_t* slotAt(uint32_t index) const {
+		return storage + CAN_RECORDER_HEADER_WORDS + (index & mask) * CAN_RECORDER_SLOT_WORDS;
+	}
+
+	void put(uint32_t word0, uint32_t word1, uint32_t word2) {
+		uint32_t* slot = slotAt(storage[HEAD]++);
+		slot[0] = word0;
+		slot[1] = word1;
+		slot[2] = word2;
+	}
+};
+
+#endif /* COMMON_API_CAN_RECORDER_H_ */
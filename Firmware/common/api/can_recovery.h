@@ -0,0 +1,164 @@
+/*
+ * can_recovery.h
+ * CAN error state tracking and bus-off recovery with backoff.
+ */
+
+#ifndef COMMON_API_CAN_RECOVERY_H_
+#define COMMON_API_CAN_RECOVERY_H_
+
+#include <stdint.h>
+
+// Error counter level at which the controller warns, see ISO 11898-1
+#define CAN_ERROR_WARNING_LIMIT 96
+// Error counter level at which the controller turns error passive
+#define CAN_ERROR_PASSIVE_LIMIT 128
+
+/** CAN controller error state machine
+ *
+ *  Driven from the CAN error interrupts rather than polled. On bus-off it
+ *  says how long to wait before restarting the controller: nothing for an
+ *  isolated bus-off, so the node is back after the protocol minimum of
+ *  128 x 11 recessive bits, and an exponentially growing delay while
+ *  bus-offs keep repeating, so a broken node does not keep disturbing the
+ *  bus.
+ *
+ *  Times are in us from the same clock as TimingCommon. The state machine
+ *  does not touch the hardware; hardware_common_mbed wires it to the CAN
+ *  interrupts.
+ *
+ *  Typical usage:
+ *    // CAN::BeIrq handler
+ *    uint32_t delay = recovery.busOff(now);
+ *    // restart the controller (CAN::mode(CAN::Normal)) after delay, then
+ *    recovery.recoveryStarted(now);
+ *
+ *    // CAN::EwIrq/EpIrq handlers, and after transfers while not error active
+ *    recovery.update(can.tderror(), can.rderror(), now);
+ */
+class CANRecovery {
+public:
+	enum State {
+		ERROR_ACTIVE = 0,
+		ERROR_WARNING,
+		ERROR_PASSIVE,
+		BUS_OFF,
+		NUM_STATES
+	};
+
+	/**
+	 * @param initialUs delay before restarting after an isolated bus-off
+	 * @param repeatUs delay after the first repeated bus-off; doubles on
+	 *        every further one
+	 * @param maxUs longest delay
+	 * @param stableUs time on the bus after which the next bus-off counts
+	 *        as isolated again
+	 */
+	CANRecovery(uint32_t initialUs = 0, uint32_t repeatUs = 10000, uint32_t maxUs = 500000, uint32_t stableUs = 1000000);
+
+	/**
+	 * Change the backoff; see the constructor.
+	 */
+	void setBackoff(uint32_t initialUs, uint32_t repeatUs, uint32_t maxUs, uint32_t stableUs);
+
+	/**
+	 * Start timing the error states.
+	 * @param now current time (us)
+	 */
+	void start(uint32_t now);
+
+	/**
+	 * The controller went bus-off.
+	 * @param now current time (us)
+	 * @return time (us) to wait before restarting the controller, 0 to
+	 *         restart right away
+	 */
+	uint32_t busOff(uint32_t now);
+
+	/**
+	 * The controller was restarted after busOff().
+	 * @param now current time (us)
+	 */
+	void recoveryStarted(uint32_t now);
+
+	/**
+	 * @return true once busOff() happened and recoveryStarted() has not
+	 *         been called since
+	 */
+	bool recoveryPending() const;
+
+	/**
+	 * The error counters may have changed. A successful transfer while bus-off
+	 * means recovery finished.
+	 * @param tec transmit error counter
+	 * @param rec receive error counter
+	 * @param now current time (us)
+	 * @param transferred true when called after a frame was sent or received
+	 */
+	void update(uint8_t tec, uint8_t rec, uint32_t now, bool transferred = false);
+
+	/**
+	 * @return current error state
+	 */
+	State state() const;
+
+	/**
+	 * @param s error state
+	 * @param now current time (us)
+	 * @return total time (us) spent in the state since start()
+	 */
+	uint32_t timeIn(State s, uint32_t now) const;
+
+	/**
+	 * @return bus-offs since start()
+	 */
+	uint32_t busOffCount() const;
+
+	/**
+	 * @return time (us) from the last bus-off to the first transfer after it
+	 */
+	uint32_t lastRecoveryUs() const;
+
+	/**
+	 * @return longest bus-off to first transfer time (us) since start()
+	 */
+	uint32_t maxRecoveryUs() const;
+
+	/**
+	 * @return highest transmit error counter seen since start()
+	 */
+	uint8_t peakTec() const;
+
+	/**
+	 * @return highest receive error counter seen since start()
+	 */
+	uint8_t peakRec() const;
+
+private:
+	uint32_t initialBackoff;
+	uint32_t repeatBackoff;
+	uint32_t maxBackoff;
+	uint32_t stableTime;
+
+	State current;
+	uint32_t enteredAt;
+	uint32_t timeInState[NUM_STATES];
+
+	uint32_t busOffAt;
+	uint32_t busOnAt;
+	uint32_t backoff;
+	bool pending;
+	bool everBusOn;
+
+	uint32_t busOffs;
+	uint32_t lastRecovery;
+	uint32_t maxRecovery;
+	uint8_t maxTec;
+	uint8_t maxRec;
+
+	/**
+	 * Account the time spent in the current state and switch to another.
+	 */
+	void enter(State next, uint32_t now);
+};
+
+#endif /* COMMON_API_CAN_RECOVERY_H_ */
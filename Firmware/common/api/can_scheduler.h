@@ -0,0 +1,169 @@
+/*
+ * can_scheduler.h
+ * Sends periodic CAN messages at their can_id.h rate, staggered so they do not burst together.
+ */
+
+#ifndef COMMON_API_CAN_SCHEDULER_H_
+#define COMMON_API_CAN_SCHEDULER_H_
+
+#include <stdint.h>
+#include <CAN/can_id.h>
+
+// Number of periodic messages one scheduler can send
+#ifndef CAN_SCHEDULER_MAX_FRAMES
+#define CAN_SCHEDULER_MAX_FRAMES 16
+#endif
+
+// Resolution of the load table used to pick phase offsets. Hyperperiods
+// longer than this many slots are folded onto the table.
+#ifndef CAN_SCHEDULER_SLOTS
+#define CAN_SCHEDULER_SLOTS 64
+#endif
+
+/** Periodic transmit schedule for the messages a board sends
+ *
+ *  Every message gets its period from can_message_info::RATE and a phase
+ *  offset chosen so that, over the hyperperiod (the LCM of all periods),
+ *  as few messages as possible fall into the same time slot. Messages
+ *  sharing a period end up evenly spread across it instead of all being
+ *  sent on the same onTick().
+ *
+ *  Pending messages are kept in one min-heap ordered by deadline, so
+ *  onTick() only looks at messages that are due. Deadlines advance by
+ *  whole periods, so a late send does not shift later ones.
+ *
+ *  Typical usage:
+ *    void sendHeartbeat() { common.writeCANMessage(...); }
+ *    void sendTemps() { common.writeCANMessage(...); }
+ *
+ *    CANScheduler schedule;
+ *
+ *    void setup() {
+ *        schedule.add(BRIZO_CAN::WHEEL_HEART, sendHeartbeat);
+ *        schedule.add(BRIZO_CAN::WHEEL_TEMPS, sendTemps);
+ *        common.startTimingCommon(&timing, &wdt_reset);
+ *        schedule.start(timing.onTick(NULL));
+ *    }
+ *
+ *    void main() {
+ *        while (1) {
+ *            uint32_t now = common.loopTime(&timing, NULL);
+ *            schedule.onTick(now);
+ *        }
+ *    }
+ */
+class CANScheduler {
+public:
+	/** One scheduled message and how closely it keeps to its period */
+	struct Frame {
+		int id;
+		uint32_t period;		// us
+		uint32_t offset;		// us after start()
+		uint32_t deadline;		// next send time (us)
+		void (*send)(void);
+		uint32_t sent;
+		uint32_t missed;		// whole periods skipped while late
+		uint32_t lastJitter;	// us the last send was after its deadline
+		uint32_t maxJitter;		// us, worst seen since start()
+		uint64_t totalJitter;	// us, sum over every send
+	};
+
+	CANScheduler();
+
+	/**
+	 * Add a periodic message. Must be called before start().
+	 * @param info message ID and rate; RATE is the period in us
+	 * @param send called when the message is due; should write the message
+	 * @return 0 on success, -1 if RATE is 0 (not periodic), the scheduler
+	 *         is full or already started
+	 */
+	int add(const BRIZO_CAN::can_message_info& info, void (*send)(void));
+
+	/**
+	 * Assign phase offsets and schedule the first send of each message.
+	 * @param now current time (us), e.g. from TimingCommon::onTick()
+	 */
+	void start(uint32_t now);
+
+	/**
+	 * Send every message whose deadline has passed, earliest first.
+	 * @param now current time (us)
+	 * @return number of messages sent
+	 */
+	int onTick(uint32_t now);
+
+	/**
+	 * @return time (us) the next message is due; only valid once started
+	 *         with at least one message
+	 */
+	uint32_t nextDeadline() const;
+
+	/**
+	 * @return number of scheduled messages
+	 */
+	int size() const;
+
+	/**
+	 * @param i message index, in the order they were added; less than size()
+	 * @return the message's schedule and jitter counters
+	 */
+	const Frame& frame(int i) const;
+
+	/**
+	 * @param i message index, less than size()
+	 * @return mean lateness (us) of the message's sends, 0 if none yet
+	 */
+	uint32_t meanJitter(int i) const;
+
+	/**
+	 * Reset the jitter counters of every message.
+	 */
+	void clearJitter();
+
+	/**
+	 * @return hyperperiod (us) the offsets were planned over
+	 */
+	uint32_t hyperperiod() const;
+
+	/**
+	 * @return most messages planned into any one load slot; 1 means no two
+	 *         messages are ever due together
+	 */
+	int peakSlotLoad() const;
+
+private:
+	Frame frames[CAN_SCHEDULER_MAX_FRAMES];
+	int numFrames;
+	bool started;
+
+	// Frame indices, a min-heap on deadline
+	uint8_t heap[CAN_SCHEDULER_MAX_FRAMES];
+
+	uint32_t hyper;
+	int peakLoad;
+
+	/**
+	 * Pick phase offsets, shortest period first, each into the offset
+	 * that keeps the busiest slot least busy. Ties go to the first offset
+	 * from a slot hashed from the ID, so boards started together do not
+	 * all send their first message at once.
+	 */
+	void assignOffsets();
+
+	/**
+	 * @return true if heap entry a is due before heap entry b
+	 */
+	bool before(int a, int b) const;
+
+	/**
+	 * Restore heap order below position i.
+	 */
+	void siftDown(int i);
+
+	/**
+	 * Restore heap order above position i.
+	 */
+	void siftUp(int i);
+};
+
+#endif /* COMMON_API_CAN_SCHEDULER_H_ */
@@ -0,0 +1,154 @@
+/*
+ * can_send_policy.h
+ * Send-on-change filtering for periodic CAN messages.
+ */
+
+#ifndef COMMON_API_CAN_SEND_POLICY_H_
+#define COMMON_API_CAN_SEND_POLICY_H_
+
+#include <stdint.h>
+#include <CAN/can_id.h>
+
+#ifndef ___COMMON_NO_MBED__
+#include <mbed.h>
+#endif // ___COMMON_NO_MBED__
+
+// Number of message IDs one policy can track
+#ifndef CAN_SEND_POLICY_MAX_IDS
+#define CAN_SEND_POLICY_MAX_IDS 16
+#endif
+
+/** Per-ID rules deciding whether a message is worth putting on the bus
+ *
+ *  A message with a rule is suppressed when its payload matches the last
+ *  one sent with that ID, until maxInterval has passed since that send.
+ *  A changed payload is also held back until minInterval has passed, so
+ *  fast-changing values are rate limited. Keep offering the message (for
+ *  example from a CANScheduler) and the latest value goes out once it is
+ *  allowed. IDs without a rule are always sent.
+ *
+ *  Typical usage:
+ *    CANSendPolicy policy;
+ *
+ *    void setup() {
+ *        // Resend unchanged light states once a second at most,
+ *        // changes at most every 20 ms
+ *        policy.add(BRIZO_CAN::DASH_LIGHT_SET_STATES, 1000000, 20000);
+ *    }
+ *
+ *    void sendLights() {
+ *        policy.write(canBuffer, makeMessage(...), timer.read_us());
+ *    }
+ */
+class CANSendPolicy {
+public:
+	/** Rule and counters for one ID */
+	struct Rule {
+		int id;
+		uint32_t minInterval;	// us between sends of changed payloads
+		uint32_t maxInterval;	// us before an unchanged payload is resent
+		uint32_t lastSent;		// us
+		bool hasSent;
+		uint8_t len;			// last payload sent
+		uint8_t data[8];
+		uint32_t sent;
+		uint32_t suppressed;
+	};
+
+	CANSendPolicy();
+
+	/**
+	 * Add a send-on-change rule for a message.
+	 * @param info message to filter
+	 * @param maxInterval longest time (us) an unchanged payload is held back;
+	 *        usually the message's RATE
+	 * @param minInterval shortest time (us) between two sends, 0 for none
+	 * @return 0 on success, -1 if the policy is full or the ID already has a rule
+	 */
+	int add(const BRIZO_CAN::can_message_info& info, uint32_t maxInterval, uint32_t minInterval = 0);
+
+	/**
+	 * Decide whether a message should be sent now. Counts it as suppressed
+	 * if not.
+	 * @param msg message about to be written
+	 * @param now current time (us)
+	 * @return true to send it, false to drop it
+	 */
+	bool shouldSend(const CANMessage& msg, uint32_t now);
+
+	/**
+	 * Record that a message went out; call after the buffer accepted a
+	 * message shouldSend() allowed.
+	 * @param msg message written
+	 * @param now current time (us)
+	 */
+	void markSent(const CANMessage& msg, uint32_t now);
+
+	/**
+	 * Write a message through a buffer if the policy allows it.
+	 * @param buffer CANRXTXBuffer, or anything with the same write()
+	 * @param msg message to write
+	 * @param now current time (us)
+	 * @return 1 if the message was queued or suppressed,
+	 *         0 if the buffer had no space
+	 */
+	template <typename Buffer>
+	int write(Buffer& buffer, const CANMessage& msg, uint32_t now) {
+		if (!shouldSend(msg, now))
+			return 1;
+		if (!buffer.write(msg))
+			return 0;
+		markSent(msg, now);
+		return 1;
+	}
+
+	/**
+	 * @return number of rules
+	 */
+	int size() const;
+
+	/**
+	 * @param i rule index, in the order they were added; less than size()
+	 * @return the rule and its counters
+	 */
+	const Rule& rule(int i) const;
+
+	/**
+	 * @return frames suppressed since clearStats()
+	 */
+	uint32_t suppressedFrames() const;
+
+	/**
+	 * @return bus time saved since clearStats(), in bits, counting each
+	 *         suppressed frame without stuff bits
+	 */
+	uint64_t suppressedBits() const;
+
+	/**
+	 * Bus load saved since clearStats(). Divide by CAN_FREQUENCY for the
+	 * share of the bus.
+	 * @param now current time (us)
+	 * @return suppressed bits per second
+	 */
+	uint32_t savedBitsPerSecond(uint32_t now) const;
+
+	/**
+	 * Reset the sent/suppressed counters.
+	 * @param now current time (us), the start of the savedBitsPerSecond() window
+	 */
+	void clearStats(uint32_t now);
+
+private:
+	Rule rules[CAN_SEND_POLICY_MAX_IDS];
+	int numRules;
+	uint32_t statsStart;
+	uint32_t totalSuppressed;
+	uint64_t totalSuppressedBits;
+
+	/**
+	 * @return rule for a message, or NULL if it has none
+	 */
+	Rule* find(const CANMessage& msg);
+};
+
+#endif /* COMMON_API_CAN_SEND_POLICY_H_ */
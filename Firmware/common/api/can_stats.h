@@ -0,0 +1,210 @@
+/*
+ * can_stats.h
+ * Optional CAN traffic and loss counters for the CAN buffers.
+ */
+
+#ifndef COMMON_API_CAN_STATS_H_
+#define COMMON_API_CAN_STATS_H_
+
+#include <stdint.h>
+
+#ifndef ___COMMON_NO_MBED__
+#include <mbed.h>
+#endif // ___COMMON_NO_MBED__
+
+// Define CAN_STATS to 1 in the project settings to count CAN traffic.
+// When 0 the counters compile away entirely.
+#ifndef CAN_STATS
+#define CAN_STATS 0
+#endif
+
+// Number of distinct IDs counted individually; must be a power of 2
+#ifndef CAN_STATS_MAX_IDS
+#define CAN_STATS_MAX_IDS 32
+#endif
+
+#if CAN_STATS
+
+/** Frames sent and received with one CAN ID */
+struct CANIdCount {
+	uint32_t id;
+	uint16_t rx;		// wraps
+	uint16_t tx;		// wraps
+};
+
+/** CAN traffic counters kept by CANRXBuffer and CANRXTXBuffer
+ *
+ *  Counters are updated from the CAN interrupt, or with interrupts disabled.
+ *  Reading them from the main loop can see a partly updated set, which is
+ *  fine for diagnostics.
+ *
+ *  IDs are counted in a small open-addressed table. Once CAN_STATS_MAX_IDS
+ *  IDs have been seen, frames with new IDs only increment untracked().
+ */
+class CANStats {
+	static_assert(CAN_STATS_MAX_IDS > 0 && (CAN_STATS_MAX_IDS & (CAN_STATS_MAX_IDS - 1)) == 0,
+			"CAN_STATS_MAX_IDS must be a power of 2");
+
+public:
+	CANStats() {
+		clear();
+		// The cycle counter times the interrupt handler
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	}
+
+	/** Reset every counter and forget all IDs */
+	void clear() {
+		for (int i = 0; i < CAN_STATS_MAX_IDS; i++) {
+			counts[i].id = EMPTY;
+			counts[i].rx = 0;
+			counts[i].tx = 0;
+		}
+		untrackedFrames = 0;
+		rxOverflowCount = 0;
+		txRejectCount = 0;
+		rxHighWaterMark = 0;
+		txHighWaterMark = 0;
+		isrMaxCycleCount = 0;
+		rxDrainCycleCount = 0;
+		rxDrainFrameCount = 0;
+	}
+
+	void countRx(uint32_t id) {
+		CANIdCount* entry = find(id);
+		if (entry) {
+			entry->rx++;
+		} else {
+			untrackedFrames++;
+		}
+	}
+
+	void countTx(uint32_t id) {
+		CANIdCount* entry = find(id);
+		if (entry) {
+			entry->tx++;
+		} else {
+			untrackedFrames++;
+		}
+	}
+
+	/** Received frames were lost because they were not read in time
+	 *  @param frames number of frames lost, e.g. from CAN::rxLost()
+	 */
+	void countRxOverflow(int frames) {
+		rxOverflowCount += frames;
+	}
+
+	/** write() turned a frame away because the transmit queue was full */
+	void countTxReject() {
+		txRejectCount++;
+	}
+
+	void rxLevel(int level) {
+		if (level > rxHighWaterMark)
+			rxHighWaterMark = level;
+	}
+
+	void txLevel(int level) {
+		if (level > txHighWaterMark)
+			txHighWaterMark = level;
+	}
+
+	/** Frames were drained from the controller in one pass
+	 *  @param frames number of frames read
+	 *  @param begin cycle count from isrBegin() taken before the pass
+	 */
+	void countRxDrain(int frames, uint32_t begin) {
+		rxDrainCycleCount += DWT->CYCCNT - begin;
+		rxDrainFrameCount += frames;
+	}
+
+	/** @returns cycle count to pass to isrEnd() */
+	uint32_t isrBegin() const {
+		return DWT->CYCCNT;
+	}
+
+	void isrEnd(uint32_t begin) {
+		uint32_t cycles = DWT->CYCCNT - begin;
+		if (cycles > isrMaxCycleCount)
+			isrMaxCycleCount = cycles;
+	}
+
+	/** @returns number of slots in the per-ID table */
+	int size() const { return CAN_STATS_MAX_IDS; }
+
+	/**
+	 * @param i slot, less than size()
+	 * @returns counts for the slot; id is CANStats::EMPTY for unused slots
+	 */
+	const CANIdCount& entry(int i) const { return counts[i]; }
+
+	/** @returns frames with IDs that did not fit in the table */
+	uint32_t untracked() const { return untrackedFrames; }
+	/** @returns received frames lost before they reached the receive buffer;
+	 *  a lower bound, see CAN::rxLost() */
+	uint32_t rxOverflows() const { return rxOverflowCount; }
+	/** @returns frames write() could not queue */
+	uint32_t txRejects() const { return txRejectCount; }
+	/** @returns most messages ever waiting in the receive buffer */
+	int rxHighWater() const { return rxHighWaterMark; }
+	/** @returns most messages ever waiting in the transmit queue */
+	int txHighWater() const { return txHighWaterMark; }
+	/** @returns longest interrupt handler run, in CPU cycles */
+	uint32_t isrMaxCycles() const { return isrMaxCycleCount; }
+	/** @returns CPU cycles spent draining received frames */
+	uint64_t rxDrainCycles() const { return rxDrainCycleCount; }
+	/** @returns frames drained; rxDrainCycles() / rxDrainFrames() is the cost per frame */
+	uint32_t rxDrainFrames() const { return rxDrainFrameCount; }
+
+	static const uint32_t EMPTY = 0xFFFFFFFF;
+
+private:
+	CANIdCount* find(uint32_t id) {
+		uint32_t slot = (id * 2654435761UL) & (CAN_STATS_MAX_IDS - 1);
+		for (int probe = 0; probe < CAN_STATS_MAX_IDS; probe++) {
+			CANIdCount& entry = counts[slot];
+			if (entry.id == id)
+				return &entry;
+			if (entry.id == EMPTY) {
+				entry.id = id;
+				return &entry;
+			}
+			slot = (slot + 1) & (CAN_STATS_MAX_IDS - 1);
+		}
+		return NULL;
+	}
+
+	CANIdCount counts[CAN_STATS_MAX_IDS];
+	uint32_t untrackedFrames;
+	uint32_t rxOverflowCount;
+	uint32_t txRejectCount;
+	int rxHighWaterMark;
+	int txHighWaterMark;
+	uint32_t isrMaxCycleCount;
+	uint64_t rxDrainCycleCount;
+	uint32_t rxDrainFrameCount;
+};
+
+#else
+
+/*
+ * Stand-in for CANStats when CAN_STATS is 0; every call is a no-op.
+ */
+class CANStats {
+public:
+	void clear() {}
+	void countRx(uint32_t) {}
+	void countTx(uint32_t) {}
+	void countRxOverflow(int) {}
+	void countTxReject() {}
+	void rxLevel(int) {}
+	void txLevel(int) {}
+	void countRxDrain(int, uint32_t) {}
+	uint32_t isrBegin() const { return 0; }
+	void isrEnd(uint32_t) {}
+};
+
+#endif // CAN_STATS
+
+#endif /* COMMON_API_CAN_STATS_H_ */
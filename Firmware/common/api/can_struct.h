@@ -14,6 +14,7 @@
 #define COMMON_API_CAN_STRUCT_H_
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
 #ifndef ___NO_MBED__
 #include <mbed.h>
@@ -65,6 +66,44 @@ DataStruct unpackMessage(CANMessage& msg) {
     return *(reinterpret_cast<DataStruct*>(sideStepConst));
 }
 
+/* Helper template function for constructing CAN messages from a generated
+ * CAN/can_codec.h payload, which carries its own ID
+ *
+ * @param payload payload struct to send
+ *
+ * @returns
+ *   CANMessage with the payload's ID, bytes and DLC
+ *
+ * Example usage:
+ *   BRIZO_CAN::WheelTempsPayload temps;
+ *   temps.mcuTemp = BRIZO_CAN::WheelTempsPayload::mcuTempScale::fromUnits<10>(tenthsC);
+ *   ...
+ *   can.write(makeMessage(temps));
+ */
+template <class Payload>
+CANMessage makeMessage(const Payload& payload) {
+    return makeMessage(Payload::ID, payload);
+}
+
+/* Helper template function for unpacking CAN messages into a generated
+ * CAN/can_codec.h payload
+ *
+ * @param msg the CANMessage object to unpack
+ * @param payload filled in if the message matches
+ *
+ * @returns
+ *   true if the message has the payload's ID and DLC,
+ *   false otherwise (payload is left untouched)
+ */
+template <class Payload>
+bool unpackMessage(const CANMessage& msg, Payload& payload) {
+    if (msg.id != (unsigned int)Payload::ID || msg.len != sizeof(Payload)) {
+        return false;
+    }
+    memcpy(&payload, msg.data, sizeof(Payload));
+    return true;
+}
+
 
 
 
@@ -0,0 +1,176 @@
+/*
+ * can_time_sync.h
+ * Aligns the boards' clocks to the telemetry node's with sync and follow-up
+ * frames over CAN.
+ */
+
+#ifndef COMMON_API_CAN_TIME_SYNC_H_
+#define COMMON_API_CAN_TIME_SYNC_H_
+
+#include <stdint.h>
+#include <TimingCommon.h>
+#include <CAN/can_id.h>
+
+#ifndef ___COMMON_NO_MBED__
+#include <mbed.h>
+#endif // ___COMMON_NO_MBED__
+
+// A sample further than this from the current estimate is taken as a late
+// interrupt and skipped, unless it happens several times in a row
+#define CAN_TIME_SYNC_GATE_US 200
+// Samples further apart than this restart the estimate
+#define CAN_TIME_SYNC_MAX_INTERVAL_US 10000000
+
+/** Two-step clock synchronisation over CAN
+ *
+ *  The master (the telemetry node) sends a one-byte SYNC frame holding a
+ *  sequence number. When the frame is on the bus, its TX interrupt takes the
+ *  master's time, which goes out in a FOLLOW_UP frame with the same sequence
+ *  number. Every other board takes its own time in the RX interrupt for
+ *  SYNC. Both interrupts come at the end of the same frame, so each
+ *  SYNC/FOLLOW_UP pair gives one master time and local time at the same
+ *  instant, without the arbitration and queueing delays.
+ *
+ *  The boards estimate the rate difference of their clock from consecutive
+ *  samples and the offset from each one, and hand both to TimingCommon, so
+ *  TimingCommon::globalTime() gives times comparable across the car.
+ *
+ *  The master times the first TX interrupt after SYNC, so SYNC is only sent
+ *  when the controller has nothing else pending. It must have a lower ID than
+ *  anything else the master sends.
+ *
+ *  Typical usage on a board:
+ *    CANTimeSync timeSync(timing);
+ *
+ *    void stampSync(const CANMessage& msg) {
+ *        timeSync.rxFrame(msg, timer.read_us());
+ *    }
+ *    // setup: canBuffer.setRxHook(stampSync);
+ *
+ *    // main loop
+ *    while (canBuffer.read(msg)) {
+ *        if (!timeSync.handle(msg)) {
+ *            handleOther(msg);
+ *        }
+ *    }
+ *    // timing.globalTime(now) is now the network time
+ *
+ *  On the master:
+ *    // CAN::TxIrq handler, before canBuffer.handleIrq()
+ *    timeSync.txComplete(timer.read_us());
+ *
+ *    // main loop
+ *    if (syncDue) {
+ *        timeSync.sendSync(can, now);
+ *    }
+ *    CANMessage followUp;
+ *    if (timeSync.followUp(followUp)) {
+ *        canBuffer.write(followUp);
+ *    }
+ */
+class CANTimeSync {
+public:
+	/**
+	 * @param timing clock to correct on boards, and to read network time
+	 *        from on the master
+	 * @param syncId ID of SYNC frames
+	 * @param followUpId ID of FOLLOW_UP frames
+	 */
+	CANTimeSync(TimingCommon& timing, uint32_t syncId = BRIZO_CAN::TELEMETRY_TIME_SYNC.ID,
+			uint32_t followUpId = BRIZO_CAN::TELEMETRY_TIME_FOLLOW_UP.ID);
+
+	/**
+	 * Master: send a SYNC frame if the controller is idle.
+	 * @param can controller, written directly to get the TX interrupt
+	 * @param now current time (us)
+	 * @return 0 if sent, -1 if the controller is busy or the last SYNC has
+	 *         not been sent yet; try again on the next loop
+	 */
+	int sendSync(CAN& can, uint32_t now);
+
+	/**
+	 * Master: a frame was sent. Call first thing in the CAN::TxIrq handler.
+	 * @param now current time (us)
+	 */
+	void txComplete(uint32_t now);
+
+	/**
+	 * Master: get the FOLLOW_UP for the last SYNC sent.
+	 * @param msg filled in with the frame to send
+	 * @return true if there is one to send
+	 */
+	bool followUp(CANMessage& msg);
+
+	/**
+	 * Board: a frame arrived. Call from the RX interrupt, as a
+	 * CANRXTXBuffer receive hook.
+	 * @param msg received frame
+	 * @param now current time (us)
+	 */
+	void rxFrame(const CANMessage& msg, uint32_t now);
+
+	/**
+	 * Board: handle a frame read from the buffer, updating the clock
+	 * correction on FOLLOW_UP.
+	 * @param msg received frame
+	 * @return true if it was a SYNC or FOLLOW_UP frame
+	 */
+	bool handle(const CANMessage& msg);
+
+	/**
+	 * @return samples used since the estimate (re)started
+	 */
+	uint32_t samples() const;
+
+	/**
+	 * @return samples skipped as outliers
+	 */
+	uint32_t rejected() const;
+
+	/**
+	 * @return difference (us) between the master time and the estimate at
+	 *         the last sample
+	 */
+	int32_t lastError() const;
+
+	/**
+	 * @return largest lastError() since the rate estimate settled
+	 */
+	uint32_t maxError() const;
+
+	/**
+	 * @return estimated rate of the master clock relative to this one, in
+	 *         parts per billion
+	 */
+	int32_t rateErrorPpb() const;
+
+private:
+	TimingCommon& timing;
+	const uint32_t syncId;
+	const uint32_t followUpId;
+
+	// Master
+	uint8_t txSeq;
+	bool txWaiting;
+	uint32_t txWrittenAt;
+	bool txCaptured;
+	uint32_t txTime;
+
+	// Board, written from the RX interrupt
+	volatile bool rxValid;
+	volatile uint8_t rxSeq;
+	volatile uint32_t rxTime;
+
+	uint32_t lastLocal;
+	uint32_t lastGlobal;
+	int32_t rate;			// 2^-32 units, as for TimingCommon
+	uint32_t numSamples;
+	uint32_t numRejected;
+	uint8_t rejectedInRow;
+	int32_t error;
+	uint32_t worstError;
+
+	void sample(uint32_t global, uint32_t local);
+};
+
+#endif /* COMMON_API_CAN_TIME_SYNC_H_ */
@@ -44,6 +44,15 @@ public:
 		return this->start == this->end;
 	}
 
+	/** Number of elements in the buffer
+	 *
+	 *  @returns
+	 *    elements written and not yet read
+	 */
+	int size() const {
+		return (this->end - this->start + N) % N;
+	}
+
 	/** Adds an element of type T to the end of the buffer
 	 *
 	 *  Note: the caller is responsible for checking that
@@ -51,11 +60,63 @@ public:
 	 *
 	 *  @param s element to append
 	 */
-	void write(T s) {
+	void write(const T& s) {
 		this->buffer[this->end] = s;
 		this->end = (this->end + 1) % N;
 	}
 
+	/** Returns the free slot at the end of the buffer so that it can be
+	 *  filled in place. The element is not visible to readers until
+	 *  commit() is called.
+	 *
+	 *  Note: the caller is responsible for checking that
+	 *        the buffer is not already full
+	 *
+	 *  @returns
+	 *    reference to the element at the end of the buffer
+	 */
+	T& claim() {
+		return this->buffer[this->end];
+	}
+
+	/** Returns the run of free slots at the end of the buffer, up to the
+	 *  point where it wraps, so that several elements can be filled in
+	 *  place. They are not visible to readers until commit(n) is called.
+	 *
+	 *  @param n set to the number of slots in the run; 0 if full
+	 *
+	 *  @returns
+	 *    pointer to the first slot of the run
+	 */
+	T* claim(int& n) {
+		int first = this->start;
+		int last = this->end;
+		if (last >= first) {
+			n = N - last - (first == 0 ? 1 : 0);
+		} else {
+			n = first - last - 1;
+		}
+		return &this->buffer[last];
+	}
+
+	/** Appends n elements previously filled through claim(n)
+	 *
+	 *  @param n number of elements to append; at most the run size
+	 */
+	void commit(int n) {
+		this->end = (this->end + n) % N;
+	}
+
+	/** Appends the element previously filled through claim()
+	 *
+	 *  Note: the caller is responsible for checking that
+	 *        the buffer is not already full
+	 *
+	 */
+	void commit() {
+		this->end = (this->end + 1) % N;
+	}
+
 	/** Pops the element at the front of the buffer
 	 *
 	 *  Note: the caller is responsible for checking that
@@ -70,6 +131,29 @@ public:
 		return s;
 	}
 
+	/** Pops up to max elements from the front of the buffer
+	 *
+	 *  Safe against a writer adding elements at the same time; elements
+	 *  written after the call starts are left for the next read.
+	 *
+	 *  @param out array to copy the elements to
+	 *  @param max size of out
+	 *
+	 *  @returns
+	 *    number of elements copied
+	 */
+	int read(T* out, int max) {
+		int first = this->start;
+		int last = this->end;
+		int n = 0;
+		while (first != last && n < max) {
+			out[n++] = this->buffer[first];
+			first = (first + 1) % N;
+		}
+		this->start = first;
+		return n;
+	}
+
 	/** Reads the element at the front of the buffer without removing it
 	 *
 	 *  Note: the caller is responsible for checking that
@@ -0,0 +1,163 @@
+/*
+ * cpu_load.h
+ * CPU load meter: sleeps the main loop while it has nothing to do and counts
+ * the time asleep against the time busy.
+ */
+
+#ifndef COMMON_API_CPU_LOAD_H_
+#define COMMON_API_CPU_LOAD_H_
+
+#include <stdint.h>
+#include <mbed.h>
+
+// Length of one load measurement (us); load() and peak() are per window
+#ifndef CPU_LOAD_WINDOW_US
+#define CPU_LOAD_WINDOW_US 100000
+#endif
+
+// Longest one idle() sleeps for (us), so the main loop still feeds the
+// watchdog on a board with nothing scheduled. Keep well under the WDT timeout.
+#ifndef CPU_LOAD_MAX_SLEEP_US
+#define CPU_LOAD_MAX_SLEEP_US 100000
+#endif
+
+/** Idle hook and CPU load meter for a board's main loop
+ *
+ *  idle() sleeps with __WFI until an interrupt or until the given time has
+ *  passed, whichever is first. The time from going to sleep to waking up is
+ *  idle, everything else (main loop and interrupt handlers) busy. Time is
+ *  read from the clock given to the constructor, the RIT based us ticker on
+ *  the LPC15XX.
+ *
+ *  Load is measured over fixed windows of CPU_LOAD_WINDOW_US: load() is the
+ *  busy share of the last finished window, peak() the busiest window since
+ *  clearPeak(). Both are in tenths of a percent, so 1000 means the board
+ *  never slept; that board has no headroom left and its callbacks run late.
+ *
+ *  Windows are only closed from idle(), so call it on every loop pass, even
+ *  when there is no time to sleep. hardware_common::idle() does this with
+ *  the next TimingCommon deadline, and writeHeartbeat() sends the load in
+ *  the heartbeat.
+ *
+ *  Typical usage:
+ *    CPULoad cpuLoad(us_ticker_read);
+ *
+ *    void heartbeat() {
+ *        common.writeHeartbeat(BRIZO_CAN::WHEEL_HEART.ID, &timing, &cpuLoad);
+ *    }
+ *
+ *    void main() {
+ *        while (1) {
+ *            common.loopTime(&timing, NULL);
+ *            ...
+ *            common.idle(&timing, &cpuLoad, NULL);
+ *        }
+ *    }
+ */
+class CPULoad {
+public:
+	/**
+	 * @param clock current time (us), e.g. us_ticker_read
+	 * @param window length of one load measurement (us)
+	 */
+	CPULoad(uint32_t (*clock)(void), uint32_t window = CPU_LOAD_WINDOW_US);
+
+	/**
+	 * Sleep until an interrupt or for at most maxUs, and count the time
+	 * asleep as idle.
+	 * @param maxUs longest time to sleep (us), capped at CPU_LOAD_MAX_SLEEP_US;
+	 *        0 to only update the load
+	 * @param workPending checked with interrupts disabled just before going
+	 *        to sleep; if it returns true there is no sleep, so work an
+	 *        interrupt handed over after the loop last looked is not left
+	 *        waiting. Can be NULL.
+	 * @return time slept (us)
+	 */
+	uint32_t idle(uint32_t maxUs, bool (*workPending)(void) = NULL);
+
+	/**
+	 * Sleep as idle() above, checking for work with a member function.
+	 */
+	template<typename T>
+	uint32_t idle(uint32_t maxUs, T* object, bool (T::*workPending)(void)) {
+		if (!arm(maxUs))
+			return 0;
+		__disable_irq();
+		return sleep(!(object->*workPending)());
+	}
+
+	/**
+	 * @return busy share of the last finished window, in tenths of a percent
+	 */
+	uint16_t load() const;
+
+	/**
+	 * @return busy share of the busiest window since clearPeak(), in tenths
+	 *         of a percent
+	 */
+	uint16_t peak() const;
+
+	/**
+	 * Start looking for the busiest window again, from the last finished
+	 * one, e.g. after sending peak().
+	 */
+	void clearPeak();
+
+	/**
+	 * @return busy share over every window since the meter was created or
+	 *         cleared, in tenths of a percent
+	 */
+	uint16_t average() const;
+
+	/**
+	 * @return number of windows finished since the meter was created or
+	 *         cleared
+	 */
+	uint32_t windows() const;
+
+	/**
+	 * Reset every count. The current window carries on.
+	 */
+	void clear();
+
+private:
+	uint32_t (*clock)(void);
+	const uint32_t window;
+
+	// Wakes the CPU from __WFI once the sleep is over
+	Timeout wakeup;
+
+	uint32_t windowStart;
+	uint32_t windowIdle;		// idle time (us) so far in the current window
+	uint16_t lastLoad;
+	uint16_t peakLoad;
+	uint32_t windowCount;
+	uint64_t totalIdle;			// idle time (us) in the finished windows
+
+	void wake() {}
+
+	/**
+	 * Close the windows finished by now and set the wakeup.
+	 * @return false if there is no time to sleep
+	 */
+	bool arm(uint32_t maxUs);
+
+	/**
+	 * With interrupts disabled: sleep until an interrupt if asleep is true,
+	 * count the time as idle, then enable interrupts.
+	 * @return time slept (us)
+	 */
+	uint32_t sleep(bool asleep);
+
+	/**
+	 * Count the time from from to to as idle, closing windows on the way.
+	 */
+	void account(uint32_t from, uint32_t to);
+
+	/**
+	 * Finish the current window with idle time (us) in it.
+	 */
+	void closeWindow(uint32_t idle);
+};
+
+#endif /* COMMON_API_CPU_LOAD_H_ */
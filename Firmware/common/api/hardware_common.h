@@ -16,6 +16,10 @@
 #include <TimingCommon.h>
 #include <CAN.h>
 #include <WDT.h>
+#include <can_recovery.h>
+#include <can_recorder.h>
+#include <cpu_load.h>
+#include <task_executor.h>
 
 // Note: for CAN applications, include either CAN.h (HW) or can_lite.h (SW)
 
@@ -31,6 +35,16 @@ public:
      */
     virtual void setupCAN(void) = 0;
 
+    /**
+     * Only take receive interrupts for the given messages, instead of every
+     * message on the bus. Call after setupCAN().
+     * @param subscriptions messages this board needs to receive
+     * @param count number of entries in subscriptions
+     * @return 0 on success, 1 if the filters had to let through more
+     *         unwanted IDs than intended (they are installed anyway)
+     */
+    virtual int setupCANFilters(const BRIZO_CAN::can_message_info* subscriptions, int count) = 0;
+
     /**
      * Start timing functionality.
      * @param timing class to start
@@ -46,22 +60,103 @@ public:
      */
     virtual int readCANMessage(CANMessage& msg) = 0;
 
+    /**
+     * Read every waiting CANMessage, up to max, in one call.
+     *
+     * @param msgs array to read to
+     * @param max size of msgs
+     * @return number of messages read, 0 if none are waiting
+     */
+    virtual size_t readCANMessages(CANMessage* msgs, size_t max) = 0;
+
     /**
      * Write a CANMessage to the board.
      *
      * @param msg A CANMessage to write.
      * @return 0 on success, 1 on failure
      */
-    virtual int writeCANMessage(CANMessage msg) = 0;
+    virtual int writeCANMessage(const CANMessage& msg) = 0;
+
+    /**
+     * Write several CANMessages to the board in one call, stopping at the
+     * first one that does not fit in the transmit queue.
+     *
+     * @param msgs CANMessages to write
+     * @param count number of messages in msgs
+     * @return number of messages written, from the start of msgs
+     */
+    virtual size_t writeCANMessages(const CANMessage* msgs, size_t count) = 0;
+
+    /**
+     * Send the CAN buffer statistics collected when built with CAN_STATS
+     * (see can_stats.h). Each call sends a summary frame and the counts for
+     * the next ID in the table, so call it periodically. The frames are laid
+     * out as BRIZO_CAN::WheelCanStatsPayload and WheelCanStatsIdPayload
+     * (can_codec.h) whatever their IDs; counts saturate at 0xFFFF, except
+     * the per-ID counts, which wrap.
+     * @param summaryId ID for the summary frame, e.g. WHEEL_CAN_STATS
+     * @param countId ID for the per-ID frame, e.g. WHEEL_CAN_STATS_ID
+     * @return 0 on success, 1 on failure or if built without CAN_STATS
+     */
+    virtual int writeCANStats(int summaryId, int countId) = 0;
+
+    /**
+     * Send the callback and loop timing collected when built with
+     * TIMING_PROFILE (see timing_profile.h). Each call sends a summary frame
+     * and the timing of the next callback that has run, so call it
+     * periodically. The frames are laid out as
+     * BRIZO_CAN::WheelTimingProfilePayload and WheelTimingCallbackPayload
+     * (can_codec.h) whatever their IDs; times saturate at 0xFFFF us.
+     * @param timing common class being used for the loop
+     * @param summaryId ID for the summary frame, e.g. WHEEL_TIMING_PROFILE
+     * @param callbackId ID for the callback frame, e.g. WHEEL_TIMING_CALLBACK
+     * @return 0 on success, 1 on failure or if built without TIMING_PROFILE
+     */
+    virtual int writeTimingProfile(TimingCommon* timing, int summaryId, int callbackId) = 0;
+
+    /**
+     * Send a heartbeat with the uptime and, if load is given, the CPU load
+     * of the last window and of the busiest window since the previous
+     * heartbeat, laid out as BRIZO_CAN::WheelHeartPayload (can_codec.h).
+     * @param id ID of the board's heartbeat
+     * @param timing common class being used for the loop
+     * @param load CPU load meter updated by idle(), or NULL to send the
+     *        uptime only
+     * @return 0 on success, 1 on failure
+     */
+    virtual int writeHeartbeat(int id, TimingCommon* timing, CPULoad* load) = 0;
 
     /**
      * Check if the CAN controller is alive or not. If it isn't, reset the
-     * controller.
+     * controller. Bus-off is normally handled from the CAN interrupt as it
+     * happens; this is a fallback in case an interrupt was missed.
      * @return True if the CAN controller was alive; false if it was not and
      *         needed to be reset.
      */
     virtual bool checkCANController(void) = 0;
 
+    /**
+     * Set how long to wait before rejoining the bus after a bus-off.
+     * See CANRecovery for the meaning of each delay.
+     * @param initialUs delay after an isolated bus-off (us)
+     * @param repeatUs delay after the first repeated bus-off (us)
+     * @param maxUs longest delay (us)
+     * @param stableUs time on the bus before a bus-off counts as isolated (us)
+     */
+    virtual void setCANRecoveryBackoff(uint32_t initialUs, uint32_t repeatUs, uint32_t maxUs, uint32_t stableUs) = 0;
+
+    /**
+     * @return CAN error state, error counter peaks and time spent in each
+     *         error state
+     */
+    virtual const CANRecovery& canRecovery(void) const = 0;
+
+    /**
+     * Record every CAN message sent and received into a flight recorder.
+     * @param recorder recorder, already started, or NULL to stop recording
+     */
+    virtual void setCANRecorder(CANRecorder* recorder) = 0;
+
     /**
      * Set up LEDs (initialize them to all off).
      */
@@ -95,12 +190,26 @@ public:
     virtual int toggleHardwareLED(bool on) = 0;
 
     /*
-     * Handle timing related tasks for the main loop
+     * Handle timing related tasks for the main loop. When built with
+     * TIMING_PROFILE, the time between calls goes into the loop period
+     * histogram of timing->profile().
      * @param timing common class being used for this loop
      * @param bool pointer where overflow status will be put
      * @return int time running     *
      */
     virtual int loopTime(TimingCommon* timing, bool* outOverflow) = 0;
+
+    /**
+     * Idle hook for the end of the main loop. Sleeps until the next
+     * TimingCommon callback or executor task is due, or an interrupt
+     * arrives, and counts the time asleep as idle in load. Does not sleep
+     * if a CAN message is waiting or the executor has a task ready.
+     * @param timing common class being used for the loop
+     * @param load CPU load meter to count idle time in
+     * @param executor executor run from the loop, or NULL
+     * @return time slept (us)
+     */
+    virtual uint32_t idle(TimingCommon* timing, CPULoad* load, TaskExecutor* executor) = 0;
 };
 
 #endif /* API_HARDWARE_COMMON_H_ */
@@ -14,6 +14,7 @@
 
 #include <mbed.h>
 #include <can_buffer.h>
+#include <can_filter.h>
 #include <hardware_common.h>
 
 class hardware_common_mbed : public hardware_common {
@@ -30,11 +31,26 @@ public:
     /** Helper function to handle a CAN message interrupt. */
     void handleCANMessage();
 
+    /** Helper function to handle the CAN bus-off interrupt. */
+    void handleCANBusOff();
+
+    /** Helper function to handle the CAN error warning/passive interrupts. */
+    void handleCANErrorState();
+
     virtual void setupCAN(void);
+    virtual int setupCANFilters(const BRIZO_CAN::can_message_info* subscriptions, int count);
     virtual void startTimingCommon(TimingCommon* timing, bool* wdtReset);
     virtual int readCANMessage(CANMessage& msg);
-    virtual int writeCANMessage(CANMessage msg);
+    virtual size_t readCANMessages(CANMessage* msgs, size_t max);
+    virtual int writeCANMessage(const CANMessage& msg);
+    virtual size_t writeCANMessages(const CANMessage* msgs, size_t count);
+    virtual int writeCANStats(int summaryId, int countId);
+    virtual int writeTimingProfile(TimingCommon* timing, int summaryId, int callbackId);
+    virtual int writeHeartbeat(int id, TimingCommon* timing, CPULoad* load);
     virtual bool checkCANController(void);
+    virtual void setCANRecoveryBackoff(uint32_t initialUs, uint32_t repeatUs, uint32_t maxUs, uint32_t stableUs);
+    virtual const CANRecovery& canRecovery(void) const;
+    virtual void setCANRecorder(CANRecorder* recorder);
     virtual void setupLEDs(DigitalOut* heartbeatLED, DigitalOut* receiveCANLED, DigitalOut* sendCANLED, DigitalOut* hardwarestatusLED);
     virtual int toggleHeartbeatLED(void);
     virtual int toggleReceiveCANLED(void);
@@ -42,10 +58,28 @@ public:
     virtual int toggleHardwareLED(void);
     virtual int toggleHardwareLED(bool on);
     virtual int loopTime(TimingCommon* timing, bool* outOverflow);
+    virtual uint32_t idle(TimingCommon* timing, CPULoad* load, TaskExecutor* executor);
 
 private:
     // 32-message buffer.
     CANRXTXBuffer<32, 16>* p_canBuffer;
+    // Last per-ID statistics slot sent by writeCANStats
+    int statsSlot;
+    // Last callback slot sent by writeTimingProfile
+    int timingSlot;
+    // Error state and bus-off backoff
+    CANRecovery recovery;
+    // Restarts the controller once a bus-off backoff has passed
+    Timeout recoveryTimeout;
+
+    /** Take the controller out of bus-off. */
+    void restartCAN();
+
+    // Executor passed to the idle() in progress, for workPending()
+    TaskExecutor* p_idleExecutor;
+
+    /** Checked by idle() with interrupts disabled, just before sleeping. */
+    bool workPending();
 
     CAN* p_can;
     Timer* p_timer;
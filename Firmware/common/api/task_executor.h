@@ -0,0 +1,219 @@
+/*
+ * task_executor.h
+ * Cooperative run-to-completion executor for a board's main loop: prioritized
+ * periodic and event-driven tasks with run time budgets.
+ */
+
+#ifndef COMMON_API_TASK_EXECUTOR_H_
+#define COMMON_API_TASK_EXECUTOR_H_
+
+#include <stdint.h>
+#include <mbed.h>
+
+// Number of tasks one executor can run
+#ifndef TASK_EXECUTOR_MAX_TASKS
+#define TASK_EXECUTOR_MAX_TASKS 16
+#endif
+
+#if TASK_EXECUTOR_MAX_TASKS > 127
+#error "TASK_EXECUTOR_MAX_TASKS must fit in a signed byte"
+#endif
+
+/** Runs a board's work as short tasks, most urgent first
+ *
+ *  A task is a function that does one piece of work and returns. It becomes
+ *  ready when its period comes round (periodic tasks) or when something,
+ *  usually an interrupt handler, calls post() for it. run() then runs ready
+ *  tasks, highest priority (lowest number) first; among tasks of the same
+ *  priority the one with the earliest deadline goes first. A task ready
+ *  through its period has its next release as deadline, an event-driven
+ *  task the time it was seen ready plus its deadline.
+ *
+ *  Nothing is preempted: a task always runs to the end, so a higher
+ *  priority task waits at most for the longest task already running. Each
+ *  task has a budget (us) for how long one run should take; runs over it
+ *  are counted and reported to the overrun handler so the slow task can be
+ *  found and split up.
+ *
+ *  post() is lock-free. It only increments the task's post counter with
+ *  LDREX/STREX, so it is safe from any interrupt priority and from the
+ *  main loop, and never disables interrupts. Posts are coalesced: one run
+ *  handles every post made before it started, and a post made while the
+ *  task runs makes it ready again. Data belongs in the poster's own buffer
+ *  (e.g. CANRXTXBuffer); the task drains it.
+ *
+ *  Typical usage:
+ *    TaskExecutor executor(us_ticker_read);
+ *    int controlTask;
+ *
+ *    void adcDone() { executor.post(controlTask); }
+ *
+ *    void setup() {
+ *        controlTask = executor.addEvent(0, 500, 200, runControl);
+ *        executor.addPeriodic(1, 10000, 300, sendStatus);
+ *        executor.addPeriodic(3, 100000, 2000, updateDisplay);
+ *        executor.setOverrunHandler(reportOverrun);
+ *    }
+ *
+ *    void main() {
+ *        while (1) {
+ *            common.loopTime(&timing, NULL);
+ *            executor.run();
+ *        }
+ *    }
+ */
+class TaskExecutor {
+public:
+	/** One task and how well it keeps to its budget and deadlines */
+	struct Task {
+		mbed::FunctionPointer callback;
+		uint8_t priority;		// 0 runs first
+		bool ready;
+		uint32_t period;		// us between releases, 0 for event-driven
+		uint32_t deadline;		// us from ready to done, event-driven tasks
+		uint32_t budget;		// us one run should take
+		uint32_t release;		// next periodic release (us)
+		uint32_t due;			// deadline of the current activation (us)
+		uint32_t readyAt;		// when it became ready (us)
+		volatile uint32_t posted;	// post() calls, only ever incremented
+		uint32_t seen;			// posted as of the last check
+		uint32_t runs;
+		uint32_t overruns;		// runs longer than budget
+		uint32_t late;			// runs finished after their deadline
+		uint32_t dropped;		// periodic releases that never ran, because the
+								// previous one had not run yet or the task was
+								// more than a period behind
+		uint32_t maxRunUs;
+		uint64_t totalRunUs;
+		uint32_t maxWaitUs;		// longest time from ready to start
+	};
+
+	/**
+	 * @param clock current time (us), e.g. us_ticker_read
+	 */
+	TaskExecutor(uint32_t (*clock)(void));
+
+	/**
+	 * Add a task run every period, first one period from now. Its
+	 * deadline is its next release.
+	 * @param priority 0 is the most urgent
+	 * @param period time between runs (us), more than 0 and less than 2^31
+	 * @param budget time one run should take at most (us)
+	 * @param callback function to run
+	 * @return task number for post() and task(), -1 on failure (executor
+	 *         full or period 0)
+	 */
+	int addPeriodic(uint8_t priority, uint32_t period, uint32_t budget, void (*callback)(void));
+
+	/**
+	 * Add a member function run every period, as addPeriodic() above.
+	 */
+	template<typename T>
+	int addPeriodic(uint8_t priority, uint32_t period, uint32_t budget, T* object, void (T::*method)(void)) {
+		if (period == 0)
+			return -1;
+		return add(priority, period, period, budget, mbed::FunctionPointer(object, method));
+	}
+
+	/**
+	 * Add a task run after each post().
+	 * @param priority 0 is the most urgent
+	 * @param deadline time from being seen ready to finishing (us)
+	 * @param budget time one run should take at most (us)
+	 * @param callback function to run
+	 * @return task number for post() and task(), -1 if the executor is full
+	 */
+	int addEvent(uint8_t priority, uint32_t deadline, uint32_t budget, void (*callback)(void));
+
+	/**
+	 * Add a member function run after each post(), as addEvent() above.
+	 */
+	template<typename T>
+	int addEvent(uint8_t priority, uint32_t deadline, uint32_t budget, T* object, void (T::*method)(void)) {
+		return add(priority, 0, deadline, budget, mbed::FunctionPointer(object, method));
+	}
+
+	/**
+	 * Make a task ready. Lock-free, so safe from any interrupt handler.
+	 * Periodic tasks may be posted too, for one extra run.
+	 * @param task task number from addPeriodic() or addEvent()
+	 */
+	void post(int task) {
+		volatile uint32_t* counter = &tasks[task].posted;
+		uint32_t value;
+		do {
+			value = __LDREXW(counter) + 1;
+		} while (__STREXW(value, counter) != 0);
+	}
+
+	/**
+	 * Run ready tasks, most urgent first, until none is ready. Each task
+	 * runs at most once per call, so a task that is always ready cannot
+	 * keep the main loop from the rest of its work.
+	 * @return number of tasks run
+	 */
+	int run();
+
+	/**
+	 * @return true if a task is ready or has been posted
+	 */
+	bool ready() const;
+
+	/**
+	 * How long nothing needs to run for, e.g. for sleeping until then.
+	 * Posts are not included, see ready().
+	 * @return time (us) until the next periodic release, 0 if one is due,
+	 *         UINT32_MAX with no periodic task
+	 */
+	uint32_t untilRelease() const;
+
+	/**
+	 * Set a function called after every run over its budget.
+	 * @param handler called with the task number and the run time (us);
+	 *        NULL to remove
+	 */
+	void setOverrunHandler(void (*handler)(int task, uint32_t runUs));
+
+	/**
+	 * @return number of tasks added
+	 */
+	int size() const;
+
+	/**
+	 * @param i task number, less than size()
+	 * @return the task's settings and counters
+	 */
+	const Task& task(int i) const;
+
+	/**
+	 * @param i task number, less than size()
+	 * @return mean run time (us), 0 if it has not run
+	 */
+	uint32_t meanRunUs(int i) const;
+
+	/**
+	 * Reset the run, overrun, late and dropped counters of every task.
+	 */
+	void clearStats();
+
+private:
+	Task tasks[TASK_EXECUTOR_MAX_TASKS];
+	int numTasks;
+	uint32_t (*clock)(void);
+	void (*overrunHandler)(int task, uint32_t runUs);
+
+	int add(uint8_t priority, uint32_t period, uint32_t deadline, uint32_t budget,
+			const mbed::FunctionPointer& callback);
+
+	/**
+	 * Mark tasks ready whose release has come or that have been posted.
+	 */
+	void update(uint32_t now);
+
+	/**
+	 * @return true if task a should run before task b
+	 */
+	bool before(int a, int b) const;
+};
+
+#endif /* COMMON_API_TASK_EXECUTOR_H_ */
@@ -0,0 +1,184 @@
+/*
+ * timing_profile.h
+ * Optional run time and lateness counters for TimingCommon callbacks and the main loop.
+ */
+
+#ifndef COMMON_API_TIMING_PROFILE_H_
+#define COMMON_API_TIMING_PROFILE_H_
+
+#include <stdint.h>
+
+// Define TIMING_PROFILE to 1 in the project settings to time callbacks and
+// the main loop. When 0 the counters compile away entirely.
+#ifndef TIMING_PROFILE
+#define TIMING_PROFILE 0
+#endif
+
+// Buckets of the loop period histogram: bucket b counts periods of 2^b to
+// 2^(b+1) - 1 us, the last one everything longer
+#define TIMING_PROFILE_BUCKETS 16
+
+/** Run time and lateness of one TimingCommon callback */
+struct TimingCallbackProfile {
+	uint32_t runs;
+	uint32_t minUs;			// shortest run
+	uint32_t maxUs;			// longest run
+	uint64_t totalUs;		// sum over every run
+	uint32_t maxLateUs;		// most a run started after its deadline
+	uint64_t totalLateUs;	// sum over every run
+	uint32_t missed;		// whole periods skipped while late
+};
+
+#if TIMING_PROFILE
+
+/** Callback and main loop timing kept by TimingCommon
+ *
+ *  Callback counters are kept per TimingCommon entry and cleared whenever
+ *  the entry is reused for another callback. Each onTick() adds the time
+ *  since the previous one to the loop period histogram, so with
+ *  hardware_common::loopTime() at the top of the loop it covers the loop.
+ */
+class TimingProfile {
+public:
+	TimingProfile() {
+		clear();
+	}
+
+	/** Reset every counter */
+	void clear() {
+		for (int i = 0; i < SLOTS; i++) {
+			clearCallback(i);
+		}
+		for (int b = 0; b < TIMING_PROFILE_BUCKETS; b++) {
+			histogram[b] = 0;
+		}
+		loops = 0;
+		loopTotalUs = 0;
+		loopMaxUs = 0;
+	}
+
+	/** Entry i now holds a different callback */
+	void clearCallback(int i) {
+		TimingCallbackProfile& profile = callbacks[i];
+		profile.runs = 0;
+		profile.minUs = UINT32_MAX;
+		profile.maxUs = 0;
+		profile.totalUs = 0;
+		profile.maxLateUs = 0;
+		profile.totalLateUs = 0;
+		profile.missed = 0;
+	}
+
+	/**
+	 * @param i entry that ran
+	 * @param lateUs time from its deadline to the start of the run
+	 * @param period its period (us), 0 for one-shot
+	 * @param runUs how long it ran
+	 */
+	void callbackRun(int i, uint32_t lateUs, uint32_t period, uint32_t runUs) {
+		TimingCallbackProfile& profile = callbacks[i];
+		profile.runs++;
+		if (runUs < profile.minUs)
+			profile.minUs = runUs;
+		if (runUs > profile.maxUs)
+			profile.maxUs = runUs;
+		profile.totalUs += runUs;
+		if (lateUs > profile.maxLateUs)
+			profile.maxLateUs = lateUs;
+		profile.totalLateUs += lateUs;
+		if (period != 0)
+			profile.missed += lateUs / period;
+	}
+
+	/** @param us time since the previous onTick() */
+	void loopPeriod(uint32_t us) {
+		histogram[bucket(us)]++;
+		loops++;
+		loopTotalUs += us;
+		if (us > loopMaxUs)
+			loopMaxUs = us;
+	}
+
+	/** @returns number of per-entry slots */
+	int size() const { return SLOTS; }
+
+	/**
+	 * @param i entry, less than size()
+	 * @returns counters of the callback in the entry; runs is 0 if it has
+	 *          not run since it was added
+	 */
+	const TimingCallbackProfile& callback(int i) const { return callbacks[i]; }
+
+	/**
+	 * @param i entry, less than size()
+	 * @returns mean run time (us), 0 if it has not run
+	 */
+	uint32_t meanRunUs(int i) const {
+		return callbacks[i].runs == 0 ? 0 : (uint32_t)(callbacks[i].totalUs / callbacks[i].runs);
+	}
+
+	/**
+	 * @param b bucket, less than TIMING_PROFILE_BUCKETS
+	 * @returns loop periods counted in the bucket
+	 */
+	uint32_t loopHistogram(int b) const { return histogram[b]; }
+
+	/**
+	 * @param percent share of loop periods, 1 to 100
+	 * @returns smallest bucket holding at least that share of loop periods
+	 *          together with the ones below it; 0 if none were counted
+	 */
+	int loopPercentileBucket(int percent) const {
+		uint64_t wanted = ((uint64_t)loops * percent + 99) / 100;
+		uint64_t seen = 0;
+		for (int b = 0; b < TIMING_PROFILE_BUCKETS; b++) {
+			seen += histogram[b];
+			if (seen >= wanted && seen > 0)
+				return b;
+		}
+		return 0;
+	}
+
+	/** @returns loop periods counted */
+	uint32_t loopCount() const { return loops; }
+	/** @returns mean loop period (us), 0 if none counted */
+	uint32_t loopMeanUs() const { return loops == 0 ? 0 : (uint32_t)(loopTotalUs / loops); }
+	/** @returns longest loop period (us) */
+	uint32_t loopMax() const { return loopMaxUs; }
+
+	/**
+	 * @param us a time
+	 * @returns histogram bucket the time falls in
+	 */
+	static int bucket(uint32_t us) {
+		int b = us == 0 ? 0 : 31 - __builtin_clz(us);
+		return b < TIMING_PROFILE_BUCKETS ? b : TIMING_PROFILE_BUCKETS - 1;
+	}
+
+private:
+	// One per TimingCommon entry, the heartbeat's included
+	static const int SLOTS = TIMING_NUM_CALLBACKS + 1;
+
+	TimingCallbackProfile callbacks[SLOTS];
+	uint32_t histogram[TIMING_PROFILE_BUCKETS];
+	uint32_t loops;
+	uint64_t loopTotalUs;
+	uint32_t loopMaxUs;
+};
+
+#else
+
+/*
+ * Stand-in for TimingProfile when TIMING_PROFILE is 0; every call is a no-op.
+ */
+class TimingProfile {
+public:
+	void clear() {}
+	void clearCallback(int) {}
+	void callbackRun(int, uint32_t, uint32_t, uint32_t) {}
+	void loopPeriod(uint32_t) {}
+};
+
+#endif // TIMING_PROFILE
+
+#endif /* COMMON_API_TIMING_PROFILE_H_ */
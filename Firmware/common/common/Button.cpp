@@ -69,14 +69,11 @@ void Button::_setHoldTime(const uint32_t currentTime){
 		return;
 	}
 
-	uint16_t newHeldTime;
-	if(currentTime >= _startTime)
-		newHeldTime = (uint16_t)((currentTime - _startTime) / 1000);
-	else
-		newHeldTime = (uint16_t)((_startTime + (UINT32_MAX - currentTime)) / 1000);
+	// Unsigned difference, right across the 32-bit wrap
+	uint32_t newHeldTime = (currentTime - _startTime) / 1000;
 
 	// Don't wrap, stay at MAX
-	if(newHeldTime < _heldTime)
+	if(newHeldTime > UINT16_MAX)
 		_heldTime = UINT16_MAX;
 	//Don't return 0 when button is held down
 	else if(newHeldTime == 0)
@@ -12,85 +12,231 @@
 
 TimingCommon::TimingCommon() {
 	timer = NULL;
-	num_callbacks = 0;
-	for(int i = 0; i < TIMING_NUM_CALLBACKS; i++) {
-		callbacks[i] = NULL;
-		thresholds[i] = 0;
-		lastTick[i] = 0;
+	lastTickTime = 0;
+	lastTickTime64 = 0;
+	inTick = false;
+	heapSize = 0;
+	for(int i = 0; i < TIMING_NUM_CALLBACKS + 1; i++) {
+		entries[i].deadline = 0;
+		entries[i].period = 0;
+		entries[i].generation = 1;
+		entries[i].heapIndex = -1;
 	}
-	heartbeat_threshold = 0;
 	heartbeat_callback = NULL;
+	heartbeat_handle = 0;
+	clearClockCorrection();
 }
 
 TimingCommon::~TimingCommon() {
 }
 
-void TimingCommon::resetCallbackLastTicks(uint32_t now) {
-	for(int i = 0; i < num_callbacks; i++) {
-		lastTick[i] = now;
-	}
-	heartbeat_lastTick = now;
-}
-
 void TimingCommon::start(Timer* t) {
 	timer = t;
 	timer->start();
-	lastTickTime = timer->read_us();
-	resetCallbackLastTicks(lastTickTime);
+	uint64_t now64 = timer->read_high_resolution_us();
+	uint32_t now = (uint32_t)now64;
+
+	// Deadlines so far count from the last tick (0 before the first start),
+	// move them to count from now
+	uint32_t shift = now - lastTickTime;
+	for(int i = 0; i < heapSize; i++) {
+		entries[heap[i]].deadline += shift;
+	}
+	lastTickTime = now;
+	lastTickTime64 = now64;
 }
 
 uint32_t TimingCommon::onTick(bool* outOverflow) {
-	uint32_t now = timer->read_us();
-
-	// Check if the clock has wrapped
-	if (now < lastTickTime) {
-		if(outOverflow != NULL)
-			*outOverflow = true;
-		resetCallbackLastTicks(now);
-	} else {
-		if(outOverflow != NULL)
-			*outOverflow = false;
-
-		// Trigger heartbeat callback
-		if(heartbeat_callback && now - heartbeat_lastTick > heartbeat_threshold) {
-			heartbeat_lastTick = now;
-			heartbeat_callback(now);
-		}
+	uint64_t now64 = timer->read_high_resolution_us();
+	uint32_t now = (uint32_t)now64;
+
+	// Deadlines are compared as differences, so callbacks keep their
+	// period through the wrap
+	if(outOverflow != NULL)
+		*outOverflow = (now64 >> 32) != (lastTickTime64 >> 32);
+	timingProfile.loopPeriod(now - lastTickTime);
+	lastTickTime = now;
+	lastTickTime64 = now64;
+
+	inTick = true;
+	while(heapSize > 0) {
+		int i = heap[0];
+		Entry& entry = entries[i];
+		if((int32_t)(now - entry.deadline) < 0)
+			break;
 
-		// Trigger callbacks, if any
-		for(int i = 0; i < num_callbacks; i++) {
-			// If threshold has passed for callback
-			if(now - lastTick[i] > thresholds[i]) {
-				lastTick[i] = now;
-				(callbacks[i])();
-			}
+		// Reschedule or free before the call, which may add or cancel
+		// callbacks itself
+		mbed::FunctionPointer callback = entry.callback;
+		uint32_t late = now - entry.deadline;
+		uint32_t period = entry.period;
+		if(entry.period != 0) {
+			entry.deadline = now + entry.period;
+			siftDown(0);
+		} else {
+			release(i);
 		}
+#if TIMING_PROFILE
+		uint32_t began = (uint32_t)timer->read_high_resolution_us();
+		callback.call();
+		timingProfile.callbackRun(i, late, period, (uint32_t)timer->read_high_resolution_us() - began);
+#else
+		(void)late;
+		(void)period;
+		callback.call();
+#endif
 	}
-
-	lastTickTime = now;
+	inTick = false;
 
 	return now;
 }
 
-int TimingCommon::addCallback(uint32_t threshold, void (*callback)(void)) {
-	if(num_callbacks >= TIMING_NUM_CALLBACKS) // no more callbacks available
+uint64_t TimingCommon::tickTime64() const {
+	return lastTickTime64;
+}
+
+uint64_t TimingCommon::read64() const {
+	return timer->read_high_resolution_us();
+}
+
+int TimingCommon::addCallback(uint32_t threshold, void (*callback)(void), TimingHandle* outHandle) {
+	return schedule(threshold + 1, threshold + 1, mbed::FunctionPointer(callback), outHandle);
+}
+
+int TimingCommon::addTimeout(uint32_t delay, void (*callback)(void), TimingHandle* outHandle) {
+	return schedule(delay, 0, mbed::FunctionPointer(callback), outHandle);
+}
+
+int TimingCommon::cancelCallback(TimingHandle handle) {
+	uint32_t i = handle & 0xFF;
+	if(handle == 0 || i >= TIMING_NUM_CALLBACKS + 1)
+		return -1;
+	if(entries[i].heapIndex < 0 || entries[i].generation != (handle >> 8))
 		return -1;
 
-	// Add new callback
-	thresholds[num_callbacks] = threshold;
-	callbacks[num_callbacks] = callback;
-	num_callbacks++;
+	release(i);
+	if(handle == heartbeat_handle)
+		heartbeat_handle = 0;
 	return 0;
 }
 
+uint32_t TimingCommon::nextDeadline() const {
+	if(heapSize == 0)
+		return lastTickTime + INT32_MAX;
+	return entries[heap[0]].deadline;
+}
+
+int TimingCommon::pending() const {
+	return heapSize;
+}
+
+const TimingProfile& TimingCommon::profile() const {
+	return timingProfile;
+}
+
+void TimingCommon::clearProfile() {
+	timingProfile.clear();
+}
+
 void TimingCommon::setHeartbeatCallback(uint32_t threshold, void (*callback)(int)) {
-	heartbeat_threshold = threshold;
+	cancelCallback(heartbeat_handle);
+	heartbeat_handle = 0;
 	heartbeat_callback = callback;
+	if(callback != NULL)
+		schedule(threshold + 1, threshold + 1, mbed::FunctionPointer(this, &TimingCommon::heartbeat), &heartbeat_handle);
+}
+
+void TimingCommon::heartbeat() {
+	heartbeat_callback(lastTickTime);
+}
+
+int TimingCommon::schedule(uint32_t delay, uint32_t period, const mbed::FunctionPointer& callback, TimingHandle* outHandle) {
+	// The spare entry is only for the heartbeat
+	int limit = TIMING_NUM_CALLBACKS;
+	if(outHandle == &heartbeat_handle || heartbeat_handle != 0)
+		limit++;
+	if(heapSize >= limit)
+		return -1;
+
+	int i = 0;
+	while(entries[i].heapIndex >= 0)
+		i++;
+
+	// Not in this onTick() pass, or a callback re-adding itself would loop
+	if(inTick && delay == 0)
+		delay = 1;
+
+	Entry& entry = entries[i];
+	timingProfile.clearCallback(i);
+	entry.deadline = lastTickTime + delay;
+	entry.period = period;
+	entry.callback = callback;
+	entry.heapIndex = heapSize;
+	heap[heapSize] = i;
+	heapSize++;
+	siftUp(entry.heapIndex);
+
+	if(outHandle != NULL)
+		*outHandle = ((TimingHandle)entry.generation << 8) | i;
+	return 0;
+}
+
+void TimingCommon::release(int entry) {
+	int position = entries[entry].heapIndex;
+	heapSize--;
+	if(position != heapSize) {
+		swap(position, heapSize);
+		siftDown(position);
+		siftUp(position);
+	}
+	entries[entry].heapIndex = -1;
+	entries[entry].generation++;
+	if(entries[entry].generation == 0)
+		entries[entry].generation = 1;
+}
+
+bool TimingCommon::before(int a, int b) const {
+	int32_t diff = (int32_t)(entries[heap[a]].deadline - entries[heap[b]].deadline);
+	// Same deadline: in the order the entries were taken, as the old array was run
+	return diff < 0 || (diff == 0 && heap[a] < heap[b]);
+}
+
+void TimingCommon::swap(int a, int b) {
+	uint8_t t = heap[a];
+	heap[a] = heap[b];
+	heap[b] = t;
+	entries[heap[a]].heapIndex = a;
+	entries[heap[b]].heapIndex = b;
+}
+
+void TimingCommon::siftDown(int i) {
+	while(true) {
+		int smallest = i;
+		int left = 2 * i + 1;
+		int right = left + 1;
+		if(left < heapSize && before(left, smallest))
+			smallest = left;
+		if(right < heapSize && before(right, smallest))
+			smallest = right;
+		if(smallest == i)
+			return;
+		swap(i, smallest);
+		i = smallest;
+	}
+}
+
+void TimingCommon::siftUp(int i) {
+	while(i > 0) {
+		int parent = (i - 1) / 2;
+		if(!before(i, parent))
+			return;
+		swap(i, parent);
+		i = parent;
+	}
 }
 
 uint32_t TimingCommon::difference(const uint32_t start, const uint32_t end){
-	if (start < end) return (end - start);
-	else return (UINT32_MAX - start) + end + 1;
+	return end - start;
 }
 
 int TimingCommon::threshold(const uint32_t last, const uint32_t now, const uint32_t interval){
@@ -106,3 +252,34 @@ int TimingCommon::tickThreshold(uint32_t &last, const uint32_t interval){
 	}
 	return 0;
 }
+
+void TimingCommon::setClockCorrection(uint32_t localRef, uint32_t globalRef, int32_t rate){
+	syncLocalRef = localRef;
+	syncGlobalRef = globalRef;
+	syncRate = rate;
+	synced = true;
+}
+
+void TimingCommon::clearClockCorrection(){
+	synced = false;
+	syncLocalRef = 0;
+	syncGlobalRef = 0;
+	syncRate = 0;
+}
+
+bool TimingCommon::clockSynced() const{
+	return synced;
+}
+
+uint32_t TimingCommon::globalTime(uint32_t local) const{
+	if(!synced)
+		return local;
+	// Signed, so times just before the reference convert too
+	int32_t elapsed = (int32_t)(local - syncLocalRef);
+	int32_t drift = (int32_t)(((int64_t)elapsed * syncRate) >> 32);
+	return syncGlobalRef + elapsed + drift;
+}
+
+uint32_t TimingCommon::globalTick() const{
+	return globalTime(lastTickTime);
+}
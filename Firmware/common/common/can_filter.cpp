@@ -0,0 +1,143 @@
+/*
+ * can_filter.cpp
+ *
+ * Acceptance filter planning for the standard 11-bit ID space.
+ */
+
+#include "can_filter.h"
+
+#define CAN_STD_ID_MASK 0x7FF
+#define CAN_STD_ID_COUNT 0x800
+
+// Number of IDs a filter with this mask accepts
+static uint32_t acceptedCount(uint32_t mask) {
+	uint32_t dontCare = ~mask & CAN_STD_ID_MASK;
+	return 1UL << __builtin_popcount(dontCare);
+}
+
+// Check if filter a accepts every ID filter b does
+static bool covers(const CANFilterPlan::Filter& a, const CANFilterPlan::Filter& b) {
+	return (b.mask & a.mask) == a.mask && (b.id & a.mask) == a.id;
+}
+
+CANFilterPlan::CANFilterPlan() {
+	numFilters = 0;
+	numFalsePositives = 0;
+}
+
+int CANFilterPlan::plan(const BRIZO_CAN::can_message_info* subscriptions, int count,
+		int maxFilters, int maxFalsePositives) {
+	if (maxFilters > CAN_RX_FILTER_COUNT)
+		maxFilters = CAN_RX_FILTER_COUNT;
+	if (maxFilters < 1)
+		maxFilters = 1;
+
+	numFilters = 0;
+	for (int i = 0; i < count; i++) {
+		uint32_t id = subscriptions[i].ID & CAN_STD_ID_MASK;
+		if (accepts(id))
+			continue;
+
+		filters[numFilters].id = id;
+		filters[numFilters].mask = CAN_STD_ID_MASK;
+		numFilters++;
+
+		// Only one spare slot, so merge as soon as it is used
+		if (numFilters > maxFilters)
+			mergeClosestPair();
+	}
+
+	// Every subscribed ID is accepted, so the rest are false positives
+	int accepted = 0;
+	for (uint32_t id = 0; id < CAN_STD_ID_COUNT; id++) {
+		if (accepts(id))
+			accepted++;
+	}
+	int subscribed = 0;
+	for (int i = 0; i < count; i++) {
+		bool duplicate = false;
+		for (int j = 0; j < i; j++) {
+			if ((subscriptions[j].ID & CAN_STD_ID_MASK) == (subscriptions[i].ID & CAN_STD_ID_MASK))
+				duplicate = true;
+		}
+		if (!duplicate)
+			subscribed++;
+	}
+	numFalsePositives = accepted - subscribed;
+
+	return numFalsePositives > maxFalsePositives ? -1 : 0;
+}
+
+void CANFilterPlan::mergeClosestPair() {
+	int bestA = 0, bestB = 1;
+	uint32_t bestCount = UINT32_MAX;
+
+	for (int a = 0; a < numFilters; a++) {
+		for (int b = a + 1; b < numFilters; b++) {
+			uint32_t mask = filters[a].mask & filters[b].mask & ~(filters[a].id ^ filters[b].id);
+			uint32_t merged = acceptedCount(mask);
+			if (merged < bestCount) {
+				bestCount = merged;
+				bestA = a;
+				bestB = b;
+			}
+		}
+	}
+
+	Filter& keep = filters[bestA];
+	keep.mask = keep.mask & filters[bestB].mask & ~(keep.id ^ filters[bestB].id);
+	keep.id &= keep.mask;
+
+	removeCoveredBy(bestA);
+}
+
+void CANFilterPlan::removeCoveredBy(int i) {
+	Filter keep = filters[i];
+	int n = 0;
+	for (int j = 0; j < numFilters; j++) {
+		if (j == i || !covers(keep, filters[j]))
+			filters[n++] = filters[j];
+	}
+	numFilters = n;
+}
+
+int CANFilterPlan::install(CAN& can) const {
+	for (int i = 0; i < numFilters; i++) {
+		can.filter(filters[i].id, filters[i].mask, CANStandard, i + 1);
+	}
+	if (numFilters > 0) {
+		for (int handle = numFilters + 1; handle <= CAN_RX_MSG_OBJ_COUNT; handle++) {
+			can.removeFilter(handle);
+		}
+	}
+	return numFilters;
+}
+
+int CANFilterPlan::size() const {
+	return numFilters;
+}
+
+const CANFilterPlan::Filter& CANFilterPlan::filter(int i) const {
+	return filters[i];
+}
+
+bool CANFilterPlan::accepts(uint32_t id) const {
+	for (int i = 0; i < numFilters; i++) {
+		if ((id & filters[i].mask) == filters[i].id)
+			return true;
+	}
+	return false;
+}
+
+int CANFilterPlan::falsePositives() const {
+	return numFalsePositives;
+}
+
+uint32_t CANFilterPlan::rejectedPerSecond(const BRIZO_CAN::can_message_info* busTraffic, int count) const {
+	uint32_t rejected = 0;
+	for (int i = 0; i < count; i++) {
+		if (busTraffic[i].RATE != 0 && !accepts(busTraffic[i].ID & CAN_STD_ID_MASK))
+			rejected += 1000000 / busTraffic[i].RATE;
+	}
+	return rejected;
+}
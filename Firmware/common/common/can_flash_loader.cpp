@@ -0,0 +1,180 @@
+/*
+ * can_flash_loader.cpp
+ *
+ * Receives a firmware image over CAN and programs it into flash through IAP.
+ */
+
+#include "can_flash_loader.h"
+
+#include <string.h>
+
+static uint32_t readU32(const uint8_t* data) {
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+CANFlashLoader::CANFlashLoader(uint32_t firstAddress, uint32_t endAddress) :
+		areaStart(firstAddress), areaEnd(endAddress), current(IDLE), address(firstAddress), length(0),
+		expectedCrc(0), offset(0), boot(false), stagedAt(0), stagedBytes(0), writtenBytes(0) {
+	memset(replyData, 0, sizeof(replyData));
+}
+
+int CANFlashLoader::request(const uint8_t* data, uint16_t len) {
+	if (len < 1) {
+		return answer(0, BAD_REQUEST, 0);
+	}
+	// Everything but START needs the staged segment written first
+	if (data[0] != START && writing()) {
+		return -1;
+	}
+
+	switch (data[0]) {
+	case START:
+		return start(data, len);
+	case DATA:
+		return segment(data, len);
+	case VERIFY:
+		return verify();
+	case BOOT:
+		if (current != VERIFIED) {
+			return answer(BOOT, NOT_READY, 0);
+		}
+		boot = true;
+		return answer(BOOT, OK, address);
+	default:
+		return answer(data[0], BAD_REQUEST, 0);
+	}
+}
+
+const uint8_t* CANFlashLoader::reply() const {
+	return replyData;
+}
+
+bool CANFlashLoader::poll() {
+	if (!writing()) {
+		return false;
+	}
+
+	uint32_t page = stagedAt + writtenBytes;
+	const uint32_t* source = staging + writtenBytes / 4;
+	if (IAP::copyRamToFlash(page, source, IAP::FLASH_PAGE_SIZE) != IAP::CMD_SUCCESS
+			|| IAP::compare(page, source, IAP::FLASH_PAGE_SIZE) != IAP::CMD_SUCCESS) {
+		current = FAILED;
+		stagedBytes = 0;
+		return true;
+	}
+	writtenBytes += IAP::FLASH_PAGE_SIZE;
+	if (writtenBytes >= stagedBytes) {
+		stagedBytes = 0;
+	}
+	return true;
+}
+
+bool CANFlashLoader::writing() const {
+	return stagedBytes != 0;
+}
+
+CANFlashLoader::State CANFlashLoader::state() const {
+	return current;
+}
+
+uint32_t CANFlashLoader::received() const {
+	return offset;
+}
+
+uint32_t CANFlashLoader::imageAddress() const {
+	return address;
+}
+
+bool CANFlashLoader::bootRequested() const {
+	return boot;
+}
+
+int CANFlashLoader::start(const uint8_t* data, uint16_t len) {
+	if (len != 13) {
+		return answer(START, BAD_REQUEST, 0);
+	}
+	uint32_t first = readU32(data + 1);
+	uint32_t bytes = readU32(data + 5);
+	if (first % IAP::FLASH_SECTOR_SIZE != 0 || first < areaStart || first >= areaEnd
+			|| bytes == 0 || bytes > areaEnd - first) {
+		return answer(START, OUT_OF_RANGE, 0);
+	}
+
+	// Drop whatever was left of an earlier image
+	stagedBytes = 0;
+	boot = false;
+	address = first;
+	length = bytes;
+	expectedCrc = readU32(data + 9);
+	offset = 0;
+	crc.reset();
+
+	// Erase everything up front: it keeps interrupts off for about 100 ms
+	// per call, which is only harmless while the tool waits for this reply
+	if (IAP::eraseSectors(IAP::sector(first), IAP::sector(first + bytes - 1)) != IAP::CMD_SUCCESS) {
+		current = FAILED;
+		return answer(START, FLASH_ERROR, 0);
+	}
+	current = RECEIVING;
+	return answer(START, OK, CAN_FLASH_SEGMENT_SIZE);
+}
+
+int CANFlashLoader::segment(const uint8_t* data, uint16_t len) {
+	if (current != RECEIVING) {
+		return answer(DATA, NOT_READY, offset);
+	}
+	if (len < 6) {
+		return answer(DATA, BAD_REQUEST, offset);
+	}
+	uint32_t at = readU32(data + 1);
+	uint16_t bytes = len - 5;
+	if (at != offset) {
+		return answer(DATA, OUT_OF_ORDER, offset);
+	}
+	// Only the last segment may be short, so pages never straddle segments
+	uint32_t left = length - offset;
+	if (bytes > CAN_FLASH_SEGMENT_SIZE || bytes > left || (bytes < CAN_FLASH_SEGMENT_SIZE && bytes != left)) {
+		return answer(DATA, BAD_REQUEST, offset);
+	}
+
+	uint8_t* stage = (uint8_t*)staging;
+	memcpy(stage, data + 5, bytes);
+	crc.update(stage, bytes);
+
+	uint16_t padded = (bytes + IAP::FLASH_PAGE_SIZE - 1) / IAP::FLASH_PAGE_SIZE * IAP::FLASH_PAGE_SIZE;
+	memset(stage + bytes, 0xFF, padded - bytes);
+	stagedAt = address + offset;
+	stagedBytes = padded;
+	writtenBytes = 0;
+
+	offset += bytes;
+	return answer(DATA, OK, offset);
+}
+
+int CANFlashLoader::verify() {
+	if (current == VERIFIED) {
+		return answer(VERIFY, OK, expectedCrc);
+	}
+	if (current != RECEIVING || offset != length) {
+		return answer(VERIFY, current == FAILED ? FLASH_ERROR : NOT_READY, offset);
+	}
+
+	uint32_t computed = crc.read();
+	if (computed != expectedCrc) {
+		current = FAILED;
+		return answer(VERIFY, CRC_MISMATCH, computed);
+	}
+	current = VERIFIED;
+	return answer(VERIFY, OK, computed);
+}
+
+int CANFlashLoader::answer(uint8_t command, Result result, uint32_t value) {
+	replyData[0] = command | 0x80;
+	replyData[1] = result;
+	replyData[2] = value & 0xFF;
+	replyData[3] = (value >> 8) & 0xFF;
+	replyData[4] = (value >> 16) & 0xFF;
+	replyData[5] = (value >> 24) & 0xFF;
+	return CAN_FLASH_REPLY_SIZE;
+}
+
@@ -0,0 +1,84 @@
+/*
+ * can_recorder.cpp
+ *
+ * CAN flight recorder: the last frames sent and received, kept across a
+ * watchdog reset.
+ */
+
+#include "can_recorder.h"
+
+CANRecorder::CANRecorder(uint32_t* storage, uint32_t slots, uint32_t (*clock)(void)) :
+		storage(storage), mask(slots - 1), clock(clock), stopped(true) {
+	// Nothing touches the storage here: it may hold the recording from
+	// before a reset
+}
+
+bool CANRecorder::start() {
+	uint32_t now = clock();
+	bool kept = storage[MAGIC] == (CAN_RECORDER_MAGIC ^ (mask + 1));
+	if (!kept) {
+		clear();
+	}
+	// A BOOT marker splits the two runs, whose clocks are unrelated
+	put(CAN_RECORDER_BOOT << CAN_RECORDER_LEN_SHIFT, now, storage[LAST_TIME]);
+	storage[LAST_TIME] = now;
+	storage[BOOTS]++;
+	stopped = false;
+	return kept;
+}
+
+void CANRecorder::clear() {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	storage[HEAD] = 0;
+	storage[LAST_TIME] = clock();
+	storage[BOOTS] = 0;
+	storage[MAGIC] = CAN_RECORDER_MAGIC ^ (mask + 1);
+	__set_PRIMASK(primask);
+}
+
+void CANRecorder::pause() {
+	stopped = true;
+}
+
+void CANRecorder::resume() {
+	stopped = false;
+}
+
+bool CANRecorder::paused() const {
+	return stopped;
+}
+
+uint32_t CANRecorder::boots() const {
+	return storage[BOOTS];
+}
+
+uint32_t CANRecorder::used() const {
+	return storage[HEAD] > mask ? mask + 1 : storage[HEAD];
+}
+
+uint32_t CANRecorder::dumpSize() const {
+	return (CAN_RECORDER_HEADER_WORDS + used() * CAN_RECORDER_SLOT_WORDS) * 4;
+}
+
+int CANRecorder::dump(uint32_t offset, uint8_t* out, int len) const {
+	// Dump header: magic, slots in the dump, boots, reserved
+	uint32_t header[CAN_RECORDER_HEADER_WORDS] = { CAN_RECORDER_MAGIC, used(), storage[BOOTS], 0 };
+	uint32_t oldest = storage[HEAD] - used();
+
+	int copied = 0;
+	while (copied < len && offset < dumpSize()) {
+		uint32_t word = offset / 4;
+		uint32_t value;
+		if (word < CAN_RECORDER_HEADER_WORDS) {
+			value = header[word];
+		} else {
+			word -= CAN_RECORDER_HEADER_WORDS;
+			value = slotAt(oldest + word / CAN_RECORDER_SLOT_WORDS)[word % CAN_RECORDER_SLOT_WORDS];
+		}
+		// Little endian regardless of where this runs
+		out[copied++] = (value >> (8 * (offset % 4))) & 0xFF;
+		offset++;
+	}
+	return copied;
+}
@@ -0,0 +1,133 @@
+/*
+ * can_recovery.cpp
+ *
+ * CAN error state tracking and bus-off recovery with backoff.
+ */
+
+#include "can_recovery.h"
+
+CANRecovery::CANRecovery(uint32_t initialUs, uint32_t repeatUs, uint32_t maxUs, uint32_t stableUs) {
+	setBackoff(initialUs, repeatUs, maxUs, stableUs);
+	start(0);
+}
+
+void CANRecovery::setBackoff(uint32_t initialUs, uint32_t repeatUs, uint32_t maxUs, uint32_t stableUs) {
+	initialBackoff = initialUs;
+	repeatBackoff = repeatUs;
+	maxBackoff = maxUs;
+	stableTime = stableUs;
+}
+
+void CANRecovery::start(uint32_t now) {
+	current = ERROR_ACTIVE;
+	enteredAt = now;
+	for (int i = 0; i < NUM_STATES; i++)
+		timeInState[i] = 0;
+
+	busOffAt = now;
+	busOnAt = now;
+	backoff = 0;
+	pending = false;
+	everBusOn = false;
+
+	busOffs = 0;
+	lastRecovery = 0;
+	maxRecovery = 0;
+	maxTec = 0;
+	maxRec = 0;
+}
+
+void CANRecovery::enter(State next, uint32_t now) {
+	timeInState[current] += now - enteredAt;
+	enteredAt = now;
+	current = next;
+}
+
+uint32_t CANRecovery::busOff(uint32_t now) {
+	// Back off only while bus-offs keep coming soon after recovering
+	bool repeated = everBusOn && now - busOnAt < stableTime;
+	if (!repeated) {
+		backoff = initialBackoff;
+	} else if (backoff < repeatBackoff) {
+		backoff = repeatBackoff;
+	} else {
+		backoff = backoff > maxBackoff / 2 ? maxBackoff : backoff * 2;
+	}
+	if (backoff > maxBackoff)
+		backoff = maxBackoff;
+
+	if (current != BUS_OFF) {
+		enter(BUS_OFF, now);
+		busOffs++;
+		busOffAt = now;
+	}
+	maxTec = 255;
+	pending = true;
+	return backoff;
+}
+
+void CANRecovery::recoveryStarted(uint32_t now) {
+	(void)now;
+	pending = false;
+}
+
+bool CANRecovery::recoveryPending() const {
+	return pending;
+}
+
+void CANRecovery::update(uint8_t tec, uint8_t rec, uint32_t now, bool transferred) {
+	if (tec > maxTec)
+		maxTec = tec;
+	if (rec > maxRec)
+		maxRec = rec;
+
+	if (current == BUS_OFF) {
+		// The counters are meaningless until the controller is back on the bus
+		if (!transferred || pending)
+			return;
+		lastRecovery = now - busOffAt;
+		if (lastRecovery > maxRecovery)
+			maxRecovery = lastRecovery;
+		busOnAt = now;
+		everBusOn = true;
+	}
+
+	State next = ERROR_ACTIVE;
+	if (tec >= CAN_ERROR_PASSIVE_LIMIT || rec >= CAN_ERROR_PASSIVE_LIMIT)
+		next = ERROR_PASSIVE;
+	else if (tec >= CAN_ERROR_WARNING_LIMIT || rec >= CAN_ERROR_WARNING_LIMIT)
+		next = ERROR_WARNING;
+	if (next != current)
+		enter(next, now);
+}
+
+CANRecovery::State CANRecovery::state() const {
+	return current;
+}
+
+uint32_t CANRecovery::timeIn(State s, uint32_t now) const {
+	uint32_t total = timeInState[s];
+	if (s == current)
+		total += now - enteredAt;
+	return total;
+}
+
+uint32_t CANRecovery::busOffCount() const {
+	return busOffs;
+}
+
+uint32_t CANRecovery::lastRecoveryUs() const {
+	return lastRecovery;
+}
+
+uint32_t CANRecovery::maxRecoveryUs() const {
+	return maxRecovery;
+}
+
+uint8_t CANRecovery::peakTec() const {
+	return maxTec;
+}
+
+uint8_t CANRecovery::peakRec() const {
+	return maxRec;
+}
@@ -0,0 +1,246 @@
+/*
+ * can_scheduler.cpp
+ *
+ * Phase offset planning and deadline-ordered sending of periodic CAN messages.
+ */
+
+#include "can_scheduler.h"
+
+#include <stddef.h>
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+	while (b != 0) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+CANScheduler::CANScheduler() {
+	numFrames = 0;
+	started = false;
+	hyper = 0;
+	peakLoad = 0;
+}
+
+int CANScheduler::add(const BRIZO_CAN::can_message_info& info, void (*send)(void)) {
+	if (info.RATE == 0 || send == NULL || started || numFrames >= CAN_SCHEDULER_MAX_FRAMES)
+		return -1;
+
+	Frame& frame = frames[numFrames];
+	frame.id = info.ID;
+	frame.period = info.RATE;
+	frame.offset = 0;
+	frame.deadline = 0;
+	frame.send = send;
+	numFrames++;
+	return 0;
+}
+
+void CANScheduler::start(uint32_t now) {
+	assignOffsets();
+	clearJitter();
+
+	for (int i = 0; i < numFrames; i++) {
+		frames[i].deadline = now + frames[i].offset;
+		heap[i] = i;
+		siftUp(i);
+	}
+	started = true;
+}
+
+void CANScheduler::assignOffsets() {
+	if (numFrames == 0)
+		return;
+
+	// Slots are the GCD of the periods, so every period is a whole number
+	// of slots, unless the hyperperiod is too long and gets folded
+	uint64_t step = frames[0].period;
+	uint64_t lcm = frames[0].period;
+	for (int i = 1; i < numFrames; i++) {
+		step = gcd(step, frames[i].period);
+		if (lcm <= UINT32_MAX)
+			lcm = lcm / gcd(lcm, frames[i].period) * frames[i].period;
+	}
+	hyper = lcm > UINT32_MAX ? UINT32_MAX : (uint32_t)lcm;
+
+	uint32_t slotLength = step;
+	int numSlots = CAN_SCHEDULER_SLOTS;
+	if (hyper / step <= CAN_SCHEDULER_SLOTS) {
+		numSlots = hyper / step;
+	} else {
+		slotLength = (hyper + CAN_SCHEDULER_SLOTS - 1) / CAN_SCHEDULER_SLOTS;
+	}
+
+	uint8_t load[CAN_SCHEDULER_SLOTS];
+	for (int s = 0; s < numSlots; s++)
+		load[s] = 0;
+
+	// Shortest period first; they are the least flexible
+	uint8_t order[CAN_SCHEDULER_MAX_FRAMES];
+	for (int i = 0; i < numFrames; i++) {
+		int j = i;
+		while (j > 0 && frames[order[j - 1]].period > frames[i].period) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	peakLoad = 0;
+	for (int n = 0; n < numFrames; n++) {
+		Frame& frame = frames[order[n]];
+
+		// Sends per hyperperiod, capped when folded since slots repeat anyway
+		uint32_t repeats = hyper / frame.period;
+		if (repeats > 4 * CAN_SCHEDULER_SLOTS)
+			repeats = 4 * CAN_SCHEDULER_SLOTS;
+		uint32_t candidates = frame.period / slotLength;
+		if (candidates < 1)
+			candidates = 1;
+		if (candidates > (uint32_t)numSlots)
+			candidates = numSlots;
+
+		// Lowest peak load wins; ties go to the lowest total load, then to
+		// the first candidate from a slot picked by the ID. Other boards
+		// plan their own slots, so without that every board's first,
+		// shortest-period message would go out at its start(). The hash's
+		// high bits pick it, as its low bits just follow the ID's.
+		uint32_t first = (uint32_t)(((uint64_t)(uint32_t)(frame.id * 2654435761UL) * candidates) >> 32);
+		uint32_t bestOffset = 0;
+		int bestPeak = 256;
+		uint32_t bestTotal = UINT32_MAX;
+		for (uint32_t k = 0; k < candidates; k++) {
+			uint32_t offset = (first + k) % candidates * slotLength;
+			int peak = 0;
+			uint32_t total = 0;
+			for (uint32_t r = 0; r < repeats; r++) {
+				int slot = (uint32_t)(((uint64_t)offset + (uint64_t)r * frame.period) / slotLength) % numSlots;
+				if (load[slot] > peak)
+					peak = load[slot];
+				total += load[slot];
+			}
+			if (peak < bestPeak || (peak == bestPeak && total < bestTotal)) {
+				bestOffset = offset;
+				bestPeak = peak;
+				bestTotal = total;
+			}
+		}
+
+		frame.offset = bestOffset;
+		for (uint32_t r = 0; r < repeats; r++) {
+			int slot = (uint32_t)(((uint64_t)bestOffset + (uint64_t)r * frame.period) / slotLength) % numSlots;
+			if (load[slot] < 255)
+				load[slot]++;
+			if (load[slot] > peakLoad)
+				peakLoad = load[slot];
+		}
+	}
+}
+
+int CANScheduler::onTick(uint32_t now) {
+	int sent = 0;
+	while (started && numFrames > 0) {
+		Frame& frame = frames[heap[0]];
+		uint32_t late = now - frame.deadline;
+		if ((int32_t)late < 0)
+			break;
+
+		// Skip whole periods rather than sending a burst to catch up
+		if (late >= frame.period) {
+			uint32_t skipped = late / frame.period;
+			frame.missed += skipped;
+			frame.deadline += skipped * frame.period;
+			late -= skipped * frame.period;
+		}
+
+		frame.sent++;
+		frame.lastJitter = late;
+		frame.totalJitter += late;
+		if (late > frame.maxJitter)
+			frame.maxJitter = late;
+
+		frame.deadline += frame.period;
+		siftDown(0);
+
+		frame.send();
+		sent++;
+	}
+	return sent;
+}
+
+uint32_t CANScheduler::nextDeadline() const {
+	return frames[heap[0]].deadline;
+}
+
+int CANScheduler::size() const {
+	return numFrames;
+}
+
+const CANScheduler::Frame& CANScheduler::frame(int i) const {
+	return frames[i];
+}
+
+uint32_t CANScheduler::meanJitter(int i) const {
+	const Frame& frame = frames[i];
+	return frame.sent == 0 ? 0 : (uint32_t)(frame.totalJitter / frame.sent);
+}
+
+void CANScheduler::clearJitter() {
+	for (int i = 0; i < numFrames; i++) {
+		frames[i].sent = 0;
+		frames[i].missed = 0;
+		frames[i].lastJitter = 0;
+		frames[i].maxJitter = 0;
+		frames[i].totalJitter = 0;
+	}
+}
+
+uint32_t CANScheduler::hyperperiod() const {
+	return hyper;
+}
+
+int CANScheduler::peakSlotLoad() const {
+	return peakLoad;
+}
+
+bool CANScheduler::before(int a, int b) const {
+	const Frame& fa = frames[heap[a]];
+	const Frame& fb = frames[heap[b]];
+	int32_t diff = (int32_t)(fa.deadline - fb.deadline);
+	// Same deadline: lower ID first, as it would win arbitration anyway
+	return diff < 0 || (diff == 0 && fa.id < fb.id);
+}
+
+void CANScheduler::siftDown(int i) {
+	while (true) {
+		int smallest = i;
+		int left = 2 * i + 1;
+		int right = left + 1;
+		if (left < numFrames && before(left, smallest))
+			smallest = left;
+		if (right < numFrames && before(right, smallest))
+			smallest = right;
+		if (smallest == i)
+			return;
+
+		uint8_t t = heap[i];
+		heap[i] = heap[smallest];
+		heap[smallest] = t;
+		i = smallest;
+	}
+}
+
+void CANScheduler::siftUp(int i) {
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (!before(i, parent))
+			return;
+
+		uint8_t t = heap[i];
+		heap[i] = heap[parent];
+		heap[parent] = t;
+		i = parent;
+	}
+}
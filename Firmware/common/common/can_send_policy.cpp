@@ -0,0 +1,119 @@
+/*
+ * can_send_policy.cpp
+ *
+ * Send-on-change filtering for periodic CAN messages.
+ */
+
+#include "can_send_policy.h"
+
+#include <string.h>
+
+// Bits in a data frame including interframe space, without stuff bits
+static uint32_t frameBits(const CANMessage& msg) {
+	uint32_t header = msg.format == CANExtended ? 67 : 47;
+	return header + 8 * msg.len;
+}
+
+CANSendPolicy::CANSendPolicy() {
+	numRules = 0;
+	clearStats(0);
+}
+
+int CANSendPolicy::add(const BRIZO_CAN::can_message_info& info, uint32_t maxInterval, uint32_t minInterval) {
+	if (numRules >= CAN_SEND_POLICY_MAX_IDS)
+		return -1;
+	for (int i = 0; i < numRules; i++) {
+		if (rules[i].id == info.ID)
+			return -1;
+	}
+
+	Rule& rule = rules[numRules];
+	rule.id = info.ID;
+	rule.minInterval = minInterval;
+	rule.maxInterval = maxInterval;
+	rule.lastSent = 0;
+	rule.hasSent = false;
+	rule.len = 0;
+	memset(rule.data, 0, sizeof(rule.data));
+	rule.sent = 0;
+	rule.suppressed = 0;
+	numRules++;
+	return 0;
+}
+
+CANSendPolicy::Rule* CANSendPolicy::find(const CANMessage& msg) {
+	if (msg.type != CANData)
+		return NULL;
+	for (int i = 0; i < numRules; i++) {
+		if ((unsigned int)rules[i].id == msg.id)
+			return &rules[i];
+	}
+	return NULL;
+}
+
+bool CANSendPolicy::shouldSend(const CANMessage& msg, uint32_t now) {
+	Rule* rule = find(msg);
+	if (rule == NULL || !rule->hasSent)
+		return true;
+
+	uint32_t elapsed = now - rule->lastSent;
+	uint8_t len = msg.len > 8 ? 8 : msg.len;
+	bool changed = len != rule->len || memcmp(msg.data, rule->data, len) != 0;
+	bool send;
+	if (elapsed < rule->minInterval)
+		send = false;
+	else
+		send = changed || elapsed >= rule->maxInterval;
+
+	if (!send) {
+		rule->suppressed++;
+		totalSuppressed++;
+		totalSuppressedBits += frameBits(msg);
+	}
+	return send;
+}
+
+void CANSendPolicy::markSent(const CANMessage& msg, uint32_t now) {
+	Rule* rule = find(msg);
+	if (rule == NULL)
+		return;
+
+	rule->lastSent = now;
+	rule->hasSent = true;
+	rule->len = msg.len > 8 ? 8 : msg.len;
+	memcpy(rule->data, msg.data, rule->len);
+	rule->sent++;
+}
+
+int CANSendPolicy::size() const {
+	return numRules;
+}
+
+const CANSendPolicy::Rule& CANSendPolicy::rule(int i) const {
+	return rules[i];
+}
+
+uint32_t CANSendPolicy::suppressedFrames() const {
+	return totalSuppressed;
+}
+
+uint64_t CANSendPolicy::suppressedBits() const {
+	return totalSuppressedBits;
+}
+
+uint32_t CANSendPolicy::savedBitsPerSecond(uint32_t now) const {
+	uint32_t elapsed = now - statsStart;
+	if (elapsed == 0)
+		return 0;
+	return (uint32_t)(totalSuppressedBits * 1000000 / elapsed);
+}
+
+void CANSendPolicy::clearStats(uint32_t now) {
+	statsStart = now;
+	totalSuppressed = 0;
+	totalSuppressedBits = 0;
+	for (int i = 0; i < numRules; i++) {
+		rules[i].sent = 0;
+		rules[i].suppressed = 0;
+	}
+}
@@ -0,0 +1,177 @@
+/*
+ * can_time_sync.cpp
+ *
+ * Aligns the boards' clocks to the telemetry node's with sync and follow-up
+ * frames over CAN.
+ */
+
+#include "can_time_sync.h"
+
+// Shortest time a one-byte SYNC can take on the bus, without stuff bits.
+// A TX interrupt sooner than this after writing it is for an older frame.
+#define SYNC_FRAME_US (52 * 1000000ULL / CAN_FREQUENCY)
+
+// Samples before the rate estimate has settled
+#define SETTLE_SAMPLES 4
+
+CANTimeSync::CANTimeSync(TimingCommon& timing, uint32_t syncId, uint32_t followUpId) :
+		timing(timing), syncId(syncId), followUpId(followUpId), txSeq(0), txWaiting(false), txWrittenAt(0),
+		txCaptured(false), txTime(0), rxValid(false), rxSeq(0), rxTime(0), lastLocal(0), lastGlobal(0), rate(0),
+		numSamples(0), numRejected(0), rejectedInRow(0), error(0), worstError(0) {
+
+}
+
+int CANTimeSync::sendSync(CAN& can, uint32_t now) {
+	// Give up on a SYNC that never went out, e.g. after bus-off
+	if (txWaiting && now - txWrittenAt < 100000) {
+		return -1;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	int result = -1;
+	if (can.txstatus() == CAN::Idle) {
+		txSeq++;
+		CANMessage msg;
+		msg.id = syncId;
+		msg.data[0] = txSeq;
+		msg.len = 1;
+		if (can.write(msg)) {
+			txWaiting = true;
+			txCaptured = false;
+			txWrittenAt = now;
+			result = 0;
+		}
+	}
+
+	__set_PRIMASK(primask);
+	return result;
+}
+
+void CANTimeSync::txComplete(uint32_t now) {
+	if (!txWaiting || now - txWrittenAt < SYNC_FRAME_US) {
+		return;
+	}
+	txWaiting = false;
+	txTime = timing.globalTime(now);
+	txCaptured = true;
+}
+
+bool CANTimeSync::followUp(CANMessage& msg) {
+	if (!txCaptured) {
+		return false;
+	}
+	txCaptured = false;
+	msg.id = followUpId;
+	msg.data[0] = txSeq;
+	msg.data[1] = txTime & 0xFF;
+	msg.data[2] = (txTime >> 8) & 0xFF;
+	msg.data[3] = (txTime >> 16) & 0xFF;
+	msg.data[4] = (txTime >> 24) & 0xFF;
+	msg.len = 5;
+	return true;
+}
+
+void CANTimeSync::rxFrame(const CANMessage& msg, uint32_t now) {
+	if (msg.id == syncId && msg.len >= 1) {
+		rxSeq = msg.data[0];
+		rxTime = now;
+		rxValid = true;
+	}
+}
+
+bool CANTimeSync::handle(const CANMessage& msg) {
+	if (msg.id == syncId) {
+		return true;
+	}
+	if (msg.id != followUpId) {
+		return false;
+	}
+	if (msg.len < 5) {
+		return true;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	bool valid = rxValid && rxSeq == msg.data[0];
+	uint32_t local = rxTime;
+	rxValid = false;
+	__set_PRIMASK(primask);
+
+	if (valid) {
+		uint32_t global = msg.data[1] | (msg.data[2] << 8) | (msg.data[3] << 16) | ((uint32_t)msg.data[4] << 24);
+		sample(global, local);
+	}
+	return true;
+}
+
+void CANTimeSync::sample(uint32_t global, uint32_t local) {
+	uint32_t interval = local - lastLocal;
+	if (numSamples == 0 || interval == 0 || interval > CAN_TIME_SYNC_MAX_INTERVAL_US) {
+		// (Re)start from this sample alone
+		numSamples = 1;
+		rate = 0;
+		worstError = 0;
+		error = 0;
+		lastLocal = local;
+		lastGlobal = global;
+		timing.setClockCorrection(local, global, 0);
+		return;
+	}
+
+	uint32_t predicted = timing.globalTime(local);
+	int32_t sampleError = (int32_t)(global - predicted);
+	uint32_t magnitude = sampleError < 0 ? -sampleError : sampleError;
+
+	// A late interrupt on either side shows up as one large error; a real
+	// change of offset keeps showing up
+	if (numSamples >= SETTLE_SAMPLES && magnitude > CAN_TIME_SYNC_GATE_US && rejectedInRow < 3) {
+		rejectedInRow++;
+		numRejected++;
+		return;
+	}
+	rejectedInRow = 0;
+
+	// Rate from this and the last sample, smoothed once settled
+	int32_t globalInterval = (int32_t)(global - lastGlobal);
+	int32_t measured = (int32_t)(((int64_t)(globalInterval - (int32_t)interval) << 32) / interval);
+	if (numSamples < SETTLE_SAMPLES) {
+		rate = measured;
+	} else {
+		rate += (measured - rate) / 4;
+	}
+
+	// Step half the offset error once settled, so one noisy sample does not
+	// move the clock by its whole error
+	uint32_t corrected = numSamples < SETTLE_SAMPLES ? global : predicted + sampleError / 2;
+	timing.setClockCorrection(local, corrected, rate);
+
+	error = sampleError;
+	if (numSamples >= SETTLE_SAMPLES && magnitude > worstError) {
+		worstError = magnitude;
+	}
+	numSamples++;
+	lastLocal = local;
+	lastGlobal = global;
+}
+
+uint32_t CANTimeSync::samples() const {
+	return numSamples;
+}
+
+uint32_t CANTimeSync::rejected() const {
+	return numRejected;
+}
+
+int32_t CANTimeSync::lastError() const {
+	return error;
+}
+
+uint32_t CANTimeSync::maxError() const {
+	return worstError;
+}
+
+int32_t CANTimeSync::rateErrorPpb() const {
+	return (int32_t)(((int64_t)rate * 1000000000LL) >> 32);
+}
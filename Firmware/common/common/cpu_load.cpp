@@ -0,0 +1,112 @@
+/*
+ * cpu_load.cpp
+ *
+ * CPU load meter: sleeps the main loop while it has nothing to do and counts
+ * the time asleep against the time busy.
+ */
+
+#include "cpu_load.h"
+
+CPULoad::CPULoad(uint32_t (*clock)(void), uint32_t window) :
+		clock(clock), window(window) {
+	windowStart = clock();
+	windowIdle = 0;
+	clear();
+}
+
+uint32_t CPULoad::idle(uint32_t maxUs, bool (*workPending)(void)) {
+	if (!arm(maxUs))
+		return 0;
+	__disable_irq();
+	return sleep(workPending == NULL || !workPending());
+}
+
+bool CPULoad::arm(uint32_t maxUs) {
+	uint32_t now = clock();
+	account(now, now);
+	if (maxUs == 0)
+		return false;
+	if (maxUs > CPU_LOAD_MAX_SLEEP_US)
+		maxUs = CPU_LOAD_MAX_SLEEP_US;
+	wakeup.attach_us(this, &CPULoad::wake, maxUs);
+	return true;
+}
+
+uint32_t CPULoad::sleep(bool asleep) {
+	uint32_t slept = 0;
+	if (asleep) {
+		// An interrupt wakes the core even with interrupts disabled; it is
+		// only taken below, so its handler counts as busy
+		uint32_t start = clock();
+		__WFI();
+		uint32_t end = clock();
+		account(start, end);
+		slept = end - start;
+	}
+	__enable_irq();
+	wakeup.detach();
+	return slept;
+}
+
+void CPULoad::account(uint32_t from, uint32_t to) {
+	while (to - windowStart >= window) {
+		uint32_t windowEnd = windowStart + window;
+		uint32_t idle = windowIdle;
+		if ((int32_t)(from - windowEnd) < 0) {
+			idle += windowEnd - from;
+			from = windowEnd;
+		}
+		closeWindow(idle);
+
+		// Windows with no idle time at all, e.g. during a long stall, in
+		// one step
+		uint32_t busy = (from - windowStart) / window;
+		if (busy > 0) {
+			windowStart += busy * window;
+			windowCount += busy;
+			lastLoad = 1000;
+			peakLoad = 1000;
+		}
+	}
+	windowIdle += to - from;
+}
+
+void CPULoad::closeWindow(uint32_t idle) {
+	lastLoad = (uint16_t)((uint64_t)(window - idle) * 1000 / window);
+	if (lastLoad > peakLoad)
+		peakLoad = lastLoad;
+	windowCount++;
+	totalIdle += idle;
+	windowStart += window;
+	windowIdle = 0;
+}
+
+uint16_t CPULoad::load() const {
+	return lastLoad;
+}
+
+uint16_t CPULoad::peak() const {
+	return peakLoad;
+}
+
+void CPULoad::clearPeak() {
+	peakLoad = lastLoad;
+}
+
+uint16_t CPULoad::average() const {
+	if (windowCount == 0)
+		return 0;
+	uint64_t total = (uint64_t)windowCount * window;
+	return (uint16_t)((total - totalIdle) * 1000 / total);
+}
+
+uint32_t CPULoad::windows() const {
+	return windowCount;
+}
+
+void CPULoad::clear() {
+	lastLoad = 0;
+	peakLoad = 0;
+	windowCount = 0;
+	totalIdle = 0;
+}
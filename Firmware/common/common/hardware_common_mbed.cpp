@@ -8,12 +8,18 @@
  */
 
 #include "hardware_common_mbed.h"
+#include "can_struct.h"
+#include "CAN/can_codec.h"
+#include <limits.h>
 
 hardware_common_mbed::hardware_common_mbed(Timer* _timer, CAN* _can, WDT* _wdt) {
     p_timer = _timer;
     p_can = _can;
     p_canBuffer = new CANRXTXBuffer<32, 16>(*_can); //TODO remove dynamic allocation
     p_wdt = _wdt;
+    statsSlot = 0;
+    timingSlot = 0;
+    p_idleExecutor = NULL;
 }
 
 hardware_common_mbed::~hardware_common_mbed() {
@@ -23,22 +29,55 @@ hardware_common_mbed::~hardware_common_mbed() {
     p_can = NULL;
 }
 
-static CANRXTXBuffer<32, 16>* _handleCANMessageBuffer = NULL;
-// handleCANMessage is attached to the CAN RX interrupt.
-void _handleCANMessage() {
-    _handleCANMessageBuffer->handleIrq();
+// handleCANMessage is attached to the CAN RX and TX interrupts.
+void hardware_common_mbed::handleCANMessage() {
+    p_canBuffer->handleIrq();
+
+    // A transfer after bus-off means the controller is back on the bus
+    if (recovery.state() != CANRecovery::ERROR_ACTIVE) {
+        recovery.update(p_can->tderror(), p_can->rderror(), p_timer->read_us(), true);
+    }
+}
+
+void hardware_common_mbed::handleCANBusOff() {
+    uint32_t delay = recovery.busOff(p_timer->read_us());
+    if (delay == 0) {
+        restartCAN();
+    } else {
+        recoveryTimeout.attach_us(this, &hardware_common_mbed::restartCAN, delay);
+    }
+}
+
+void hardware_common_mbed::handleCANErrorState() {
+    recovery.update(p_can->tderror(), p_can->rderror(), p_timer->read_us());
+}
+
+void hardware_common_mbed::restartCAN() {
+    // Clears INIT; the controller is back after 128 x 11 recessive bits
+    p_can->mode(CAN::Normal);
+    recovery.recoveryStarted(p_timer->read_us());
 }
 
 void hardware_common_mbed::setupCAN(void) {
     p_can->frequency(CAN_FREQUENCY);
-    _handleCANMessageBuffer = p_canBuffer;
-    p_can->attach(_handleCANMessage, CAN::RxIrq);
-    p_can->attach(_handleCANMessage, CAN::TxIrq);
+    p_can->attach(this, &hardware_common_mbed::handleCANMessage, CAN::RxIrq);
+    p_can->attach(this, &hardware_common_mbed::handleCANMessage, CAN::TxIrq);
+    p_can->attach(this, &hardware_common_mbed::handleCANBusOff, CAN::BeIrq);
+    p_can->attach(this, &hardware_common_mbed::handleCANErrorState, CAN::EwIrq);
+    p_can->attach(this, &hardware_common_mbed::handleCANErrorState, CAN::EpIrq);
+}
+
+int hardware_common_mbed::setupCANFilters(const BRIZO_CAN::can_message_info* subscriptions, int count) {
+    CANFilterPlan plan;
+    int result = plan.plan(subscriptions, count);
+    plan.install(*p_can);
+    return result != 0; // 1=failure
 }
 
 void hardware_common_mbed::startTimingCommon(TimingCommon* timing, bool* wdtReset) {
     *wdtReset = p_wdt->causedReset();
 	timing->start(p_timer);
+    recovery.start(p_timer->read_us());
     p_wdt->enable();
 }
 
@@ -46,20 +85,143 @@ int hardware_common_mbed::readCANMessage(CANMessage& msg) {
     return p_canBuffer->read(msg) != 1; // 1=failure
 }
 
-int hardware_common_mbed::writeCANMessage(CANMessage msg) {
+size_t hardware_common_mbed::readCANMessages(CANMessage* msgs, size_t max) {
+    return p_canBuffer->read(msgs, max > INT_MAX ? INT_MAX : (int)max);
+}
+
+int hardware_common_mbed::writeCANMessage(const CANMessage& msg) {
     return p_canBuffer->write(msg) != 1; // 1=failure
 }
 
+size_t hardware_common_mbed::writeCANMessages(const CANMessage* msgs, size_t count) {
+    return p_canBuffer->write(msgs, count > INT_MAX ? INT_MAX : (int)count);
+}
+
+#if CAN_STATS || TIMING_PROFILE
+static uint16_t saturate16(uint32_t value) {
+    return value > 0xFFFF ? 0xFFFF : value;
+}
+#endif
+
+int hardware_common_mbed::writeCANStats(int summaryId, int countId) {
+#if CAN_STATS
+    const CANStats& stats = p_canBuffer->stats();
+
+    BRIZO_CAN::WheelCanStatsPayload summary;
+    summary.rxOverflows = saturate16(stats.rxOverflows());
+    summary.txRejects = saturate16(stats.txRejects());
+    summary.rxHighWater = stats.rxHighWater() > 0xFF ? 0xFF : stats.rxHighWater();
+    summary.txHighWater = stats.txHighWater() > 0xFF ? 0xFF : stats.txHighWater();
+    summary.isrMaxUs = saturate16(stats.isrMaxCycles() / (SystemCoreClock / 1000000));
+    int failed = writeCANMessage(makeMessage(summaryId, summary));
+
+    // Move on to the next ID that has been seen
+    for (int i = 0; i < stats.size(); i++) {
+        statsSlot = (statsSlot + 1) % stats.size();
+        if (stats.entry(statsSlot).id != CANStats::EMPTY)
+            break;
+    }
+    const CANIdCount& entry = stats.entry(statsSlot);
+    if (entry.id != CANStats::EMPTY) {
+        BRIZO_CAN::WheelCanStatsIdPayload count;
+        count.id = entry.id;
+        count.rx = entry.rx;
+        count.tx = entry.tx;
+        count.untracked = stats.untracked();
+        failed |= writeCANMessage(makeMessage(countId, count));
+    }
+
+    return failed;
+#else
+    return 1; // 1=failure, counters not built in
+#endif
+}
+
+int hardware_common_mbed::writeTimingProfile(TimingCommon* timing, int summaryId, int callbackId) {
+#if TIMING_PROFILE
+    const TimingProfile& profile = timing->profile();
+
+    uint32_t missed = 0;
+    for (int i = 0; i < profile.size(); i++)
+        missed += profile.callback(i).missed;
+
+    BRIZO_CAN::WheelTimingProfilePayload summary;
+    summary.loopMeanUs = saturate16(profile.loopMeanUs());
+    summary.loopMaxUs = saturate16(profile.loopMax());
+    summary.loopP50Bucket = profile.loopPercentileBucket(50);
+    summary.loopP99Bucket = profile.loopPercentileBucket(99);
+    summary.missed = saturate16(missed);
+    int failed = writeCANMessage(makeMessage(summaryId, summary));
+
+    // Move on to the next callback that has run
+    for (int i = 0; i < profile.size(); i++) {
+        timingSlot = (timingSlot + 1) % profile.size();
+        if (profile.callback(timingSlot).runs != 0)
+            break;
+    }
+    const TimingCallbackProfile& callback = profile.callback(timingSlot);
+    if (callback.runs != 0) {
+        BRIZO_CAN::WheelTimingCallbackPayload entry;
+        entry.slot = timingSlot;
+        entry.missed = callback.missed > 0xFF ? 0xFF : callback.missed;
+        entry.meanRunUs = saturate16(profile.meanRunUs(timingSlot));
+        entry.maxRunUs = saturate16(callback.maxUs);
+        entry.maxLateUs = saturate16(callback.maxLateUs);
+        failed |= writeCANMessage(makeMessage(callbackId, entry));
+    }
+
+    return failed;
+#else
+    return 1; // 1=failure, profiler not built in
+#endif
+}
+
+int hardware_common_mbed::writeHeartbeat(int id, TimingCommon* timing, CPULoad* load) {
+    uint32_t uptime = (uint32_t)timing->read64();
+    if (load == NULL)
+        return writeCANMessage(makeMessage(id, uptime));
+
+    BRIZO_CAN::WheelHeartPayload heartbeat;
+    heartbeat.uptime = uptime;
+    heartbeat.cpuLoad = load->load();
+    heartbeat.cpuPeak = load->peak();
+    load->clearPeak();
+    return writeCANMessage(makeMessage(id, heartbeat));
+}
+
 bool hardware_common_mbed::checkCANController() {
 	//implemented for LPC15xx only!
 	if (LPC_C_CAN0->CANCNTL & (1 << 0)) {
-			LPC_C_CAN0->CANCNTL &= ~(1 << 0);
+		// Waiting out a bus-off backoff
+		if (recovery.recoveryPending())
 			return false;
+
+		// Stuck in INIT without a bus-off interrupt. May be called with
+		// interrupts already disabled, so restore rather than enable them
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		if (recovery.state() != CANRecovery::BUS_OFF)
+			recovery.busOff(p_timer->read_us());
+		restartCAN();
+		__set_PRIMASK(primask);
+		return false;
 	}
 
     return true;
 }
 
+void hardware_common_mbed::setCANRecoveryBackoff(uint32_t initialUs, uint32_t repeatUs, uint32_t maxUs, uint32_t stableUs) {
+    recovery.setBackoff(initialUs, repeatUs, maxUs, stableUs);
+}
+
+const CANRecovery& hardware_common_mbed::canRecovery() const {
+    return recovery;
+}
+
+void hardware_common_mbed::setCANRecorder(CANRecorder* recorder) {
+    p_canBuffer->setRecorder(recorder);
+}
+
 void hardware_common_mbed::setupLEDs(DigitalOut* heartbeatLED, DigitalOut* receiveCANLED, DigitalOut* sendCANLED, DigitalOut* hardwareLED) {
 	p_heartbeatLED = heartbeatLED;
 	p_receiveCANLED = receiveCANLED;
@@ -99,3 +261,28 @@ int hardware_common_mbed::loopTime(TimingCommon* timing, bool* isOverflow){
 	p_wdt->feed();
 	return timing->onTick(isOverflow);
 }
+
+uint32_t hardware_common_mbed::idle(TimingCommon* timing, CPULoad* load, TaskExecutor* executor) {
+    // Sleep until the next callback or task release, whichever is first
+    uint32_t maxUs = CPU_LOAD_MAX_SLEEP_US;
+    if (timing->pending() > 0) {
+        int32_t untilDeadline = (int32_t)(timing->nextDeadline() - (uint32_t)timing->read64());
+        if (untilDeadline <= 0)
+            maxUs = 0;
+        else if ((uint32_t)untilDeadline < maxUs)
+            maxUs = untilDeadline;
+    }
+    if (executor != NULL && executor->untilRelease() < maxUs)
+        maxUs = executor->untilRelease();
+
+    p_idleExecutor = executor;
+    uint32_t slept = load->idle(maxUs, this, &hardware_common_mbed::workPending);
+    p_idleExecutor = NULL;
+    return slept;
+}
+
+bool hardware_common_mbed::workPending() {
+    if (p_can != NULL && !p_canBuffer->rxEmpty())
+        return true;
+    return p_idleExecutor != NULL && p_idleExecutor->ready();
+}
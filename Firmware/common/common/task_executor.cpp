@@ -0,0 +1,190 @@
+/*
+ * task_executor.cpp
+ *
+ * Cooperative run-to-completion executor for a board's main loop.
+ */
+
+#include "task_executor.h"
+
+TaskExecutor::TaskExecutor(uint32_t (*clock)(void)) :
+		numTasks(0), clock(clock), overrunHandler(NULL) {
+}
+
+int TaskExecutor::addPeriodic(uint8_t priority, uint32_t period, uint32_t budget, void (*callback)(void)) {
+	if (period == 0)
+		return -1;
+	return add(priority, period, period, budget, mbed::FunctionPointer(callback));
+}
+
+int TaskExecutor::addEvent(uint8_t priority, uint32_t deadline, uint32_t budget, void (*callback)(void)) {
+	return add(priority, 0, deadline, budget, mbed::FunctionPointer(callback));
+}
+
+int TaskExecutor::add(uint8_t priority, uint32_t period, uint32_t deadline, uint32_t budget,
+		const mbed::FunctionPointer& callback) {
+	if (numTasks >= TASK_EXECUTOR_MAX_TASKS)
+		return -1;
+
+	Task& task = tasks[numTasks];
+	task.callback = callback;
+	task.priority = priority;
+	task.ready = false;
+	task.period = period;
+	task.deadline = deadline;
+	task.budget = budget;
+	task.release = clock() + period;
+	task.due = 0;
+	task.readyAt = 0;
+	task.posted = 0;
+	task.seen = 0;
+	task.runs = 0;
+	task.overruns = 0;
+	task.late = 0;
+	task.dropped = 0;
+	task.maxRunUs = 0;
+	task.totalRunUs = 0;
+	task.maxWaitUs = 0;
+	return numTasks++;
+}
+
+void TaskExecutor::update(uint32_t now) {
+	for (int i = 0; i < numTasks; i++) {
+		Task& task = tasks[i];
+
+		if (task.period != 0 && (int32_t)(now - task.release) >= 0) {
+			if (task.ready) {
+				// The previous release has not run yet; it keeps its
+				// earlier deadline and this one is dropped. If it then
+				// finishes late, that counts separately in late.
+				task.dropped++;
+			} else {
+				task.ready = true;
+				task.readyAt = task.release;
+				task.due = task.release + task.period;
+			}
+			// Releases stay on whole periods, skipping any missed while late
+			uint32_t skipped = (now - task.release) / task.period;
+			task.dropped += skipped;
+			task.release += (skipped + 1) * task.period;
+		}
+
+		uint32_t posted = task.posted;
+		if (posted != task.seen) {
+			task.seen = posted;
+			if (!task.ready) {
+				task.ready = true;
+				task.readyAt = now;
+				task.due = now + task.deadline;
+			}
+		}
+	}
+}
+
+bool TaskExecutor::before(int a, int b) const {
+	if (tasks[a].priority != tasks[b].priority)
+		return tasks[a].priority < tasks[b].priority;
+	int32_t diff = (int32_t)(tasks[a].due - tasks[b].due);
+	// Same deadline: in the order the tasks were added
+	return diff < 0 || (diff == 0 && a < b);
+}
+
+int TaskExecutor::run() {
+	bool ran[TASK_EXECUTOR_MAX_TASKS] = { false };
+	int count = 0;
+
+	while (true) {
+		uint32_t now = clock();
+		update(now);
+
+		int next = -1;
+		for (int i = 0; i < numTasks; i++) {
+			if (tasks[i].ready && !ran[i] && (next < 0 || before(i, next)))
+				next = i;
+		}
+		if (next < 0)
+			break;
+
+		// Not ready any more before the call, so a post from inside it
+		// makes it ready again
+		Task& task = tasks[next];
+		task.ready = false;
+		ran[next] = true;
+		uint32_t wait = now - task.readyAt;
+
+		task.callback.call();
+
+		uint32_t end = clock();
+		uint32_t runUs = end - now;
+		task.runs++;
+		task.totalRunUs += runUs;
+		if (runUs > task.maxRunUs)
+			task.maxRunUs = runUs;
+		if (wait > task.maxWaitUs)
+			task.maxWaitUs = wait;
+		if ((int32_t)(end - task.due) > 0)
+			task.late++;
+		if (runUs > task.budget) {
+			task.overruns++;
+			if (overrunHandler != NULL)
+				overrunHandler(next, runUs);
+		}
+		count++;
+	}
+	return count;
+}
+
+bool TaskExecutor::ready() const {
+	uint32_t now = clock();
+	for (int i = 0; i < numTasks; i++) {
+		const Task& task = tasks[i];
+		if (task.ready || task.posted != task.seen)
+			return true;
+		if (task.period != 0 && (int32_t)(now - task.release) >= 0)
+			return true;
+	}
+	return false;
+}
+
+uint32_t TaskExecutor::untilRelease() const {
+	uint32_t now = clock();
+	uint32_t until = UINT32_MAX;
+	for (int i = 0; i < numTasks; i++) {
+		if (tasks[i].period == 0)
+			continue;
+		int32_t left = (int32_t)(tasks[i].release - now);
+		if (left <= 0)
+			return 0;
+		if ((uint32_t)left < until)
+			until = left;
+	}
+	return until;
+}
+
+void TaskExecutor::setOverrunHandler(void (*handler)(int task, uint32_t runUs)) {
+	overrunHandler = handler;
+}
+
+int TaskExecutor::size() const {
+	return numTasks;
+}
+
+const TaskExecutor::Task& TaskExecutor::task(int i) const {
+	return tasks[i];
+}
+
+uint32_t TaskExecutor::meanRunUs(int i) const {
+	return tasks[i].runs == 0 ? 0 : (uint32_t)(tasks[i].totalRunUs / tasks[i].runs);
+}
+
+void TaskExecutor::clearStats() {
+	for (int i = 0; i < numTasks; i++) {
+		Task& task = tasks[i];
+		task.runs = 0;
+		task.overruns = 0;
+		task.late = 0;
+		task.dropped = 0;
+		task.maxRunUs = 0;
+		task.totalRunUs = 0;
+		task.maxWaitUs = 0;
+	}
+}
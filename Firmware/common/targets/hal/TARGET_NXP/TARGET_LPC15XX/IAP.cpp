@@ -31,3 +31,86 @@ bool IAP::getUniqueID(uint32_t (&data)[4]){
 
 	return false;
 }
+
+// The flash can't be read while it is erased or written, so nothing running
+// from it, interrupt handlers included, may run until IAP returns
+static uint32_t flashCommand(unsigned int (&command_param)[5]){
+	unsigned int status_result[5];
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	IAP::iap_entry(command_param, status_result);
+	if(!primask)
+		__enable_irq();
+
+	return status_result[0];
+}
+
+static uint32_t prepare(uint32_t start, uint32_t end){
+	unsigned int command_param[5];
+	unsigned int status_result[5];
+
+	command_param[0] = IAP::COMMAND_PREPARE;
+	command_param[1] = start;
+	command_param[2] = end;
+
+	IAP::iap_entry(command_param, status_result);
+
+	return status_result[0];
+}
+
+uint32_t IAP::eraseSectors(uint32_t start, uint32_t end){
+	uint32_t status = prepare(start, end);
+	if(status != CMD_SUCCESS)
+		return status;
+
+	unsigned int command_param[5];
+	command_param[0] = COMMAND_ERASE_SECTORS;
+	command_param[1] = start;
+	command_param[2] = end;
+	command_param[3] = SystemCoreClock / 1000;
+
+	return flashCommand(command_param);
+}
+
+uint32_t IAP::copyRamToFlash(uint32_t address, const uint32_t* data, uint32_t bytes){
+	uint32_t status = prepare(sector(address), sector(address + bytes - 1));
+	if(status != CMD_SUCCESS)
+		return status;
+
+	unsigned int command_param[5];
+	command_param[0] = COMMAND_COPY_RAM_TO_FLASH;
+	command_param[1] = address;
+	command_param[2] = (uint32_t)data;
+	command_param[3] = bytes;
+	command_param[4] = SystemCoreClock / 1000;
+
+	return flashCommand(command_param);
+}
+
+uint32_t IAP::blankCheck(uint32_t start, uint32_t end){
+	unsigned int command_param[5];
+	unsigned int status_result[5];
+
+	command_param[0] = COMMAND_BLANK_CHECK;
+	command_param[1] = start;
+	command_param[2] = end;
+
+	iap_entry(command_param, status_result);
+
+	return status_result[0];
+}
+
+uint32_t IAP::compare(uint32_t address, const uint32_t* data, uint32_t bytes){
+	unsigned int command_param[5];
+	unsigned int status_result[5];
+
+	command_param[0] = COMMAND_COMPARE;
+	command_param[1] = address;
+	command_param[2] = (uint32_t)data;
+	command_param[3] = bytes;
+
+	iap_entry(command_param, status_result);
+
+	return status_result[0];
+}
@@ -139,6 +139,25 @@ public:
      */
     int read(CANMessage &msg, int handle = 0);
 
+    /** Read every waiting CANMessage, up to max, from the bus.
+     *
+     *  @param msgs array to read to.
+     *  @param max size of msgs
+     *
+     *  @returns
+     *    number of messages read
+     */
+    int read(CANMessage *msgs, int max);
+
+    /** Count received messages the controller overwrote before they were
+     *  read, since the last call. Each receive message object can only
+     *  flag that it lost at least one, so this is a lower bound.
+     *
+     *  @returns
+     *    number of messages lost, 0 if the target cannot tell
+     */
+    int rxLost();
+
     /** Reset CAN interface.
      *
      * To use after error overflow.
@@ -198,6 +217,16 @@ public:
      */
     int filter(unsigned int id, unsigned int mask, CANFormat format = CANAny, int handle = 0);
 
+    /** Stop a receive message object accepting messages
+     *
+     *  @param handle message filter handle returned by filter()
+     *
+     *  @returns
+     *    0 if the handle is not a receive filter or the target cannot do it,
+     *    1 if the filter was removed
+     */
+    int removeFilter(int handle);
+
     /** Returns number of read errors to detect read overflow errors.
      */
     unsigned char rderror();
@@ -74,15 +74,20 @@ public:
      */
     int read_us();
 
+    /** Get the time passed in micro-seconds, 64 bits wide so it does not
+     *  wrap
+     */
+    us_timestamp_t read_high_resolution_us();
+
 #ifdef MBED_OPERATORS
     operator float();
 #endif
 
 protected:
-    int slicetime();
+    us_timestamp_t slicetime();
     int _running;          // whether the timer is running
-    unsigned int _start;   // the start time of the latest slice
-    int _time;             // any accumulated time from previous slices
+    us_timestamp_t _start; // the start time of the latest slice
+    us_timestamp_t _time;  // any accumulated time from previous slices
     const ticker_data_t *_ticker_data;
 };
 
@@ -18,6 +18,26 @@
 #if DEVICE_CAN
 
 #include "cmsis.h"
+#include "toolchain.h"
+
+// Targets without a batched read fall back to one can_read per frame
+extern "C" WEAK int can_read_all(can_t *obj, CAN_Message *msgs, int max) {
+    int count = 0;
+    while (count < max && can_read(obj, &msgs[count], 0)) {
+        count++;
+    }
+    return count;
+}
+
+// Targets that cannot tell report no lost frames
+extern "C" WEAK int can_rx_lost(can_t *obj) {
+    return 0;
+}
+
+// Targets that cannot invalidate a filter report it as unsupported
+extern "C" WEAK int can_filter_remove(can_t *obj, int32_t handle) {
+    return 0;
+}
 
 namespace mbed {
 
@@ -43,6 +63,15 @@ int CAN::read(CANMessage &msg, int handle) {
     return can_read(&_can, &msg, handle);
 }
 
+int CAN::read(CANMessage *msgs, int max) {
+    // CANMessage adds no members to CAN_Message, so the arrays line up
+    return can_read_all(&_can, msgs, max);
+}
+
+int CAN::rxLost() {
+    return can_rx_lost(&_can);
+}
+
 void CAN::reset() {
     can_reset(&_can);
 }
@@ -71,6 +100,10 @@ int CAN::filter(unsigned int id, unsigned int mask, CANFormat format, int handle
     return can_filter(&_can, id, mask, format, handle);
 }
 
+int CAN::removeFilter(int handle) {
+    return can_filter_remove(&_can, handle);
+}
+
 void CAN::attach(void (*fptr)(void), IrqType type) {
     if (fptr) {
         _irq[(CanIrqType)type].attach(fptr);
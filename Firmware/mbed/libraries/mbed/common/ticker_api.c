@@ -23,31 +23,188 @@ void ticker_set_handler(const ticker_data_t *const data, ticker_event_handler ha
     data->queue->event_handler = handler;
 }
 
+/* Timestamps wrap, so events are ordered by their difference, which is
+ * consistent as long as all queued events are within 2^31 of each other */
+static int is_before(const ticker_event_t *a, const ticker_event_t *b) {
+    return (int)(a->timestamp - b->timestamp) < 0;
+}
+
+static int height(const ticker_event_t *node) {
+    return node == NULL ? 0 : node->height;
+}
+
+static void update_height(ticker_event_t *node) {
+    int left = height(node->left);
+    int right = height(node->right);
+    node->height = 1 + (left > right ? left : right);
+}
+
+static int is_queued(const ticker_event_queue_t *queue, const ticker_event_t *obj) {
+    return obj->parent != NULL || queue->root == obj;
+}
+
+/* Put child where node was under parent */
+static void replace_child(ticker_event_queue_t *queue, ticker_event_t *parent, ticker_event_t *node, ticker_event_t *child) {
+    if (parent == NULL) {
+        queue->root = child;
+    } else if (parent->left == node) {
+        parent->left = child;
+    } else {
+        parent->right = child;
+    }
+    if (child != NULL) {
+        child->parent = parent;
+    }
+}
+
+static ticker_event_t *rotate_right(ticker_event_queue_t *queue, ticker_event_t *node) {
+    ticker_event_t *top = node->left;
+    node->left = top->right;
+    if (top->right != NULL) {
+        top->right->parent = node;
+    }
+    replace_child(queue, node->parent, node, top);
+    top->right = node;
+    node->parent = top;
+    update_height(node);
+    update_height(top);
+    return top;
+}
+
+static ticker_event_t *rotate_left(ticker_event_queue_t *queue, ticker_event_t *node) {
+    ticker_event_t *top = node->right;
+    node->right = top->left;
+    if (top->left != NULL) {
+        top->left->parent = node;
+    }
+    replace_child(queue, node->parent, node, top);
+    top->left = node;
+    node->parent = top;
+    update_height(node);
+    update_height(top);
+    return top;
+}
+
+/* Restore AVL balance from node up to the root, at most 1.44 log2(n) steps */
+static void rebalance(ticker_event_queue_t *queue, ticker_event_t *node) {
+    while (node != NULL) {
+        update_height(node);
+        int balance = height(node->left) - height(node->right);
+        if (balance > 1) {
+            if (height(node->left->left) < height(node->left->right)) {
+                rotate_left(queue, node->left);
+            }
+            node = rotate_right(queue, node);
+        } else if (balance < -1) {
+            if (height(node->right->right) < height(node->right->left)) {
+                rotate_right(queue, node->right);
+            }
+            node = rotate_left(queue, node);
+        }
+        node = node->parent;
+    }
+}
+
+static void queue_insert(ticker_event_queue_t *queue, ticker_event_t *obj) {
+    /* Equal timestamps go after the ones already queued */
+    ticker_event_t *parent = NULL;
+    ticker_event_t *p = queue->root;
+    while (p != NULL) {
+        parent = p;
+        p = is_before(obj, p) ? p->left : p->right;
+    }
+
+    obj->left = NULL;
+    obj->right = NULL;
+    obj->height = 1;
+    obj->parent = parent;
+    if (parent == NULL) {
+        queue->root = obj;
+    } else if (is_before(obj, parent)) {
+        parent->left = obj;
+    } else {
+        parent->right = obj;
+    }
+
+    if (queue->head == NULL || is_before(obj, queue->head)) {
+        queue->head = obj;
+    }
+    rebalance(queue, parent);
+}
+
+static void queue_remove(ticker_event_queue_t *queue, ticker_event_t *obj) {
+    if (queue->head == obj) {
+        /* The head has no earlier events, so the next one is the first in
+         * its right subtree, or else its parent */
+        ticker_event_t *next = obj->right;
+        if (next == NULL) {
+            next = obj->parent;
+        } else {
+            while (next->left != NULL) {
+                next = next->left;
+            }
+        }
+        queue->head = next;
+    }
+
+    ticker_event_t *start;
+    if (obj->left != NULL && obj->right != NULL) {
+        /* Move the next later event into obj's place */
+        ticker_event_t *next = obj->right;
+        while (next->left != NULL) {
+            next = next->left;
+        }
+        start = next;
+        if (next->parent != obj) {
+            start = next->parent;
+            replace_child(queue, next->parent, next, next->right);
+            next->right = obj->right;
+            next->right->parent = next;
+        }
+        replace_child(queue, obj->parent, obj, next);
+        next->left = obj->left;
+        next->left->parent = next;
+    } else {
+        start = obj->parent;
+        replace_child(queue, obj->parent, obj, obj->left != NULL ? obj->left : obj->right);
+    }
+    rebalance(queue, start);
+
+    obj->left = NULL;
+    obj->right = NULL;
+    obj->parent = NULL;
+}
+
 void ticker_irq_handler(const ticker_data_t *const data) {
     data->interface->clear_interrupt();
 
-    /* Go through all the pending TimerEvents */
+    /* Go through all the pending TimerEvents, taking one at a time off the
+     * queue so interrupts are only disabled briefly */
     while (1) {
-        if (data->queue->head == NULL) {
+        __disable_irq();
+        ticker_event_t *p = data->queue->head;
+        if (p == NULL) {
             // There are no more TimerEvents left, so disable matches.
             data->interface->disable_interrupt();
+            __enable_irq();
             return;
         }
 
-        if ((int)(data->queue->head->timestamp - data->interface->read()) <= 0) {
+        if ((int)(p->timestamp - data->interface->read()) <= 0) {
             // This event was in the past:
-            //      point to the following one and execute its handler
-            ticker_event_t *p = data->queue->head;
-            data->queue->head = data->queue->head->next;
+            //      take it off the queue and execute its handler
+            queue_remove(data->queue, p);
+            __enable_irq();
             if (data->queue->event_handler != NULL) {
                 (*data->queue->event_handler)(p->id); // NOTE: the handler can set new events
             }
             /* Note: We continue back to examining the head because calling the
-             * event handler may have altered the chain of pending events. */
+             * event handler may have altered the queue. */
         } else {
-            // This event and the following ones in the list are in the future:
+            // This event and the following ones in the queue are in the future:
             //      set it as next interrupt and return
-            data->interface->set_interrupt(data->queue->head->timestamp);
+            data->interface->set_interrupt(p->timestamp);
+            __enable_irq();
             return;
         }
     }
@@ -57,32 +214,19 @@ void ticker_insert_event(const ticker_data_t *const data, ticker_event_t *obj, t
     /* disable interrupts for the duration of the function */
     __disable_irq();
 
+    // an event can only be queued once
+    if (is_queued(data->queue, obj)) {
+        queue_remove(data->queue, obj);
+    }
+
     // initialise our data
     obj->timestamp = timestamp;
     obj->id = id;
 
-    /* Go through the list until we either reach the end, or find
-       an element this should come before (which is possibly the
-       head). */
-    ticker_event_t *prev = NULL, *p = data->queue->head;
-    while (p != NULL) {
-        /* check if we come before p */
-        if ((int)(timestamp - p->timestamp) < 0) {
-            break;
-        }
-        /* go to the next element */
-        prev = p;
-        p = p->next;
-    }
-    /* if prev is NULL we're at the head */
-    if (prev == NULL) {
-        data->queue->head = obj;
+    queue_insert(data->queue, obj);
+    if (data->queue->head == obj) {
         data->interface->set_interrupt(timestamp);
-    } else {
-        prev->next = obj;
     }
-    /* if we're at the end p will be NULL, which is correct */
-    obj->next = p;
 
     __enable_irq();
 }
@@ -90,24 +234,15 @@ void ticker_insert_event(const ticker_data_t *const data, ticker_event_t *obj, t
 void ticker_remove_event(const ticker_data_t *const data, ticker_event_t *obj) {
     __disable_irq();
 
-    // remove this object from the list
-    if (data->queue->head == obj) {
-        // first in the list, so just drop me
-        data->queue->head = obj->next;
-        if (data->queue->head == NULL) {
-            data->interface->disable_interrupt();
-        } else {
-            data->interface->set_interrupt(data->queue->head->timestamp);
-        }
-    } else {
-        // find the object before me, then drop me
-        ticker_event_t* p = data->queue->head;
-        while (p != NULL) {
-            if (p->next == obj) {
-                p->next = obj->next;
-                break;
+    if (is_queued(data->queue, obj)) {
+        int was_head = data->queue->head == obj;
+        queue_remove(data->queue, obj);
+        if (was_head) {
+            if (data->queue->head == NULL) {
+                data->interface->disable_interrupt();
+            } else {
+                data->interface->set_interrupt(data->queue->head->timestamp);
             }
-            p = p->next;
         }
     }
 
@@ -119,6 +254,14 @@ timestamp_t ticker_read(const ticker_data_t *const data)
     return data->interface->read();
 }
 
+us_timestamp_t ticker_read_64(const ticker_data_t *const data)
+{
+    if (data->interface->read_64 == NULL) {
+        return data->interface->read();
+    }
+    return data->interface->read_64();
+}
+
 int ticker_get_next_timestamp(const ticker_data_t *const data, timestamp_t *timestamp)
 {
     int ret = 0;
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 #include "us_ticker_api.h"
+#include "toolchain.h"
+#include "cmsis.h"
 
 static ticker_event_queue_t events;
 
@@ -23,6 +25,7 @@ static const ticker_interface_t us_interface = {
     .disable_interrupt = us_ticker_disable_interrupt,
     .clear_interrupt = us_ticker_clear_interrupt,
     .set_interrupt = us_ticker_set_interrupt,
+    .read_64 = us_ticker_read_64,
 };
 
 static const ticker_data_t us_data = {
@@ -35,6 +38,24 @@ const ticker_data_t* get_us_ticker_data(void)
     return &us_data;
 }
 
+WEAK us_timestamp_t us_ticker_read_64(void)
+{
+    static uint32_t last = 0;
+    static uint32_t wraps = 0;
+
+    // Callers may already have interrupts disabled; keep them that way
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t now = us_ticker_read();
+    if (now < last) {
+        wraps++;
+    }
+    last = now;
+    us_timestamp_t time = ((us_timestamp_t)wraps << 32) | now;
+    __set_PRIMASK(primask);
+    return time;
+}
+
 void us_ticker_irq_handler(void)
 {
     ticker_irq_handler(&us_data);
@@ -70,8 +70,11 @@ void          can_irq_set  (can_t *obj, CanIrqType irq, uint32_t enable);
 
 int           can_write    (can_t *obj, CAN_Message, int cc);
 int           can_read     (can_t *obj, CAN_Message *msg, int handle);
+int           can_read_all (can_t *obj, CAN_Message *msgs, int max);
+int           can_rx_lost  (can_t *obj);
 int           can_mode     (can_t *obj, CanMode mode);
 int           can_filter(can_t *obj, uint32_t id, uint32_t mask, CANFormat format, int32_t handle);
+int           can_filter_remove(can_t *obj, int32_t handle);
 void          can_reset    (can_t *obj);
 CanTxState    can_tx_status(can_t *obj);
 unsigned char can_rderror  (can_t *obj);
@@ -20,12 +20,23 @@
 
 typedef uint32_t timestamp_t;
 
+/** 64-bit time in the ticker's units, which does not wrap
+ */
+typedef uint64_t us_timestamp_t;
+
 /** Ticker's event structure
+ *
+ * Queued events form a balanced binary tree ordered by timestamp, so
+ * inserting and removing take O(log n) steps with interrupts disabled.
+ * Zero-initialize an event before its first use.
  */
 typedef struct ticker_event_s {
     timestamp_t            timestamp; /**< Event's timestamp */
     uint32_t               id;        /**< TimerEvent object */
-    struct ticker_event_s *next;      /**< Next event in the queue */
+    struct ticker_event_s *left;      /**< Subtree of earlier events */
+    struct ticker_event_s *right;     /**< Subtree of later events, and equal ones queued after */
+    struct ticker_event_s *parent;    /**< NULL for the root and for events not queued */
+    uint8_t                height;    /**< Height of the subtree, for balancing */
 } ticker_event_t;
 
 typedef void (*ticker_event_handler)(uint32_t id);
@@ -38,13 +49,15 @@ typedef struct {
     void (*disable_interrupt)(void);              /**< Disable interrupt function */
     void (*clear_interrupt)(void);                /**< Clear interrupt function */
     void (*set_interrupt)(timestamp_t timestamp); /**< Set interrupt function */
+    us_timestamp_t (*read_64)(void);              /**< 64-bit read function, NULL if the ticker only has read */
 } ticker_interface_t;
 
 /** Tickers events queue structure
  */
 typedef struct {
     ticker_event_handler event_handler; /**< Event handler */
-    ticker_event_t *head;               /**< A pointer to head */
+    ticker_event_t *head;               /**< A pointer to head, the earliest event */
+    ticker_event_t *root;               /**< Root of the event tree */
 } ticker_event_queue_t;
 
 /** Tickers data structure
@@ -94,6 +107,16 @@ void ticker_insert_event(const ticker_data_t *const data, ticker_event_t *obj, t
  */
 timestamp_t ticker_read(const ticker_data_t *const data);
 
+/** Read the current ticker's timestamp, 64 bits wide
+ *
+ * Only monotonic for tickers with a read_64 function; for others the
+ * 32-bit timestamp is returned as is.
+ *
+ * @param data The ticker's data
+ * @return The current timestamp
+ */
+us_timestamp_t ticker_read_64(const ticker_data_t *const data);
+
 /** Read the next event's timestamp
  *
  * @param data The ticker's data
@@ -53,6 +53,16 @@ void us_ticker_init(void);
  */
 uint32_t us_ticker_read(void);
 
+/** Read the current counter, without wrapping
+ *
+ * Targets with a counter wider than 32 bits provide their own. The default
+ * extends us_ticker_read() and must be called at least once per wrap
+ * (71 minutes) to catch every one.
+ *
+ * @return The time since the ticker was initialized in microseconds
+ */
+us_timestamp_t us_ticker_read_64(void);
+
 /** Set interrupt for specified timestamp
  *
  * @param timestamp The time in microseconds to be set
@@ -15,6 +15,7 @@
  */
 
 #include "can_api.h"
+#include "can_msg_obj.h"
 
 #include "cmsis.h"
 #include "mbed_error.h"
@@ -23,8 +24,10 @@
 #include <string.h>
 
 /* Handy defines */
-#define RX_MSG_OBJ_COUNT 31
-#define TX_MSG_OBJ_COUNT 1
+#define TX_MSG_OBJ_COUNT CAN_TX_MSG_OBJ_COUNT
+#define RX_MSG_OBJ_COUNT CAN_RX_MSG_OBJ_COUNT
+#define TX_MSG_OBJ_MASK  (0xFFFFFFFFUL << RX_MSG_OBJ_COUNT)
+#define RX_MSG_OBJ_MASK  (0xFFFFFFFFUL >> TX_MSG_OBJ_COUNT)
 #define DLC_MAX          8
 
 #define ID_STD_MASK      0x07FF
@@ -78,18 +81,119 @@
 #define CANTEST_TX_SHIFT               5                 
 #define CANTEST_RX                     (1 << 7)           // Monitors the actual value of the CAN_RXD pin.
 
+// Read a received object in one transfer, clearing NEWDAT and INTPND
+#define CANIFn_CMDMSK_RX_READ   (CANIFn_CMDMSK_RD | CANIFn_CMDMSK_ARB | CANIFn_CMDMSK_CTRL | CANIFn_CMDMSK_CLRINTPND | CANIFn_CMDMSK_NEWDAT | CANIFn_CMDMSK_DATA_A | CANIFn_CMDMSK_DATA_B)
+
+// IF1 and IF2 share a register layout
+typedef struct {
+    __IO uint32_t CMDREQ;
+    __IO uint32_t CMDMSK;
+    __IO uint32_t MSK1;
+    __IO uint32_t MSK2;
+    __IO uint32_t ARB1;
+    __IO uint32_t ARB2;
+    __IO uint32_t MCTRL;
+    __IO uint32_t DA1;
+    __IO uint32_t DA2;
+    __IO uint32_t DB1;
+    __IO uint32_t DB2;
+} can_if_t;
+
+#define CAN_IF1 ((can_if_t *)&LPC_C_CAN0->CANIF1_CMDREQ)
+#define CAN_IF2 ((can_if_t *)&LPC_C_CAN0->CANIF2_CMDREQ)
+
 static uint32_t can_irq_id = 0;
 static can_irq_handler irq_handler;
 
 static uint32_t tx_interrupts = 0;
 static uint32_t rx_interrupts = 0;
+// Bitmap of enabled IRQ_ERROR/IRQ_PASSIVE/IRQ_BUS handlers (bit = CanIrqType)
+static uint32_t error_interrupts = 0;
+#define ERROR_IRQ_MASK ((1UL << IRQ_ERROR) | (1UL << IRQ_PASSIVE) | (1UL << IRQ_BUS))
+
+// EPASS/EWARN/BOFF as of the last status interrupt, to report changes only
+static uint32_t error_status = 0;
+// Set on bus-off when an IRQ_BUS handler owns recovery; until it calls
+// can_mode(MODE_NORMAL), other calls leave the controller in INIT
+static volatile uint32_t bus_off_hold = 0;
+// Receive objects found overwritten (MSGLST) since can_rx_lost last ran
+static uint32_t rx_lost = 0;
+// Arbitration rank (can_tx_rank) of the frame last written to each
+// transmit object; only read for objects still pending
+static uint32_t tx_rank[TX_MSG_OBJ_COUNT];
+
+// Bitmap of transmit message objects still waiting to be sent (bit n = object n+1)
+static inline uint32_t can_tx_pending(void) {
+    return ((LPC_C_CAN0->CANTXREQ1 & 0xFFFF) | (LPC_C_CAN0->CANTXREQ2 << 16)) & TX_MSG_OBJ_MASK;
+}
+
+// Position of a frame in arbitration, lowest wins: the 11-bit base ID,
+// then standard before extended, then the rest of an extended ID
+static inline uint32_t can_tx_rank(const CAN_Message *msg) {
+    if (msg->format == CANExtended) {
+        return ((msg->id & ID_EXT_MASK) >> 18 << 19) | (1UL << 18) | (msg->id & 0x3FFFF);
+    }
+    return (msg->id & ID_STD_MASK) << 19;
+}
+
+// Bitmap of receive message objects holding unread frames (bit n = object n+1)
+static inline uint32_t can_rx_pending(void) {
+    return ((LPC_C_CAN0->CANND1 & 0xFFFF) | (LPC_C_CAN0->CANND2 << 16)) & RX_MSG_OBJ_MASK;
+}
+
+// Start reading a message object into a message interface
+static inline void can_if_start_read(can_if_t *ifn, uint32_t msgnum) {
+    while (ifn->CMDREQ & CANIFn_CMDREQ_BUSY);
+    ifn->CMDMSK = CANIFn_CMDMSK_RX_READ;
+    ifn->CMDREQ = msgnum & 0x3F;
+}
+
+// Wait for a read started with can_if_start_read and unpack it
+static inline void can_if_finish_read(can_if_t *ifn, uint32_t msgnum, CAN_Message *msg) {
+    while (ifn->CMDREQ & CANIFn_CMDREQ_BUSY);
+
+    uint32_t arb2 = ifn->ARB2;
+    if (arb2 & CANIFn_ARB2_XTD) {
+        msg->format = CANExtended;
+        msg->id = ((arb2 & 0x1FFF) << 16) | (ifn->ARB1 & 0xFFFF);
+    } else {
+        msg->format = CANStandard;
+        msg->id = (arb2 & 0x1FFF) >> 2;
+    }
+    msg->type = (arb2 & CANIFn_ARB2_DIR) ? CANRemote : CANData;
+
+    uint32_t mctrl = ifn->MCTRL;
+    uint32_t len = mctrl & DLC_MASK;
+    msg->len = len > DLC_MAX ? DLC_MAX : len;
+
+    uint32_t da1 = ifn->DA1, da2 = ifn->DA2, db1 = ifn->DB1, db2 = ifn->DB2;
+    msg->data[0] = da1 & 0xFF;
+    msg->data[1] = (da1 >> 8) & 0xFF;
+    msg->data[2] = da2 & 0xFF;
+    msg->data[3] = (da2 >> 8) & 0xFF;
+    msg->data[4] = db1 & 0xFF;
+    msg->data[5] = (db1 >> 8) & 0xFF;
+    msg->data[6] = db2 & 0xFF;
+    msg->data[7] = (db2 >> 8) & 0xFF;
+
+    // The object took a frame while still holding an unread one. Count it
+    // and write MSGLST back cleared; a frame that arrives between the read
+    // and this write loses its NEWDAT too, so the count is a lower bound.
+    if (mctrl & CANIFn_MCTRL_MSGLST) {
+        rx_lost++;
+        ifn->MCTRL = mctrl & ~(CANIFn_MCTRL_MSGLST | CANIFn_MCTRL_NEWDAT | CANIFn_MCTRL_INTPND);
+        ifn->CMDMSK = CANIFn_CMDMSK_WR | CANIFn_CMDMSK_CTRL;
+        ifn->CMDREQ = msgnum & 0x3F;
+        while (ifn->CMDREQ & CANIFn_CMDREQ_BUSY);
+    }
+}
 
 static inline void can_disable(can_t *obj) {
     LPC_C_CAN0->CANCNTL |= 0x1;
 }
 
 static inline void can_enable(can_t *obj) {
-    if (LPC_C_CAN0->CANCNTL & 0x1) {
+    if ((LPC_C_CAN0->CANCNTL & 0x1) && !bus_off_hold) {
         LPC_C_CAN0->CANCNTL &= ~(0x1);
     }
 }
@@ -103,6 +207,9 @@ int can_mode(can_t *obj, CanMode mode) {
             success = 1;
             break;
         case MODE_NORMAL:
+            // Also starts bus-off recovery: the controller rejoins the bus
+            // after 128 sequences of 11 recessive bits
+            bus_off_hold = 0;
             LPC_C_CAN0->CANCNTL &=~CANCNTL_TEST;
             can_enable(obj);
             success = 1;
@@ -133,18 +240,19 @@ int can_mode(can_t *obj, CanMode mode) {
     return success;
 }
 
+// Clear a message object's INTPND bit only; NEWDAT and the frame stay
 static inline void can_clear_interrupt(int32_t handle) {
     if (0 < handle && handle <= 32) {
         // Make sure the interface is available
         while( LPC_C_CAN0->CANIF2_CMDREQ & CANIFn_CMDREQ_BUSY );
 
         // Just request that the message object's INTPND bit be cleared
-        LPC_C_CAN0->CANIF2_CMDMSK_W = CANIFn_CMDMSK_CLRINTPND | CANIFn_CMDMSK_NEWDAT;
+        LPC_C_CAN0->CANIF2_CMDMSK_W = CANIFn_CMDMSK_CLRINTPND;
         // In a union with CMDMSK_R
         // Start Transfer to given message number
         LPC_C_CAN0->CANIF2_CMDREQ = handle & 0x3F;
 
-        // Wait until transfer to message ram complete - TODO: maybe not block??
+        // Wait for the transfer, so CANINT no longer shows this object
         while( LPC_C_CAN0->CANIF2_CMDREQ & CANIFn_CMDREQ_BUSY );
     }
 }
@@ -153,12 +261,12 @@ static inline void can_clear_interrupt(int32_t handle) {
 int can_filter(can_t *obj, uint32_t id, uint32_t mask, CANFormat format, int32_t handle) {
     uint16_t i;
 
-    // Find first free message object
+    // Find first free receive message object
     if (handle == 0) {
         uint32_t msgval = LPC_C_CAN0->CANMSGV1 | (LPC_C_CAN0->CANMSGV2 << 16);
 
         // Find first free messagebox
-        for (i = 0; i < 32; i++) {
+        for (i = 0; i < RX_MSG_OBJ_COUNT; i++) {
             if ((msgval & (1 << i)) == 0) {
                 handle = i+1;
                 break;
@@ -167,6 +275,13 @@ int can_filter(can_t *obj, uint32_t id, uint32_t mask, CANFormat format, int32_t
     }
 
     if (handle > 0 && handle <= 32) {
+        // can_read_all uses IF1 from the CAN interrupt
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        // Make sure the interface is available
+        while ( LPC_C_CAN0->CANIF1_CMDREQ & CANIFn_CMDREQ_BUSY );
+
         if (format == CANExtended) {
             // Mark message valid, Direction = TX, Extended Frame, Set Identifier and mask everything
             LPC_C_CAN0->CANIF1_ARB1 = (id & 0xFFFF);
@@ -190,45 +305,89 @@ int can_filter(can_t *obj, uint32_t id, uint32_t mask, CANFormat format, int32_t
 
         // Wait until transfer to message ram complete - TODO: maybe not block??
         while ( LPC_C_CAN0->CANIF1_CMDREQ & CANIFn_CMDREQ_BUSY );
+
+        __set_PRIMASK(primask);
     }
 
     return handle;
 }
 
+int can_filter_remove(can_t *obj, int32_t handle) {
+    if (handle <= 0 || handle > RX_MSG_OBJ_COUNT) {
+        return 0;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Make sure the interface is available
+    while ( LPC_C_CAN0->CANIF1_CMDREQ & CANIFn_CMDREQ_BUSY );
+
+    // Clear MSGVAL so the object takes part in acceptance no more, and drop
+    // whatever it still holds
+    LPC_C_CAN0->CANIF1_ARB1 = 0;
+    LPC_C_CAN0->CANIF1_ARB2 = 0;
+    LPC_C_CAN0->CANIF1_MCTRL = 0;
+    LPC_C_CAN0->CANIF1_CMDMSK_W = CANIFn_CMDMSK_WR | CANIFn_CMDMSK_ARB | CANIFn_CMDMSK_CTRL | CANIFn_CMDMSK_CLRINTPND;
+    LPC_C_CAN0->CANIF1_CMDREQ = (handle & 0x3F);
+    while ( LPC_C_CAN0->CANIF1_CMDREQ & CANIFn_CMDREQ_BUSY );
+
+    __set_PRIMASK(primask);
+    return 1;
+}
+
+/* CANINT shows the most urgent pending source only, so keep serving it
+ * until it reads 0: frames that arrive while the handler runs are taken in
+ * the same interrupt instead of costing another entry.
+ *
+ * Receive objects are left for the handler, whose can_read_all() clears
+ * NEWDAT and INTPND as it reads them. If one is still pending afterwards,
+ * e.g. because the receive buffer was full, only its INTPND is cleared: the
+ * frame stays in the object for the next read instead of being dropped.
+ */
 static inline void can_irq() {
-    uint32_t intid = LPC_C_CAN0->CANINT & 0xFFFF;
-    if (0x0001 <= intid && intid <= RX_MSG_OBJ_COUNT) {
-        can_clear_interrupt(intid);
-        if (rx_interrupts) {
-            irq_handler(can_irq_id, IRQ_RX);
-        } else {
+    uint32_t intid;
+    while ((intid = LPC_C_CAN0->CANINT & 0xFFFF) != 0) {
+        if (0x0001 <= intid && intid <= RX_MSG_OBJ_COUNT) {
+            if (rx_interrupts) {
+                irq_handler(can_irq_id, IRQ_RX);
+            }
+            if ((LPC_C_CAN0->CANINT & 0xFFFF) == intid) {
+                can_clear_interrupt(intid);
+            }
+        } else if (RX_MSG_OBJ_COUNT < intid && intid <= 0x0020) {
             can_clear_interrupt(intid);
-        }
-    } else if (RX_MSG_OBJ_COUNT < intid && intid <= 0x0020) {
-        can_clear_interrupt(intid);
-        if (tx_interrupts) {
-            irq_handler(can_irq_id, IRQ_TX);
+            if (tx_interrupts) {
+                irq_handler(can_irq_id, IRQ_TX);
+            }
+        } else if (intid == 0x8000) {
+            uint32_t status = LPC_C_CAN0->CANSTAT;
+            // Every bus error raises a status interrupt, so only report changes
+            uint32_t changed = (status ^ error_status) & (CANSTAT_BOFF | CANSTAT_EWARN | CANSTAT_EPASS);
+            error_status = status;
+            if ((changed & status & CANSTAT_BOFF) != 0) {
+                // The controller set INIT; hold it there for the handler
+                if (error_interrupts & (1UL << IRQ_BUS)) {
+                    bus_off_hold = 1;
+                }
+                irq_handler(can_irq_id, IRQ_BUS);
+            }
+            if ((changed & CANSTAT_EWARN) != 0) {
+                irq_handler(can_irq_id, IRQ_ERROR);
+            }
+            if ((changed & CANSTAT_EPASS) != 0) {
+                irq_handler(can_irq_id, IRQ_PASSIVE);
+            }
+            if ((status & CANSTAT_RXOK) != 0) {
+                LPC_C_CAN0->CANSTAT &= ~CANSTAT_RXOK;
+                irq_handler(can_irq_id, IRQ_RX);
+            }
+            if ((status & CANSTAT_TXOK) != 0) {
+                LPC_C_CAN0->CANSTAT &= ~CANSTAT_TXOK;
+                irq_handler(can_irq_id, IRQ_TX);
+            }
         } else {
-            can_clear_interrupt(intid);
-        }
-    } else if (intid == 0x8000) {
-        uint32_t status = LPC_C_CAN0->CANSTAT;
-        if ((status & CANSTAT_BOFF) != 0) {
-            irq_handler(can_irq_id, IRQ_BUS);
-        }
-        if ((status & CANSTAT_EWARN) != 0) {
-            irq_handler(can_irq_id, IRQ_ERROR);
-        }
-        if ((status & CANSTAT_EPASS) != 0) {
-            irq_handler(can_irq_id, IRQ_PASSIVE);
-        }
-        if ((status & CANSTAT_RXOK) != 0) {
-            LPC_C_CAN0->CANSTAT &= ~CANSTAT_RXOK;
-            irq_handler(can_irq_id, IRQ_RX);
-        }
-        if ((status & CANSTAT_TXOK) != 0) {
-            LPC_C_CAN0->CANSTAT &= ~CANSTAT_TXOK;
-            irq_handler(can_irq_id, IRQ_TX);
+            break;
         }
     }
 }
@@ -255,17 +414,31 @@ void can_irq_set(can_t *obj, CanIrqType type, uint32_t enable) {
            case IRQ_TX:
                tx_interrupts = enable;
                break;
+           case IRQ_ERROR:
+           case IRQ_PASSIVE:
+           case IRQ_BUS:
+               if (enable) {
+                   error_interrupts |= 1UL << type;
+               } else {
+                   error_interrupts &= ~(1UL << type);
+               }
+               break;
            default:
                return;
     }
 
     // Put CAN in Reset Mode and enable interrupt
     can_disable(obj);
-    if(!(rx_interrupts || tx_interrupts)) {
-        LPC_C_CAN0->CANCNTL &= ~(1UL << 1 | 1UL << 2);
-    } else {
-        LPC_C_CAN0->CANCNTL |= 1UL << 1 | 1UL << 2;
+    // Status changes (SIE) report transfers and bus errors, error changes
+    // (EIE) report EWARN and BOFF
+    uint32_t cntl = LPC_C_CAN0->CANCNTL & ~(CANCNTL_IE | CANCNTL_SIE | CANCNTL_EIE);
+    if (rx_interrupts || tx_interrupts) {
+        cntl |= CANCNTL_IE | CANCNTL_SIE;
     }
+    if (error_interrupts & ERROR_IRQ_MASK) {
+        cntl |= CANCNTL_IE | CANCNTL_SIE | CANCNTL_EIE;
+    }
+    LPC_C_CAN0->CANCNTL = cntl;
     // Take it out of reset...
     can_enable(obj);
 
@@ -450,21 +623,39 @@ int can_write(can_t *obj, CAN_Message msg, int cc) {
     // Make sure controller is enabled
     can_enable(obj);
 
-    // Find first message object that isn't pending to send
-    uint16_t msgnum = 0;
-    uint32_t txPending = (LPC_C_CAN0->CANTXREQ1 & 0xFF) | (LPC_C_CAN0->CANTXREQ2 << 16);
-    uint16_t i = 0;
-    for(i = RX_MSG_OBJ_COUNT; i < 32; i++) {
-        if ((txPending & (1 << i)) == 0) {
-            msgnum = i+1;
+    // can_read_all uses IF1 from the CAN interrupt, and the TX handler may
+    // write too, so pick the object with interrupts off
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // The controller sends pending objects lowest number first, whatever
+    // their IDs, so keep them in arbitration order: use the object right
+    // after the last pending frame that ranks the same or better. Equal IDs
+    // stay in FIFO order. If that object still holds a frame that ranks
+    // worse, turn this one down, so it waits in the caller's queue for the
+    // lowest object to free up instead of going out behind the whole pool.
+    // Once the last object is pending the pool has to drain before frames
+    // that rank the same or worse can follow.
+    uint32_t rank = can_tx_rank(&msg);
+    uint32_t txPending = can_tx_pending();
+    uint32_t bit = RX_MSG_OBJ_COUNT;
+    uint32_t pending = txPending;
+    while (pending != 0) {
+        uint32_t highest = 31 - __CLZ(pending);
+        if (tx_rank[highest - RX_MSG_OBJ_COUNT] <= rank) {
+            bit = highest + 1;
             break;
         }
+        pending &= ~(1UL << highest);
     }
 
     // If no messageboxes are available, stop and return failure
-    if (msgnum == 0) {
+    if (bit > 31 || (txPending & (1UL << bit)) != 0) {
+        __set_PRIMASK(primask);
         return 0;
     }
+    uint16_t msgnum = bit + 1;
+    tx_rank[bit - RX_MSG_OBJ_COUNT] = rank;
 
     // Make sure the interface is available
     while ( LPC_C_CAN0->CANIF1_CMDREQ & CANIFn_CMDREQ_BUSY );
@@ -504,6 +695,8 @@ int can_write(can_t *obj, CAN_Message msg, int cc) {
     // Wait until transfer to message ram complete - TODO: maybe not block??
     while ( LPC_C_CAN0->CANIF1_CMDREQ & CANIFn_CMDREQ_BUSY);
 
+    __set_PRIMASK(primask);
+
     // Wait until TXOK is set, then clear it - TODO: maybe not block
     //while ( !(LPC_C_CAN0->STAT & CANSTAT_TXOK) );
     LPC_C_CAN0->CANSTAT &= ~(1UL << 3);
@@ -512,61 +705,20 @@ int can_write(can_t *obj, CAN_Message msg, int cc) {
 }
 
 int can_read(can_t *obj, CAN_Message *msg, int handle) {
-    uint16_t i;
-
     // Make sure controller is enabled
     can_enable(obj);
 
     // Find first message object with new data
     if (handle == 0) {
-        uint32_t newdata = LPC_C_CAN0->CANND1 | (LPC_C_CAN0->CANND2 << 16);
-        // Find first free messagebox
-        for (i = 0; i < RX_MSG_OBJ_COUNT; i++) {
-            if (newdata & (1 << i)) {
-                handle = i+1;
-                break;
-            }
+        uint32_t newdata = can_rx_pending();
+        if (newdata != 0) {
+            handle = __CLZ(__RBIT(newdata)) + 1;
         }
     }
 
     if (handle > 0 && handle <= 32) {
-        // Wait until message interface is free
-        while ( LPC_C_CAN0->CANIF2_CMDREQ & CANIFn_CMDREQ_BUSY );
-
-        // Transfer all fields to message object
-        LPC_C_CAN0->CANIF2_CMDMSK_W = CANIFn_CMDMSK_RD | CANIFn_CMDMSK_MASK | CANIFn_CMDMSK_ARB | CANIFn_CMDMSK_CTRL | CANIFn_CMDMSK_CLRINTPND | CANIFn_CMDMSK_TXRQST | CANIFn_CMDMSK_DATA_A | CANIFn_CMDMSK_DATA_B;
-
-        // Start Transfer from given message number
-        LPC_C_CAN0->CANIF2_CMDREQ = (handle & 0x3F);
-
-        // Wait until transfer to message ram complete
-        while ( LPC_C_CAN0->CANIF2_CMDREQ & CANIFn_CMDREQ_BUSY );
-
-        if (LPC_C_CAN0->CANIF2_ARB2 & CANIFn_ARB2_XTD) {
-            msg->format = CANExtended;
-            msg->id = (LPC_C_CAN0->CANIF2_ARB1 & 0x1FFF) << 16;
-            msg->id |= (LPC_C_CAN0->CANIF2_ARB2 & 0x1FFF);
-        } else {
-            msg->format = CANStandard;
-            msg->id = (LPC_C_CAN0->CANIF2_ARB2 & 0x1FFF) >> 2;
-        }
-
-       if (LPC_C_CAN0->CANIF2_ARB2 & CANIFn_ARB2_DIR) {
-            msg->type   = CANRemote;
-        }
-        else {
-            msg->type   = CANData;
-        }
-
-        msg->len        = (LPC_C_CAN0->CANIF2_MCTRL & 0xF); // TODO: If > 8, len = 8
-        msg->data[0]    = ((LPC_C_CAN0->CANIF2_DA1 >> 0) & 0xFF);
-        msg->data[1]    = ((LPC_C_CAN0->CANIF2_DA1 >> 8) & 0xFF);
-        msg->data[2]    = ((LPC_C_CAN0->CANIF2_DA2 >> 0) & 0xFF);
-        msg->data[3]    = ((LPC_C_CAN0->CANIF2_DA2 >> 8) & 0xFF);
-        msg->data[4]    = ((LPC_C_CAN0->CANIF2_DB1 >> 0) & 0xFF);
-        msg->data[5]    = ((LPC_C_CAN0->CANIF2_DB1 >> 8) & 0xFF);
-        msg->data[6]    = ((LPC_C_CAN0->CANIF2_DB2 >> 0) & 0xFF);
-        msg->data[7]    = ((LPC_C_CAN0->CANIF2_DB2 >> 8) & 0xFF);
+        can_if_start_read(CAN_IF2, handle);
+        can_if_finish_read(CAN_IF2, handle, msg);
 
         LPC_C_CAN0->CANSTAT &= ~(1UL << 4);
         return 1;
@@ -574,22 +726,72 @@ int can_read(can_t *obj, CAN_Message *msg, int handle) {
     return 0;
 }
 
-CanTxState can_tx_status(can_t *obj) {
-    // Count how many message boxes are available
-    uint32_t txPending = (LPC_C_CAN0->CANTXREQ1 & 0xFF) | (LPC_C_CAN0->CANTXREQ2 << 16);
-    int i = 0;
+/* Read every pending received frame, up to max, in one pass.
+ *
+ * The new data bitmap is read once and walked lowest object first. Reads
+ * alternate between IF2 and IF1, so the controller copies the next object
+ * into one interface while the previous one is unpacked from the other.
+ * Each transfer also clears the object's NEWDAT and INTPND bits. Objects
+ * that were overwritten before being read are counted for can_rx_lost.
+ *
+ * IF1 is shared with can_write, so call this from the CAN interrupt or
+ * with interrupts disabled.
+ */
+int can_read_all(can_t *obj, CAN_Message *msgs, int max) {
+    can_if_t *interfaces[2] = { CAN_IF2, CAN_IF1 };
     int count = 0;
-    if (txPending != 0) {
-        for(i = RX_MSG_OBJ_COUNT; i < 32; i++) {
-            if ((txPending & (1 << i)) != 0) {
-                count++;
+
+    // Make sure controller is enabled
+    can_enable(obj);
+
+    uint32_t pending;
+    while (count < max && (pending = can_rx_pending()) != 0) {
+        uint32_t msgnums[2];
+        int current = 0;
+        msgnums[current] = __CLZ(__RBIT(pending)) + 1;
+        can_if_start_read(interfaces[current], msgnums[current]);
+        pending &= pending - 1;
+
+        while (1) {
+            // Queue the next object on the other interface before unpacking
+            int more = (pending != 0) && (count + 1 < max);
+            if (more) {
+                msgnums[current ^ 1] = __CLZ(__RBIT(pending)) + 1;
+                can_if_start_read(interfaces[current ^ 1], msgnums[current ^ 1]);
+                pending &= pending - 1;
+            }
+
+            can_if_finish_read(interfaces[current], msgnums[current], &msgs[count++]);
+
+            if (!more) {
+                break;
             }
+            current ^= 1;
         }
     }
 
-    if (count == 0) {
+    LPC_C_CAN0->CANSTAT &= ~CANSTAT_RXOK;
+    return count;
+}
+
+int can_rx_lost(can_t *obj) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    int lost = rx_lost;
+    rx_lost = 0;
+    __set_PRIMASK(primask);
+    return lost;
+}
+
+CanTxState can_tx_status(can_t *obj) {
+    // can_write also turns a frame down when the object it needs still
+    // holds one that ranks worse, but the pool is only full once every
+    // object is pending
+    uint32_t txPending = can_tx_pending();
+
+    if (txPending == 0) {
         return TX_STATE_IDLE;
-    } else if (count == TX_MSG_OBJ_COUNT) {
+    } else if (txPending == (uint32_t)TX_MSG_OBJ_MASK) {
         return TX_STATE_BUSY;
     } else {
         return TX_STATE_AVAILABLE;
@@ -0,0 +1,34 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_CAN_MSG_OBJ_H
+#define MBED_CAN_MSG_OBJ_H
+
+/* Split of the 32 C_CAN message objects between receive and transmit.
+ * Override CAN_TX_MSG_OBJ_COUNT from the build settings to resize the
+ * transmit pool; message objects 1..CAN_RX_MSG_OBJ_COUNT receive and the
+ * remaining ones transmit. Code that programs receive objects itself
+ * (e.g. CANFilterPlan) includes this header so it sees the same split. */
+#ifndef CAN_TX_MSG_OBJ_COUNT
+#define CAN_TX_MSG_OBJ_COUNT 8
+#endif
+
+#if (CAN_TX_MSG_OBJ_COUNT < 1) || (CAN_TX_MSG_OBJ_COUNT > 31)
+#error "CAN_TX_MSG_OBJ_COUNT must be between 1 and 31"
+#endif
+
+#define CAN_RX_MSG_OBJ_COUNT (32 - CAN_TX_MSG_OBJ_COUNT)
+
+#endif
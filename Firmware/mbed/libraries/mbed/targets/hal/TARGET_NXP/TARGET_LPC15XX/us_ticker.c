@@ -19,8 +19,53 @@
 
 #define US_TICKER_TIMER_IRQn     RIT_IRQn
 
+// The RIT counter is 48 bits wide
+#define RIT_COUNTER_MASK         0xFFFFFFFFFFFFULL
+
+// Counts become microseconds as count * reciprocal >> RECIPROCAL_SHIFT with
+// reciprocal = ceil(2^RECIPROCAL_SHIFT / ticks per us). With the shift at
+// 48 + 7 bits this equals count / (ticks per us) for every 48-bit count, as
+// long as there are at most 128 ticks per us (the LPC15XX tops out at 72).
+#define RECIPROCAL_SHIFT         55
+
 int us_ticker_inited = 0;
 
+static uint32_t ticker_clock;
+static uint32_t ticks_per_us;
+static uint32_t reciprocal_lo;
+static uint32_t reciprocal_hi;
+
+static void us_ticker_calibrate(void) {
+    ticker_clock = SystemCoreClock;
+    ticks_per_us = ticker_clock / 1000000;
+
+    // The only division, once per clock change
+    uint64_t reciprocal = ((1ULL << RECIPROCAL_SHIFT) + ticks_per_us - 1) / ticks_per_us;
+    reciprocal_lo = (uint32_t)reciprocal;
+    reciprocal_hi = (uint32_t)(reciprocal >> 32);
+}
+
+static inline uint64_t rit_count(void) {
+    // The halves are separate registers; read again if the low word
+    // wrapped in between
+    uint32_t high, low;
+    do {
+        high = LPC_RIT->COUNTER_H;
+        low = LPC_RIT->COUNTER;
+    } while (LPC_RIT->COUNTER_H != high);
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline us_timestamp_t ticks_to_us(uint64_t count) {
+    // (count * reciprocal) >> 55, from 32x32 bit multiplies
+    uint32_t high = (uint32_t)(count >> 32);
+    uint32_t low = (uint32_t)count;
+    uint64_t mid = (uint64_t)high * reciprocal_lo + (uint64_t)low * reciprocal_hi
+            + (((uint64_t)low * reciprocal_lo) >> 32);
+    uint64_t top = (uint64_t)high * reciprocal_hi + (uint32_t)(mid >> 32);
+    return (top << (64 - RECIPROCAL_SHIFT)) | ((uint32_t)mid >> (RECIPROCAL_SHIFT - 32));
+}
+
 void us_ticker_init(void) {
     if (us_ticker_inited) return;
     us_ticker_inited = 1;
@@ -43,6 +88,8 @@ void us_ticker_init(void) {
 
     // Timer enable, enable for debug
     LPC_RIT->CTRL = 0xC;
+
+    us_ticker_calibrate();
     
     NVIC_SetVector(US_TICKER_TIMER_IRQn, (uint32_t)us_ticker_irq_handler);
     NVIC_EnableIRQ(US_TICKER_TIMER_IRQn);
@@ -52,16 +99,41 @@ uint32_t us_ticker_read() {
     if (!us_ticker_inited)
         us_ticker_init();
     
-    uint64_t temp;
-    temp = LPC_RIT->COUNTER | ((uint64_t)LPC_RIT->COUNTER_H << 32);
-    temp /= (SystemCoreClock/1000000);
-    return (uint32_t)temp;
+    if (ticker_clock != SystemCoreClock)
+        us_ticker_calibrate();
+
+    return (uint32_t)ticks_to_us(rit_count());
+}
+
+us_timestamp_t us_ticker_read_64(void) {
+    if (!us_ticker_inited)
+        us_ticker_init();
+    if (ticker_clock != SystemCoreClock)
+        us_ticker_calibrate();
+
+    // Straight from the 48-bit counter, so it needs no state or locking.
+    // At 72 MHz the counter itself wraps after 45 days.
+    return ticks_to_us(rit_count());
 }
 
 void us_ticker_set_interrupt(timestamp_t timestamp) {
-	uint64_t temp = ((uint64_t)timestamp * (SystemCoreClock/1000000));
-    LPC_RIT->COMPVAL = (temp & 0xFFFFFFFFL);
-    LPC_RIT->COMPVAL_H = ((temp >> 32)& 0x0000FFFFL);
+    // The timestamp is the low 32 bits of the time in us; place it relative
+    // to the current count, as the counter runs on past 2^32 us
+    uint64_t now = rit_count();
+    int32_t delta = (int32_t)(timestamp - (uint32_t)ticks_to_us(now));
+    if (delta <= 0) {
+        NVIC_SetPendingIRQ(US_TICKER_TIMER_IRQn);
+        return;
+    }
+
+    uint64_t target = (now + (uint64_t)delta * ticks_per_us) & RIT_COUNTER_MASK;
+    LPC_RIT->COMPVAL = (uint32_t)target;
+    LPC_RIT->COMPVAL_H = (uint32_t)(target >> 32);
+
+    // The match is on equality: if the counter already went past, it would
+    // not come round again for days
+    if (((rit_count() - target) & RIT_COUNTER_MASK) < (RIT_COUNTER_MASK >> 1))
+        NVIC_SetPendingIRQ(US_TICKER_TIMER_IRQn);
 }
 
 void us_ticker_disable_interrupt(void) {
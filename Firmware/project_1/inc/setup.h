@@ -9,7 +9,8 @@
 #ifndef MBED15X9_SKELETON_SETUP_H_
 #define MBED15X9_SKELETON_SETUP_H_
 
-//how often to check if the CAN controller is working
+//how often to check if the CAN controller is working; bus-off is handled
+//from the CAN interrupt, this only catches a missed interrupt
 #define CHECK_CAN_RATE_US 500000
 
 //how long without a feed for watch dog timer to trigger a reset
@@ -0,0 +1,50 @@
+/*
+ * can.cpp
+ *
+ * Controller behind the host CAN class in mbed.h.
+ */
+
+#include <mbed.h>
+
+CAN::CAN() : next(0), waiting(0), sentFrames(0) {
+	for (int i = 0; i < PATTERN; i++) {
+		frames[i].id = 0x470 + i;
+		frames[i].len = 8;
+		for (int b = 0; b < 8; b++)
+			frames[i].data[b] = (unsigned char)(i * 8 + b);
+	}
+}
+
+int CAN::read(CANMessage& msg, int handle) {
+	(void)handle;
+	if (waiting == 0)
+		return 0;
+	msg = frames[next];
+	next = (next + 1) % PATTERN;
+	waiting--;
+	return 1;
+}
+
+int CAN::read(CANMessage* msgs, int max) {
+	int count = 0;
+	while (count < max && waiting > 0) {
+		msgs[count++] = frames[next];
+		next = (next + 1) % PATTERN;
+		waiting--;
+	}
+	return count;
+}
+
+int CAN::write(CANMessage msg) {
+	(void)msg;
+	sentFrames++;
+	return 1;
+}
+
+CAN::TxStatus CAN::txstatus() {
+	return Idle;
+}
+
+int CAN::rxLost() {
+	return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * can_port.cpp
+ *
+ * CANPort over a CANRXTXBuffer, with the bodies of hardware_common_mbed.
+ */
+
+#include "can_port.h"
+
+#include <can_buffer.h>
+#include <limits.h>
+
+class CANPortMbed : public CANPort {
+public:
+	explicit CANPortMbed(CAN& can) : canBuffer(can) {}
+
+	virtual void handleCANMessage() {
+		canBuffer.handleIrq();
+	}
+
+	virtual int readCANMessage(CANMessage& msg) {
+		return canBuffer.read(msg) != 1; // 1=failure
+	}
+
+	virtual size_t readCANMessages(CANMessage* msgs, size_t max) {
+		return canBuffer.read(msgs, max > INT_MAX ? INT_MAX : (int)max);
+	}
+
+	virtual int writeCANMessage(const CANMessage& msg) {
+		return canBuffer.write(msg) != 1; // 1=failure
+	}
+
+	virtual size_t writeCANMessages(const CANMessage* msgs, size_t count) {
+		return canBuffer.write(msgs, count > INT_MAX ? INT_MAX : (int)count);
+	}
+
+private:
+	CANRXTXBuffer<32, 16> canBuffer;
+};
+
+CANPort* newCANPort(CAN& can) {
+	return new CANPortMbed(can);
+}
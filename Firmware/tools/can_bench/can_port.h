@@ -0,0 +1,41 @@
+/*
+ * can_port.h
+ * The CAN calls of hardware_common, for timing them without the rest of a
+ * board.
+ */
+
+#ifndef TOOLS_CAN_BENCH_CAN_PORT_H_
+#define TOOLS_CAN_BENCH_CAN_PORT_H_
+
+#include <mbed.h>
+
+/** The CAN part of hardware_common, with the same virtual calls */
+class CANPort {
+public:
+	virtual ~CANPort() {}
+
+	/** The CAN interrupt handler */
+	virtual void handleCANMessage() = 0;
+
+	/** @return 0 on success, 1 on failure */
+	virtual int readCANMessage(CANMessage& msg) = 0;
+
+	/** @return number of messages read, 0 if none are waiting */
+	virtual size_t readCANMessages(CANMessage* msgs, size_t max) = 0;
+
+	/** @return 0 on success, 1 on failure */
+	virtual int writeCANMessage(const CANMessage& msg) = 0;
+
+	/** @return number of messages written, from the start of msgs */
+	virtual size_t writeCANMessages(const CANMessage* msgs, size_t count) = 0;
+};
+
+/**
+ * A CANPort forwarding to a CANRXTXBuffer<32, 16>, as hardware_common_mbed
+ * does. It is built in can_port.cpp, so calls through it stay virtual.
+ * @param can controller behind the buffer
+ * @return new port, to be deleted by the caller
+ */
+CANPort* newCANPort(CAN& can);
+
+#endif /* TOOLS_CAN_BENCH_CAN_PORT_H_ */
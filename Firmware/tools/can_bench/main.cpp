@@ -0,0 +1,346 @@
+/*
+ * main.cpp
+ *
+ * can_bench: time the CAN buffers' receive and transmit paths per frame on
+ * the host.
+ *
+ * Usage: can_bench rx [-n framesPerIrq] [-r rounds]
+ *        can_bench batch [-n framesPerIrq] [-r rounds]
+ */
+
+#include <mbed.h>
+#include <can_buffer.h>
+#include "can_port.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static const char* const UNIT = "TSC cycles";
+
+static inline uint64_t ticks() {
+	return __rdtsc();
+}
+#else
+static const char* const UNIT = "ns";
+
+static inline uint64_t ticks() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+static const int RX_SIZE = 32;
+static const int REPEATS = 5;
+
+// Work done on every received frame, kept so it cannot be optimised away
+static volatile uint32_t sink;
+
+static inline void handle(const CANMessage& msg) {
+	sink = sink + msg.id + msg.data[7];
+}
+
+// Cost of reading the clock twice, taken off every measurement
+static uint64_t clockOverhead() {
+	uint64_t best = UINT64_MAX;
+	for (int i = 0; i < 10000; i++) {
+		uint64_t begin = ticks();
+		uint64_t end = ticks();
+		if (end - begin < best)
+			best = end - begin;
+	}
+	return best;
+}
+
+/*
+ * CircularBuffer as it was before claim/commit: elements go in and come
+ * out by value.
+ */
+template <class T, int N>
+class CopyingCircularBuffer {
+public:
+	CopyingCircularBuffer() : start(0), end(0) {}
+
+	bool full() const {
+		return (this->end + 1) % N == this->start;
+	}
+
+	bool empty() const {
+		return this->start == this->end;
+	}
+
+	void write(T s) {
+		this->buffer[this->end] = s;
+		this->end = (this->end + 1) % N;
+	}
+
+	T read() {
+		T s = this->buffer[this->start];
+		this->start = (this->start + 1) % N;
+		return s;
+	}
+
+private:
+	T buffer[N];
+	volatile int start;
+	volatile int end;
+};
+
+/*
+ * CANRXBuffer's receive path before claim/commit: each frame is read into
+ * a local, copied into the ring and copied out again.
+ */
+template <int RXSize>
+class CopyingRXBuffer {
+public:
+	CopyingRXBuffer(CAN& can, int handle=0) : can(can), handle(handle) {}
+
+	int read(CANMessage& msg) {
+		int messageValid = 0;
+		if (!rxBuffer.empty()) {
+			msg = rxBuffer.read();
+			messageValid = 1;
+		}
+		return messageValid;
+	}
+
+	void handleIrq() {
+		CANMessage msg;
+		while (can.read(msg, handle) && !rxBuffer.full()) {
+			rxBuffer.write(msg);
+		}
+	}
+
+private:
+	CopyingCircularBuffer<CANMessage, RXSize> rxBuffer;
+	CAN& can;
+	const int handle;
+};
+
+/** Interrupt and main loop time of one way of receiving, per frame */
+struct RxResult {
+	double irq;
+	double loop;
+};
+
+/*
+ * Run rounds of: framesPerIrq frames arrive, the IRQ handler moves them
+ * into the buffer, the main loop handles them. Best of REPEATS runs.
+ */
+template <class Path>
+static RxResult timeRx(Path& path, CAN& can, int framesPerIrq, int rounds, uint64_t overhead) {
+	RxResult best = { 1e30, 1e30 };
+	for (int repeat = 0; repeat < REPEATS; repeat++) {
+		uint64_t irqTicks = 0;
+		uint64_t loopTicks = 0;
+		for (int round = 0; round < rounds; round++) {
+			can.arrive(framesPerIrq);
+			uint64_t begin = ticks();
+			path.irq();
+			uint64_t middle = ticks();
+			path.loop();
+			uint64_t end = ticks();
+			irqTicks += middle - begin - overhead;
+			loopTicks += end - middle - overhead;
+		}
+		double frames = (double)rounds * framesPerIrq;
+		if (irqTicks / frames + loopTicks / frames < best.irq + best.loop) {
+			best.irq = irqTicks / frames;
+			best.loop = loopTicks / frames;
+		}
+	}
+	return best;
+}
+
+struct CopyingPath {
+	CopyingRXBuffer<RX_SIZE> buffer;
+
+	explicit CopyingPath(CAN& can) : buffer(can) {}
+
+	void irq() { buffer.handleIrq(); }
+
+	void loop() {
+		CANMessage msg;
+		while (buffer.read(msg))
+			handle(msg);
+	}
+};
+
+struct ClaimReadPath {
+	CANRXBuffer<RX_SIZE> buffer;
+
+	explicit ClaimReadPath(CAN& can) : buffer(can) {}
+
+	void irq() { buffer.handleIrq(); }
+
+	void loop() {
+		CANMessage msg;
+		while (buffer.read(msg))
+			handle(msg);
+	}
+};
+
+struct ClaimPeekPath {
+	CANRXBuffer<RX_SIZE> buffer;
+
+	explicit ClaimPeekPath(CAN& can) : buffer(can) {}
+
+	void irq() { buffer.handleIrq(); }
+
+	void loop() {
+		const CANMessage* msg;
+		while ((msg = buffer.peek()) != NULL) {
+			handle(*msg);
+			buffer.consume();
+		}
+	}
+};
+
+static void printRx(const char* name, const RxResult& result, const RxResult& before) {
+	double total = result.irq + result.loop;
+	printf("%-28s %8.1f %8.1f %8.1f %9.0f %%\n", name, result.irq, result.loop, total,
+			(before.irq + before.loop) / total * 100);
+}
+
+static int runRx(int framesPerIrq, int rounds) {
+	uint64_t overhead = clockOverhead();
+	CAN can;
+
+	CopyingPath copying(can);
+	ClaimReadPath claimRead(can);
+	ClaimPeekPath claimPeek(can);
+	RxResult before = timeRx(copying, can, framesPerIrq, rounds, overhead);
+	RxResult afterRead = timeRx(claimRead, can, framesPerIrq, rounds, overhead);
+	RxResult afterPeek = timeRx(claimPeek, can, framesPerIrq, rounds, overhead);
+
+	printf("%d frames per interrupt, %d rounds, best of %d, %s per frame\n\n", framesPerIrq, rounds, REPEATS, UNIT);
+	printf("receive path                      irq     loop    total  vs before\n");
+	printRx("before: copy in, read()", before, before);
+	printRx("claim/commit, read()", afterRead, before);
+	printRx("claim/commit, peek/consume", afterPeek, before);
+	return 0;
+}
+
+/*
+ * Best of REPEATS runs of rounds calls to timeRound, which returns the
+ * ticks its timed part took; per frame.
+ */
+template <class Round>
+static double timeRounds(Round timeRound, int framesPerIrq, int rounds) {
+	double best = 1e30;
+	for (int repeat = 0; repeat < REPEATS; repeat++) {
+		uint64_t total = 0;
+		for (int round = 0; round < rounds; round++)
+			total += timeRound();
+		double perFrame = total / ((double)rounds * framesPerIrq);
+		if (perFrame < best)
+			best = perFrame;
+	}
+	return best;
+}
+
+static void printBatch(const char* name, double perFrame, double batched) {
+	printf("%-6s %10.1f %10.1f %9.0f %%\n", name, perFrame, batched, perFrame / batched * 100);
+}
+
+static int runBatch(int framesPerIrq, int rounds) {
+	uint64_t overhead = clockOverhead();
+	CAN can;
+	CANPort* port = newCANPort(can);
+	CANMessage msgs[RX_SIZE];
+	CANMessage out[RX_SIZE];
+	for (int i = 0; i < framesPerIrq; i++) {
+		out[i].id = 0x300 + i;
+		out[i].len = 8;
+	}
+
+	// One virtual call per frame, and one more that finds the buffer empty
+	double readOne = timeRounds([&]() {
+		can.arrive(framesPerIrq);
+		port->handleCANMessage();
+		uint64_t begin = ticks();
+		CANMessage msg;
+		while (port->readCANMessage(msg) == 0)
+			handle(msg);
+		return ticks() - begin - overhead;
+	}, framesPerIrq, rounds);
+
+	double readBatch = timeRounds([&]() {
+		can.arrive(framesPerIrq);
+		port->handleCANMessage();
+		uint64_t begin = ticks();
+		size_t count = port->readCANMessages(msgs, RX_SIZE);
+		for (size_t i = 0; i < count; i++)
+			handle(msgs[i]);
+		return ticks() - begin - overhead;
+	}, framesPerIrq, rounds);
+
+	double writeOne = timeRounds([&]() {
+		uint64_t begin = ticks();
+		for (int i = 0; i < framesPerIrq; i++)
+			port->writeCANMessage(out[i]);
+		return ticks() - begin - overhead;
+	}, framesPerIrq, rounds);
+
+	double writeBatch = timeRounds([&]() {
+		uint64_t begin = ticks();
+		port->writeCANMessages(out, framesPerIrq);
+		return ticks() - begin - overhead;
+	}, framesPerIrq, rounds);
+
+	uint64_t expected = (uint64_t)2 * REPEATS * rounds * framesPerIrq;
+	delete port;
+
+	printf("%d frames per call, %d rounds, best of %d, %s per frame\n\n", framesPerIrq, rounds, REPEATS, UNIT);
+	printf("        per frame    batched  batch speed\n");
+	printBatch("read", readOne, readBatch);
+	printBatch("write", writeOne, writeBatch);
+	if (can.sent() != expected) {
+		printf("%llu frames sent, expected %llu\n", (unsigned long long)can.sent(), (unsigned long long)expected);
+		return 1;
+	}
+	return 0;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: can_bench rx|batch [-n framesPerIrq] [-r rounds]\n");
+	fprintf(stderr, "  rx     receive path before and after claim/commit\n");
+	fprintf(stderr, "  batch  hardware_common's per-frame and batched CAN calls\n");
+	fprintf(stderr, "  -n  frames per interrupt and per batch, 1 to %d (default 8)\n", RX_SIZE - 1);
+	fprintf(stderr, "  -r  interrupts per run (default 200000)\n");
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		usage();
+		return 2;
+	}
+	const char* mode = argv[1];
+	int framesPerIrq = 8;
+	int rounds = 200000;
+	for (int arg = 2; arg < argc; arg++) {
+		if (arg + 1 < argc && strcmp(argv[arg], "-n") == 0) {
+			framesPerIrq = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-r") == 0) {
+			rounds = atoi(argv[++arg]);
+		} else {
+			usage();
+			return 2;
+		}
+	}
+	if (framesPerIrq < 1 || framesPerIrq >= RX_SIZE || rounds < 1) {
+		usage();
+		return 2;
+	}
+
+	if (strcmp(mode, "rx") == 0)
+		return runRx(framesPerIrq, rounds);
+	if (strcmp(mode, "batch") == 0)
+		return runBatch(framesPerIrq, rounds);
+	usage();
+	return 2;
+}
@@ -0,0 +1,78 @@
+/*
+ * mbed.h
+ * Host replacement for the parts of mbed the CAN buffers use, with a CAN
+ * controller that always has frames waiting, so can_bench times the
+ * buffers rather than a bus.
+ */
+
+#ifndef TOOLS_CAN_BENCH_MBED_H_
+#define TOOLS_CAN_BENCH_MBED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <can_lite.h>
+
+// Nothing runs concurrently in the benchmark
+static inline void __disable_irq() {}
+static inline void __enable_irq() {}
+static inline uint32_t __get_PRIMASK() { return 0; }
+static inline void __set_PRIMASK(uint32_t) {}
+
+/** mbed CAN on a controller fed by the benchmark
+ *
+ *  arrive() makes frames wait in the controller; read() hands them out in
+ *  turn from a fixed set. write() always finds a free transmit object.
+ *  The calls are defined in can.cpp, so like the mbed library's they are
+ *  real calls the buffers cannot inline.
+ */
+class CAN {
+public:
+	enum TxStatus {
+		Idle = 0,
+		Available,
+		Busy
+	};
+
+	CAN();
+
+	/**
+	 * @param count frames that arrive in the controller
+	 */
+	void arrive(int count) { waiting += count; }
+
+	/**
+	 * @param handle ignored, every frame matches
+	 * @return 1 if a frame was read, 0 if none was waiting
+	 */
+	int read(CANMessage& msg, int handle = 0);
+
+	/**
+	 * @return number of frames read, up to max
+	 */
+	int read(CANMessage* msgs, int max);
+
+	/**
+	 * @return 1, the frame is always taken
+	 */
+	int write(CANMessage msg);
+
+	TxStatus txstatus();
+	int rxLost();
+
+	/**
+	 * @return frames taken by write()
+	 */
+	uint64_t sent() const { return sentFrames; }
+
+private:
+	static const int PATTERN = 16;
+
+	CANMessage frames[PATTERN];
+	int next;
+	int waiting;
+	uint64_t sentFrames;
+};
+
+#endif /* TOOLS_CAN_BENCH_MBED_H_ */
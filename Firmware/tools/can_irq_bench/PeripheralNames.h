@@ -0,0 +1,9 @@
+/*
+ * PeripheralNames.h
+ * Host replacement for the LPC15XX peripheral names; can_api.c uses none.
+ */
+
+#ifndef TOOLS_CAN_IRQ_BENCH_PERIPHERALNAMES_H_
+#define TOOLS_CAN_IRQ_BENCH_PERIPHERALNAMES_H_
+
+#endif /* TOOLS_CAN_IRQ_BENCH_PERIPHERALNAMES_H_ */
@@ -0,0 +1,12 @@
+/*
+ * PinNames.h
+ * Host replacement for the LPC15XX pin names; can_init() only passes the
+ * pins on to the switch matrix.
+ */
+
+#ifndef TOOLS_CAN_IRQ_BENCH_PINNAMES_H_
+#define TOOLS_CAN_IRQ_BENCH_PINNAMES_H_
+
+typedef int PinName;
+
+#endif /* TOOLS_CAN_IRQ_BENCH_PINNAMES_H_ */
@@ -0,0 +1,285 @@
+/*
+ * c_can_model.cpp
+ * Register-level model of the LPC15XX C_CAN controller.
+ */
+
+#include "c_can_model.h"
+#include "cmsis.h"
+
+#include <string.h>
+
+LPC_C_CAN0_Type hostCCAN0;
+LPC_SYSCON_Type hostSYSCON;
+LPC_SWM_Type hostSWM;
+uint32_t SystemCoreClock = 72000000;
+
+// Register numbers, in the order of LPC_C_CAN0_Type
+enum {
+	REG_CNTL, REG_STAT, REG_EC, REG_BT, REG_INT, REG_TEST, REG_BRPE,
+	REG_IF1, REG_IF2 = REG_IF1 + 11,
+	REG_TXREQ1 = REG_IF2 + 11, REG_TXREQ2, REG_ND1, REG_ND2, REG_MSGV1, REG_MSGV2,
+	REG_CLKDIV
+};
+
+// Register offsets within a message interface
+enum {
+	IF_CMDREQ, IF_CMDMSK, IF_MSK1, IF_MSK2, IF_ARB1, IF_ARB2, IF_MCTRL, IF_DATA
+};
+
+static const uint32_t CNTL_SIE = 1UL << 2;
+static const uint32_t STAT_RXOK = 1UL << 4;
+static const uint32_t CMDREQ_BUSY = 1UL << 15;
+static const uint32_t CMDMSK_DATA_B = 1UL << 0;
+static const uint32_t CMDMSK_DATA_A = 1UL << 1;
+static const uint32_t CMDMSK_TXRQST_NEWDAT = 1UL << 2;
+static const uint32_t CMDMSK_CLRINTPND = 1UL << 3;
+static const uint32_t CMDMSK_CTRL = 1UL << 4;
+static const uint32_t CMDMSK_ARB = 1UL << 5;
+static const uint32_t CMDMSK_MASK = 1UL << 6;
+static const uint32_t CMDMSK_WR = 1UL << 7;
+static const uint32_t ARB2_DIR = 1UL << 13;
+static const uint32_t ARB2_XTD = 1UL << 14;
+static const uint32_t ARB2_MSGVAL = 1UL << 15;
+static const uint32_t ARB2_STD_ID = 0x1FFC;
+static const uint32_t MCTRL_DLC = 0x0F;
+static const uint32_t MCTRL_TXRQST = 1UL << 8;
+static const uint32_t MCTRL_RXIE = 1UL << 10;
+static const uint32_t MCTRL_UMASK = 1UL << 12;
+static const uint32_t MCTRL_INTPND = 1UL << 13;
+static const uint32_t MCTRL_MSGLST = 1UL << 14;
+static const uint32_t MCTRL_NEWDAT = 1UL << 15;
+
+namespace CCANRegisters {
+
+static int number(const Register* reg) {
+	return reg - &hostCCAN0.CANCNTL;
+}
+
+Register::operator ::uint32_t() const {
+	return CCANModel::instance().read(number(this));
+}
+
+Register& Register::operator=(::uint32_t value) {
+	CCANModel::instance().write(number(this), value);
+	return *this;
+}
+
+} // end namespace CCANRegisters
+
+CCANModel& CCANModel::instance() {
+	static CCANModel model;
+	return model;
+}
+
+CCANModel::CCANModel() :
+		cntl(1), stat(0), test(0), bt(0), brpe(0), clkdiv(0),
+		statusInterrupt(false), overwrites(0),
+		accessCycles(3), transferCycles(12), now(0), ramFreeAt(0) {
+	memset(objects, 0, sizeof(objects));
+	memset(interfaces, 0, sizeof(interfaces));
+	clearCounts();
+}
+
+void CCANModel::setTiming(uint32_t accessCycles, uint32_t transferCycles) {
+	this->accessCycles = accessCycles;
+	this->transferCycles = transferCycles;
+}
+
+void CCANModel::clearCounts() {
+	count.reads = 0;
+	count.writes = 0;
+	count.busyPolls = 0;
+	overwrites = 0;
+	now = 0;
+	ramFreeAt = 0;
+	interfaces[0].busyUntil = 0;
+	interfaces[1].busyUntil = 0;
+}
+
+bool CCANModel::receive(uint32_t id, uint8_t len, const uint8_t* data) {
+	uint32_t arb2 = (id << 2) & ARB2_STD_ID;
+	for (int i = 0; i < 32; i++) {
+		MessageObject& o = objects[i];
+		if ((o.arb2 & (ARB2_MSGVAL | ARB2_DIR | ARB2_XTD)) != ARB2_MSGVAL)
+			continue;
+		uint32_t mask = (o.mctrl & MCTRL_UMASK) ? (o.msk2 & ARB2_STD_ID) : ARB2_STD_ID;
+		if (((o.arb2 ^ arb2) & mask) != 0)
+			continue;
+
+		if (o.mctrl & MCTRL_NEWDAT) {
+			o.mctrl |= MCTRL_MSGLST;
+			overwrites++;
+		}
+		o.arb2 = (o.arb2 & ~ARB2_STD_ID) | arb2;
+		o.mctrl = (o.mctrl & ~MCTRL_DLC) | len | MCTRL_NEWDAT;
+		if (o.mctrl & MCTRL_RXIE)
+			o.mctrl |= MCTRL_INTPND;
+		for (int word = 0; word < 4; word++)
+			o.data[word] = data[word * 2] | (data[word * 2 + 1] << 8);
+
+		stat |= STAT_RXOK;
+		if (cntl & CNTL_SIE)
+			statusInterrupt = true;
+		return true;
+	}
+	return false;
+}
+
+// Move the fields CMDMSK selects between an interface and an object
+void CCANModel::transfer(Interface& ifn, uint32_t msgnum) {
+	uint64_t start = ramFreeAt > now ? ramFreeAt : now;
+	ramFreeAt = start + transferCycles;
+	ifn.busyUntil = ramFreeAt;
+	if (msgnum < 1 || msgnum > 32)
+		return;
+
+	MessageObject& o = objects[msgnum - 1];
+	uint32_t cmdmsk = ifn.cmdmsk;
+	if (cmdmsk & CMDMSK_WR) {
+		if (cmdmsk & CMDMSK_MASK) {
+			o.msk1 = ifn.msk1;
+			o.msk2 = ifn.msk2;
+		}
+		if (cmdmsk & CMDMSK_ARB) {
+			o.arb1 = ifn.arb1;
+			o.arb2 = ifn.arb2;
+		}
+		if (cmdmsk & CMDMSK_CTRL)
+			o.mctrl = ifn.mctrl;
+		if (cmdmsk & CMDMSK_TXRQST_NEWDAT)
+			o.mctrl |= MCTRL_TXRQST;
+		if (cmdmsk & CMDMSK_DATA_A) {
+			o.data[0] = ifn.data[0];
+			o.data[1] = ifn.data[1];
+		}
+		if (cmdmsk & CMDMSK_DATA_B) {
+			o.data[2] = ifn.data[2];
+			o.data[3] = ifn.data[3];
+		}
+	} else {
+		if (cmdmsk & CMDMSK_MASK) {
+			ifn.msk1 = o.msk1;
+			ifn.msk2 = o.msk2;
+		}
+		if (cmdmsk & CMDMSK_ARB) {
+			ifn.arb1 = o.arb1;
+			ifn.arb2 = o.arb2;
+		}
+		if (cmdmsk & CMDMSK_CTRL)
+			ifn.mctrl = o.mctrl;
+		if (cmdmsk & CMDMSK_DATA_A) {
+			ifn.data[0] = o.data[0];
+			ifn.data[1] = o.data[1];
+		}
+		if (cmdmsk & CMDMSK_DATA_B) {
+			ifn.data[2] = o.data[2];
+			ifn.data[3] = o.data[3];
+		}
+		if (cmdmsk & CMDMSK_CLRINTPND)
+			o.mctrl &= ~MCTRL_INTPND;
+		if (cmdmsk & CMDMSK_TXRQST_NEWDAT)
+			o.mctrl &= ~MCTRL_NEWDAT;
+	}
+}
+
+// CANINT: the status interrupt first, then the lowest object with INTPND
+uint32_t CCANModel::interruptId() const {
+	if (statusInterrupt)
+		return 0x8000;
+	for (int i = 0; i < 32; i++) {
+		if (objects[i].mctrl & MCTRL_INTPND)
+			return i + 1;
+	}
+	return 0;
+}
+
+// Half of a bitmap of objects, 0 for objects 1-16 and 1 for 17-32, with
+// the given MCTRL bits set, or the MSGVAL bit for a mask of 0
+uint32_t CCANModel::bitmap(uint32_t mask, int half) const {
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++) {
+		const MessageObject& o = objects[half * 16 + i];
+		if (mask == 0 ? (o.arb2 & ARB2_MSGVAL) != 0 : (o.mctrl & mask) != 0)
+			bits |= 1UL << i;
+	}
+	return bits;
+}
+
+uint32_t CCANModel::read(int reg) {
+	count.reads++;
+	now += accessCycles;
+
+	if (reg >= REG_IF1 && reg < REG_TXREQ1) {
+		Interface& ifn = interfaces[(reg - REG_IF1) / 11];
+		int field = (reg - REG_IF1) % 11;
+		switch (field) {
+		case IF_CMDREQ:
+			if (now < ifn.busyUntil) {
+				count.busyPolls++;
+				return ifn.cmdreq | CMDREQ_BUSY;
+			}
+			return ifn.cmdreq;
+		case IF_CMDMSK: return ifn.cmdmsk;
+		case IF_MSK1: return ifn.msk1;
+		case IF_MSK2: return ifn.msk2;
+		case IF_ARB1: return ifn.arb1;
+		case IF_ARB2: return ifn.arb2;
+		case IF_MCTRL: return ifn.mctrl;
+		default: return ifn.data[field - IF_DATA];
+		}
+	}
+
+	switch (reg) {
+	case REG_CNTL: return cntl;
+	case REG_STAT:
+		// Reading the status register acknowledges the status interrupt
+		statusInterrupt = false;
+		return stat;
+	case REG_INT: return interruptId();
+	case REG_TEST: return test;
+	case REG_BT: return bt;
+	case REG_BRPE: return brpe;
+	case REG_CLKDIV: return clkdiv;
+	case REG_TXREQ1: return bitmap(MCTRL_TXRQST, 0);
+	case REG_TXREQ2: return bitmap(MCTRL_TXRQST, 1);
+	case REG_ND1: return bitmap(MCTRL_NEWDAT, 0);
+	case REG_ND2: return bitmap(MCTRL_NEWDAT, 1);
+	case REG_MSGV1: return bitmap(0, 0);
+	case REG_MSGV2: return bitmap(0, 1);
+	default: return 0;
+	}
+}
+
+void CCANModel::write(int reg, uint32_t value) {
+	count.writes++;
+	now += accessCycles;
+
+	if (reg >= REG_IF1 && reg < REG_TXREQ1) {
+		Interface& ifn = interfaces[(reg - REG_IF1) / 11];
+		int field = (reg - REG_IF1) % 11;
+		switch (field) {
+		case IF_CMDREQ:
+			ifn.cmdreq = value & 0x3F;
+			transfer(ifn, ifn.cmdreq);
+			break;
+		case IF_CMDMSK: ifn.cmdmsk = value; break;
+		case IF_MSK1: ifn.msk1 = value; break;
+		case IF_MSK2: ifn.msk2 = value; break;
+		case IF_ARB1: ifn.arb1 = value; break;
+		case IF_ARB2: ifn.arb2 = value; break;
+		case IF_MCTRL: ifn.mctrl = value; break;
+		default: ifn.data[field - IF_DATA] = value; break;
+		}
+		return;
+	}
+
+	switch (reg) {
+	case REG_CNTL: cntl = value; break;
+	case REG_STAT: stat = value & 0x1F; break;
+	case REG_TEST: test = value; break;
+	case REG_BT: bt = value; break;
+	case REG_BRPE: brpe = value; break;
+	case REG_CLKDIV: clkdiv = value; break;
+	default: break;
+	}
+}
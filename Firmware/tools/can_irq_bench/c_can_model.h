@@ -0,0 +1,90 @@
+/*
+ * c_can_model.h
+ * Register-level model of the LPC15XX C_CAN controller that counts every
+ * register access can_api.c makes.
+ */
+
+#ifndef TOOLS_CAN_IRQ_BENCH_C_CAN_MODEL_H_
+#define TOOLS_CAN_IRQ_BENCH_C_CAN_MODEL_H_
+
+#include <stdint.h>
+
+/*
+ * The 32 message objects and the registers of LPC_C_CAN0 in cmsis.h.
+ *
+ * Time is counted in CPU cycles: every register access takes
+ * accessCycles, and a message interface stays busy for transferCycles
+ * after CMDREQ is written. Transfers use one message RAM, so one queued
+ * while another runs starts when that one ends. Only the controller
+ * functions can_api.c relies on for receiving are modelled; transmit
+ * requests are stored and never sent.
+ */
+class CCANModel {
+public:
+	/** Register accesses and busy polls since the last clearCounts() */
+	struct Counts {
+		uint64_t reads;
+		uint64_t writes;
+		uint64_t busyPolls;
+	};
+
+	/**
+	 * @param accessCycles CPU cycles of one register access
+	 * @param transferCycles CPU cycles of one message object transfer
+	 */
+	void setTiming(uint32_t accessCycles, uint32_t transferCycles);
+
+	/**
+	 * A standard data frame arrives from the bus. The lowest valid receive
+	 * object whose filter matches takes it.
+	 * @param id identifier
+	 * @param len data length, 0 to 8
+	 * @param data payload
+	 * @return true if an object took the frame
+	 */
+	bool receive(uint32_t id, uint8_t len, const uint8_t* data);
+
+	/** Objects that took a frame while holding an unread one */
+	uint32_t overwritten() const { return overwrites; }
+
+	const Counts& counts() const { return count; }
+	uint64_t cycles() const { return now; }
+	void clearCounts();
+
+	uint32_t read(int reg);
+	void write(int reg, uint32_t value);
+
+	static CCANModel& instance();
+
+private:
+	CCANModel();
+
+	struct MessageObject {
+		uint32_t msk1, msk2, arb1, arb2, mctrl;
+		uint32_t data[4];
+	};
+
+	struct Interface {
+		uint32_t cmdreq, cmdmsk, msk1, msk2, arb1, arb2, mctrl;
+		uint32_t data[4];
+		uint64_t busyUntil;
+	};
+
+	void transfer(Interface& ifn, uint32_t msgnum);
+	uint32_t interruptId() const;
+	uint32_t bitmap(uint32_t mask, int half) const;
+
+	MessageObject objects[32];
+	Interface interfaces[2];
+	uint32_t cntl, stat, test, bt, brpe, clkdiv;
+	bool statusInterrupt;
+	uint32_t overwrites;
+
+	uint32_t accessCycles;
+	uint32_t transferCycles;
+	uint64_t now;
+	uint64_t ramFreeAt;
+	Counts count;
+};
+
+#endif /* TOOLS_CAN_IRQ_BENCH_C_CAN_MODEL_H_ */
@@ -0,0 +1,126 @@
+/*
+ * cmsis.h
+ * Host replacement for the LPC15XX CMSIS headers, as far as can_api.c
+ * uses them. LPC_C_CAN0 is the register block of the C_CAN model in
+ * c_can_model.h.
+ */
+
+#ifndef TOOLS_CAN_IRQ_BENCH_CMSIS_H_
+#define TOOLS_CAN_IRQ_BENCH_CMSIS_H_
+
+#include <stdint.h>
+
+namespace CCANRegisters {
+
+/** One C_CAN register; every access goes through the model */
+class Register {
+public:
+	operator ::uint32_t() const;
+	Register& operator=(::uint32_t value);
+	Register& operator=(const Register&) = delete;
+
+	// unsigned long, as the masks can_api.c applies are 1UL << n, which
+	// are 64 bits wide on the host
+	Register& operator|=(unsigned long value) {
+		return *this = (::uint32_t)*this | (::uint32_t)value;
+	}
+
+	Register& operator&=(unsigned long value) {
+		return *this = (::uint32_t)*this & (::uint32_t)value;
+	}
+
+	::uint32_t value;
+};
+
+// can_api.c declares its IF1/IF2 overlay as "__IO uint32_t", which
+// becomes CCANRegisters::uint32_t, so accesses through the overlay reach
+// the model too
+typedef Register uint32_t;
+
+} // end namespace CCANRegisters
+
+#define __IO ::CCANRegisters::
+
+/** C_CAN registers can_api.c uses, IF1 and IF2 laid out as its can_if_t */
+struct LPC_C_CAN0_Type {
+	__IO uint32_t CANCNTL;
+	__IO uint32_t CANSTAT;
+	__IO uint32_t CANEC;
+	__IO uint32_t CANBT;
+	__IO uint32_t CANINT;
+	__IO uint32_t CANTEST;
+	__IO uint32_t CANBRPE;
+	__IO uint32_t CANIF1_CMDREQ;
+	__IO uint32_t CANIF1_CMDMSK_W;
+	__IO uint32_t CANIF1_MSK1;
+	__IO uint32_t CANIF1_MSK2;
+	__IO uint32_t CANIF1_ARB1;
+	__IO uint32_t CANIF1_ARB2;
+	__IO uint32_t CANIF1_MCTRL;
+	__IO uint32_t CANIF1_DA1;
+	__IO uint32_t CANIF1_DA2;
+	__IO uint32_t CANIF1_DB1;
+	__IO uint32_t CANIF1_DB2;
+	__IO uint32_t CANIF2_CMDREQ;
+	__IO uint32_t CANIF2_CMDMSK_W;
+	__IO uint32_t CANIF2_MSK1;
+	__IO uint32_t CANIF2_MSK2;
+	__IO uint32_t CANIF2_ARB1;
+	__IO uint32_t CANIF2_ARB2;
+	__IO uint32_t CANIF2_MCTRL;
+	__IO uint32_t CANIF2_DA1;
+	__IO uint32_t CANIF2_DA2;
+	__IO uint32_t CANIF2_DB1;
+	__IO uint32_t CANIF2_DB2;
+	__IO uint32_t CANTXREQ1;
+	__IO uint32_t CANTXREQ2;
+	__IO uint32_t CANND1;
+	__IO uint32_t CANND2;
+	__IO uint32_t CANMSGV1;
+	__IO uint32_t CANMSGV2;
+	__IO uint32_t CANCLKDIV;
+};
+
+/** Clock and switch matrix registers can_init() sets; plain memory */
+struct LPC_SYSCON_Type {
+	volatile uint32_t SYSAHBCLKCTRL1;
+	volatile uint32_t PRESETCTRL1;
+};
+
+struct LPC_SWM_Type {
+	volatile uint32_t PINASSIGN[16];
+};
+
+extern LPC_C_CAN0_Type hostCCAN0;
+extern LPC_SYSCON_Type hostSYSCON;
+extern LPC_SWM_Type hostSWM;
+
+#define LPC_C_CAN0 (&hostCCAN0)
+#define LPC_SYSCON (&hostSYSCON)
+#define LPC_SWM (&hostSWM)
+
+extern uint32_t SystemCoreClock;
+
+// The benchmark calls the interrupt handler itself
+#define C_CAN0_IRQn 0
+#define NVIC_SetVector(irq, vector) ((void)0)
+#define NVIC_EnableIRQ(irq) ((void)0)
+#define NVIC_DisableIRQ(irq) ((void)0)
+
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t) {}
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+
+static inline uint32_t __RBIT(uint32_t value) {
+	uint32_t result = 0;
+	for (int i = 0; i < 32; i++)
+		result |= ((value >> i) & 1) << (31 - i);
+	return result;
+}
+
+static inline uint8_t __CLZ(uint32_t value) {
+	return value == 0 ? 32 : __builtin_clz(value);
+}
+
+#endif /* TOOLS_CAN_IRQ_BENCH_CMSIS_H_ */
@@ -0,0 +1,18 @@
+/*
+ * device.h
+ * Host replacement for the LPC15XX device.h included by can_api.h.
+ */
+
+#ifndef TOOLS_CAN_IRQ_BENCH_DEVICE_H_
+#define TOOLS_CAN_IRQ_BENCH_DEVICE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEVICE_CAN 1
+
+struct can_s {
+	int index;
+};
+
+#endif /* TOOLS_CAN_IRQ_BENCH_DEVICE_H_ */
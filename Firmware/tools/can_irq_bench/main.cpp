@@ -0,0 +1,151 @@
+/*
+ * main.cpp
+ *
+ * can_irq_bench: count the register accesses and estimate the cycles the
+ * LPC15XX C_CAN interrupt spends per received frame, on a model of the
+ * controller.
+ *
+ * Usage: can_irq_bench [-n framesPerIrq] [-r rounds] [-a accessCycles] [-x transferCycles]
+ */
+
+// Built as part of this file so the static can_irq() can be called
+#include "../../mbed/libraries/mbed/targets/hal/TARGET_NXP/TARGET_LPC15XX/can_api.c"
+#include "c_can_model.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const uint32_t FIRST_ID = 0x470;
+
+static can_t can;
+static CAN_Message msgs[CAN_RX_MSG_OBJ_COUNT];
+static bool readAll;
+static uint64_t drained;
+
+/*
+ * CAN::read(msgs, max) on a target without can_read_all(): one can_read()
+ * per frame, each scanning the new data bitmap again. Copied from the
+ * WEAK fallback in CAN.cpp.
+ */
+static int readEach(can_t* obj, CAN_Message* msgs, int max) {
+	int count = 0;
+	while (count < max && can_read(obj, &msgs[count], 0)) {
+		count++;
+	}
+	return count;
+}
+
+// The attached receive handler, as CANRXBuffer::handleIrq() drains
+static void irqHandler(uint32_t id, CanIrqType type) {
+	if (type != IRQ_RX)
+		return;
+	if (readAll)
+		drained += can_read_all(&can, msgs, CAN_RX_MSG_OBJ_COUNT);
+	else
+		drained += readEach(&can, msgs, CAN_RX_MSG_OBJ_COUNT);
+}
+
+/** Model counts of one drain path, per frame */
+struct IrqResult {
+	double reads;
+	double writes;
+	double busyPolls;
+	double cycles;
+};
+
+/*
+ * Run rounds of: framesPerIrq frames arrive in their own receive objects,
+ * then the interrupt handler runs. Only the interrupt is counted.
+ * @return false if a frame was lost or left unread
+ */
+static bool runPath(bool all, int framesPerIrq, int rounds, IrqResult& result) {
+	CCANModel& model = CCANModel::instance();
+	readAll = all;
+	drained = 0;
+
+	uint64_t reads = 0, writes = 0, busyPolls = 0, cycles = 0;
+	uint8_t data[8] = { 0 };
+	for (int round = 0; round < rounds; round++) {
+		for (int i = 0; i < framesPerIrq; i++) {
+			data[0] = round;
+			data[1] = i;
+			model.receive(FIRST_ID + i, 8, data);
+		}
+		model.clearCounts();
+		can_irq();
+		reads += model.counts().reads;
+		writes += model.counts().writes;
+		busyPolls += model.counts().busyPolls;
+		cycles += model.cycles();
+		if (model.overwritten() != 0)
+			return false;
+	}
+
+	double frames = (double)rounds * framesPerIrq;
+	result.reads = reads / frames;
+	result.writes = writes / frames;
+	result.busyPolls = busyPolls / frames;
+	result.cycles = cycles / frames;
+	return drained == (uint64_t)rounds * framesPerIrq;
+}
+
+static void printResult(const char* name, const IrqResult& result, const IrqResult& before) {
+	printf("%-22s %7.2f %7.2f %7.2f %8.1f %9.0f %%\n", name, result.reads, result.writes,
+			result.busyPolls, result.cycles, before.cycles / result.cycles * 100);
+}
+
+static void usage() {
+	fprintf(stderr, "usage: can_irq_bench [-n framesPerIrq] [-r rounds] [-a accessCycles] [-x transferCycles]\n");
+	fprintf(stderr, "  -n  frames per interrupt, 1 to %d (default 8)\n", CAN_RX_MSG_OBJ_COUNT);
+	fprintf(stderr, "  -r  interrupts per path (default 10000)\n");
+	fprintf(stderr, "  -a  CPU cycles per register access (default 3)\n");
+	fprintf(stderr, "  -x  CPU cycles per message object transfer (default 12)\n");
+}
+
+int main(int argc, char** argv) {
+	int framesPerIrq = 8;
+	int rounds = 10000;
+	int accessCycles = 3;
+	int transferCycles = 12;
+	for (int arg = 1; arg < argc; arg++) {
+		if (arg + 1 < argc && strcmp(argv[arg], "-n") == 0) {
+			framesPerIrq = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-r") == 0) {
+			rounds = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-a") == 0) {
+			accessCycles = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-x") == 0) {
+			transferCycles = atoi(argv[++arg]);
+		} else {
+			usage();
+			return 2;
+		}
+	}
+	if (framesPerIrq < 1 || framesPerIrq > CAN_RX_MSG_OBJ_COUNT || rounds < 1
+			|| accessCycles < 1 || transferCycles < 0) {
+		usage();
+		return 2;
+	}
+
+	CCANModel::instance().setTiming(accessCycles, transferCycles);
+	can_init(&can, 0, 0);
+	can_irq_init(&can, irqHandler, 0);
+	can_irq_set(&can, IRQ_RX, 1);
+	for (int i = 0; i < framesPerIrq; i++)
+		can_filter(&can, FIRST_ID + i, 0x7FF, CANStandard, i + 1);
+
+	IrqResult each, all;
+	bool ok = runPath(false, framesPerIrq, rounds, each);
+	ok = runPath(true, framesPerIrq, rounds, all) && ok;
+
+	printf("%d frames per interrupt, %d rounds, %d cycles per access, %d per transfer\n\n",
+			framesPerIrq, rounds, accessCycles, transferCycles);
+	printf("per frame                reads  writes   polls   cycles  vs can_read\n");
+	printResult("can_read() per frame", each, each);
+	printResult("can_read_all()", all, each);
+	if (!ok) {
+		printf("frames were lost or left unread\n");
+		return 1;
+	}
+	return 0;
+}
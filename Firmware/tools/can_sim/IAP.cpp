@@ -0,0 +1,54 @@
+/*
+ * IAP.cpp
+ *
+ * Host replacement for the flash commands of common/api/IAP.h.
+ */
+
+#include "IAP.h"
+
+#include <string.h>
+
+static IAP::SimFlash* flash = NULL;
+
+void IAP::select(SimFlash& selected) {
+	flash = &selected;
+}
+
+uint32_t IAP::eraseSectors(uint32_t start, uint32_t end) {
+	if (start > end || (end + 1) * FLASH_SECTOR_SIZE > FLASH_SIZE)
+		return INVALID_SECTOR;
+	memset(&flash->memory[start * FLASH_SECTOR_SIZE], 0xFF, (end - start + 1) * FLASH_SECTOR_SIZE);
+	flash->busyNs += (end - start + 1) * ERASE_NS_PER_SECTOR;
+	flash->erases += end - start + 1;
+	return CMD_SUCCESS;
+}
+
+uint32_t IAP::copyRamToFlash(uint32_t address, const uint32_t* data, uint32_t bytes) {
+	if (address % FLASH_PAGE_SIZE != 0 || address + bytes > FLASH_SIZE)
+		return DST_ADDR_ERROR;
+	if (bytes != 256 && bytes != 512 && bytes != 1024 && bytes != 4096)
+		return COUNT_ERROR;
+	// Programming can only clear bits
+	const uint8_t* source = (const uint8_t*)data;
+	for (uint32_t i = 0; i < bytes; i++)
+		flash->memory[address + i] &= source[i];
+	flash->busyNs += bytes / FLASH_PAGE_SIZE * WRITE_NS_PER_PAGE;
+	flash->writes += bytes / FLASH_PAGE_SIZE;
+	return CMD_SUCCESS;
+}
+
+uint32_t IAP::blankCheck(uint32_t start, uint32_t end) {
+	if (start > end || (end + 1) * FLASH_SECTOR_SIZE > FLASH_SIZE)
+		return INVALID_SECTOR;
+	for (uint32_t i = start * FLASH_SECTOR_SIZE; i < (end + 1) * FLASH_SECTOR_SIZE; i++) {
+		if (flash->memory[i] != 0xFF)
+			return SECTOR_NOT_BLANK;
+	}
+	return CMD_SUCCESS;
+}
+
+uint32_t IAP::compare(uint32_t address, const uint32_t* data, uint32_t bytes) {
+	if (address % 4 != 0 || bytes % 4 != 0 || address + bytes > FLASH_SIZE)
+		return DST_ADDR_ERROR;
+	return memcmp(&flash->memory[address], data, bytes) == 0 ? CMD_SUCCESS : COMPARE_ERROR;
+}
@@ -0,0 +1,58 @@
+/*
+ * IAP.h
+ * Host replacement for the flash commands of common/api/IAP.h, so the
+ * bootloader code can run in can_sim. Each simulated board selects its own
+ * flash with IAP::select() before running.
+ */
+
+#ifndef TOOLS_CAN_SIM_IAP_H_
+#define TOOLS_CAN_SIM_IAP_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace IAP {
+
+	const uint32_t CMD_SUCCESS = 0;
+	const uint32_t SRC_ADDR_ERROR = 2;
+	const uint32_t DST_ADDR_ERROR = 3;
+	const uint32_t COUNT_ERROR = 6;
+	const uint32_t INVALID_SECTOR = 7;
+	const uint32_t SECTOR_NOT_BLANK = 8;
+	const uint32_t COMPARE_ERROR = 10;
+
+	const uint32_t FLASH_SIZE = 0x40000;
+	const uint32_t FLASH_SECTOR_SIZE = 4096;
+	const uint32_t FLASH_PAGE_SIZE = 256;
+
+	// Worst case times from the LPC15xx datasheet
+	const uint64_t ERASE_NS_PER_SECTOR = 100000000;
+	const uint64_t WRITE_NS_PER_PAGE = 1000000;
+
+	/** Flash of one simulated board */
+	struct SimFlash {
+		std::vector<uint8_t> memory;
+		uint64_t busyNs;	// time the CPU was stalled in IAP calls
+		uint32_t erases;
+		uint32_t writes;
+
+		SimFlash() : memory(FLASH_SIZE, 0xFF), busyNs(0), erases(0), writes(0) {}
+	};
+
+	/**
+	 * Route the following IAP calls to a board's flash
+	 */
+	void select(SimFlash& flash);
+
+	inline uint32_t sector(uint32_t address) {
+		return address / FLASH_SECTOR_SIZE;
+	}
+
+	uint32_t eraseSectors(uint32_t start, uint32_t end);
+	uint32_t copyRamToFlash(uint32_t address, const uint32_t* data, uint32_t bytes);
+	uint32_t blankCheck(uint32_t start, uint32_t end);
+	uint32_t compare(uint32_t address, const uint32_t* data, uint32_t bytes);
+
+}
+
+#endif /* TOOLS_CAN_SIM_IAP_H_ */
@@ -0,0 +1,464 @@
+/*
+ * can_sim.cpp
+ *
+ * Virtual CAN bus: arbitration, frame timing and delivery.
+ */
+
+#include "can_sim.h"
+
+#include <string.h>
+
+// Bits are appended most significant first
+static void appendBits(std::vector<uint8_t>& bits, uint32_t value, int count) {
+	for (int i = count - 1; i >= 0; i--)
+		bits.push_back((value >> i) & 1);
+}
+
+// Start of frame through the control field, plus the data field
+static void frameHeader(const CAN_Message& msg, std::vector<uint8_t>& bits) {
+	bool remote = msg.type == CANRemote;
+	bits.push_back(0);								// SOF
+	if (msg.format == CANExtended) {
+		appendBits(bits, msg.id >> 18, 11);
+		bits.push_back(1);							// SRR
+		bits.push_back(1);							// IDE
+		appendBits(bits, msg.id & 0x3FFFF, 18);
+		bits.push_back(remote);						// RTR
+		bits.push_back(0);							// r1
+		bits.push_back(0);							// r0
+	} else {
+		appendBits(bits, msg.id & 0x7FF, 11);
+		bits.push_back(remote);						// RTR
+		bits.push_back(0);							// IDE
+		bits.push_back(0);							// r0
+	}
+	int len = msg.len > 8 ? 8 : msg.len;
+	appendBits(bits, msg.len & 0xF, 4);
+	if (!remote) {
+		for (int i = 0; i < len; i++)
+			appendBits(bits, msg.data[i], 8);
+	}
+}
+
+// Identifier bits in wire order, left aligned; the lower value wins arbitration
+static uint32_t arbitrationKey(const CAN_Message& msg) {
+	std::vector<uint8_t> bits;
+	frameHeader(msg, bits);
+	int arbitrationBits = msg.format == CANExtended ? 32 : 13;
+	uint32_t key = 0;
+	for (int i = 0; i < 32; i++)
+		key = (key << 1) | (i < arbitrationBits ? bits[1 + i] : 0);
+	return key;
+}
+
+int VirtualCANBus::frameBits(const CAN_Message& msg) {
+	std::vector<uint8_t> bits;
+	frameHeader(msg, bits);
+
+	uint16_t crc = 0;
+	for (size_t i = 0; i < bits.size(); i++) {
+		bool feedback = ((crc >> 14) & 1) ^ bits[i];
+		crc = (crc << 1) & 0x7FFF;
+		if (feedback)
+			crc ^= 0x4599;
+	}
+	appendBits(bits, crc, 15);
+
+	// A bit of the opposite level follows every 5 equal bits up to the
+	// end of the CRC; stuff bits count towards the next run
+	int stuffBits = 0;
+	int run = 1;
+	uint8_t last = bits[0];
+	for (size_t i = 1; i < bits.size(); i++) {
+		if (bits[i] == last) {
+			run++;
+		} else {
+			last = bits[i];
+			run = 1;
+		}
+		if (run == 5) {
+			stuffBits++;
+			last = !last;
+			run = 1;
+		}
+	}
+
+	// CRC delimiter, ACK slot and delimiter, end of frame, interframe space
+	return (int)bits.size() + stuffBits + 1 + 2 + 7 + 3;
+}
+
+VirtualCANBus::VirtualCANBus(uint32_t bitRate) : bitRate(bitRate), now(0), sender(NULL), senderSlot(-1), frameEnd(0) {
+	clearStats();
+}
+
+VirtualCANBus& VirtualCANBus::defaultBus() {
+	static VirtualCANBus bus;
+	return bus;
+}
+
+void VirtualCANBus::attach(CAN* node) {
+	nodes.push_back(node);
+}
+
+void VirtualCANBus::detach(CAN* node) {
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i] == node) {
+			nodes.erase(nodes.begin() + i);
+			break;
+		}
+	}
+	if (sender == node)
+		sender = NULL;
+}
+
+void VirtualCANBus::arbitrate() {
+	CAN* winner = NULL;
+	int winnerSlot = -1;
+	uint32_t winnerKey = 0;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		int slot = nodes[i]->nextTx();
+		if (slot < 0)
+			continue;
+		uint32_t key = arbitrationKey(nodes[i]->tx[slot].msg);
+		if (winner == NULL || key < winnerKey) {
+			winner = nodes[i];
+			winnerSlot = slot;
+			winnerKey = key;
+		}
+	}
+	if (winner == NULL)
+		return;
+
+	sender = winner;
+	senderSlot = winnerSlot;
+	uint64_t bits = frameBits(winner->tx[winnerSlot].msg);
+	frameEnd = now + (bits * 1000000000ULL + bitRate - 1) / bitRate;
+}
+
+void VirtualCANBus::finishFrame() {
+	CAN* from = sender;
+	CAN::TxObject& object = from->tx[senderSlot];
+	CAN_Message msg = object.msg;
+	sender = NULL;
+
+	uint64_t bits = frameBits(msg);
+	uint64_t duration = (bits * 1000000000ULL + bitRate - 1) / bitRate;
+	busyNs += duration;
+	uint32_t key = msg.format == CANExtended ? (msg.id | 0x80000000UL) : (msg.id & 0x7FF);
+	CANSimIdStats& id = stats[key];
+	uint64_t latency = now - object.queuedNs;
+	id.frames++;
+	id.bits += bits;
+	id.totalLatencyNs += latency;
+	if (latency > id.maxLatencyNs)
+		id.maxLatencyNs = latency;
+	object.pending = false;
+
+	// Handlers may write or detach, so decide who to interrupt first
+	std::vector<CAN*> interrupted;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i] != from && nodes[i]->receive(msg))
+			interrupted.push_back(nodes[i]);
+	}
+	from->interrupt(CAN::TxIrq);
+	for (size_t i = 0; i < interrupted.size(); i++)
+		interrupted[i]->interrupt(CAN::RxIrq);
+}
+
+CAN* VirtualCANBus::nextReleased() const {
+	CAN* next = NULL;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		CAN* node = nodes[i];
+		if ((node->rxIrqPending || node->txIrqPending) &&
+				(next == NULL || node->irqHeldUntil < next->irqHeldUntil))
+			next = node;
+	}
+	return next;
+}
+
+void VirtualCANBus::run(uint64_t untilNs) {
+	while (true) {
+		// Held interrupts run when their hold ends, between frames; a
+		// handler released now may still queue a frame before arbitration
+		CAN* released = nextReleased();
+		bool releaseNow = released != NULL && released->irqHeldUntil <= now;
+		if (sender == NULL && !releaseNow)
+			arbitrate();
+		if (released != NULL && released->irqHeldUntil <= untilNs &&
+				(sender == NULL || released->irqHeldUntil <= frameEnd)) {
+			if (released->irqHeldUntil > now)
+				now = released->irqHeldUntil;
+			released->releaseIrq();
+			continue;
+		}
+		if (sender == NULL || frameEnd > untilNs)
+			break;
+		now = frameEnd;
+		finishFrame();
+	}
+	if (untilNs > now)
+		now = untilNs;
+}
+
+double VirtualCANBus::load() const {
+	uint64_t elapsed = now - statsStart;
+	return elapsed == 0 ? 0.0 : (double)busyNs / elapsed;
+}
+
+void VirtualCANBus::clearStats() {
+	statsStart = now;
+	busyNs = 0;
+	stats.clear();
+}
+
+CAN::CAN(int rd, int td) : bus(VirtualCANBus::defaultBus()) {
+	(void)rd;
+	(void)td;
+	reset();
+	bus.attach(this);
+}
+
+CAN::CAN(VirtualCANBus& bus) : bus(bus) {
+	reset();
+	bus.attach(this);
+}
+
+CAN::~CAN() {
+	bus.detach(this);
+}
+
+int CAN::frequency(int hz) {
+	// Every controller on a virtual bus runs at the bus rate
+	return (uint32_t)hz == bus.bitRate;
+}
+
+// Position of a frame in arbitration, lowest wins, as can_tx_rank() in
+// can_api.c: the 11-bit base ID, then standard before extended, then the
+// rest of an extended ID
+static uint32_t txRank(const CAN_Message& msg) {
+	if (msg.format == CANExtended)
+		return ((msg.id & 0x1FFFFFFF) >> 18 << 19) | (1UL << 18) | (msg.id & 0x3FFFF);
+	return (msg.id & 0x7FF) << 19;
+}
+
+int CAN::write(CANMessage msg) {
+	if (silent)
+		return 0;
+
+	// Same object allocation as can_write(): the one after the last pending
+	// frame that ranks the same or better in arbitration, if it is free
+	uint32_t rank = txRank(msg);
+	int slot = 0;
+	for (int i = CAN_TX_MSG_OBJ_COUNT - 1; i >= 0; i--) {
+		if (tx[i].pending && txRank(tx[i].msg) <= rank) {
+			slot = i + 1;
+			break;
+		}
+	}
+	if (slot >= CAN_TX_MSG_OBJ_COUNT || tx[slot].pending)
+		return 0;
+
+	tx[slot].pending = true;
+	tx[slot].msg = msg;
+	tx[slot].queuedNs = bus.now;
+	return 1;
+}
+
+int CAN::read(CANMessage& msg, int handle) {
+	// Same object choice as can_read(): the lowest one with new data
+	if (handle == 0) {
+		for (int i = 0; i < CAN_RX_MSG_OBJ_COUNT; i++) {
+			if (rx[i].newData) {
+				handle = i + 1;
+				break;
+			}
+		}
+	}
+	if (handle < 1 || handle > CAN_RX_MSG_OBJ_COUNT || !rx[handle - 1].newData)
+		return 0;
+
+	// Reading clears NEWDAT; MSGLST was already counted in overflows
+	RxObject& object = rx[handle - 1];
+	static_cast<CAN_Message&>(msg) = object.msg;
+	object.newData = false;
+	object.lost = false;
+	return 1;
+}
+
+int CAN::read(CANMessage* msgs, int max) {
+	int count = 0;
+	while (count < max && read(msgs[count], 0))
+		count++;
+	return count;
+}
+
+int CAN::rxLost() {
+	int lost = (int)(overflows - overflowsReported);
+	overflowsReported = overflows;
+	return lost;
+}
+
+void CAN::reset() {
+	for (int i = 0; i < CAN_TX_MSG_OBJ_COUNT; i++)
+		tx[i].pending = false;
+	for (int i = 0; i < CAN_RX_MSG_OBJ_COUNT; i++) {
+		rx[i].valid = false;
+		rx[i].newData = false;
+		rx[i].lost = false;
+	}
+	// Object 1 accepts everything, as can_config_rxmsgobj() leaves it
+	filter(0, 0, CANStandard, 1);
+	irqHeldUntil = 0;
+	rxIrqPending = false;
+	txIrqPending = false;
+	silent = false;
+	overflows = 0;
+	overflowsReported = 0;
+	filtered = 0;
+}
+
+CAN::TxStatus CAN::txstatus() {
+	if (nextTx() < 0)
+		return Idle;
+	for (int i = 0; i < CAN_TX_MSG_OBJ_COUNT; i++) {
+		if (!tx[i].pending)
+			return Available;
+	}
+	return Busy;
+}
+
+void CAN::monitor(bool silent) {
+	this->silent = silent;
+}
+
+int CAN::mode(Mode mode) {
+	switch (mode) {
+	case Normal:
+		silent = false;
+		return 1;
+	case Silent:
+		silent = true;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+int CAN::filter(unsigned int id, unsigned int mask, CANFormat format, int handle) {
+	// Same object choice as can_filter(): the first invalid one
+	if (handle == 0) {
+		for (int i = 0; i < CAN_RX_MSG_OBJ_COUNT; i++) {
+			if (!rx[i].valid) {
+				handle = i + 1;
+				break;
+			}
+		}
+	}
+	if (handle < 1 || handle > CAN_RX_MSG_OBJ_COUNT)
+		return 0;
+
+	// can_filter() treats anything but CANExtended as standard
+	RxObject& object = rx[handle - 1];
+	object.valid = true;
+	object.id = id;
+	object.mask = mask;
+	object.format = format == CANExtended ? CANExtended : CANStandard;
+	object.newData = false;
+	object.lost = false;
+	return handle;
+}
+
+int CAN::removeFilter(int handle) {
+	if (handle < 1 || handle > CAN_RX_MSG_OBJ_COUNT)
+		return 0;
+	rx[handle - 1].valid = false;
+	rx[handle - 1].newData = false;
+	rx[handle - 1].lost = false;
+	return 1;
+}
+
+unsigned char CAN::rderror() {
+	return 0;
+}
+
+unsigned char CAN::tderror() {
+	return 0;
+}
+
+void CAN::attach(void (*fptr)(void), IrqType type) {
+	if (fptr != NULL)
+		irq[type] = fptr;
+	else
+		irq[type] = nullptr;
+}
+
+void CAN::holdIrq(uint64_t untilNs) {
+	if (untilNs > irqHeldUntil)
+		irqHeldUntil = untilNs;
+}
+
+void CAN::interrupt(IrqType type) {
+	if (bus.now < irqHeldUntil) {
+		if (type == RxIrq)
+			rxIrqPending = true;
+		else if (type == TxIrq)
+			txIrqPending = true;
+		return;
+	}
+	if (irq[type])
+		irq[type]();
+}
+
+void CAN::releaseIrq() {
+	bool rxPending = rxIrqPending;
+	bool txPending = txIrqPending;
+	rxIrqPending = false;
+	txIrqPending = false;
+	if (txPending && irq[TxIrq])
+		irq[TxIrq]();
+	if (rxPending && irq[RxIrq])
+		irq[RxIrq]();
+}
+
+int CAN::nextTx() const {
+	for (int i = 0; i < CAN_TX_MSG_OBJ_COUNT; i++) {
+		if (tx[i].pending)
+			return i;
+	}
+	return -1;
+}
+
+bool CAN::receive(const CAN_Message& msg) {
+	// Identifiers compare as in the message objects: a standard ID sits in
+	// the top 11 of the 29 arbitration bits, and only an extended filter
+	// also checks the frame format
+	uint32_t frameArb = msg.format == CANExtended ? (msg.id & 0x1FFFFFFF) : ((msg.id & 0x7FF) << 18);
+	for (int i = 0; i < CAN_RX_MSG_OBJ_COUNT; i++) {
+		RxObject& object = rx[i];
+		if (!object.valid)
+			continue;
+		uint32_t id, mask;
+		if (object.format == CANExtended) {
+			if (msg.format != CANExtended)
+				continue;
+			id = object.id & 0x1FFFFFFF;
+			mask = object.mask & 0x1FFFFFFF;
+		} else {
+			id = (object.id & 0x7FF) << 18;
+			mask = (object.mask & 0x7FF) << 18;
+		}
+		if ((frameArb & mask) != (id & mask))
+			continue;
+
+		// A single object overwrites an unread frame and sets MSGLST
+		if (object.newData) {
+			object.lost = true;
+			overflows++;
+		}
+		object.msg = msg;
+		object.newData = true;
+		return true;
+	}
+	filtered++;
+	return false;
+}
@@ -0,0 +1,319 @@
+/*
+ * can_sim.h
+ * In-process virtual CAN bus and a host version of the mbed CAN class.
+ */
+
+#ifndef TOOLS_CAN_SIM_CAN_SIM_H_
+#define TOOLS_CAN_SIM_CAN_SIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include <can_lite.h>
+#include <CAN/can_id.h>
+#include <can_msg_obj.h>
+
+class CAN;
+
+/** Traffic seen on the bus for one ID */
+struct CANSimIdStats {
+	uint64_t frames;
+	uint64_t bits;			// including stuff bits and interframe space
+	uint64_t maxLatencyNs;	// from CAN::write() to the end of the frame
+	uint64_t totalLatencyNs;
+
+	CANSimIdStats() : frames(0), bits(0), maxLatencyNs(0), totalLatencyNs(0) {}
+};
+
+/** Shared bus connecting any number of CAN controllers
+ *
+ *  Time only moves when run() is called. Frames go out one at a time: when
+ *  the bus is idle, the controllers' pending frames arbitrate bit by bit
+ *  on the identifier, exactly as on the wire, and the winner takes the bus
+ *  for its length at CAN_FREQUENCY, stuff bits included. At the end of a
+ *  frame every other controller receives it, then the sender's TX and the
+ *  receivers' RX interrupt handlers run, unless a controller's interrupts
+ *  are held with CAN::holdIrq(); those run when the hold ends.
+ *
+ *  Typical usage:
+ *    VirtualCANBus bus;
+ *    CAN wheel(bus), dash(bus);
+ *    CANRXTXBuffer<32, 16> wheelBuffer(wheel);
+ *    wheel.attach(&wheelBuffer, &CANRXTXBuffer<32, 16>::handleIrq, CAN::RxIrq);
+ *
+ *    while (bus.nowNs() < 10000000000ULL) {
+ *        wheelMainLoop();
+ *        dashMainLoop();
+ *        bus.run(bus.nowNs() + 100000);
+ *    }
+ *    printf("%.1f %% load\n", bus.load() * 100);
+ */
+class VirtualCANBus {
+public:
+	/**
+	 * @param bitRate bits per second
+	 */
+	explicit VirtualCANBus(uint32_t bitRate = CAN_FREQUENCY);
+
+	/**
+	 * Bus used by CAN objects built from pins, as in unmodified firmware.
+	 */
+	static VirtualCANBus& defaultBus();
+
+	/**
+	 * Advance time, sending frames as the bus allows.
+	 * @param untilNs time to stop at; frames still on the wire are finished
+	 *        by a later call
+	 */
+	void run(uint64_t untilNs);
+
+	/**
+	 * @return current simulated time (ns)
+	 */
+	uint64_t nowNs() const { return now; }
+
+	/**
+	 * @return current simulated time (us), as read by mbed Timers
+	 */
+	uint32_t nowUs() const { return (uint32_t)(now / 1000); }
+
+	/**
+	 * @return share of time since the last clearStats() the bus was busy, 0 to 1
+	 */
+	double load() const;
+
+	/**
+	 * @return traffic per ID since the last clearStats(); extended IDs
+	 *         have bit 31 set
+	 */
+	const std::map<uint32_t, CANSimIdStats>& idStats() const { return stats; }
+
+	/**
+	 * Reset the load and per-ID counters.
+	 */
+	void clearStats();
+
+	/**
+	 * Length of a frame on the wire.
+	 * @param msg frame
+	 * @return bits from start of frame to the end of the interframe space
+	 */
+	static int frameBits(const CAN_Message& msg);
+
+private:
+	friend class CAN;
+
+	uint32_t bitRate;
+	uint64_t now;
+	std::vector<CAN*> nodes;
+
+	CAN* sender;			// controller whose frame is on the wire, or NULL
+	int senderSlot;
+	uint64_t frameEnd;
+
+	uint64_t statsStart;
+	uint64_t busyNs;
+	std::map<uint32_t, CANSimIdStats> stats;
+
+	/**
+	 * @return controller with held interrupts pending whose hold ends
+	 *         first, or NULL
+	 */
+	CAN* nextReleased() const;
+
+	void attach(CAN* node);
+	void detach(CAN* node);
+
+	/**
+	 * Start the frame that wins arbitration, if any is pending.
+	 */
+	void arbitrate();
+
+	/**
+	 * Deliver the frame on the wire and release its message object.
+	 */
+	void finishFrame();
+};
+
+/** Host stand-in for mbed::CAN on a VirtualCANBus
+ *
+ *  Matches the LPC15XX driver and its C_CAN message objects, split by
+ *  CAN_TX_MSG_OBJ_COUNT as in can_msg_obj.h. Transmit objects are sent
+ *  lowest object first and kept in arbitration order, as can_write() does:
+ *  write() turns a frame down if the object it needs holds a frame with a
+ *  higher ID. Each receive object holds a single
+ *  frame: a frame is stored in the lowest valid object whose filter
+ *  accepts it, and if that object still holds an unread frame the old one
+ *  is overwritten and counted in rxOverflows(), like MSGLST. After reset()
+ *  only object 1 is valid and accepts everything, as after
+ *  can_config_rxmsgobj().
+ */
+class CAN {
+public:
+	enum TxStatus {
+		Idle = 0,
+		Available,
+		Busy
+	};
+
+	enum Mode {
+		Reset = 0,
+		Normal,
+		Silent,
+		LocalTest,
+		GlobalTest,
+		SilentTest
+	};
+
+	enum IrqType {
+		RxIrq = 0,
+		TxIrq,
+		EwIrq,
+		DoIrq,
+		WuIrq,
+		EpIrq,
+		AlIrq,
+		BeIrq,
+		IdIrq
+	};
+
+	/**
+	 * Connect to the default bus; pins are ignored.
+	 */
+	CAN(int rd, int td);
+
+	/**
+	 * Connect to a given bus.
+	 */
+	explicit CAN(VirtualCANBus& bus);
+
+	virtual ~CAN();
+
+	int frequency(int hz);
+
+	/**
+	 * @return 1 if the frame took a transmit object, 0 if none was free
+	 */
+	int write(CANMessage msg);
+
+	/**
+	 * @param handle filter handle to read from, 0 for any
+	 * @return 1 if a frame was read, 0 if none was waiting
+	 */
+	int read(CANMessage& msg, int handle = 0);
+
+	/**
+	 * @return number of frames read, up to max
+	 */
+	int read(CANMessage* msgs, int max);
+
+	/**
+	 * @return frames lost since the last call, as counted by rxOverflows()
+	 */
+	int rxLost();
+
+	void reset();
+	TxStatus txstatus();
+	void monitor(bool silent);
+	int mode(Mode mode);
+
+	/**
+	 * Program a receive object; handle 0 takes the first invalid one.
+	 * @return filter handle, 0 if there is no such receive object
+	 */
+	int filter(unsigned int id, unsigned int mask, CANFormat format = CANAny, int handle = 0);
+
+	/**
+	 * Invalidate a receive object.
+	 * @return 1 if handle is a receive object, 0 if not
+	 */
+	int removeFilter(int handle);
+
+	unsigned char rderror();
+	unsigned char tderror();
+
+	void attach(void (*fptr)(void), IrqType type = RxIrq);
+
+	template <typename T>
+	void attach(T* tptr, void (T::*mptr)(void), IrqType type = RxIrq) {
+		if (tptr != NULL && mptr != NULL)
+			irq[type] = [tptr, mptr]() { (tptr->*mptr)(); };
+		else
+			irq[type] = nullptr;
+	}
+
+	/**
+	 * Keep this controller's interrupt handlers from running until a given
+	 * time, as a CPU with interrupts disabled would. Frames still arrive in
+	 * the receive objects meanwhile.
+	 * @param untilNs bus time the interrupts are enabled again
+	 */
+	void holdIrq(uint64_t untilNs);
+
+	/**
+	 * @return frames overwritten in a receive object before they were read
+	 */
+	uint32_t rxOverflows() const { return overflows; }
+
+	/**
+	 * @return frames no receive object accepted
+	 */
+	uint32_t rxFiltered() const { return filtered; }
+
+private:
+	friend class VirtualCANBus;
+
+	struct RxObject {
+		bool valid;
+		unsigned int id;
+		unsigned int mask;
+		CANFormat format;
+		bool newData;
+		bool lost;			// MSGLST
+		CAN_Message msg;
+	};
+
+	struct TxObject {
+		bool pending;
+		CAN_Message msg;
+		uint64_t queuedNs;
+	};
+
+	VirtualCANBus& bus;
+	TxObject tx[CAN_TX_MSG_OBJ_COUNT];
+	RxObject rx[CAN_RX_MSG_OBJ_COUNT];		// object n is rx[n - 1]
+	std::function<void()> irq[9];
+	uint64_t irqHeldUntil;
+	bool rxIrqPending;
+	bool txIrqPending;
+	bool silent;
+	uint32_t overflows;
+	uint32_t overflowsReported;	// overflows as of the last rxLost()
+	uint32_t filtered;
+
+	/**
+	 * @return lowest pending transmit object, or -1
+	 */
+	int nextTx() const;
+
+	/**
+	 * Accept a frame from the bus into a receive object.
+	 * @return true if the RX interrupt should fire
+	 */
+	bool receive(const CAN_Message& msg);
+
+	/**
+	 * Run an interrupt handler, or keep it for later if interrupts are held.
+	 */
+	void interrupt(IrqType type);
+
+	/**
+	 * Run the handlers kept while interrupts were held.
+	 */
+	void releaseIrq();
+};
+
+#endif /* TOOLS_CAN_SIM_CAN_SIM_H_ */
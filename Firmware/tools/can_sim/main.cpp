@@ -0,0 +1,811 @@
+/*
+ * main.cpp
+ *
+ * can_sim: run the periodic traffic of the boards in can_id.h on a virtual
+ * bus and report load, latency and receive overflows.
+ *
+ * Usage: can_sim [-t seconds] [-l loopUs] [-f framesPerMs] [-c]
+ *        can_sim -i bytes [-t seconds] [-l loopUs] [-b blockSize] [-s stMin]
+ *        can_sim -u boards [-k kilobytes] [-l loopUs]
+ *        can_sim -y [-t seconds] [-l loopUs] [-j jitterUs]
+ *        can_sim -p burstFrames [-t seconds] [-l loopUs]
+ */
+
+#include <mbed.h>
+#include <can_buffer.h>
+#include <can_isotp.h>
+#include <can_filter.h>
+#include <can_flash_loader.h>
+#include <can_time_sync.h>
+#include <can_scheduler.h>
+#include <CAN/can_id.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Board firmware is modelled as a main loop that drains its receive buffer
+// and writes whatever periodic messages are due
+struct SimBoard {
+	const char* name;
+	std::vector<BRIZO_CAN::can_message_info> messages;
+	std::vector<uint32_t> lastSent;
+	CAN can;
+	CANRXTXBuffer<32, 16> buffer;
+	uint64_t received;
+	uint64_t rejected;
+	// Send through a CANScheduler instead of all at once
+	bool scheduled;
+	CANScheduler schedule;
+
+	SimBoard(const char* name, VirtualCANBus& bus, bool scheduled = false) :
+			name(name), can(bus), buffer(can), received(0), rejected(0), scheduled(scheduled) {
+		can.attach(&buffer, &CANRXTXBuffer<32, 16>::handleIrq, CAN::RxIrq);
+		can.attach(&buffer, &CANRXTXBuffer<32, 16>::handleIrq, CAN::TxIrq);
+	}
+
+	// The scheduler's send callbacks take no arguments, so the loop tells
+	// which messages were due from their sent counters instead
+	static void noteDue() {}
+
+	void add(const BRIZO_CAN::can_message_info& info) {
+		messages.push_back(info);
+		lastSent.push_back(0);
+		if (scheduled)
+			schedule.add(info, noteDue);
+	}
+
+	void loop(uint32_t nowUs, bool first) {
+		CANMessage msg;
+		while (buffer.read(msg))
+			received++;
+
+		if (scheduled) {
+			if (first)
+				schedule.start(nowUs);
+			schedule.onTick(nowUs);
+		}
+		for (size_t i = 0; i < messages.size(); i++) {
+			if (scheduled) {
+				if (schedule.frame(i).sent == lastSent[i])
+					continue;
+				lastSent[i] = schedule.frame(i).sent;
+			} else {
+				// Same check as TimingCommon::onTick(), all starting together
+				if (!first && nowUs - lastSent[i] <= messages[i].RATE)
+					continue;
+				lastSent[i] = nowUs;
+			}
+			CANMessage out;
+			out.id = messages[i].ID;
+			out.len = 8;
+			if (!buffer.write(out))
+				rejected++;
+		}
+	}
+};
+
+static void usage() {
+	fprintf(stderr, "usage: can_sim [-t seconds] [-l loopUs] [-f framesPerMs] [-c]\n");
+	fprintf(stderr, "  -t  simulated time to run (default 10)\n");
+	fprintf(stderr, "  -l  main loop period of every board in us (default 1000)\n");
+	fprintf(stderr, "  -f  extra 8-byte frames per ms from a flooding node at ID 0x7FF\n");
+	fprintf(stderr, "  -c  boards send through a CANScheduler each, and the offsets are printed\n");
+	fprintf(stderr, "  -i  instead, send ISO-TP transfers of this many bytes back to back between two nodes\n");
+	fprintf(stderr, "  -b  ISO-TP block size the receiver asks for (default 0, no limit)\n");
+	fprintf(stderr, "  -s  ISO-TP separation time the receiver asks for (default 0)\n");
+	fprintf(stderr, "  -u  instead, update this many boards (1 to 8) at once through their bootloaders\n");
+	fprintf(stderr, "  -k  image size in kB for -u (default 64)\n");
+	fprintf(stderr, "  -y  instead, sync the clocks of the DEMO, DASH and WHEEL boards to a telemetry node\n");
+	fprintf(stderr, "  -j  worst interrupt latency in us for -y (default 10)\n");
+	fprintf(stderr, "  -p  instead, queue bursts of this many diagnostic frames next to periodic traffic\n");
+	fprintf(stderr, "      and report the delay per priority class\n");
+}
+
+typedef CANIsoTp<CANRXTXBuffer<32, 16> > IsoTp;
+
+// One node streams ISO-TP transfers to another; both loops run every loopUs
+static int runIsoTp(double seconds, uint32_t loopUs, int transferBytes, int blockSize, int stMin) {
+	VirtualCANBus& bus = VirtualCANBus::defaultBus();
+	SimBoard sender("TX", bus);
+	SimBoard receiver("RX", bus);
+
+	std::vector<uint8_t> data(transferBytes);
+	std::vector<uint8_t> received(transferBytes);
+	for (int i = 0; i < transferBytes; i++)
+		data[i] = (uint8_t)(i * 7 + 1);
+
+	IsoTp txSide(sender.buffer);
+	IsoTp rxSide(receiver.buffer);
+	int txSession = txSide.open(0x640, 0x648, NULL, 0);
+	int rxSession = rxSide.open(0x648, 0x640, &received[0], transferBytes, blockSize, stMin);
+
+	uint64_t endNs = (uint64_t)(seconds * 1e9);
+	uint64_t transfers = 0;
+	uint64_t failures = 0;
+	txSide.send(txSession, &data[0], transferBytes, bus.nowUs());
+	while (bus.nowNs() < endNs) {
+		uint32_t now = bus.nowUs();
+		CANMessage msg;
+		while (receiver.buffer.read(msg))
+			rxSide.handle(msg, now);
+		rxSide.poll(now);
+		if (rxSide.rxStatus(rxSession) == IsoTp::DONE) {
+			if (rxSide.received(rxSession) == transferBytes && received == data)
+				transfers++;
+			else
+				failures++;
+			rxSide.release(rxSession);
+		} else if (rxSide.rxStatus(rxSession) == IsoTp::ERROR) {
+			failures++;
+			rxSide.release(rxSession);
+		}
+
+		while (sender.buffer.read(msg))
+			txSide.handle(msg, now);
+		txSide.poll(now);
+		if (txSide.txStatus(txSession) != IsoTp::BUSY)
+			txSide.send(txSession, &data[0], transferBytes, now);
+
+		bus.run(bus.nowNs() + loopUs * 1000ULL);
+	}
+
+	double elapsed = bus.nowNs() / 1e9;
+	double payload = transfers * (double)transferBytes / elapsed;
+	// Best case: 8-byte frames carrying 7 bytes each, without stuff bits
+	double lineRate = CAN_FREQUENCY / 111.0 * 7;
+	printf("%.3f s simulated at %u bit/s, bus load %.2f %%\n", elapsed, (unsigned)CAN_FREQUENCY, bus.load() * 100);
+	printf("%llu transfers of %d bytes, %llu failed\n", (unsigned long long)transfers, transferBytes, (unsigned long long)failures);
+	printf("payload throughput %.0f bytes/s, %.1f %% of the %.0f bytes/s 7-bytes-per-frame limit\n",
+			payload, payload / lineRate * 100, lineRate);
+	return failures == 0 ? 0 : 1;
+}
+
+// Application area of the simulated boards; the bootloader has the first 32 kB
+static const uint32_t APP_START = 0x8000;
+static const int MAX_UPDATE_BOARDS = 8;
+
+typedef CANIsoTp<CANRXTXBuffer<32, 16>, MAX_UPDATE_BOARDS> UpdaterIsoTp;
+
+// A board sitting in its bootloader, running the loop from can_flash_loader.h
+struct SimBootloader {
+	SimBoard board;
+	IAP::SimFlash flash;
+	CANFlashLoader loader;
+	IsoTp isotp;
+	uint8_t request[CAN_FLASH_REQUEST_SIZE];
+	int session;
+	int replyLen;
+	bool pageWritten;
+	uint64_t busyUntilNs;
+
+	SimBootloader(const char* name, VirtualCANBus& bus, uint32_t requestId, uint32_t replyId) :
+			board(name, bus), loader(APP_START, IAP::FLASH_SIZE), isotp(board.buffer), replyLen(-1), pageWritten(false), busyUntilNs(0) {
+		session = isotp.open(replyId, requestId, request, sizeof(request), 1);
+
+		// Requests get a message object of their own, so traffic for the
+		// other boards cannot overwrite one while a page is written
+		BRIZO_CAN::can_message_info subscription = { (int)requestId, 0 };
+		CANFilterPlan plan;
+		plan.plan(&subscription, 1);
+		plan.install(board.can);
+	}
+
+	void loop(uint64_t nowNs) {
+		// The CPU is stalled while IAP erases or writes
+		if (nowNs < busyUntilNs)
+			return;
+		uint32_t now = (uint32_t)(nowNs / 1000);
+		uint64_t busyBefore = flash.busyNs;
+		IAP::select(flash);
+
+		// A reply written after erasing goes out once the erase is over
+		if (replyLen >= 0) {
+			isotp.send(session, loader.reply(), replyLen, now);
+			replyLen = -1;
+		}
+
+		// The flow control held while the last page was written goes out
+		// once the write is over
+		if (pageWritten) {
+			isotp.hold(session, false);
+			isotp.poll(now);
+			pageWritten = false;
+		}
+
+		isotp.hold(session, true);
+		CANMessage msg;
+		while (board.buffer.read(msg))
+			isotp.handle(msg, now);
+		isotp.poll(now);
+		if (isotp.rxStatus(session) == IsoTp::DONE) {
+			int len = loader.request(request, isotp.received(session));
+			if (len >= 0) {
+				isotp.release(session);
+				if (flash.busyNs == busyBefore)
+					isotp.send(session, loader.reply(), len, now);
+				else
+					replyLen = len;
+			}
+		}
+		if (isotp.flowControlHeld(session) || isotp.rxStatus(session) != IsoTp::BUSY)
+			pageWritten = loader.poll();
+		// Frame by frame only while pages are left to write
+		isotp.setBlockSize(session, loader.writing() ? 1 : 0);
+		if (!pageWritten) {
+			isotp.hold(session, false);
+			isotp.poll(now);
+		}
+		busyUntilNs = nowNs + flash.busyNs - busyBefore;
+
+		// IAP runs with interrupts disabled, so CAN interrupts wait too
+		if (busyUntilNs > nowNs)
+			board.can.holdIrq(busyUntilNs);
+	}
+};
+
+// The update tool's view of one board
+struct UpdateTarget {
+	int session;
+	uint8_t step;				// CANFlashLoader::Command being sent or waited for, 0 when finished
+	bool sendPending;
+	bool failed;
+	bool rangeChecked;			// answered OUT_OF_RANGE to a START past the application area
+	uint32_t offset;
+	uint8_t request[CAN_FLASH_REQUEST_SIZE];
+	uint16_t requestLen;
+	uint8_t reply[CAN_FLASH_REPLY_SIZE];
+	uint64_t sentNs;			// when the request was handed to ISO-TP
+	uint64_t doneNs;
+};
+
+static uint32_t replyValue(const uint8_t* reply) {
+	return reply[2] | (reply[3] << 8) | (reply[4] << 16) | ((uint32_t)reply[5] << 24);
+}
+
+static void putU32(uint8_t* data, uint32_t value) {
+	data[0] = value & 0xFF;
+	data[1] = (value >> 8) & 0xFF;
+	data[2] = (value >> 16) & 0xFF;
+	data[3] = (value >> 24) & 0xFF;
+}
+
+// Build the next request for a target after its last reply
+static void nextRequest(UpdateTarget& t, const std::vector<uint8_t>& image) {
+	t.request[0] = t.step;
+	t.requestLen = 1;
+	if (t.step == CANFlashLoader::START) {
+		CRC32Update crc;
+		crc.update(const_cast<uint8_t*>(&image[0]), image.size());
+		// The first START asks for a sector past the end of the area, which
+		// must be refused without erasing anything
+		putU32(t.request + 1, t.rangeChecked ? APP_START : IAP::FLASH_SIZE + IAP::FLASH_SECTOR_SIZE);
+		putU32(t.request + 5, image.size());
+		putU32(t.request + 9, crc.read());
+		t.requestLen = 13;
+	} else if (t.step == CANFlashLoader::DATA) {
+		uint32_t bytes = image.size() - t.offset;
+		if (bytes > CAN_FLASH_SEGMENT_SIZE)
+			bytes = CAN_FLASH_SEGMENT_SIZE;
+		putU32(t.request + 1, t.offset);
+		memcpy(t.request + 5, &image[t.offset], bytes);
+		t.requestLen = 5 + bytes;
+	}
+	t.sendPending = true;
+}
+
+// One tool node updates several bootloaders at once, each through its own
+// ISO-TP session
+static int runUpdate(uint32_t loopUs, int numBoards, int kilobytes) {
+	VirtualCANBus& bus = VirtualCANBus::defaultBus();
+	SimBoard tool("TOOL", bus);
+	UpdaterIsoTp isotp(tool.buffer);
+
+	std::vector<uint8_t> image(kilobytes * 1024);
+	for (size_t i = 0; i < image.size(); i++)
+		image[i] = (uint8_t)(i * 31 + (i >> 8));
+
+	std::vector<SimBootloader*> boards;
+	std::vector<UpdateTarget> targets(numBoards);
+	for (int b = 0; b < numBoards; b++) {
+		uint32_t requestId = 0x610 + 0x10 * b;
+		boards.push_back(new SimBootloader("BOOT", bus, requestId, requestId + 8));
+		UpdateTarget& t = targets[b];
+		memset(&t, 0, sizeof(t));
+		t.session = isotp.open(requestId, requestId + 8, t.reply, sizeof(t.reply));
+		t.step = CANFlashLoader::START;
+		nextRequest(t, image);
+	}
+
+	// Give up well after a worst case 256 kB update, and on a board that
+	// has not answered well after erasing 256 kB
+	const uint64_t limitNs = 60000000000ULL;
+	const uint64_t replyTimeoutNs = 10000000000ULL;
+	int remaining = numBoards;
+	int streaming = -1;			// board a DATA request is being sent to
+	while (remaining > 0 && bus.nowNs() < limitNs) {
+		uint32_t now = bus.nowUs();
+		CANMessage msg;
+		while (tool.buffer.read(msg))
+			isotp.handle(msg, now);
+		isotp.poll(now);
+
+		for (int b = 0; b < numBoards; b++) {
+			UpdateTarget& t = targets[b];
+			if (t.step == 0)
+				continue;
+			bool noReply = !t.sendPending && bus.nowNs() - t.sentNs > replyTimeoutNs;
+			if (isotp.txStatus(t.session) == UpdaterIsoTp::ERROR || noReply) {
+				fprintf(stderr, "board %d: command %d %s rx=%d ov=%u at %llu\n", b, t.step,
+						noReply ? "got no reply" : "timed out", boards[b]->isotp.rxStatus(boards[b]->session),
+						(unsigned)boards[b]->board.can.rxOverflows(), (unsigned long long)bus.nowNs());
+				t.failed = true;
+				t.step = 0;
+				remaining--;
+				if (streaming == b)
+					streaming = -1;
+				continue;
+			}
+			if (isotp.rxStatus(t.session) == UpdaterIsoTp::DONE) {
+				isotp.release(t.session);
+				if (streaming == b)
+					streaming = -1;
+				if (t.step == CANFlashLoader::START && !t.rangeChecked) {
+					if (t.reply[1] != CANFlashLoader::OUT_OF_RANGE || boards[b]->flash.erases != 0) {
+						fprintf(stderr, "board %d: START past the application area answered %d after %u erases\n",
+								b, t.reply[1], (unsigned)boards[b]->flash.erases);
+						t.failed = true;
+						t.step = 0;
+					} else {
+						t.rangeChecked = true;
+					}
+				} else if (t.reply[1] != CANFlashLoader::OK) {
+					fprintf(stderr, "board %d: command %d failed with %d\n", b, t.step, t.reply[1]);
+					t.failed = true;
+					t.step = 0;
+				} else if (t.step == CANFlashLoader::START) {
+					t.step = CANFlashLoader::DATA;
+				} else if (t.step == CANFlashLoader::DATA) {
+					t.offset = replyValue(t.reply);
+					if (t.offset >= image.size())
+						t.step = CANFlashLoader::VERIFY;
+				} else if (t.step == CANFlashLoader::VERIFY) {
+					t.step = CANFlashLoader::BOOT;
+				} else {
+					t.step = 0;
+				}
+				if (t.step != 0) {
+					nextRequest(t, image);
+				} else {
+					t.doneNs = bus.nowNs();
+					remaining--;
+				}
+			}
+			// One segment on its way at a time, until its board answers: a
+			// board's flow control and replies lose arbitration to the tool's
+			// frames for the boards with lower IDs, and would wait for every
+			// stream to end. The end of a segment may still sit in the
+			// transmit objects once ISO-TP has handed it over, and the next
+			// segment for a board with a lower ID would go out first.
+			if (t.sendPending && isotp.txStatus(t.session) != UpdaterIsoTp::BUSY
+					&& (t.step != CANFlashLoader::DATA || streaming < 0)
+					&& isotp.send(t.session, t.request, t.requestLen, now) == 0) {
+				t.sendPending = false;
+				t.sentNs = bus.nowNs();
+				if (t.step == CANFlashLoader::DATA)
+					streaming = b;
+			}
+		}
+		isotp.poll(now);
+
+		for (int b = 0; b < numBoards; b++)
+			boards[b]->loop(bus.nowNs());
+		bus.run(bus.nowNs() + loopUs * 1000ULL);
+	}
+
+	double elapsed = bus.nowNs() / 1e9;
+	printf("%d board(s), %d kB image each, %.3f s simulated at %u bit/s, bus load %.2f %%\n\n", numBoards, kilobytes,
+			elapsed, (unsigned)CAN_FREQUENCY, bus.load() * 100);
+	printf("board  done s  image kB/s  erased sectors  pages written  stalled ms  flash\n");
+	int failures = 0;
+	for (int b = 0; b < numBoards; b++) {
+		UpdateTarget& t = targets[b];
+		SimBootloader& board = *boards[b];
+		bool match = memcmp(&board.flash.memory[APP_START], &image[0], image.size()) == 0;
+		bool ok = !t.failed && t.step == 0 && match && board.loader.bootRequested();
+		if (!ok)
+			failures++;
+		double doneS = t.doneNs / 1e9;
+		printf("%5d  %6.3f  %10.1f  %14u  %13u  %10.1f  %s\n", b, doneS, ok ? kilobytes / doneS : 0.0,
+				(unsigned)board.flash.erases, (unsigned)board.flash.writes, board.flash.busyNs / 1e6,
+				ok ? "ok" : "FAILED");
+		delete boards[b];
+	}
+	return failures == 0 ? 0 : 1;
+}
+
+// Free-running board clock, off by a fixed rate and offset from bus time
+struct SimClock {
+	double ppm;
+	uint32_t offsetUs;
+	uint32_t jitterUs;
+
+	uint32_t now() const {
+		return offsetUs + (uint32_t)(VirtualCANBus::defaultBus().nowNs() * (1 + ppm * 1e-6) / 1000);
+	}
+
+	// Time as read first thing in an interrupt handler: usually a little
+	// late, and now and then very late behind a critical section
+	uint32_t interruptNow() const {
+		uint32_t late = jitterUs ? rand() % (jitterUs + 1) : 0;
+		if (rand() % 100 == 0)
+			late += 500;
+		return now() + late;
+	}
+};
+
+// The telemetry node, sending SYNC every second
+struct SyncMaster {
+	SimBoard board;
+	SimClock clock;
+	TimingCommon timing;
+	CANTimeSync sync;
+	uint32_t lastSync;
+
+	SyncMaster(VirtualCANBus& bus, uint32_t jitterUs) : board("TELEM", bus), sync(timing), lastSync(0) {
+		clock.ppm = 0;
+		clock.offsetUs = 0;
+		clock.jitterUs = jitterUs;
+		board.can.attach(this, &SyncMaster::handleTx, CAN::TxIrq);
+	}
+
+	void handleTx() {
+		sync.txComplete(clock.interruptNow());
+		board.buffer.handleIrq();
+	}
+
+	void loop(bool first) {
+		uint32_t now = clock.now();
+		board.loop(now, first);
+		if ((first || now - lastSync >= BRIZO_CAN::TELEMETRY_TIME_SYNC.RATE) && sync.sendSync(board.can, now) == 0)
+			lastSync = now;
+		CANMessage followUp;
+		if (sync.followUp(followUp))
+			board.buffer.write(followUp);
+	}
+};
+
+// A board disciplining its TimingCommon to the telemetry node
+struct SyncSlave {
+	SimBoard board;
+	SimClock clock;
+	TimingCommon timing;
+	CANTimeSync sync;
+	double maxError;
+	double totalError;
+	uint64_t checks;
+
+	SyncSlave(const char* name, VirtualCANBus& bus, double ppm, uint32_t offsetUs, uint32_t jitterUs) :
+			board(name, bus), sync(timing), maxError(0), totalError(0), checks(0) {
+		clock.ppm = ppm;
+		clock.offsetUs = offsetUs;
+		clock.jitterUs = jitterUs;
+	}
+
+	void loop(bool first, uint32_t masterNow) {
+		uint32_t now = clock.now();
+		CANMessage msg;
+		while (board.buffer.read(msg)) {
+			if (!sync.handle(msg))
+				board.received++;
+		}
+		// Keep sending this board's own traffic
+		std::vector<uint32_t>& last = board.lastSent;
+		for (size_t i = 0; i < board.messages.size(); i++) {
+			if (!first && now - last[i] <= board.messages[i].RATE)
+				continue;
+			last[i] = now;
+			CANMessage out;
+			out.id = board.messages[i].ID;
+			out.len = 8;
+			if (!board.buffer.write(out))
+				board.rejected++;
+		}
+
+		// Once settled, compare the network time with the master's clock
+		if (sync.samples() > 4) {
+			double error = fabs((double)(int32_t)(timing.globalTime(now) - masterNow));
+			if (error > maxError)
+				maxError = error;
+			totalError += error;
+			checks++;
+		}
+	}
+};
+
+static SyncSlave* syncSlaves[3];
+
+template <int N>
+static void stampSync(const CANMessage& msg) {
+	syncSlaves[N]->sync.rxFrame(msg, syncSlaves[N]->clock.interruptNow());
+}
+
+static int runTimeSync(double seconds, uint32_t loopUs, uint32_t jitterUs) {
+	VirtualCANBus& bus = VirtualCANBus::defaultBus();
+	srand(1);
+
+	SyncMaster master(bus, jitterUs);
+	syncSlaves[0] = new SyncSlave("DEMO", bus, 42.0, 123456789, jitterUs);
+	syncSlaves[0]->board.add(BRIZO_CAN::DEMO_HEART);
+	syncSlaves[1] = new SyncSlave("DASH", bus, -87.5, 3000000000U, jitterUs);
+	syncSlaves[1]->board.add(BRIZO_CAN::DASH_HEART);
+	syncSlaves[1]->board.add(BRIZO_CAN::DASH_DRIVE_DIR_AND_BRAKE);
+	syncSlaves[1]->board.add(BRIZO_CAN::DASH_LIGHT_SET_STATES);
+	syncSlaves[1]->board.add(BRIZO_CAN::DASH_PERIPHERALS_STATES);
+	syncSlaves[1]->board.add(BRIZO_CAN::DASH_LIGHT_OUTPUT);
+	syncSlaves[2] = new SyncSlave("WHEEL", bus, 12.3, 77, jitterUs);
+	syncSlaves[2]->board.add(BRIZO_CAN::WHEEL_HEART);
+	syncSlaves[2]->board.add(BRIZO_CAN::WHEEL_TEMPS);
+	syncSlaves[2]->board.add(BRIZO_CAN::WHEEL_TURN_SIGNALS_HORN);
+	syncSlaves[2]->board.add(BRIZO_CAN::WHEEL_RAWBTN);
+	syncSlaves[0]->board.buffer.setRxHook(stampSync<0>);
+	syncSlaves[1]->board.buffer.setRxHook(stampSync<1>);
+	syncSlaves[2]->board.buffer.setRxHook(stampSync<2>);
+
+	uint64_t endNs = (uint64_t)(seconds * 1e9);
+	bool first = true;
+	while (bus.nowNs() < endNs) {
+		master.loop(first);
+		for (int b = 0; b < 3; b++)
+			syncSlaves[b]->loop(first, master.clock.now());
+		first = false;
+		bus.run(bus.nowNs() + loopUs * 1000ULL);
+	}
+
+	printf("%.3f s simulated at %u bit/s, bus load %.2f %%, interrupt latency up to %u us\n\n", bus.nowNs() / 1e9,
+			(unsigned)CAN_FREQUENCY, bus.load() * 100, (unsigned)jitterUs);
+	printf("board  clock ppm  estimated ppm  samples  rejected  mean error us  max error us\n");
+	int failures = 0;
+	for (int b = 0; b < 3; b++) {
+		SyncSlave& slave = *syncSlaves[b];
+		// The estimate is of the master's rate relative to the board's
+		double estimated = -slave.sync.rateErrorPpb() / 1000.0;
+		printf("%-6s %9.1f  %13.2f  %7u  %8u  %13.1f  %12.1f\n", slave.board.name, slave.clock.ppm, estimated,
+				(unsigned)slave.sync.samples(), (unsigned)slave.sync.rejected(),
+				slave.checks ? slave.totalError / slave.checks : 0.0, slave.maxError);
+		if (slave.checks == 0)
+			failures++;
+		delete syncSlaves[b];
+	}
+	return failures == 0 ? 0 : 1;
+}
+
+// Delay from CANRXTXBuffer::write() to the end of the frame, for the IDs
+// sharing their top three bits
+struct PriorityClass {
+	uint64_t frames;
+	uint64_t rejected;
+	uint64_t totalNs;
+	uint64_t maxNs;
+	uint32_t worstId;
+};
+
+static const int PRIORITY_CLASSES = 8;
+static VirtualCANBus* priorityBus;
+static PriorityClass priorityClasses[PRIORITY_CLASSES];
+// Write time of every frame, by the sequence number in its first 4 bytes
+static std::vector<uint64_t> priorityWrittenNs;
+
+static void stampPriority(const CANMessage& msg) {
+	uint32_t seq = msg.data[0] | (msg.data[1] << 8) | (msg.data[2] << 16) | ((uint32_t)msg.data[3] << 24);
+	uint64_t delay = priorityBus->nowNs() - priorityWrittenNs[seq];
+	PriorityClass& c = priorityClasses[(msg.id >> 8) & (PRIORITY_CLASSES - 1)];
+	c.frames++;
+	c.totalNs += delay;
+	if (delay > c.maxNs) {
+		c.maxNs = delay;
+		c.worstId = msg.id;
+	}
+}
+
+static void writeSequenced(SimBoard& board, uint32_t id) {
+	uint32_t seq = priorityWrittenNs.size();
+	priorityWrittenNs.push_back(priorityBus->nowNs());
+	CANMessage out;
+	out.id = id;
+	out.len = 8;
+	putU32(out.data, seq);
+	if (!board.buffer.write(out)) {
+		board.rejected++;
+		priorityClasses[(id >> 8) & (PRIORITY_CLASSES - 1)].rejected++;
+	}
+}
+
+// One board queues bursts of diagnostics next to its periodic traffic, a
+// second one receives everything
+static int runPriority(double seconds, uint32_t loopUs, int burst) {
+	VirtualCANBus& bus = VirtualCANBus::defaultBus();
+	priorityBus = &bus;
+	SimBoard sender("TX", bus);
+	sender.add(BRIZO_CAN::WHEEL_HEART);
+	sender.add(BRIZO_CAN::WHEEL_TEMPS);
+	sender.add(BRIZO_CAN::DASH_DRIVE_DIR_AND_BRAKE);
+	sender.add(BRIZO_CAN::DASH_LIGHT_SET_STATES);
+	sender.add(BRIZO_CAN::WHEEL_TURN_SIGNALS_HORN);
+	sender.add(BRIZO_CAN::DASH_PERIPHERALS_STATES);
+	SimBoard receiver("RX", bus);
+	receiver.buffer.setRxHook(stampPriority);
+
+	uint64_t endNs = (uint64_t)(seconds * 1e9);
+	uint32_t lastBurst = 0;
+	bool first = true;
+	while (bus.nowNs() < endNs) {
+		uint32_t now = bus.nowUs();
+		CANMessage msg;
+		while (receiver.buffer.read(msg))
+			receiver.received++;
+
+		// Diagnostics go out as a burst every WHEEL_RAWBTN period, written
+		// before the periodic frames due in the same pass
+		if (first || now - lastBurst > BRIZO_CAN::WHEEL_RAWBTN.RATE) {
+			lastBurst = now;
+			for (int i = 0; i < burst; i++)
+				writeSequenced(sender, BRIZO_CAN::WHEEL_RAWBTN.ID + i % 15);
+		}
+		for (size_t i = 0; i < sender.messages.size(); i++) {
+			if (!first && now - sender.lastSent[i] <= sender.messages[i].RATE)
+				continue;
+			sender.lastSent[i] = now;
+			writeSequenced(sender, sender.messages[i].ID);
+		}
+		first = false;
+		bus.run(bus.nowNs() + loopUs * 1000ULL);
+	}
+
+	printf("%.3f s simulated at %u bit/s, bus load %.2f %%, %d diagnostic frames every %u us, %d transmit objects\n\n",
+			bus.nowNs() / 1e9, (unsigned)CAN_FREQUENCY, bus.load() * 100, burst,
+			(unsigned)BRIZO_CAN::WHEEL_RAWBTN.RATE, CAN_TX_MSG_OBJ_COUNT);
+	printf("class     frames  rejected  mean delay us  max delay us  worst ID\n");
+	for (int i = 0; i < PRIORITY_CLASSES; i++) {
+		const PriorityClass& c = priorityClasses[i];
+		if (c.frames == 0 && c.rejected == 0)
+			continue;
+		printf("0x%X##  %9llu  %8llu  %13.1f  %12.1f     0x%03X\n", i, (unsigned long long)c.frames,
+				(unsigned long long)c.rejected, c.frames ? c.totalNs / 1e3 / c.frames : 0.0, c.maxNs / 1e3,
+				(unsigned)c.worstId);
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	double seconds = 10;
+	uint32_t loopUs = 1000;
+	int flood = 0;
+	int isotpBytes = 0;
+	int blockSize = 0;
+	int stMin = 0;
+	int updateBoards = 0;
+	int kilobytes = 64;
+	bool timeSync = false;
+	bool scheduled = false;
+	uint32_t jitterUs = 10;
+	int burst = 0;
+	for (int arg = 1; arg < argc; arg++) {
+		if (arg + 1 < argc && strcmp(argv[arg], "-t") == 0) {
+			seconds = atof(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-l") == 0) {
+			loopUs = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-f") == 0) {
+			flood = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-i") == 0) {
+			isotpBytes = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-b") == 0) {
+			blockSize = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-s") == 0) {
+			stMin = strtol(argv[++arg], NULL, 0);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-u") == 0) {
+			updateBoards = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-k") == 0) {
+			kilobytes = atoi(argv[++arg]);
+		} else if (strcmp(argv[arg], "-c") == 0) {
+			scheduled = true;
+		} else if (strcmp(argv[arg], "-y") == 0) {
+			timeSync = true;
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-j") == 0) {
+			jitterUs = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-p") == 0) {
+			burst = atoi(argv[++arg]);
+		} else {
+			usage();
+			return 2;
+		}
+	}
+	if (loopUs < 1)
+		loopUs = 1;
+	if (isotpBytes > CAN_ISOTP_MAX_LENGTH) {
+		usage();
+		return 2;
+	}
+	if (isotpBytes > 0)
+		return runIsoTp(seconds, loopUs, isotpBytes, blockSize, stMin);
+	if (updateBoards > MAX_UPDATE_BOARDS || kilobytes < 1 || kilobytes * 1024 > (int)(IAP::FLASH_SIZE - APP_START)) {
+		usage();
+		return 2;
+	}
+	if (updateBoards > 0)
+		return runUpdate(loopUs, updateBoards, kilobytes);
+	if (timeSync)
+		return runTimeSync(seconds, loopUs, jitterUs);
+	if (burst > 0)
+		return runPriority(seconds, loopUs, burst);
+
+	VirtualCANBus& bus = VirtualCANBus::defaultBus();
+
+	SimBoard demo("DEMO", bus, scheduled);
+	demo.add(BRIZO_CAN::DEMO_HEART);
+
+	SimBoard dash("DASH", bus, scheduled);
+	dash.add(BRIZO_CAN::DASH_HEART);
+	dash.add(BRIZO_CAN::DASH_DRIVE_DIR_AND_BRAKE);
+	dash.add(BRIZO_CAN::DASH_LIGHT_SET_STATES);
+	dash.add(BRIZO_CAN::DASH_PERIPHERALS_STATES);
+	dash.add(BRIZO_CAN::DASH_LIGHT_OUTPUT);
+
+	SimBoard wheel("WHEEL", bus, scheduled);
+	wheel.add(BRIZO_CAN::WHEEL_HEART);
+	wheel.add(BRIZO_CAN::WHEEL_TEMPS);
+	wheel.add(BRIZO_CAN::WHEEL_TURN_SIGNALS_HORN);
+	wheel.add(BRIZO_CAN::WHEEL_RAWBTN);
+	wheel.add(BRIZO_CAN::WHEEL_CAN_STATS);
+	wheel.add(BRIZO_CAN::WHEEL_CAN_STATS_ID);
+
+	SimBoard* boards[] = { &demo, &dash, &wheel };
+	const int numBoards = sizeof(boards) / sizeof(boards[0]);
+	CAN flooder(bus);
+
+	uint64_t endNs = (uint64_t)(seconds * 1e9);
+	uint64_t nextFloodNs = 0;
+	bool first = true;
+	while (bus.nowNs() < endNs) {
+		for (int b = 0; b < numBoards; b++)
+			boards[b]->loop(bus.nowUs(), first);
+		first = false;
+
+		uint64_t nextNs = bus.nowNs() + loopUs * 1000ULL;
+		while (flood > 0 && nextFloodNs < nextNs) {
+			bus.run(nextFloodNs);
+			flooder.write(CANMessage(0x7FF, "floodfld", 8));
+			nextFloodNs += 1000000 / flood;
+		}
+		bus.run(nextNs);
+	}
+
+	printf("%.3f s simulated at %u bit/s, bus load %.2f %%\n\n", bus.nowNs() / 1e9, (unsigned)CAN_FREQUENCY, bus.load() * 100);
+	printf("   ID     frames  bits/frame  mean latency us  max latency us\n");
+	const std::map<uint32_t, CANSimIdStats>& stats = bus.idStats();
+	for (std::map<uint32_t, CANSimIdStats>::const_iterator it = stats.begin(); it != stats.end(); ++it) {
+		const CANSimIdStats& s = it->second;
+		printf("0x%03X %10llu  %10.1f  %15.1f  %14.1f\n", (unsigned)it->first, (unsigned long long)s.frames,
+				(double)s.bits / s.frames, s.totalLatencyNs / 1e3 / s.frames, s.maxLatencyNs / 1e3);
+	}
+
+	printf("\nboard   received  rx overflows  tx rejected\n");
+	for (int b = 0; b < numBoards; b++) {
+		printf("%-6s %9llu  %12u  %11llu\n", boards[b]->name, (unsigned long long)boards[b]->received,
+				(unsigned)boards[b]->can.rxOverflows(), (unsigned long long)boards[b]->rejected);
+	}
+
+	if (scheduled) {
+		printf("\nboard     ID   period us  offset us\n");
+		for (int b = 0; b < numBoards; b++) {
+			for (int i = 0; i < boards[b]->schedule.size(); i++) {
+				const CANScheduler::Frame& frame = boards[b]->schedule.frame(i);
+				printf("%-6s 0x%03X  %10u  %9u\n", boards[b]->name, (unsigned)frame.id,
+						(unsigned)frame.period, (unsigned)frame.offset);
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * mbed.h
+ * Host replacement for the parts of mbed the common CAN code uses, so
+ * board code can be compiled against the virtual bus in can_sim.h.
+ */
+
+#ifndef TOOLS_CAN_SIM_MBED_H_
+#define TOOLS_CAN_SIM_MBED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <can_lite.h>
+#include "can_sim.h"
+#include "../../mbed/libraries/mbed/api/FunctionPointer.h"
+
+typedef int PinName;
+#define NC ((PinName)0xFFFFFFFF)
+
+// Interrupt handlers run from VirtualCANBus::run(), never concurrently
+static inline void __disable_irq() {}
+static inline void __enable_irq() {}
+static inline uint32_t __get_PRIMASK() { return 0; }
+static inline void __set_PRIMASK(uint32_t) {}
+
+/** mbed Timer counting simulated time on the default bus */
+class Timer {
+public:
+	Timer() : running(false), startUs(0), elapsedUs(0) {}
+
+	void start() {
+		if (!running) {
+			startUs = nowUs();
+			running = true;
+		}
+	}
+
+	void stop() {
+		elapsedUs = read_high_resolution_us();
+		running = false;
+	}
+
+	void reset() {
+		startUs = nowUs();
+		elapsedUs = 0;
+	}
+
+	uint64_t read_high_resolution_us() {
+		return running ? elapsedUs + nowUs() - startUs : elapsedUs;
+	}
+
+	int read_us() { return (int)read_high_resolution_us(); }
+	int read_ms() { return (int)(read_high_resolution_us() / 1000); }
+	float read() { return read_high_resolution_us() / 1000000.0f; }
+
+private:
+	bool running;
+	uint64_t startUs;
+	uint64_t elapsedUs;
+
+	static uint64_t nowUs() { return VirtualCANBus::defaultBus().nowNs() / 1000; }
+};
+
+#endif /* TOOLS_CAN_SIM_MBED_H_ */
@@ -0,0 +1,345 @@
+/*
+ * can_trace.cpp
+ *
+ * canDef.json decode plan and batch decoder.
+ */
+
+#include "can_trace.h"
+#include "json.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+#include <utility>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Payloads are unpacked as little-endian 64-bit words"
+#endif
+
+struct FormatInfo {
+	const char* name;
+	CANSignal::Type type;
+	uint8_t size;
+};
+
+// Data formats the telemetry decoder handles, see CAN/README.md
+static const FormatInfo formats[] = {
+	{ "FloatLE", CANSignal::F32, 4 },
+	{ "Uint64LE", CANSignal::U64, 8 },
+	{ "Int64LE", CANSignal::I64, 8 },
+	{ "Uint32LE", CANSignal::U32, 4 },
+	{ "Int32LE", CANSignal::I32, 4 },
+	{ "Uint16LE", CANSignal::U16, 2 },
+	{ "Uint16", CANSignal::U16, 2 },
+	{ "Int16LE", CANSignal::I16, 2 },
+	{ "Uint8", CANSignal::U8, 1 },
+	{ "Uint8LE", CANSignal::U8, 1 },
+	{ "BitMap8LE", CANSignal::U8, 1 },
+	{ "BitMap16LE", CANSignal::U16, 2 },
+	{ "BitMap32LE", CANSignal::U32, 4 },
+};
+
+static const FormatInfo* findFormat(const std::string& name) {
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		if (name == formats[i].name)
+			return &formats[i];
+	}
+	return NULL;
+}
+
+// Same naming as generate_can_codec.py: 'MCU Temp' -> mcuTemp
+static std::string signalName(const std::string& valueName) {
+	bool identifier = !valueName.empty() && !isdigit((unsigned char)valueName[0]);
+	bool upper = true;
+	for (size_t i = 0; i < valueName.size(); i++) {
+		unsigned char c = valueName[i];
+		if (!isalnum(c) && c != '_')
+			identifier = false;
+		if (islower(c))
+			upper = false;
+	}
+	if (identifier) {
+		std::string name = valueName;
+		if (!upper)
+			name[0] = tolower((unsigned char)name[0]);
+		return name;
+	}
+
+	// Split into words; the first is lower-cased, the rest capitalized
+	std::string name;
+	int word = -1;
+	bool wordStart = true;
+	for (size_t i = 0; i < valueName.size(); i++) {
+		unsigned char c = valueName[i];
+		if (!isalnum(c)) {
+			wordStart = true;
+			continue;
+		}
+		if (wordStart)
+			word++;
+		if (word == 0)
+			name += tolower(c);
+		else
+			name += wordStart ? (char)toupper(c) : (char)c;
+		wordStart = false;
+	}
+	if (!name.empty() && isdigit((unsigned char)name[0]))
+		name = "value" + name;
+	return name;
+}
+
+void CANColumns::append(CANColumns& other) {
+	if (messages.size() < other.messages.size())
+		messages.resize(other.messages.size());
+	for (size_t m = 0; m < other.messages.size(); m++) {
+		CANMessageColumns& to = messages[m];
+		CANMessageColumns& from = other.messages[m];
+		to.timestampUs.insert(to.timestampUs.end(), from.timestampUs.begin(), from.timestampUs.end());
+		if (to.values.size() < from.values.size())
+			to.values.resize(from.values.size());
+		for (size_t s = 0; s < from.values.size(); s++)
+			to.values[s].insert(to.values[s].end(), from.values[s].begin(), from.values[s].end());
+	}
+	unknown += other.unknown;
+	malformed += other.malformed;
+	truncated += other.truncated;
+	other = CANColumns();
+}
+
+CANDecodePlan::CANDecodePlan() {
+	for (uint32_t id = 0; id < STD_ID_COUNT; id++)
+		index[id] = NO_LAYOUT;
+}
+
+int CANDecodePlan::load(const std::string& path, std::string& error) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) {
+		error = "cannot open " + path;
+		return -1;
+	}
+	std::string text;
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		text.append(buffer, n);
+	fclose(file);
+
+	return parse(text, error);
+}
+
+int CANDecodePlan::parse(const std::string& json, std::string& error) {
+	JsonValue root;
+	if (JsonValue::parse(json, root, error) != 0)
+		return -1;
+	if (!root.isObject()) {
+		error = "canDef.json is not an object";
+		return -1;
+	}
+
+	layouts.clear();
+	for (uint32_t id = 0; id < STD_ID_COUNT; id++)
+		index[id] = NO_LAYOUT;
+
+	const std::map<std::string, JsonValue>& entries = root.members();
+	for (std::map<std::string, JsonValue>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+		const std::string& key = it->first;
+		const JsonValue& entry = it->second;
+
+		CANMessageLayout layout;
+		layout.id = strtoul(key.c_str(), NULL, 16);
+		layout.name = entry["DataName"].string(key);
+		layout.size = 0;
+		if (layout.id >= STD_ID_COUNT) {
+			error = key + ": not a standard 11-bit ID";
+			return -1;
+		}
+
+		const JsonValue& format = entry["DataFormat"];
+		const JsonValue& names = entry["ValueNames"];
+		const JsonValue& multiplier = entry["Multiplier"];
+		int count = (int)entry["DataQty"].number(1);
+
+		std::set<std::string> used;
+		for (int i = 0; i < count; i++) {
+			// Scalars apply to every value; short arrays fall back to the defaults
+			std::string formatName = format.isArray() ? format[std::min((size_t)i, format.size() - 1)].string() : format.string();
+			const FormatInfo* info = findFormat(formatName);
+			if (!info) {
+				error = key + ": unknown DataFormat " + formatName;
+				return -1;
+			}
+
+			CANSignal signal;
+			std::string valueName = names.isArray() ? names[i].string() : (i == 0 ? names.string() : "");
+			signal.name = signalName(valueName);
+			if (signal.name.empty()) {
+				char fallback[16];
+				snprintf(fallback, sizeof(fallback), count == 1 ? "value" : "value%d", i);
+				signal.name = fallback;
+			}
+			while (used.count(signal.name))
+				signal.name += "_";
+			used.insert(signal.name);
+
+			signal.type = info->type;
+			signal.size = info->size;
+			signal.offset = layout.size;
+			signal.multiplier = multiplier.isArray() ? multiplier[i].number(1) : multiplier.number(1);
+			layout.size += info->size;
+			layout.signals.push_back(signal);
+		}
+
+		if (layout.size > 8) {
+			error = key + ": payload is longer than 8 bytes";
+			return -1;
+		}
+		if (index[layout.id] != NO_LAYOUT) {
+			error = key + ": ID defined twice";
+			return -1;
+		}
+		index[layout.id] = 0;
+		layouts.push_back(layout);
+	}
+
+	// Keys like "0x60" and "0x060" sort differently from their IDs
+	std::sort(layouts.begin(), layouts.end(),
+			[](const CANMessageLayout& a, const CANMessageLayout& b) { return a.id < b.id; });
+	for (size_t m = 0; m < layouts.size(); m++)
+		index[layouts[m].id] = (int)m;
+
+	return 0;
+}
+
+void CANDecodePlan::prepare(CANColumns& columns) const {
+	columns.messages.resize(layouts.size());
+	for (size_t m = 0; m < layouts.size(); m++)
+		columns.messages[m].values.resize(layouts[m].signals.size());
+}
+
+template <typename T>
+static void unpackColumn(const uint64_t* payloads, size_t count, unsigned shift, double multiplier, double* out) {
+	for (size_t i = 0; i < count; i++)
+		out[i] = (double)(T)(payloads[i] >> shift) * multiplier;
+}
+
+static void unpackFloatColumn(const uint64_t* payloads, size_t count, unsigned shift, double multiplier, double* out) {
+	for (size_t i = 0; i < count; i++) {
+		uint32_t bits = (uint32_t)(payloads[i] >> shift);
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		out[i] = value * multiplier;
+	}
+}
+
+static void unpackSignal(const CANSignal& signal, const uint64_t* payloads, size_t count, double* out) {
+	unsigned shift = signal.offset * 8;
+	switch (signal.type) {
+	case CANSignal::U8: unpackColumn<uint8_t>(payloads, count, shift, signal.multiplier, out); break;
+	case CANSignal::U16: unpackColumn<uint16_t>(payloads, count, shift, signal.multiplier, out); break;
+	case CANSignal::U32: unpackColumn<uint32_t>(payloads, count, shift, signal.multiplier, out); break;
+	case CANSignal::U64: unpackColumn<uint64_t>(payloads, count, shift, signal.multiplier, out); break;
+	case CANSignal::I16: unpackColumn<int16_t>(payloads, count, shift, signal.multiplier, out); break;
+	case CANSignal::I32: unpackColumn<int32_t>(payloads, count, shift, signal.multiplier, out); break;
+	case CANSignal::I64: unpackColumn<int64_t>(payloads, count, shift, signal.multiplier, out); break;
+	case CANSignal::F32: unpackFloatColumn(payloads, count, shift, signal.multiplier, out); break;
+	}
+}
+
+// True if a payload of len bytes holds whole values only
+static bool endsOnSignal(const CANMessageLayout& layout, uint8_t len) {
+	for (size_t s = 0; s < layout.signals.size(); s++) {
+		if (layout.signals[s].offset + layout.signals[s].size == len)
+			return true;
+	}
+	return false;
+}
+
+void CANDecodePlan::decode(const CANMessage* frames, const uint64_t* timestampUs, size_t count, CANColumns& columns) const {
+	if (columns.messages.size() != layouts.size())
+		prepare(columns);
+
+	// Pass 1: classify frames and count them per message
+	std::vector<int> slots(count);
+	std::vector<size_t> starts(layouts.size() + 1, 0);
+	for (size_t i = 0; i < count; i++) {
+		const CANMessage& frame = frames[i];
+		int m = frame.format == CANStandard ? find(frame.id) : NO_LAYOUT;
+		if (m == NO_LAYOUT) {
+			columns.unknown++;
+		} else if (frame.type != CANData || (frame.len < layouts[m].size && !endsOnSignal(layouts[m], frame.len))) {
+			columns.malformed++;
+			m = NO_LAYOUT;
+		} else {
+			if (frame.len < layouts[m].size)
+				columns.truncated++;
+			starts[m + 1]++;
+		}
+		slots[i] = m;
+	}
+	for (size_t m = 0; m < layouts.size(); m++)
+		starts[m + 1] += starts[m];
+
+	// Pass 2: gather payloads into one contiguous run per message, noting
+	// where the short ones went
+	std::vector<uint64_t> payloads(starts[layouts.size()]);
+	std::vector<uint64_t> times(starts[layouts.size()]);
+	std::vector<size_t> next(starts.begin(), starts.end() - 1);
+	std::vector<std::pair<size_t, uint8_t> > shortFrames;
+	for (size_t i = 0; i < count; i++) {
+		int m = slots[i];
+		if (m == NO_LAYOUT)
+			continue;
+		size_t at = next[m]++;
+		memcpy(&payloads[at], frames[i].data, 8);
+		times[at] = timestampUs[i];
+		if (frames[i].len < layouts[m].size)
+			shortFrames.push_back(std::make_pair(at, frames[i].len));
+	}
+
+	// Pass 3: unpack each signal over its message's run
+	for (size_t m = 0; m < layouts.size(); m++) {
+		size_t n = starts[m + 1] - starts[m];
+		if (n == 0)
+			continue;
+
+		CANMessageColumns& out = columns.messages[m];
+		out.timestampUs.insert(out.timestampUs.end(), times.begin() + starts[m], times.begin() + starts[m + 1]);
+		for (size_t s = 0; s < layouts[m].signals.size(); s++) {
+			const CANSignal& signal = layouts[m].signals[s];
+			std::vector<double>& column = out.values[s];
+			size_t old = column.size();
+			column.resize(old + n);
+			unpackSignal(signal, &payloads[starts[m]], n, &column[old]);
+		}
+	}
+
+	// Values the short frames did not carry; shortFrames is in payload order
+	for (size_t f = 0; f < shortFrames.size(); f++) {
+		size_t at = shortFrames[f].first;
+		int m = (int)(std::upper_bound(starts.begin(), starts.end(), at) - starts.begin()) - 1;
+		CANMessageColumns& out = columns.messages[m];
+		size_t row = out.timestampUs.size() - (starts[m + 1] - at);
+		for (size_t s = 0; s < layouts[m].signals.size(); s++) {
+			const CANSignal& signal = layouts[m].signals[s];
+			if (signal.offset + signal.size > shortFrames[f].second)
+				out.values[s][row] = NAN;
+		}
+	}
+}
+
+void canTraceUnpack(const CANTraceRecord* records, size_t count, CANMessage* frames, uint64_t* timestampUs) {
+	for (size_t i = 0; i < count; i++) {
+		const CANTraceRecord& record = records[i];
+		CANMessage& frame = frames[i];
+		frame.id = record.id;
+		frame.len = record.len > 8 ? 8 : record.len;
+		frame.format = (record.flags & CAN_TRACE_EXTENDED) ? CANExtended : CANStandard;
+		frame.type = (record.flags & CAN_TRACE_REMOTE) ? CANRemote : CANData;
+		memcpy(frame.data, record.data, 8);
+		timestampUs[i] = record.timestampUs;
+	}
+}
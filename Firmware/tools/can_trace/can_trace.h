@@ -0,0 +1,174 @@
+/*
+ * can_trace.h
+ * Batch decoding of logged CAN frames into per-signal columns using canDef.json.
+ */
+
+#ifndef TOOLS_CAN_TRACE_CAN_TRACE_H_
+#define TOOLS_CAN_TRACE_CAN_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <can_lite.h>
+
+/** Frame as stored in a binary trace file, 24 bytes, little-endian */
+struct CANTraceRecord {
+	uint64_t timestampUs;
+	uint32_t id;
+	uint8_t len;
+	uint8_t flags;			// CAN_TRACE_EXTENDED | CAN_TRACE_REMOTE | CAN_TRACE_TX
+	uint8_t reserved[2];
+	uint8_t data[8];
+};
+
+static_assert(sizeof(CANTraceRecord) == 24, "Trace record layout changed");
+
+#define CAN_TRACE_EXTENDED 0x01
+#define CAN_TRACE_REMOTE 0x02
+// Sent by the board that recorded the trace rather than received
+#define CAN_TRACE_TX 0x04
+
+/** One value inside a message payload */
+struct CANSignal {
+	enum Type { U8, U16, U32, U64, I16, I32, I64, F32 };
+
+	std::string name;
+	Type type;
+	uint8_t offset;			// byte offset in the payload
+	uint8_t size;			// bytes
+	double multiplier;
+};
+
+/** A message from canDef.json and how to unpack it */
+struct CANMessageLayout {
+	uint32_t id;
+	std::string name;
+	uint8_t size;			// payload bytes all signals span
+	std::vector<CANSignal> signals;
+};
+
+/** Decoded values of one message, one column per signal */
+struct CANMessageColumns {
+	std::vector<uint64_t> timestampUs;
+	std::vector<std::vector<double> > values;
+};
+
+/** Output of decoding, indexed the same as CANDecodePlan::messages() */
+struct CANColumns {
+	std::vector<CANMessageColumns> messages;
+	uint64_t unknown;		// frames with an ID canDef.json does not describe
+	uint64_t malformed;		// remote frames, or frames ending inside a value
+	uint64_t truncated;		// frames missing trailing values, decoded as NaN
+
+	CANColumns() : unknown(0), malformed(0), truncated(0) {}
+
+	/**
+	 * Append another set of columns decoded with the same plan.
+	 * @param other columns to move onto the end of these
+	 */
+	void append(CANColumns& other);
+};
+
+/** canDef.json flattened into an ID-indexed table of layouts
+ *
+ *  Typical usage:
+ *    CANDecodePlan plan;
+ *    std::string error;
+ *    if (plan.load("canDef.json", error) != 0) { ... }
+ *
+ *    CANColumns columns;
+ *    plan.decode(frames, timestamps, count, columns);
+ */
+class CANDecodePlan {
+public:
+	static const int NO_LAYOUT = -1;
+
+	CANDecodePlan();
+
+	/**
+	 * Load the message definitions.
+	 * @param path canDef.json
+	 * @param error set to a description of the problem on failure
+	 * @return 0 on success, -1 on failure
+	 */
+	int load(const std::string& path, std::string& error);
+
+	/**
+	 * Build the plan from canDef.json text.
+	 * @return 0 on success, -1 on failure
+	 */
+	int parse(const std::string& json, std::string& error);
+
+	/**
+	 * @return all layouts, in ID order
+	 */
+	const std::vector<CANMessageLayout>& messages() const { return layouts; }
+
+	/**
+	 * @param id standard 11-bit ID
+	 * @return index into messages(), or NO_LAYOUT
+	 */
+	int find(uint32_t id) const { return id < STD_ID_COUNT ? index[id] : NO_LAYOUT; }
+
+	/**
+	 * Size columns to hold this plan's messages.
+	 */
+	void prepare(CANColumns& columns) const;
+
+	/**
+	 * Decode a batch of frames, appending to columns.
+	 * Frames are grouped by message first, then each signal is unpacked
+	 * from a contiguous run of payloads so the inner loops vectorize.
+	 * Messages grow by appending values, so a frame that stops at the end
+	 * of a value is decoded with the values after it as NaN; e.g. a
+	 * WHEEL_HEART with the uptime only, from older firmware or from
+	 * writeHeartbeat() without a load meter.
+	 * @param frames received frames
+	 * @param timestampUs receive time of each frame
+	 * @param count number of frames
+	 * @param columns output, prepared by prepare()
+	 */
+	void decode(const CANMessage* frames, const uint64_t* timestampUs, size_t count, CANColumns& columns) const;
+
+private:
+	static const uint32_t STD_ID_COUNT = 0x800;
+
+	std::vector<CANMessageLayout> layouts;
+	int index[STD_ID_COUNT];
+};
+
+/**
+ * Convert trace records to frames.
+ * @param records records read from a trace file
+ * @param count number of records
+ * @param frames output, count entries
+ * @param timestampUs output, count entries
+ */
+void canTraceUnpack(const CANTraceRecord* records, size_t count, CANMessage* frames, uint64_t* timestampUs);
+
+/** What canRecorderDecode() found besides the frames */
+struct CANRecorderDumpInfo {
+	uint32_t boots;					// resets recorded since the recorder was cleared
+	std::vector<size_t> bootAt;		// index of the first record after each reset in the dump
+	uint32_t orphans;				// extended frames whose ID slot was overwritten
+
+	CANRecorderDumpInfo() : boots(0), orphans(0) {}
+};
+
+/**
+ * Convert a CANRecorder dump (see can_recorder.h) to trace records.
+ * Times restart after each reset in the dump, so each run is placed after
+ * the previous one, offset by its own time since reset.
+ * @param dump bytes from CANRecorder::dump()
+ * @param bytes size of dump
+ * @param records output, appended to
+ * @param info output
+ * @param error set to a description of the problem on failure
+ * @return 0 on success, -1 if the dump is malformed
+ */
+int canRecorderDecode(const uint8_t* dump, size_t bytes, std::vector<CANTraceRecord>& records,
+		CANRecorderDumpInfo& info, std::string& error);
+
+#endif /* TOOLS_CAN_TRACE_CAN_TRACE_H_ */
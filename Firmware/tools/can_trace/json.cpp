@@ -0,0 +1,239 @@
+/*
+ * json.cpp
+ *
+ * Recursive descent JSON reader.
+ */
+
+#include "json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const JsonValue nullValue;
+
+class JsonParser {
+public:
+	JsonParser(const std::string& text) : text(text), pos(0) {}
+
+	int document(JsonValue& value, std::string& error) {
+		if (parseValue(value, 0) != 0 || (skipSpace(), pos != text.size())) {
+			char where[32];
+			snprintf(where, sizeof(where), " at offset %u", (unsigned)pos);
+			error = (problem ? problem : "unexpected character") + std::string(where);
+			return -1;
+		}
+		return 0;
+	}
+
+private:
+	static const int MAX_DEPTH = 64;
+
+	const std::string& text;
+	size_t pos;
+	const char* problem = NULL;
+
+	int fail(const char* what) {
+		problem = what;
+		return -1;
+	}
+
+	void skipSpace() {
+		while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+			pos++;
+	}
+
+	bool consume(const char* literal) {
+		size_t n = strlen(literal);
+		if (text.compare(pos, n, literal) != 0)
+			return false;
+		pos += n;
+		return true;
+	}
+
+	int parseValue(JsonValue& value, int depth) {
+		if (depth > MAX_DEPTH)
+			return fail("nesting too deep");
+
+		skipSpace();
+		if (pos >= text.size())
+			return fail("unexpected end of input");
+
+		char c = text[pos];
+		if (c == '{')
+			return parseObject(value, depth);
+		if (c == '[')
+			return parseArray(value, depth);
+		if (c == '"') {
+			value.kind = JsonValue::String;
+			return parseString(value.str);
+		}
+		if (consume("true")) {
+			value.kind = JsonValue::Bool;
+			value.boolean = true;
+			return 0;
+		}
+		if (consume("false")) {
+			value.kind = JsonValue::Bool;
+			value.boolean = false;
+			return 0;
+		}
+		if (consume("null")) {
+			value.kind = JsonValue::Null;
+			return 0;
+		}
+		return parseNumber(value);
+	}
+
+	int parseObject(JsonValue& value, int depth) {
+		value.kind = JsonValue::Object;
+		pos++;
+		skipSpace();
+		if (pos < text.size() && text[pos] == '}') {
+			pos++;
+			return 0;
+		}
+		while (true) {
+			std::string key;
+			skipSpace();
+			if (pos >= text.size() || text[pos] != '"')
+				return fail("expected object key");
+			if (parseString(key) != 0)
+				return -1;
+			skipSpace();
+			if (pos >= text.size() || text[pos] != ':')
+				return fail("expected ':'");
+			pos++;
+			if (parseValue(value.object[key], depth + 1) != 0)
+				return -1;
+			skipSpace();
+			if (pos < text.size() && text[pos] == ',') {
+				pos++;
+				continue;
+			}
+			if (pos < text.size() && text[pos] == '}') {
+				pos++;
+				return 0;
+			}
+			return fail("expected ',' or '}'");
+		}
+	}
+
+	int parseArray(JsonValue& value, int depth) {
+		value.kind = JsonValue::Array;
+		pos++;
+		skipSpace();
+		if (pos < text.size() && text[pos] == ']') {
+			pos++;
+			return 0;
+		}
+		while (true) {
+			value.array.push_back(JsonValue());
+			if (parseValue(value.array.back(), depth + 1) != 0)
+				return -1;
+			skipSpace();
+			if (pos < text.size() && text[pos] == ',') {
+				pos++;
+				continue;
+			}
+			if (pos < text.size() && text[pos] == ']') {
+				pos++;
+				return 0;
+			}
+			return fail("expected ',' or ']'");
+		}
+	}
+
+	int parseString(std::string& out) {
+		pos++;
+		while (pos < text.size()) {
+			char c = text[pos++];
+			if (c == '"')
+				return 0;
+			if (c != '\\') {
+				out += c;
+				continue;
+			}
+			if (pos >= text.size())
+				break;
+			c = text[pos++];
+			switch (c) {
+			case 'n': out += '\n'; break;
+			case 't': out += '\t'; break;
+			case 'r': out += '\r'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'u': {
+				if (pos + 4 > text.size())
+					return fail("bad \\u escape");
+				unsigned long code = strtoul(text.substr(pos, 4).c_str(), NULL, 16);
+				pos += 4;
+				// Names in canDef.json are ASCII; anything else becomes UTF-8
+				if (code < 0x80) {
+					out += (char)code;
+				} else if (code < 0x800) {
+					out += (char)(0xC0 | (code >> 6));
+					out += (char)(0x80 | (code & 0x3F));
+				} else {
+					out += (char)(0xE0 | (code >> 12));
+					out += (char)(0x80 | ((code >> 6) & 0x3F));
+					out += (char)(0x80 | (code & 0x3F));
+				}
+				break;
+			}
+			default: out += c; break;
+			}
+		}
+		return fail("unterminated string");
+	}
+
+	int parseNumber(JsonValue& value) {
+		const char* start = text.c_str() + pos;
+		char* end;
+		double n = strtod(start, &end);
+		if (end == start)
+			return fail("unexpected character");
+		pos += end - start;
+		value.kind = JsonValue::Number;
+		value.num = n;
+		return 0;
+	}
+};
+
+JsonValue::JsonValue() : kind(Null), boolean(false), num(0) {
+}
+
+int JsonValue::parse(const std::string& text, JsonValue& value, std::string& error) {
+	value = JsonValue();
+	JsonParser parser(text);
+	return parser.document(value, error);
+}
+
+double JsonValue::number(double fallback) const {
+	return kind == Number ? num : fallback;
+}
+
+std::string JsonValue::string(const std::string& fallback) const {
+	return kind == String ? str : fallback;
+}
+
+size_t JsonValue::size() const {
+	if (kind == Array)
+		return array.size();
+	if (kind == Object)
+		return object.size();
+	return 0;
+}
+
+const JsonValue& JsonValue::operator[](size_t i) const {
+	if (kind != Array || i >= array.size())
+		return nullValue;
+	return array[i];
+}
+
+const JsonValue& JsonValue::operator[](const char* key) const {
+	if (kind != Object)
+		return nullValue;
+	std::map<std::string, JsonValue>::const_iterator it = object.find(key);
+	return it == object.end() ? nullValue : it->second;
+}
@@ -0,0 +1,75 @@
+/*
+ * json.h
+ * Minimal JSON reader, enough to load canDef.json without dependencies.
+ */
+
+#ifndef TOOLS_CAN_TRACE_JSON_H_
+#define TOOLS_CAN_TRACE_JSON_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+/** Parsed JSON value
+ *
+ *  Lookups that miss return a shared null value, so optional fields can be
+ *  chained without checking each step:
+ *    double m = entry["Multiplier"][i].number(1);
+ */
+class JsonValue {
+public:
+	enum Type { Null, Bool, Number, String, Array, Object };
+
+	JsonValue();
+
+	/**
+	 * Parse a complete JSON document.
+	 * @param text document text
+	 * @param value set to the parsed document
+	 * @param error set to a description of the first problem on failure
+	 * @return 0 on success, -1 on a syntax error
+	 */
+	static int parse(const std::string& text, JsonValue& value, std::string& error);
+
+	Type type() const { return kind; }
+	bool isArray() const { return kind == Array; }
+	bool isObject() const { return kind == Object; }
+	bool isString() const { return kind == String; }
+	bool isNumber() const { return kind == Number; }
+
+	/**
+	 * @param fallback returned if this is not a number
+	 */
+	double number(double fallback = 0) const;
+
+	/**
+	 * @param fallback returned if this is not a string
+	 */
+	std::string string(const std::string& fallback = std::string()) const;
+
+	/**
+	 * @return number of array elements or object members, 0 otherwise
+	 */
+	size_t size() const;
+
+	/** Array element, or null if out of range or not an array */
+	const JsonValue& operator[](size_t i) const;
+
+	/** Object member, or null if missing or not an object */
+	const JsonValue& operator[](const char* key) const;
+
+	/** Object members in key order */
+	const std::map<std::string, JsonValue>& members() const { return object; }
+
+private:
+	friend class JsonParser;
+
+	Type kind;
+	bool boolean;
+	double num;
+	std::string str;
+	std::vector<JsonValue> array;
+	std::map<std::string, JsonValue> object;
+};
+
+#endif /* TOOLS_CAN_TRACE_JSON_H_ */
@@ -0,0 +1,193 @@
+/*
+ * main.cpp
+ *
+ * can_trace: decode a binary CAN trace into one file per signal.
+ *
+ * Usage: can_trace [-j threads] canDef.json trace.bin outDir
+ *        can_trace -r recorderDump.bin trace.bin
+ */
+
+#include "can_trace.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Frames decoded per batch; keeps the per-batch scratch arrays in cache
+#define BATCH_FRAMES 65536
+
+static void usage() {
+	fprintf(stderr, "usage: can_trace [-j threads] canDef.json trace.bin outDir\n");
+	fprintf(stderr, "  trace.bin holds 24-byte CANTraceRecords, see can_trace.h\n");
+	fprintf(stderr, "  writes outDir/<DataName>.timestampUs.u64 and outDir/<DataName>.<value>.f64\n");
+	fprintf(stderr, "       can_trace -r recorderDump.bin trace.bin\n");
+	fprintf(stderr, "  converts a CANRecorder dump to a trace file\n");
+}
+
+static int readTrace(const char* path, std::vector<CANTraceRecord>& records) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	fseek(file, 0, SEEK_END);
+	long bytes = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (bytes < 0 || bytes % sizeof(CANTraceRecord) != 0) {
+		fprintf(stderr, "%s is not a whole number of %u-byte records\n", path, (unsigned)sizeof(CANTraceRecord));
+		fclose(file);
+		return -1;
+	}
+	records.resize(bytes / sizeof(CANTraceRecord));
+	size_t read = records.empty() ? 0 : fread(&records[0], sizeof(CANTraceRecord), records.size(), file);
+	fclose(file);
+	if (read != records.size()) {
+		fprintf(stderr, "short read on %s\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+static void decodeRange(const CANDecodePlan* plan, const CANTraceRecord* records, size_t count, CANColumns* columns) {
+	std::vector<CANMessage> frames(BATCH_FRAMES);
+	std::vector<uint64_t> timestamps(BATCH_FRAMES);
+	plan->prepare(*columns);
+	for (size_t done = 0; done < count; done += BATCH_FRAMES) {
+		size_t n = count - done < BATCH_FRAMES ? count - done : BATCH_FRAMES;
+		canTraceUnpack(records + done, n, &frames[0], &timestamps[0]);
+		plan->decode(&frames[0], &timestamps[0], n, *columns);
+	}
+}
+
+static int writeColumn(const std::string& path, const void* data, size_t bytes) {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file || fwrite(data, 1, bytes, file) != bytes) {
+		fprintf(stderr, "cannot write %s\n", path.c_str());
+		if (file)
+			fclose(file);
+		return -1;
+	}
+	fclose(file);
+	return 0;
+}
+
+static int convertRecorderDump(const char* dumpPath, const char* tracePath) {
+	FILE* file = fopen(dumpPath, "rb");
+	if (!file) {
+		fprintf(stderr, "cannot open %s: %s\n", dumpPath, strerror(errno));
+		return -1;
+	}
+	std::vector<uint8_t> dump;
+	uint8_t chunk[4096];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		dump.insert(dump.end(), chunk, chunk + read);
+	fclose(file);
+
+	std::vector<CANTraceRecord> records;
+	CANRecorderDumpInfo info;
+	std::string error;
+	if (canRecorderDecode(dump.data(), dump.size(), records, info, error) != 0) {
+		fprintf(stderr, "%s: %s\n", dumpPath, error.c_str());
+		return -1;
+	}
+	if (writeColumn(tracePath, records.data(), records.size() * sizeof(CANTraceRecord)) != 0)
+		return -1;
+
+	size_t sent = 0;
+	for (size_t i = 0; i < records.size(); i++) {
+		if (records[i].flags & CAN_TRACE_TX)
+			sent++;
+	}
+	printf("%u frames (%u sent, %u received), %u resets since cleared, %u without their extended ID\n",
+			(unsigned)records.size(), (unsigned)sent, (unsigned)(records.size() - sent), info.boots, info.orphans);
+	for (size_t b = 0; b < info.bootAt.size(); b++) {
+		if (info.bootAt[b] < records.size())
+			printf("reset before frame %u at %.6f s\n", (unsigned)info.bootAt[b], records[info.bootAt[b]].timestampUs / 1e6);
+		else
+			printf("reset after the last frame\n");
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	unsigned threads = std::thread::hardware_concurrency();
+	int arg = 1;
+	if (argc == 4 && strcmp(argv[1], "-r") == 0)
+		return convertRecorderDump(argv[2], argv[3]) == 0 ? 0 : 1;
+	if (arg + 1 < argc && strcmp(argv[arg], "-j") == 0) {
+		threads = atoi(argv[arg + 1]);
+		arg += 2;
+	}
+	if (argc - arg != 3) {
+		usage();
+		return 2;
+	}
+	if (threads < 1)
+		threads = 1;
+	const char* defPath = argv[arg];
+	const char* tracePath = argv[arg + 1];
+	std::string outDir = argv[arg + 2];
+
+	CANDecodePlan plan;
+	std::string error;
+	if (plan.load(defPath, error) != 0) {
+		fprintf(stderr, "%s: %s\n", defPath, error.c_str());
+		return 1;
+	}
+
+	std::vector<CANTraceRecord> records;
+	if (readTrace(tracePath, records) != 0)
+		return 1;
+
+	// Each thread decodes a contiguous slice so joining the slices in order
+	// keeps every column in trace order
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t perThread = (records.size() + threads - 1) / threads;
+	std::vector<CANColumns> slices(threads);
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < threads; t++) {
+		size_t first = t * perThread;
+		size_t count = first >= records.size() ? 0 : std::min(perThread, records.size() - first);
+		workers.push_back(std::thread(decodeRange, &plan, records.data() + first, count, &slices[t]));
+	}
+	for (unsigned t = 0; t < threads; t++)
+		workers[t].join();
+
+	CANColumns columns;
+	plan.prepare(columns);
+	for (unsigned t = 0; t < threads; t++)
+		columns.append(slices[t]);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	mkdir(outDir.c_str(), 0777);
+	for (size_t m = 0; m < plan.messages().size(); m++) {
+		const CANMessageLayout& layout = plan.messages()[m];
+		const CANMessageColumns& decoded = columns.messages[m];
+		if (decoded.timestampUs.empty())
+			continue;
+
+		std::string base = outDir + "/" + layout.name + ".";
+		if (writeColumn(base + "timestampUs.u64", decoded.timestampUs.data(), decoded.timestampUs.size() * sizeof(uint64_t)) != 0)
+			return 1;
+		for (size_t s = 0; s < layout.signals.size(); s++) {
+			const std::vector<double>& values = decoded.values[s];
+			if (writeColumn(base + layout.signals[s].name + ".f64", values.data(), values.size() * sizeof(double)) != 0)
+				return 1;
+		}
+		printf("0x%03X %-28s %10u frames\n", layout.id, layout.name.c_str(), (unsigned)decoded.timestampUs.size());
+	}
+
+	printf("%u frames, %llu unknown, %llu malformed, %llu missing trailing values\n", (unsigned)records.size(),
+			(unsigned long long)columns.unknown, (unsigned long long)columns.malformed,
+			(unsigned long long)columns.truncated);
+	printf("decoded in %.3f s on %u threads (%.1f M frames/s)\n", seconds, threads,
+			seconds > 0 ? records.size() / seconds / 1e6 : 0.0);
+	return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * recorder.cpp
+ *
+ * Decoder for CANRecorder dumps.
+ */
+
+#include "can_trace.h"
+#include <can_recorder.h>
+
+#include <string.h>
+
+static uint32_t wordAt(const uint8_t* dump, size_t word) {
+	const uint8_t* p = dump + word * 4;
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Frames of one run between resets, with times relative to the run's first
+// slot until a marker gives the real time
+struct RecorderRun {
+	std::vector<CANTraceRecord> records;
+	std::vector<uint32_t> times;
+	uint32_t shift;					// add to times for the board's clock
+	uint32_t now;					// relative time of the last slot
+	bool anchored;
+	bool afterBoot;
+
+	RecorderRun() : shift(0), now(0), anchored(false), afterBoot(false) {}
+
+	// A marker says the last slot was at this board time
+	void anchor(uint32_t lastTime) {
+		if (!anchored) {
+			shift = lastTime - now;
+			anchored = true;
+		}
+	}
+};
+
+// Put a run on the 64-bit trace time line after the previous one
+static void appendRun(const RecorderRun& run, uint64_t& end, bool first, std::vector<CANTraceRecord>& records) {
+	if (run.records.empty())
+		return;
+	uint32_t previous = run.times[0] + run.shift;
+	// Continue after the previous run by the time since this one's reset
+	uint64_t time = first ? previous : end + (run.afterBoot ? previous : 0);
+	for (size_t i = 0; i < run.records.size(); i++) {
+		uint32_t t = run.times[i] + run.shift;
+		time += (uint32_t)(t - previous);
+		previous = t;
+		records.push_back(run.records[i]);
+		records.back().timestampUs = time;
+	}
+	end = time;
+}
+
+int canRecorderDecode(const uint8_t* dump, size_t bytes, std::vector<CANTraceRecord>& records,
+		CANRecorderDumpInfo& info, std::string& error) {
+	if (bytes < CAN_RECORDER_HEADER_WORDS * 4 || wordAt(dump, 0) != CAN_RECORDER_MAGIC) {
+		error = "not a CANRecorder dump";
+		return -1;
+	}
+	uint32_t slots = wordAt(dump, 1);
+	if (bytes != (CAN_RECORDER_HEADER_WORDS + (size_t)slots * CAN_RECORDER_SLOT_WORDS) * 4) {
+		error = "dump size does not match its slot count";
+		return -1;
+	}
+	info.boots = wordAt(dump, 2);
+
+	RecorderRun run;
+	uint64_t end = 0;
+	bool first = true;
+	bool haveExtId = false;
+	uint32_t extId = 0;
+	for (uint32_t s = 0; s < slots; s++) {
+		size_t base = CAN_RECORDER_HEADER_WORDS + (size_t)s * CAN_RECORDER_SLOT_WORDS;
+		uint32_t word = wordAt(dump, base);
+		uint32_t len = (word >> CAN_RECORDER_LEN_SHIFT) & CAN_RECORDER_LEN_MASK;
+
+		if (len == CAN_RECORDER_EXT_ID) {
+			extId = wordAt(dump, base + 1);
+			haveExtId = true;
+			continue;
+		}
+		if (len == CAN_RECORDER_TIME) {
+			run.anchor(wordAt(dump, base + 2));
+			run.now = wordAt(dump, base + 1) - run.shift;
+			continue;
+		}
+		if (len == CAN_RECORDER_BOOT) {
+			run.anchor(wordAt(dump, base + 2));
+			appendRun(run, end, first, records);
+			if (!run.records.empty())
+				first = false;
+			run = RecorderRun();
+			run.anchor(wordAt(dump, base + 1));
+			run.afterBoot = true;
+			info.bootAt.push_back(records.size());
+			haveExtId = false;
+			continue;
+		}
+		if (len > 8) {
+			error = "unknown slot type";
+			return -1;
+		}
+
+		run.now += word >> CAN_RECORDER_DELTA_SHIFT;
+		CANTraceRecord record;
+		memset(&record, 0, sizeof(record));
+		record.id = word & CAN_RECORDER_ID_MASK;
+		record.len = len;
+		if (word & CAN_RECORDER_EXTENDED) {
+			if (!haveExtId) {
+				info.orphans++;
+				continue;
+			}
+			record.id = extId;
+			record.flags |= CAN_TRACE_EXTENDED;
+		}
+		haveExtId = false;
+		if (word & CAN_RECORDER_REMOTE)
+			record.flags |= CAN_TRACE_REMOTE;
+		if (word & CAN_RECORDER_TX)
+			record.flags |= CAN_TRACE_TX;
+		uint32_t data[2] = { wordAt(dump, base + 1), wordAt(dump, base + 2) };
+		for (int i = 0; i < 8; i++)
+			record.data[i] = (data[i / 4] >> (8 * (i % 4))) & 0xFF;
+		run.records.push_back(record);
+		run.times.push_back(run.now);
+	}
+	appendRun(run, end, first, records);
+	return 0;
+}
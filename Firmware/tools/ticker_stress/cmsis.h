@@ -0,0 +1,21 @@
+/*
+ * cmsis.h
+ * Host replacement for the interrupt control ticker_api.c uses, so
+ * ticker_stress can time how long interrupts stay disabled.
+ */
+
+#ifndef TOOLS_TICKER_STRESS_CMSIS_H_
+#define TOOLS_TICKER_STRESS_CMSIS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void __disable_irq(void);
+void __enable_irq(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TOOLS_TICKER_STRESS_CMSIS_H_ */
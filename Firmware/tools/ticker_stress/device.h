@@ -0,0 +1,12 @@
+/*
+ * device.h
+ * Host replacement for the target's device.h included by ticker_api.h.
+ */
+
+#ifndef TOOLS_TICKER_STRESS_DEVICE_H_
+#define TOOLS_TICKER_STRESS_DEVICE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#endif /* TOOLS_TICKER_STRESS_DEVICE_H_ */
@@ -0,0 +1,231 @@
+/*
+ * main.cpp
+ *
+ * ticker_stress: drive mbed's ticker event queue with many events and report
+ * how long it keeps interrupts disabled.
+ *
+ * Usage: ticker_stress [-n events] [-r rounds] [-s seed]
+ */
+
+#include "ticker_api.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Interrupt-disabled time of one kind of operation
+struct Section {
+	const char* name;
+	std::vector<uint32_t> ns;
+
+	void report() {
+		if (ns.empty())
+			return;
+		std::sort(ns.begin(), ns.end());
+		uint64_t total = 0;
+		for (size_t i = 0; i < ns.size(); i++)
+			total += ns[i];
+		printf("%-16s %9u %8.0f %8u %8u %8u\n", name, (unsigned)ns.size(), (double)total / ns.size(),
+				ns[ns.size() / 2], ns[ns.size() * 999 / 1000], ns.back());
+	}
+};
+
+static Clock::time_point disabledAt;
+static Section* current;
+
+extern "C" void __disable_irq(void) {
+	disabledAt = Clock::now();
+}
+
+extern "C" void __enable_irq(void) {
+	if (current)
+		current->ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - disabledAt).count());
+}
+
+// Fake us ticker
+static uint32_t nowUs;
+static uint32_t interruptAt;
+static bool interruptSet;
+
+static void tickerInit(void) {}
+static uint32_t tickerRead(void) { return nowUs; }
+static void tickerDisable(void) { interruptSet = false; }
+static void tickerClear(void) {}
+static void tickerSet(timestamp_t timestamp) {
+	interruptAt = timestamp;
+	interruptSet = true;
+}
+
+static const ticker_interface_t fakeInterface = {
+	tickerInit, tickerRead, tickerDisable, tickerClear, tickerSet, NULL
+};
+static ticker_event_queue_t fakeQueue;
+static const ticker_data_t fakeData = { &fakeInterface, &fakeQueue };
+
+// What should be queued, to check the queue against
+static std::multimap<uint64_t, int> model;
+static std::vector<std::multimap<uint64_t, int>::iterator> modelAt;
+static std::vector<ticker_event_t> events;
+static std::vector<bool> queued;
+static std::vector<uint32_t> periods;
+static uint64_t nowUnwrapped;
+static uint32_t fired;
+static bool failed;
+
+static void modelInsert(int i, uint64_t at) {
+	if (queued[i])
+		model.erase(modelAt[i]);
+	// Equal times run in the order they were queued
+	modelAt[i] = model.insert(model.upper_bound(at), std::make_pair(at, i));
+	queued[i] = true;
+}
+
+static void modelRemove(int i) {
+	if (queued[i])
+		model.erase(modelAt[i]);
+	queued[i] = false;
+}
+
+static void insert(int i, uint32_t delay) {
+	uint64_t at = nowUnwrapped + delay;
+	modelInsert(i, at);
+	ticker_insert_event(&fakeData, &events[i], (timestamp_t)at, i);
+}
+
+// Periodic events put themselves back, as Ticker does
+static void handler(uint32_t id) {
+	int i = id;
+	const std::pair<const uint64_t, int>& first = *model.begin();
+	if (first.second != i) {
+		printf("event %d ran, expected %d\n", i, first.second);
+		failed = true;
+	}
+	if ((int32_t)(uint32_t)(first.first - nowUnwrapped) > 0) {
+		printf("event %d ran %u us early\n", i, (uint32_t)(first.first - nowUnwrapped));
+		failed = true;
+	}
+	modelRemove(i);
+	fired++;
+	if (periods[i] != 0)
+		insert(i, periods[i]);
+}
+
+static int treeHeight() {
+	return fakeQueue.root == NULL ? 0 : fakeQueue.root->height;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: ticker_stress [-n events] [-r rounds] [-s seed]\n");
+	fprintf(stderr, "  -n  events in the system (default 128)\n");
+	fprintf(stderr, "  -r  random operations (default 200000)\n");
+	fprintf(stderr, "  -s  random seed (default 1)\n");
+}
+
+int main(int argc, char** argv) {
+	int numEvents = 128;
+	long rounds = 200000;
+	unsigned seed = 1;
+	for (int arg = 1; arg < argc; arg++) {
+		if (arg + 1 < argc && strcmp(argv[arg], "-n") == 0) {
+			numEvents = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-r") == 0) {
+			rounds = atol(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-s") == 0) {
+			seed = atoi(argv[++arg]);
+		} else {
+			usage();
+			return 2;
+		}
+	}
+	if (numEvents < 1 || rounds < 1) {
+		usage();
+		return 2;
+	}
+
+	std::mt19937 random(seed);
+	events.resize(numEvents);
+	memset(&events[0], 0, events.size() * sizeof(ticker_event_t));
+	queued.resize(numEvents);
+	modelAt.resize(numEvents);
+	periods.resize(numEvents);
+	ticker_set_handler(&fakeData, handler);
+
+	// Start just before the 32-bit wrap so it is crossed early on
+	nowUnwrapped = 0xFFFF0000u;
+	nowUs = (uint32_t)nowUnwrapped;
+
+	// Half the events are periodic tickers from 100 us to 100 ms, the rest
+	// timeouts that get attached and detached
+	for (int i = 0; i < numEvents; i++) {
+		periods[i] = i % 2 == 0 ? 100 + random() % 100000 : 0;
+		if (periods[i] != 0)
+			insert(i, random() % periods[i]);
+	}
+
+	Section insertSection = { "insert", std::vector<uint32_t>() };
+	Section removeSection = { "remove", std::vector<uint32_t>() };
+	Section irqSection = { "irq handler", std::vector<uint32_t>() };
+	int maxHeight = 0;
+
+	for (long r = 0; r < rounds && !failed; r++) {
+		int i = random() % numEvents;
+		if (periods[i] == 0 && !queued[i]) {
+			current = &insertSection;
+			insert(i, 1 + random() % 50000);
+		} else if (periods[i] == 0 || random() % 8 == 0) {
+			// Detaching a ticker stops it until attached again
+			current = &removeSection;
+			modelRemove(i);
+			ticker_remove_event(&fakeData, &events[i]);
+			if (periods[i] != 0) {
+				current = &insertSection;
+				insert(i, periods[i]);
+			}
+		} else {
+			// Reattach with the same period, moving it
+			current = &insertSection;
+			insert(i, periods[i]);
+		}
+		current = NULL;
+		maxHeight = std::max(maxHeight, treeHeight());
+
+		// Let time pass and run the interrupt when its match is reached
+		uint32_t step = random() % 200;
+		nowUnwrapped += step;
+		nowUs = (uint32_t)nowUnwrapped;
+		if (interruptSet && (int32_t)(nowUs - interruptAt) >= 0) {
+			current = &irqSection;
+			ticker_irq_handler(&fakeData);
+			current = NULL;
+		}
+
+		// The head of the queue must be the earliest event
+		if (model.empty() != (fakeQueue.head == NULL)
+				|| (!model.empty() && fakeQueue.head != &events[model.begin()->second])) {
+			printf("queue head is wrong after %ld operations\n", r + 1);
+			failed = true;
+		}
+	}
+
+	// log2(n + 2) * 1.44 is the most an AVL tree can grow to
+	double bound = 1.4405 * (31 - __builtin_clz(numEvents + 2) + 1);
+	printf("%d events, %ld operations, %u events run, tree height at most %d (bound %.1f)\n", numEvents, rounds,
+			(unsigned)fired, maxHeight, bound);
+	printf("interrupts disabled (ns): count     mean      p50    p99.9      max\n");
+	insertSection.report();
+	removeSection.report();
+	irqSection.report();
+
+	if (failed || maxHeight > bound) {
+		printf("FAILED\n");
+		return 1;
+	}
+	return 0;
+}
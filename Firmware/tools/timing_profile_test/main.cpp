@@ -0,0 +1,231 @@
+/*
+ * main.cpp
+ *
+ * timing_profile_test: check the counters in timing_profile.h and how
+ * TimingCommon::onTick() feeds them, on a fake clock.
+ *
+ * Usage: timing_profile_test
+ */
+
+#include <mbed.h>
+#include <TimingCommon.h>
+
+#include <stdio.h>
+#include <vector>
+
+#if !TIMING_PROFILE
+#error "Build with -DTIMING_PROFILE=1"
+#endif
+
+uint64_t fakeNowUs = 0;
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK_EQ(actual, expected) check((uint64_t)(actual), (uint64_t)(expected), #actual, __LINE__)
+
+static void check(uint64_t actual, uint64_t expected, const char* what, int line) {
+	checks++;
+	if (actual != expected) {
+		failures++;
+		printf("line %d: %s is %llu, expected %llu\n", line, what,
+				(unsigned long long)actual, (unsigned long long)expected);
+	}
+}
+
+// Callbacks that take a known time by moving the fake clock
+static int slowRuns = 0;
+static void slow() { slowRuns++; fakeNowUs += 300; }
+static void fast() { fakeNowUs += 5; }
+static void instant() {}
+
+// Times of every run of a periodic callback across the 32-bit wrap
+static TimingCommon* wrapTiming;
+static std::vector<uint64_t> wrapRuns;
+static void wrapCallback() { wrapRuns.push_back(wrapTiming->tickTime64()); }
+
+static void testBuckets() {
+	CHECK_EQ(TimingProfile::bucket(0), 0);
+	CHECK_EQ(TimingProfile::bucket(1), 0);
+	CHECK_EQ(TimingProfile::bucket(2), 1);
+	CHECK_EQ(TimingProfile::bucket(3), 1);
+	CHECK_EQ(TimingProfile::bucket(1023), 9);
+	CHECK_EQ(TimingProfile::bucket(1024), 10);
+	CHECK_EQ(TimingProfile::bucket(65535), 15);
+	CHECK_EQ(TimingProfile::bucket(65536), TIMING_PROFILE_BUCKETS - 1);
+	CHECK_EQ(TimingProfile::bucket(UINT32_MAX), TIMING_PROFILE_BUCKETS - 1);
+}
+
+static void testCallbackCounters() {
+	TimingProfile profile;
+	const TimingCallbackProfile& c = profile.callback(2);
+	CHECK_EQ(c.runs, 0);
+	CHECK_EQ(c.minUs, UINT32_MAX);
+	CHECK_EQ(profile.meanRunUs(2), 0);
+
+	profile.callbackRun(2, 0, 1000, 40);
+	profile.callbackRun(2, 2500, 1000, 10);
+	profile.callbackRun(2, 999, 1000, 70);
+	CHECK_EQ(c.runs, 3);
+	CHECK_EQ(c.minUs, 10);
+	CHECK_EQ(c.maxUs, 70);
+	CHECK_EQ(c.totalUs, 120);
+	CHECK_EQ(profile.meanRunUs(2), 40);
+	CHECK_EQ(c.maxLateUs, 2500);
+	CHECK_EQ(c.totalLateUs, 3499);
+	// Only whole periods count as missed
+	CHECK_EQ(c.missed, 2);
+
+	// One-shot callbacks have no period to miss
+	profile.callbackRun(3, 5000, 0, 1);
+	CHECK_EQ(profile.callback(3).missed, 0);
+	CHECK_EQ(profile.callback(3).maxLateUs, 5000);
+
+	profile.clearCallback(2);
+	CHECK_EQ(c.runs, 0);
+	CHECK_EQ(c.minUs, UINT32_MAX);
+	CHECK_EQ(c.missed, 0);
+	CHECK_EQ(profile.callback(3).runs, 1);
+}
+
+static void testLoopHistogram() {
+	TimingProfile profile;
+	CHECK_EQ(profile.loopPercentileBucket(50), 0);
+	CHECK_EQ(profile.loopMeanUs(), 0);
+
+	for (int i = 0; i < 98; i++)
+		profile.loopPeriod(10);
+	profile.loopPeriod(1500);
+	profile.loopPeriod(100000);
+	CHECK_EQ(profile.loopCount(), 100);
+	CHECK_EQ(profile.loopMeanUs(), (98 * 10 + 1500 + 100000) / 100);
+	CHECK_EQ(profile.loopMax(), 100000);
+	CHECK_EQ(profile.loopHistogram(3), 98);
+	CHECK_EQ(profile.loopHistogram(10), 1);
+	CHECK_EQ(profile.loopHistogram(TIMING_PROFILE_BUCKETS - 1), 1);
+	CHECK_EQ(profile.loopPercentileBucket(50), 3);
+	CHECK_EQ(profile.loopPercentileBucket(98), 3);
+	CHECK_EQ(profile.loopPercentileBucket(99), 10);
+	CHECK_EQ(profile.loopPercentileBucket(100), TIMING_PROFILE_BUCKETS - 1);
+
+	profile.clear();
+	CHECK_EQ(profile.loopCount(), 0);
+	CHECK_EQ(profile.loopMax(), 0);
+	CHECK_EQ(profile.loopHistogram(3), 0);
+}
+
+static void testOnTick() {
+	fakeNowUs = 0;
+	TimingCommon timing;
+	Timer timer;
+	TimingHandle slowHandle, fastHandle, timeoutHandle;
+	timing.addCallback(999, slow, &slowHandle);
+	timing.addCallback(99, fast, &fastHandle);
+	timing.addTimeout(500, instant, &timeoutHandle);
+	timing.start(&timer);
+	const TimingProfile& profile = timing.profile();
+	const TimingCallbackProfile& s = profile.callback(slowHandle & 0xFF);
+	const TimingCallbackProfile& f = profile.callback(fastHandle & 0xFF);
+	const TimingCallbackProfile& t = profile.callback(timeoutHandle & 0xFF);
+
+	// Everything due at once: runs are timed one by one, lateness is
+	// from the tick
+	fakeNowUs = 1000;
+	timing.onTick(NULL);
+	CHECK_EQ(fakeNowUs, 1305);
+	CHECK_EQ(f.runs, 1);
+	CHECK_EQ(f.maxUs, 5);
+	CHECK_EQ(f.maxLateUs, 900);
+	CHECK_EQ(f.missed, 9);
+	CHECK_EQ(s.runs, 1);
+	CHECK_EQ(s.maxUs, 300);
+	CHECK_EQ(s.maxLateUs, 0);
+	CHECK_EQ(t.runs, 1);
+	CHECK_EQ(t.maxLateUs, 500);
+	CHECK_EQ(t.missed, 0);
+
+	// A long stall: two whole periods of slow missed
+	fakeNowUs = 4500;
+	timing.onTick(NULL);
+	CHECK_EQ(slowRuns, 2);
+	CHECK_EQ(s.runs, 2);
+	CHECK_EQ(s.minUs, 300);
+	CHECK_EQ(s.totalUs, 600);
+	CHECK_EQ(s.maxLateUs, 2500);
+	CHECK_EQ(s.missed, 2);
+	CHECK_EQ(f.runs, 2);
+
+	// Loop periods are from tick to tick, callbacks included
+	CHECK_EQ(profile.loopCount(), 2);
+	CHECK_EQ(profile.loopMax(), 3500);
+	CHECK_EQ(profile.loopHistogram(9), 1);
+	CHECK_EQ(profile.loopHistogram(11), 1);
+
+	// A new callback in a freed entry starts from clean counters
+	TimingHandle reused;
+	timing.addTimeout(10, instant, &reused);
+	CHECK_EQ(reused & 0xFF, timeoutHandle & 0xFF);
+	CHECK_EQ(t.runs, 0);
+	CHECK_EQ(t.maxLateUs, 0);
+
+	timing.clearProfile();
+	CHECK_EQ(s.runs, 0);
+	CHECK_EQ(s.minUs, UINT32_MAX);
+	CHECK_EQ(profile.loopCount(), 0);
+}
+
+static void testNothingDue() {
+	fakeNowUs = 5000;
+	TimingCommon timing;
+	Timer timer;
+	timing.start(&timer);
+	timing.onTick(NULL);
+	CHECK_EQ(timing.pending(), 0);
+	CHECK_EQ(timing.nextDeadline(), 5000u + INT32_MAX);
+}
+
+static void testWrap() {
+	// Start 3 ms before the 32-bit time wraps
+	fakeNowUs = 0xFFFFF448u;
+	TimingCommon timing;
+	Timer timer;
+	wrapTiming = &timing;
+	wrapRuns.clear();
+	timing.addCallback(999, wrapCallback);
+	timing.start(&timer);
+
+	int overflows = 0;
+	for (int i = 0; i < 10000; i++) {
+		fakeNowUs++;
+		bool overflow;
+		timing.onTick(&overflow);
+		if (overflow) {
+			overflows++;
+			CHECK_EQ(fakeNowUs, 0x100000000ull);
+		}
+	}
+	CHECK_EQ(overflows, 1);
+	CHECK_EQ(timing.tickTime64(), 0xFFFFF448ull + 10000);
+	CHECK_EQ(wrapRuns.size(), 10);
+	for (size_t i = 1; i < wrapRuns.size(); i++)
+		CHECK_EQ(wrapRuns[i] - wrapRuns[i - 1], 1000);
+
+	const TimingCallbackProfile& w = timing.profile().callback(0);
+	CHECK_EQ(w.runs, 10);
+	CHECK_EQ(w.maxLateUs, 0);
+	CHECK_EQ(w.missed, 0);
+	CHECK_EQ(timing.profile().loopCount(), 10000);
+	CHECK_EQ(timing.profile().loopHistogram(0), 10000);
+}
+
+int main() {
+	testBuckets();
+	testCallbackCounters();
+	testLoopHistogram();
+	testOnTick();
+	testNothingDue();
+	testWrap();
+
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+/*
+ * mbed.h
+ * Host replacement for the parts of mbed TimingCommon uses: a Timer that
+ * reads a fake clock the test moves by hand.
+ */
+
+#ifndef TOOLS_TIMING_PROFILE_TEST_MBED_H_
+#define TOOLS_TIMING_PROFILE_TEST_MBED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../../mbed/libraries/mbed/api/FunctionPointer.h"
+
+// Time (us) every Timer reads, moved only by the test and its callbacks
+extern uint64_t fakeNowUs;
+
+/** mbed Timer reading fakeNowUs */
+class Timer {
+public:
+	void start() {}
+	uint64_t read_high_resolution_us() { return fakeNowUs; }
+	int read_us() { return (int)fakeNowUs; }
+};
+
+#endif /* TOOLS_TIMING_PROFILE_TEST_MBED_H_ */
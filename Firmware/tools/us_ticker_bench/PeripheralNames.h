@@ -0,0 +1,9 @@
+/*
+ * PeripheralNames.h
+ * Host replacement for the LPC15XX peripheral names; us_ticker.c uses none.
+ */
+
+#ifndef TOOLS_US_TICKER_BENCH_PERIPHERALNAMES_H_
+#define TOOLS_US_TICKER_BENCH_PERIPHERALNAMES_H_
+
+#endif /* TOOLS_US_TICKER_BENCH_PERIPHERALNAMES_H_ */
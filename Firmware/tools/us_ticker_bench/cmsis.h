@@ -0,0 +1,45 @@
+/*
+ * cmsis.h
+ * Host replacement for the LPC15XX CMSIS headers, as far as us_ticker.c
+ * uses them. LPC_RIT is plain memory that the benchmark sets to the
+ * count it wants read.
+ */
+
+#ifndef TOOLS_US_TICKER_BENCH_CMSIS_H_
+#define TOOLS_US_TICKER_BENCH_CMSIS_H_
+
+#include <stdint.h>
+
+/** RIT registers, laid out as LPC_RIT_Type */
+struct LPC_RIT_Type {
+	volatile uint32_t COMPVAL;
+	volatile uint32_t MASK;
+	volatile uint32_t CTRL;
+	volatile uint32_t COUNTER;
+	volatile uint32_t COMPVAL_H;
+	volatile uint32_t MASK_H;
+	volatile uint32_t RESERVED0;
+	volatile uint32_t COUNTER_H;
+};
+
+/** Clock registers us_ticker_init() sets */
+struct LPC_SYSCON_Type {
+	volatile uint32_t SYSAHBCLKCTRL1;
+	volatile uint32_t PRESETCTRL1;
+};
+
+extern LPC_RIT_Type hostRIT;
+extern LPC_SYSCON_Type hostSYSCON;
+
+#define LPC_RIT (&hostRIT)
+#define LPC_SYSCON (&hostSYSCON)
+
+extern uint32_t SystemCoreClock;
+
+// The benchmark never takes the interrupt
+#define RIT_IRQn 15
+#define NVIC_SetVector(irq, vector) ((void)0)
+#define NVIC_EnableIRQ(irq) ((void)0)
+#define NVIC_SetPendingIRQ(irq) ((void)0)
+
+#endif /* TOOLS_US_TICKER_BENCH_CMSIS_H_ */
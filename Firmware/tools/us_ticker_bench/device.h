@@ -0,0 +1,13 @@
+/*
+ * device.h
+ * Host replacement for the LPC15XX device.h included by ticker_api.h.
+ */
+
+#ifndef TOOLS_US_TICKER_BENCH_DEVICE_H_
+#define TOOLS_US_TICKER_BENCH_DEVICE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cmsis.h"
+
+#endif /* TOOLS_US_TICKER_BENCH_DEVICE_H_ */
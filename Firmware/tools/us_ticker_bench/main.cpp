@@ -0,0 +1,171 @@
+/*
+ * main.cpp
+ *
+ * us_ticker_bench: check the LPC15XX us ticker's multiply by a reciprocal
+ * against the division it replaced, and time a read with each.
+ *
+ * Usage: us_ticker_bench [-n countsPerRate] [-r reads] [-m ticksPerUs]
+ */
+
+// Built as part of this file so it runs against this folder's LPC_RIT
+#include "../../mbed/libraries/mbed/targets/hal/TARGET_NXP/TARGET_LPC15XX/us_ticker.c"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+LPC_RIT_Type hostRIT;
+LPC_SYSCON_Type hostSYSCON;
+uint32_t SystemCoreClock = 72000000;
+
+void us_ticker_irq_handler(void) {
+}
+
+static const int MAX_TICKS_PER_US = 128;
+// Counts checked at each end of the 48-bit range
+static const uint64_t END_COUNTS = 4096;
+
+static uint64_t randomState = 0x2545F4914F6CDD1DULL;
+
+// xorshift64, so every run checks the same counts
+static uint64_t random48() {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	return randomState & RIT_COUNTER_MASK;
+}
+
+static void setCount(uint64_t count) {
+	hostRIT.COUNTER = (uint32_t)count;
+	hostRIT.COUNTER_H = (uint32_t)(count >> 32);
+}
+
+/*
+ * us_ticker_read() before the reciprocal, widened to 64 bits: one 64-bit
+ * division per read.
+ */
+static uint64_t divisionRead() {
+	uint64_t temp;
+	temp = hostRIT.COUNTER | ((uint64_t)hostRIT.COUNTER_H << 32);
+	temp /= (SystemCoreClock / 1000000);
+	return temp;
+}
+
+/*
+ * Read count through us_ticker_read_64() and us_ticker_read().
+ * @return false, after printing it, if either differs from the division
+ */
+static bool check(uint64_t count, uint32_t ticksPerUs) {
+	setCount(count);
+	uint64_t expected = count / ticksPerUs;
+	uint64_t read64 = us_ticker_read_64();
+	uint32_t read32 = us_ticker_read();
+	if (read64 == expected && read32 == (uint32_t)expected)
+		return true;
+	printf("%3u ticks/us, count 0x%012llx: expected %llu, read_64 %llu, read %u\n", ticksPerUs,
+			(unsigned long long)count, (unsigned long long)expected, (unsigned long long)read64, read32);
+	return false;
+}
+
+/*
+ * Check every tick rate from 1 to MAX_TICKS_PER_US on both ends of the
+ * counter range, on either side of multiples of the rate and at random.
+ * @return number of counts that differed
+ */
+static uint64_t sweep(int countsPerRate, uint64_t& checked) {
+	uint64_t mismatches = 0;
+	for (uint32_t ticksPerUs = 1; ticksPerUs <= MAX_TICKS_PER_US; ticksPerUs++) {
+		SystemCoreClock = ticksPerUs * 1000000;
+		for (uint64_t i = 0; i < END_COUNTS; i++) {
+			mismatches += !check(i, ticksPerUs);
+			mismatches += !check(RIT_COUNTER_MASK - i, ticksPerUs);
+		}
+		for (int i = 0; i < countsPerRate; i++) {
+			uint64_t multiple = random48() / ticksPerUs * ticksPerUs;
+			mismatches += !check(multiple, ticksPerUs);
+			if (multiple > 0)
+				mismatches += !check(multiple - 1, ticksPerUs);
+			mismatches += !check(random48(), ticksPerUs);
+		}
+		checked += 2 * END_COUNTS + 3 * (uint64_t)countsPerRate;
+		if (mismatches > 20) {
+			printf("stopping after %llu mismatches\n", (unsigned long long)mismatches);
+			break;
+		}
+	}
+	return mismatches;
+}
+
+/*
+ * Time reads of changing counts.
+ * @param read conversion to time, or 0 to time the counter reads alone
+ * @return ns per read
+ */
+static double timeReads(uint64_t (*read)(), int reads, uint64_t& sink) {
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < reads; i++) {
+		count = (count + 0x10000000DULL) & RIT_COUNTER_MASK;
+		setCount(count);
+		if (read)
+			sum += read();
+		else
+			sum += hostRIT.COUNTER | ((uint64_t)hostRIT.COUNTER_H << 32);
+	}
+	auto end = std::chrono::steady_clock::now();
+	sink += sum;
+	return std::chrono::duration<double, std::nano>(end - start).count() / reads;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: us_ticker_bench [-n countsPerRate] [-r reads] [-m ticksPerUs]\n");
+	fprintf(stderr, "  -n  random counts checked per tick rate (default 100000)\n");
+	fprintf(stderr, "  -r  reads timed per path (default 10000000)\n");
+	fprintf(stderr, "  -m  ticks per us while timing, 1 to %d (default 72)\n", MAX_TICKS_PER_US);
+}
+
+int main(int argc, char** argv) {
+	int countsPerRate = 100000;
+	int reads = 10000000;
+	int timedTicksPerUs = 72;
+	for (int arg = 1; arg < argc; arg++) {
+		if (arg + 1 < argc && strcmp(argv[arg], "-n") == 0) {
+			countsPerRate = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-r") == 0) {
+			reads = atoi(argv[++arg]);
+		} else if (arg + 1 < argc && strcmp(argv[arg], "-m") == 0) {
+			timedTicksPerUs = atoi(argv[++arg]);
+		} else {
+			usage();
+			return 2;
+		}
+	}
+	if (countsPerRate < 0 || reads < 1 || timedTicksPerUs < 1 || timedTicksPerUs > MAX_TICKS_PER_US) {
+		usage();
+		return 2;
+	}
+
+	us_ticker_init();
+
+	uint64_t checked = 0;
+	uint64_t mismatches = sweep(countsPerRate, checked);
+	printf("1 to %d ticks/us: %llu counts checked, %llu mismatches\n\n", MAX_TICKS_PER_US,
+			(unsigned long long)checked, (unsigned long long)mismatches);
+
+	SystemCoreClock = timedTicksPerUs * 1000000;
+	uint64_t sink = 0;
+	double counter = timeReads(0, reads, sink);
+	double division = timeReads(divisionRead, reads, sink);
+	double multiply = timeReads(us_ticker_read_64, reads, sink);
+	printf("%d reads at %d ticks/us    ns/read  conversion ns\n", reads, timedTicksPerUs);
+	printf("%-26s %8.2f\n", "counter only", counter);
+	printf("%-26s %8.2f %14.2f\n", "division (before)", division, division - counter);
+	printf("%-26s %8.2f %14.2f\n", "reciprocal multiply", multiply, multiply - counter);
+	// Keeps the reads from being optimized out
+	if (sink == 1)
+		printf("\n");
+
+	return mismatches == 0 ? 0 : 1;
+}